@@ -3,6 +3,7 @@
 #include "core/uloop_scheduler.h"
 #include "http/http-requests.h"
 #include "services/config/config.h"
+#include "services/ubus_server.h"
 #include <json-c/json.h>
 #include <stdbool.h>
 #include <stdio.h>
@@ -328,6 +329,9 @@ void access_token_task(void *task_context) {
         context->callbacks->on_token_refresh(context->access_token->token, context->callbacks->context);
     }
 
+    // Let UBUS clients such as fry-collector fetch the new token
+    ubus_server_notify_token_refresh();
+
     // Schedule the next refresh
     uint32_t next_delay_ms = calculate_next_delay_ms(context->access_token->expires_at_seconds, config.access_interval);
     console_debug(&csl, "Scheduling next access token refresh in %u ms", next_delay_ms);
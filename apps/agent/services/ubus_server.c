@@ -379,5 +379,22 @@ void ubus_server_cleanup(void) {
 // Check if server is running
 bool ubus_server_is_running(void) { return server_running && ubus_ctx != NULL; }
 
+// Announce a rotated access token
+void ubus_server_notify_token_refresh(void) {
+    if (!ubus_server_is_running() || !server_context || !server_context->access_token) {
+        return;
+    }
+
+    struct blob_buf event = {0};
+    blob_buf_init(&event, 0);
+    blobmsg_add_u64(&event, "expires_at", server_context->access_token->expires_at_seconds);
+
+    int ret = ubus_send_event(ubus_ctx, FRY_AGENT_TOKEN_EVENT, event.head);
+    if (ret) {
+        console_warn(&csl, "Failed to send %s event: %s", FRY_AGENT_TOKEN_EVENT, ubus_strerror(ret));
+    }
+    blob_buf_free(&event);
+}
+
 // Get UBUS context (for internal use)
 struct ubus_context *ubus_server_get_context(void) { return ubus_ctx; }
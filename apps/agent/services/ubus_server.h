@@ -11,6 +11,9 @@
 // UBUS service name for the agent
 #define FRY_AGENT_SERVICE_NAME "fry-agent"
 
+// UBUS event sent after the access token was rotated
+#define FRY_AGENT_TOKEN_EVENT "fry-agent.token"
+
 // UBUS method handler function type
 typedef int (*UbusMethodHandler)(struct ubus_context *ctx,
                                  struct ubus_object *obj,
@@ -76,6 +79,12 @@ void ubus_server_cleanup(void);
  */
 bool ubus_server_is_running(void);
 
+/**
+ * Announce a rotated access token to UBUS clients (e.g. fry-collector)
+ * Only the expiry is broadcast, clients fetch the token with get_access_token.
+ */
+void ubus_server_notify_token_refresh(void);
+
 /**
  * Get the UBUS context (for internal use)
  * @return Pointer to UBUS context or NULL if not initialized
@@ -0,0 +1,82 @@
+#include "adaptive.h"
+#include "core/console.h"
+#include <string.h>
+
+static Console csl = {
+    .topic = "adaptive",
+};
+
+static uint32_t clamp_u32(uint32_t value, uint32_t min, uint32_t max) {
+    if (value < min) return min;
+    if (value > max) return max;
+    return value;
+}
+
+void adaptive_init(adaptive_batching_t *adaptive, bool enabled, uint32_t batch_size, uint32_t size_min,
+                   uint32_t size_max, uint32_t timeout_ms, uint32_t timeout_min_ms, uint32_t timeout_max_ms,
+                   uint32_t urgent_percent) {
+    memset(adaptive, 0, sizeof(*adaptive));
+
+    adaptive->enabled = enabled;
+    adaptive->size_min = size_min;
+    adaptive->size_max = size_max;
+    adaptive->timeout_min_ms = timeout_min_ms;
+    adaptive->timeout_max_ms = timeout_max_ms;
+    adaptive->urgent_base = urgent_percent;
+
+    adaptive->batch_size = batch_size;
+    adaptive->batch_timeout_ms = timeout_ms;
+    adaptive->urgent_percent = urgent_percent;
+    adaptive->success = 1.0;
+}
+
+void adaptive_record_upload(adaptive_batching_t *adaptive, double rtt_ms, bool success, uint32_t queue_fill_percent) {
+    if (!adaptive->enabled) {
+        return;
+    }
+
+    // The first sample seeds the RTT average
+    if (adaptive->samples++ == 0) {
+        adaptive->rtt_ms = rtt_ms;
+    } else {
+        adaptive->rtt_ms += ADAPTIVE_EWMA_WEIGHT * (rtt_ms - adaptive->rtt_ms);
+    }
+    adaptive->success += ADAPTIVE_EWMA_WEIGHT * ((success ? 1.0 : 0.0) - adaptive->success);
+
+    uint32_t size = adaptive->batch_size;
+    uint32_t timeout = adaptive->batch_timeout_ms;
+
+    if (queue_fill_percent >= ADAPTIVE_QUEUE_HIGH_PERCENT || adaptive->rtt_ms >= ADAPTIVE_RTT_HIGH_MS ||
+        adaptive->success < ADAPTIVE_SUCCESS_LOW) {
+        // Requests are expensive or cannot keep up: fewer, larger batches
+        size = clamp_u32(size * 2, adaptive->size_min, adaptive->size_max);
+        timeout = clamp_u32(timeout + timeout / 2, adaptive->timeout_min_ms, adaptive->timeout_max_ms);
+    } else if (queue_fill_percent <= ADAPTIVE_QUEUE_LOW_PERCENT && adaptive->rtt_ms <= ADAPTIVE_RTT_LOW_MS &&
+               adaptive->success >= ADAPTIVE_SUCCESS_HIGH) {
+        // Fast, idle link: trade request count for latency
+        size = clamp_u32(size - (size / 4 ? size / 4 : 1), adaptive->size_min, adaptive->size_max);
+        timeout = clamp_u32(timeout - timeout / 4, adaptive->timeout_min_ms, adaptive->timeout_max_ms);
+    }
+
+    // Seal early on slow links, a full queue takes longer to drain
+    double slowness = adaptive->rtt_ms / ADAPTIVE_RTT_HIGH_MS;
+    if (slowness > 1.0) slowness = 1.0;
+    uint32_t urgent = adaptive->urgent_base;
+    if (urgent > ADAPTIVE_URGENT_MIN_PERCENT) {
+        urgent -= (uint32_t)((urgent - ADAPTIVE_URGENT_MIN_PERCENT) * slowness);
+    }
+    adaptive->urgent_percent = urgent;
+
+    if (size != adaptive->batch_size || timeout != adaptive->batch_timeout_ms) {
+        if (size > adaptive->batch_size || timeout > adaptive->batch_timeout_ms) {
+            adaptive->grown++;
+        } else {
+            adaptive->shrunk++;
+        }
+        console_debug(&csl, "Batch size %u -> %u, timeout %u -> %u ms (rtt %.0f ms, success %.0f%%, queue %u%%)",
+                      adaptive->batch_size, size, adaptive->batch_timeout_ms, timeout, adaptive->rtt_ms,
+                      adaptive->success * 100.0, queue_fill_percent);
+        adaptive->batch_size = size;
+        adaptive->batch_timeout_ms = timeout;
+    }
+}
@@ -0,0 +1,68 @@
+#ifndef ADAPTIVE_H
+#define ADAPTIVE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define ADAPTIVE_EWMA_WEIGHT 0.2       // Weight of the newest sample
+#define ADAPTIVE_RTT_LOW_MS 150.0      // Below this the link counts as fast
+#define ADAPTIVE_RTT_HIGH_MS 750.0     // Above this requests are expensive, batch more
+#define ADAPTIVE_QUEUE_LOW_PERCENT 10  // Queue fill below which batches may shrink
+#define ADAPTIVE_QUEUE_HIGH_PERCENT 50 // Queue fill above which batches grow
+#define ADAPTIVE_SUCCESS_LOW 0.8       // Success rate below which batches grow (fewer requests)
+#define ADAPTIVE_SUCCESS_HIGH 0.95     // Success rate required to shrink batches
+#define ADAPTIVE_URGENT_MIN_PERCENT 60 // Lowest urgent threshold, reached at ADAPTIVE_RTT_HIGH_MS
+
+/**
+ * Batch size and timeout controller
+ * Upload round trip time and success rate are tracked as moving averages.
+ * Slow or failing uploads and a filling queue grow batches multiplicatively
+ * (fewer, larger requests); a fast, idle link shrinks them gradually for low
+ * latency. Both values stay within the configured bounds.
+ */
+typedef struct adaptive_batching {
+    bool enabled;
+    uint32_t size_min;
+    uint32_t size_max;
+    uint32_t timeout_min_ms;
+    uint32_t timeout_max_ms;
+    uint32_t urgent_base; // Urgent threshold in percent at zero RTT
+
+    uint32_t batch_size;       // Current batch size
+    uint32_t batch_timeout_ms; // Current batch timeout
+    uint32_t urgent_percent;   // Current urgent threshold
+
+    double rtt_ms;    // Moving average of the upload round trip
+    double success;   // Moving average of the upload success rate (0-1)
+    uint32_t samples; // Uploads measured
+    uint32_t grown;   // Adjustments towards larger batches
+    uint32_t shrunk;  // Adjustments towards smaller batches
+} adaptive_batching_t;
+
+/**
+ * Initialize the controller
+ * With enabled false the initial values are kept for good.
+ * @param adaptive Controller to initialize
+ * @param enabled Adapt to measurements
+ * @param batch_size Initial batch size
+ * @param size_min Lower bound of the batch size
+ * @param size_max Upper bound of the batch size
+ * @param timeout_ms Initial batch timeout
+ * @param timeout_min_ms Lower bound of the batch timeout
+ * @param timeout_max_ms Upper bound of the batch timeout
+ * @param urgent_percent Urgent queue threshold at zero RTT
+ */
+void adaptive_init(adaptive_batching_t *adaptive, bool enabled, uint32_t batch_size, uint32_t size_min,
+                   uint32_t size_max, uint32_t timeout_ms, uint32_t timeout_min_ms, uint32_t timeout_max_ms,
+                   uint32_t urgent_percent);
+
+/**
+ * Feed the outcome of a batch upload and adjust the batch parameters
+ * @param adaptive Controller
+ * @param rtt_ms Time from dispatch to completion
+ * @param success Whether the backend accepted the batch
+ * @param queue_fill_percent Current queue fill level
+ */
+void adaptive_record_upload(adaptive_batching_t *adaptive, double rtt_ms, bool success, uint32_t queue_fill_percent);
+
+#endif // ADAPTIVE_H
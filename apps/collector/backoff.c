@@ -0,0 +1,67 @@
+#include "backoff.h"
+#include <stdbool.h>
+#include <string.h>
+
+/**
+ * xorshift64, plenty for spreading retries
+ */
+static uint64_t next_random(backoff_t *backoff) {
+    uint64_t x = backoff->rng;
+
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    backoff->rng = x;
+    return x;
+}
+
+void backoff_init(backoff_t *backoff, uint32_t base_ms, uint32_t max_ms, uint64_t seed) {
+    memset(backoff, 0, sizeof(*backoff));
+    backoff->base_ms = base_ms ? base_ms : 1;
+    backoff->max_ms = max_ms > backoff->base_ms ? max_ms : backoff->base_ms;
+
+    // xorshift must not start from zero
+    backoff->rng = seed ? seed : 0x9e3779b97f4a7c15ULL;
+}
+
+uint32_t backoff_failure(backoff_t *backoff, uint32_t retry_after_ms, uint64_t now_ms) {
+    // Requests that were in flight when the backoff started fail together, they share its level
+    bool active = now_ms < backoff->until_ms;
+    uint32_t level = active && backoff->attempt > 0 ? backoff->attempt - 1 : backoff->attempt;
+    uint64_t ceiling = backoff->base_ms;
+    uint32_t delay;
+
+    // base * 2^level, without overflowing past max
+    for (uint32_t i = 0; i < level && ceiling < backoff->max_ms; i++) {
+        ceiling <<= 1;
+    }
+    if (ceiling > backoff->max_ms) {
+        ceiling = backoff->max_ms;
+    }
+
+    delay = (uint32_t)(next_random(backoff) % (ceiling + 1));
+
+    // The server knows best when it can take requests again, jitter on top keeps the fleet apart
+    if (retry_after_ms > delay) {
+        delay = retry_after_ms + (uint32_t)(next_random(backoff) % (retry_after_ms / 4 + 1));
+    }
+
+    if (!active && backoff->attempt < 32) {
+        backoff->attempt++;
+    }
+    backoff->delay_ms = delay;
+    if (now_ms + delay > backoff->until_ms) {
+        backoff->until_ms = now_ms + delay;
+    }
+    return delay;
+}
+
+void backoff_reset(backoff_t *backoff) {
+    backoff->attempt = 0;
+    backoff->delay_ms = 0;
+    backoff->until_ms = 0;
+}
+
+uint32_t backoff_remaining_ms(const backoff_t *backoff, uint64_t now_ms) {
+    return backoff->until_ms > now_ms ? (uint32_t)(backoff->until_ms - now_ms) : 0;
+}
@@ -0,0 +1,55 @@
+#ifndef BACKOFF_H
+#define BACKOFF_H
+
+#include <stdint.h>
+
+/**
+ * Exponential backoff with full jitter
+ * The n-th consecutive failure waits a random time between 0 and
+ * min(max, base * 2^n), so devices that failed together do not retry
+ * together. A server requested delay (Retry-After) is a lower bound, with up
+ * to a quarter of it added as jitter. Failures of requests that were already
+ * in flight when the backoff started draw from the same level instead of
+ * escalating it once per request.
+ */
+typedef struct backoff {
+    uint32_t base_ms;
+    uint32_t max_ms;
+    uint32_t attempt;  // Consecutive failures
+    uint32_t delay_ms; // Delay chosen for the last failure
+    uint64_t until_ms; // Monotonic time before which the backend is left alone, 0 if not backing off
+    uint64_t rng;      // xorshift64 state
+} backoff_t;
+
+/**
+ * Initialize the backoff
+ * @param backoff Backoff to initialize
+ * @param base_ms Upper bound of the first delay
+ * @param max_ms Upper bound of any jittered delay
+ * @param seed Random seed, should differ between devices
+ */
+void backoff_init(backoff_t *backoff, uint32_t base_ms, uint32_t max_ms, uint64_t seed);
+
+/**
+ * Record a failure and pick the delay before the next attempt
+ * @param backoff Backoff
+ * @param retry_after_ms Delay requested by the server, 0 if none
+ * @param now_ms Monotonic time in milliseconds
+ * @return delay in milliseconds
+ */
+uint32_t backoff_failure(backoff_t *backoff, uint32_t retry_after_ms, uint64_t now_ms);
+
+/**
+ * Record a success, the next failure starts over at base_ms
+ */
+void backoff_reset(backoff_t *backoff);
+
+/**
+ * Time left until the backend may be contacted again
+ * @param backoff Backoff
+ * @param now_ms Monotonic time in milliseconds
+ * @return milliseconds, 0 if not backing off
+ */
+uint32_t backoff_remaining_ms(const backoff_t *backoff, uint64_t now_ms);
+
+#endif // BACKOFF_H
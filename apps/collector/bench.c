@@ -0,0 +1,620 @@
+#include "bench_sink.h"
+#include "collect.h"
+#include "config.h"
+#include "core/console.h"
+#include "filter.h"
+#include "ubus.h"
+#include <errno.h>
+#include <libubox/blobmsg.h>
+#include <libubox/uloop.h>
+#include <libubox/utils.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <syslog.h>
+#include <time.h>
+#include <unistd.h>
+
+#define BENCH_DEFAULT_COUNT 100000
+#define BENCH_DEFAULT_DRAIN_S 30
+#define BENCH_WRITE_CHUNK (64 * 1024) // Stream bytes stamped and written at once when unpaced
+#define BENCH_PACE_TICK_MS 10
+#define BENCH_MONITOR_MS 100
+
+static Console csl = {
+    .topic = "bench",
+};
+
+typedef struct bench_options {
+    const char *config_file;
+    const char *replay_file;
+    uint32_t count;
+    uint32_t rate;
+    uint32_t duplicate_percent;
+    bool external_sink;
+    uint32_t sink_delay_ms;
+    uint32_t sink_fail_percent;
+    uint32_t drain_timeout_s;
+    bool verbose;
+} bench_options_t;
+
+/**
+ * Encoded log stream as logd writes it to readers: one blob per record
+ */
+typedef struct log_stream_buf {
+    uint8_t *data;
+    size_t len;
+    size_t size;
+    uint32_t records;
+} log_stream_buf_t;
+
+static bench_options_t options = {
+    .drain_timeout_s = BENCH_DEFAULT_DRAIN_S,
+};
+
+// Run state
+static struct uloop_timeout monitor_timer;
+static uint64_t start_ms = 0;
+static uint64_t feed_end_ms = 0;
+static uint64_t end_ms = 0;
+static bool timed_out = false;
+static volatile bool interrupted = false;
+
+// Synthetic messages, each with one %u that makes it unique
+static const struct {
+    uint32_t priority;
+    uint32_t source;
+    const char *format;
+} templates[] = {
+    {LOG_DAEMON | LOG_INFO, FILTER_SOURCE_SYSLOG,
+     "dnsmasq-dhcp[1432]: DHCPACK(br-lan) 192.168.1.23 3c:22:fb:41:9e:07 client-%u"},
+    {LOG_DAEMON | LOG_NOTICE, FILTER_SOURCE_SYSLOG, "netifd: Interface 'wan' has link connectivity (event %u)"},
+    {LOG_KERN | LOG_INFO, FILTER_SOURCE_KLOG, "br-lan: port 2(lan2) entered forwarding state after %u ms"},
+    {LOG_AUTHPRIV | LOG_INFO, FILTER_SOURCE_SYSLOG,
+     "dropbear[%u]: Password auth succeeded for 'root' from 192.168.1.100:51234"},
+    {LOG_DAEMON | LOG_ERR, FILTER_SOURCE_SYSLOG,
+     "hostapd: wlan0: STA 9c:b6:d0:12:34:56 IEEE 802.11: disassociated due to inactivity, seq %u"},
+    {LOG_DAEMON | LOG_WARNING, FILTER_SOURCE_SYSLOG,
+     "odhcpd[1893]: A default route is present but there is no public prefix on lan thus we don't announce a "
+     "default route by overriding ra_default (attempt %u)"},
+    {LOG_CRON | LOG_INFO, FILTER_SOURCE_SYSLOG, "crond[1120]: USER root pid %u cmd /usr/sbin/fry-healthcheck"},
+    {LOG_KERN | LOG_WARNING, FILTER_SOURCE_KLOG,
+     "ath10k_pci 0000:01:00.0: failed to transmit frame: -105 (queue depth %u)"},
+};
+
+static uint64_t monotonic_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + (uint64_t)ts.tv_nsec / 1000000;
+}
+
+static uint64_t realtime_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + (uint64_t)ts.tv_nsec / 1000000;
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr,
+            "Usage: %s [options]\n"
+            "Feeds a log stream through the collector pipeline without ubusd, logd or fry-agent\n"
+            "and uploads it to a loopback sink.\n\n"
+            "  -c FILE  Configuration file (default: the collector's search paths)\n"
+            "  -n N     Logs to feed (default: %u, or one pass over -f)\n"
+            "  -r RATE  Logs per second, 0 feeds as fast as the collector reads (default: 0)\n"
+            "  -f FILE  Replay a logread capture instead of synthetic logs\n"
+            "  -d PCT   Percentage of synthetic logs repeating the previous message (default: 0)\n"
+            "  -x       Upload to logs_endpoint as configured (e.g. mock-backend.py) instead of the built-in sink\n"
+            "  -D MS    Built-in sink response delay (default: 0)\n"
+            "  -F PCT   Built-in sink failure percentage (default: 0)\n"
+            "  -T SEC   Time allowed to drain the queue after the stream ended (default: %u)\n"
+            "  -v       Collector logs on stderr\n",
+            prog, BENCH_DEFAULT_COUNT, BENCH_DEFAULT_DRAIN_S);
+}
+
+static bool parse_args(int argc, char *argv[]) {
+    int opt;
+
+    while ((opt = getopt(argc, argv, "c:n:r:f:d:xD:F:T:vh")) != -1) {
+        switch (opt) {
+        case 'c':
+            options.config_file = optarg;
+            break;
+        case 'n':
+            options.count = (uint32_t)strtoul(optarg, NULL, 10);
+            break;
+        case 'r':
+            options.rate = (uint32_t)strtoul(optarg, NULL, 10);
+            break;
+        case 'f':
+            options.replay_file = optarg;
+            break;
+        case 'd':
+            options.duplicate_percent = (uint32_t)strtoul(optarg, NULL, 10);
+            break;
+        case 'x':
+            options.external_sink = true;
+            break;
+        case 'D':
+            options.sink_delay_ms = (uint32_t)strtoul(optarg, NULL, 10);
+            break;
+        case 'F':
+            options.sink_fail_percent = (uint32_t)strtoul(optarg, NULL, 10);
+            break;
+        case 'T':
+            options.drain_timeout_s = (uint32_t)strtoul(optarg, NULL, 10);
+            break;
+        case 'v':
+            options.verbose = true;
+            break;
+        default:
+            usage(argv[0]);
+            return false;
+        }
+    }
+
+    if (!options.replay_file && options.count == 0) {
+        options.count = BENCH_DEFAULT_COUNT;
+    }
+    return true;
+}
+
+/**
+ * Port of an http://127.0.0.1:<port>/ or http://localhost:<port>/ endpoint
+ * @return port, or 0 if the endpoint is not on the loopback interface
+ */
+static uint16_t loopback_port(const char *endpoint) {
+    static const char *const prefixes[] = {"http://127.0.0.1:", "http://localhost:"};
+
+    for (size_t i = 0; i < ARRAY_SIZE(prefixes); i++) {
+        size_t len = strlen(prefixes[i]);
+        if (strncmp(endpoint, prefixes[i], len) == 0) {
+            unsigned long port = strtoul(endpoint + len, NULL, 10);
+            return port > 0 && port <= 65535 ? (uint16_t)port : 0;
+        }
+    }
+    return 0;
+}
+
+static bool stream_append(log_stream_buf_t *stream, struct blob_buf *b, uint32_t id, uint32_t priority,
+                          uint32_t source, const char *msg) {
+    // Same members in the same order as logd
+    blob_buf_init(b, 0);
+    blobmsg_add_string(b, "msg", msg);
+    blobmsg_add_u32(b, "id", id);
+    blobmsg_add_u32(b, "priority", priority);
+    blobmsg_add_u32(b, "source", source);
+    blobmsg_add_u64(b, "time", 0); // Stamped when written
+
+    size_t len = blob_raw_len(b->head);
+    if (stream->len + len > stream->size) {
+        size_t size = stream->size ? stream->size * 2 : 1024 * 1024;
+        while (size < stream->len + len) {
+            size *= 2;
+        }
+        uint8_t *data = realloc(stream->data, size);
+        if (!data) {
+            return false;
+        }
+        stream->data = data;
+        stream->size = size;
+    }
+
+    memcpy(stream->data + stream->len, b->head, len);
+    stream->len += len;
+    stream->records++;
+    return true;
+}
+
+static bool build_synthetic(log_stream_buf_t *stream, struct blob_buf *b) {
+    char msg[512];
+    uint32_t unique = 0;
+    size_t t = 0;
+
+    for (uint32_t i = 0; i < options.count; i++) {
+        // Repeats keep the template and number of the previous log, so they collapse like a storm
+        if (i == 0 || (uint32_t)(rand() % 100) >= options.duplicate_percent) {
+            t = (size_t)rand() % ARRAY_SIZE(templates);
+            snprintf(msg, sizeof(msg), templates[t].format, unique++);
+        }
+        if (!stream_append(stream, b, i, templates[t].priority, templates[t].source, msg)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * Parse a logread line: "Thu Oct 16 10:00:00 2026 daemon.info dnsmasq[1]: message"
+ * @return message, or NULL if the line is not in logread format
+ */
+static const char *parse_logread_line(char *line, uint32_t *priority, uint32_t *source) {
+    line[strcspn(line, "\n")] = '\0';
+    if (strlen(line) < 26 || line[24] != ' ') {
+        return NULL;
+    }
+
+    char *selector = line + 25;
+    char *msg = strchr(selector, ' ');
+    char *dot = strchr(selector, '.');
+    if (!msg || !dot || dot > msg) {
+        return NULL;
+    }
+    *msg++ = '\0';
+    *dot = '\0';
+
+    int facility = filter_parse_facility(selector);
+    int level = strcmp(dot + 1, "warn") == 0 ? LOG_WARNING : filter_parse_level(dot + 1);
+    if (facility < 0 || facility > 23 || level < 0) {
+        return NULL;
+    }
+
+    *priority = ((uint32_t)facility << 3) | (uint32_t)level;
+    *source = FILTER_SOURCE_SYSLOG;
+    if (facility == 0 && strncmp(msg, "kernel: ", 8) == 0) {
+        *source = FILTER_SOURCE_KLOG;
+        msg += 8;
+    }
+    return msg;
+}
+
+static bool build_replay(log_stream_buf_t *stream, struct blob_buf *b) {
+    FILE *file = fopen(options.replay_file, "r");
+    if (!file) {
+        console_error(&csl, "Failed to open %s: %s", options.replay_file, strerror(errno));
+        return false;
+    }
+
+    char line[4096];
+    uint32_t id = 0;
+    uint32_t skipped = 0;
+    bool ok = true;
+
+    // One pass, or as many as it takes to reach -n
+    do {
+        rewind(file);
+        while (ok && fgets(line, sizeof(line), file) && (options.count == 0 || id < options.count)) {
+            uint32_t priority, source;
+            const char *msg = parse_logread_line(line, &priority, &source);
+            if (!msg) {
+                skipped++;
+                continue;
+            }
+            ok = stream_append(stream, b, id++, priority, source, msg);
+        }
+    } while (ok && id > 0 && options.count > 0 && id < options.count);
+
+    fclose(file);
+    if (skipped > 0) {
+        console_warn(&csl, "Skipped %u lines not in logread format", skipped);
+    }
+    if (id == 0) {
+        console_error(&csl, "No logs in %s", options.replay_file);
+        return false;
+    }
+    return ok;
+}
+
+static bool write_all(int fd, const uint8_t *data, size_t len) {
+    while (len > 0) {
+        ssize_t n = write(fd, data, len);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        data += n;
+        len -= (size_t)n;
+    }
+    return true;
+}
+
+/**
+ * Stamp records with the current wall clock, the sink measures latency against it
+ * @return bytes covered by the records stamped
+ */
+static size_t stamp_records(uint8_t *data, size_t len, size_t max_bytes, uint32_t max_records) {
+    uint64_t now = cpu_to_be64(realtime_ms());
+    size_t pos = 0;
+
+    for (uint32_t i = 0; i < max_records && pos < len; i++) {
+        struct blob_attr *attr = (struct blob_attr *)(data + pos);
+        size_t record_len = blob_raw_len(attr);
+        if (pos > 0 && pos + record_len > max_bytes) {
+            break;
+        }
+        // "time" is the last member, its 8 byte value ends the record
+        memcpy(data + pos + record_len - sizeof(now), &now, sizeof(now));
+        pos += record_len;
+    }
+    return pos;
+}
+
+/**
+ * Feeder process: encode the stream, signal readiness, then write it
+ */
+static void run_feeder(int out_fd, int ready_fd) {
+    log_stream_buf_t stream = {0};
+    struct blob_buf b = {0};
+
+    bool ok = options.replay_file ? build_replay(&stream, &b) : build_synthetic(&stream, &b);
+    blob_buf_free(&b);
+
+    // One status byte: the parent starts the clock when it arrives
+    uint8_t status = ok ? 1 : 0;
+    if (write(ready_fd, &status, 1) != 1 || !ok) {
+        _exit(1);
+    }
+    close(ready_fd);
+
+    size_t pos = 0;
+    if (options.rate == 0) {
+        while (pos < stream.len) {
+            size_t len = stamp_records(stream.data + pos, stream.len - pos, BENCH_WRITE_CHUNK, UINT32_MAX);
+            if (!write_all(out_fd, stream.data + pos, len)) {
+                _exit(1);
+            }
+            pos += len;
+        }
+    } else {
+        uint64_t start = monotonic_ms();
+        uint64_t written = 0;
+        while (pos < stream.len) {
+            uint64_t due = (monotonic_ms() - start) * options.rate / 1000 + 1;
+            if (due > written) {
+                uint32_t records = (uint32_t)(due - written);
+                size_t len = stamp_records(stream.data + pos, stream.len - pos, SIZE_MAX, records);
+                if (!write_all(out_fd, stream.data + pos, len)) {
+                    _exit(1);
+                }
+                pos += len;
+                written = due;
+            }
+            usleep(BENCH_PACE_TICK_MS * 1000);
+        }
+    }
+
+    _exit(0);
+}
+
+static pid_t start_feeder(int *log_fd) {
+    int stream_fds[2], ready_fds[2];
+
+    if (pipe(stream_fds) < 0 || pipe(ready_fds) < 0) {
+        return -1;
+    }
+
+    pid_t pid = fork();
+    if (pid < 0) {
+        return -1;
+    }
+    if (pid == 0) {
+        close(stream_fds[0]);
+        close(ready_fds[0]);
+        signal(SIGINT, SIG_IGN);
+        run_feeder(stream_fds[1], ready_fds[1]);
+    }
+
+    close(stream_fds[1]);
+    close(ready_fds[1]);
+
+    uint8_t status = 0;
+    ssize_t n = read(ready_fds[0], &status, 1);
+    close(ready_fds[0]);
+    if (n != 1 || status != 1) {
+        close(stream_fds[0]);
+        waitpid(pid, NULL, 0);
+        return -1;
+    }
+
+    *log_fd = stream_fds[0];
+    return pid;
+}
+
+/**
+ * Ends the run once the stream is consumed and everything queued was delivered
+ */
+static void monitor_timer_cb(struct uloop_timeout *timeout) {
+    uint64_t now = monotonic_ms();
+
+    if (ubus_is_log_streaming()) {
+        uloop_timeout_set(&monitor_timer, BENCH_MONITOR_MS);
+        return;
+    }
+
+    if (feed_end_ms == 0) {
+        feed_end_ms = now;
+    }
+
+    // No more logs will arrive, send partial batches without waiting for their deadline
+    collect_force_batch_processing();
+
+    collect_buffer_stats_t buffer;
+    spool_stats_t spool;
+    collect_get_buffer_stats(&buffer);
+    collect_get_spool_stats(&spool);
+
+    if (buffer.held_records == 0 && spool.pending_batches == 0) {
+        end_ms = now;
+        uloop_end();
+    } else if (now - feed_end_ms > (uint64_t)options.drain_timeout_s * 1000) {
+        timed_out = true;
+        end_ms = now;
+        uloop_end();
+    } else {
+        uloop_timeout_set(&monitor_timer, BENCH_MONITOR_MS);
+    }
+}
+
+static void signal_handler(int sig) {
+    interrupted = true;
+    uloop_end();
+}
+
+static double cpu_seconds(const struct rusage *usage) {
+    return (double)usage->ru_utime.tv_sec + (double)usage->ru_utime.tv_usec / 1e6 +
+           (double)usage->ru_stime.tv_sec + (double)usage->ru_stime.tv_usec / 1e6;
+}
+
+static void print_report(const struct rusage *before, const struct rusage *after, const bench_sink_result_t *sink) {
+    collect_ingest_stats_t ingest;
+    collect_payload_stats_t payload;
+    collect_http_stats_t http;
+    spool_stats_t spool;
+    filter_stats_t filter;
+
+    collect_get_ingest_stats(&ingest);
+    collect_get_payload_stats(&payload);
+    collect_get_http_stats(&http);
+    collect_get_spool_stats(&spool);
+    ubus_get_filter_stats(&filter);
+
+    uint64_t read_logs = filter.accepted + filter.dropped_level + filter.dropped_pattern;
+    double feed_s = (double)((feed_end_ms ? feed_end_ms : end_ms) - start_ms) / 1000.0;
+    double total_s = (double)(end_ms - start_ms) / 1000.0;
+    double cpu_s = cpu_seconds(after) - cpu_seconds(before);
+    double user_s = (double)(after->ru_utime.tv_sec - before->ru_utime.tv_sec) +
+                    (double)(after->ru_utime.tv_usec - before->ru_utime.tv_usec) / 1e6;
+
+    printf("\n=== fry-collector-bench ===\n");
+    if (interrupted) {
+        printf("Interrupted, results are partial\n");
+    } else if (timed_out) {
+        printf("Drain timed out after %u s, results are partial\n", options.drain_timeout_s);
+    }
+    if (!ubus_should_accept_logs()) {
+        printf("Log acceptance was disabled by upload failures, the stream stopped early\n");
+    }
+
+    printf("Logs:       read=%llu enqueued=%llu collapsed=%llu\n", (unsigned long long)read_logs,
+           (unsigned long long)ingest.enqueued, (unsigned long long)ingest.collapsed);
+    printf("Drops:      buffer_exhausted=%llu queue_full=%llu evicted=%llu filtered=%llu rate_limited=%llu "
+           "sampled=%llu\n",
+           (unsigned long long)ingest.buffer_exhausted, (unsigned long long)ingest.queue_full,
+           (unsigned long long)ingest.evicted, (unsigned long long)(filter.dropped_level + filter.dropped_pattern),
+           (unsigned long long)ingest.rate_limited, (unsigned long long)ingest.sampled);
+    printf("Throughput: %.0f logs/s ingest over %.2f s, %.0f logs/s end to end over %.2f s\n",
+           feed_s > 0 ? (double)read_logs / feed_s : 0, feed_s, total_s > 0 ? (double)read_logs / total_s : 0,
+           total_s);
+    printf("CPU:        %.3f s (user %.3f s, sys %.3f s), %.2f us/log\n", cpu_s, user_s, cpu_s - user_s,
+           read_logs ? cpu_s * 1e6 / (double)read_logs : 0);
+    printf("Peak RSS:   %ld KB\n", after->ru_maxrss);
+    printf("Payload:    batches=%llu serialized=%llu B wire=%llu B (%.1f B/record on the wire)\n",
+           (unsigned long long)payload.batches, (unsigned long long)payload.payload_bytes,
+           (unsigned long long)payload.wire_bytes,
+           payload.logs ? (double)payload.wire_bytes / (double)payload.logs : 0);
+    printf("Batches:    size p50=%.0f p95=%.0f p99=%.0f max=%.0f\n", http.batch_size_p50, http.batch_size_p95,
+           http.batch_size_p99, http.batch_size_max);
+    printf("HTTP:       requests=%llu rtt p50=%.1f p95=%.1f p99=%.1f max=%.1f ms, spooled=%llu replayed=%llu\n",
+           (unsigned long long)http.requests, http.latency_p50_ms, http.latency_p95_ms, http.latency_p99_ms,
+           http.latency_max_ms, (unsigned long long)spool.written_batches,
+           (unsigned long long)spool.replayed_batches);
+
+    if (sink) {
+        printf("Sink:       requests=%llu failed=%llu records=%llu body=%llu B\n", (unsigned long long)sink->requests,
+               (unsigned long long)sink->failed, (unsigned long long)sink->records,
+               (unsigned long long)sink->body_bytes);
+        if (sink->undecoded > 0) {
+            printf("            %llu bodies could not be decoded, their latency is missing\n",
+                   (unsigned long long)sink->undecoded);
+        }
+        printf("Latency:    log written to received by sink p50=%.1f p95=%.1f p99=%.1f max=%.1f ms\n",
+               histogram_percentile(&sink->latency, 50), histogram_percentile(&sink->latency, 95),
+               histogram_percentile(&sink->latency, 99), sink->latency.max);
+    } else {
+        printf("Latency:    not measured with an external sink\n");
+    }
+}
+
+int main(int argc, char *argv[]) {
+    console_set_channels(CONSOLE_CHANNEL_STDIO);
+    console_set_identity("fry-collector-bench");
+    console_set_level(CONSOLE_LEVEL_ERROR);
+
+    if (!parse_args(argc, argv)) {
+        return 2;
+    }
+
+    if (options.config_file && config_use_file(options.config_file) < 0) {
+        console_error(&csl, "Failed to load configuration from %s", options.config_file);
+        return 1;
+    }
+    const collector_config_t *config = config_get_current();
+    if (config_validate(config) < 0) {
+        console_error(&csl, "Configuration validation failed");
+        return 1;
+    }
+    console_set_level(options.verbose ? config->console_log_level : CONSOLE_LEVEL_ERROR);
+
+    bench_sink_t sink;
+    if (!options.external_sink) {
+        uint16_t port = loopback_port(config->logs_endpoint);
+        if (port == 0) {
+            console_error(&csl, "The built-in sink needs an http://127.0.0.1:<port>/ logs_endpoint, or use -x");
+            return 1;
+        }
+        if (bench_sink_start(&sink, port, options.sink_delay_ms, options.sink_fail_percent) < 0) {
+            return 1;
+        }
+    }
+
+    signal(SIGPIPE, SIG_IGN);
+
+    int log_fd;
+    pid_t feeder = start_feeder(&log_fd);
+    if (feeder < 0) {
+        console_error(&csl, "Failed to prepare the log stream");
+        if (!options.external_sink) {
+            bench_sink_result_t ignored;
+            bench_sink_stop(&sink, &ignored);
+        }
+        return 1;
+    }
+
+    uloop_init();
+    signal(SIGINT, signal_handler);
+    signal(SIGTERM, signal_handler);
+
+    if (collect_init() < 0 || ubus_init_offline(log_fd, "bench") < 0) {
+        console_error(&csl, "Failed to initialize the collector");
+        kill(feeder, SIGTERM);
+        waitpid(feeder, NULL, 0);
+        return 1;
+    }
+
+    struct rusage before, after;
+    getrusage(RUSAGE_SELF, &before);
+    start_ms = monotonic_ms();
+
+    monitor_timer.cb = monitor_timer_cb;
+    uloop_timeout_set(&monitor_timer, BENCH_MONITOR_MS);
+    uloop_run();
+
+    if (end_ms == 0) {
+        end_ms = monotonic_ms();
+    }
+    getrusage(RUSAGE_SELF, &after);
+    uloop_timeout_cancel(&monitor_timer);
+
+    kill(feeder, SIGTERM);
+    waitpid(feeder, NULL, 0);
+
+    bench_sink_result_t sink_result;
+    bool have_sink = false;
+    if (!options.external_sink) {
+        have_sink = bench_sink_stop(&sink, &sink_result) == 0;
+    }
+
+    print_report(&before, &after, have_sink ? &sink_result : NULL);
+
+    ubus_cleanup();
+    collect_cleanup();
+    close(log_fd);
+    uloop_done();
+
+    return timed_out || interrupted ? 1 : 0;
+}
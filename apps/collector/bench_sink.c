@@ -0,0 +1,594 @@
+#define _GNU_SOURCE // memmem()
+#include "bench_sink.h"
+#include "core/console.h"
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+#include <zlib.h>
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+#define SINK_MAX_CONNECTIONS 16
+#define SINK_MAX_REQUEST (16 * 1024 * 1024)
+#define SINK_POLL_MS 100
+
+static Console csl = {
+    .topic = "bench-sink",
+};
+
+typedef struct sink_connection {
+    int fd;
+    char *buf;
+    size_t len;
+    size_t size;
+    size_t header_len; // 0 until the header is complete
+    size_t body_len;
+    char encoding[16];
+    bool msgpack; // Content-Type: application/msgpack
+    bool expect_continue;
+    uint64_t respond_at; // Monotonic ms the pending response is due, 0 if none
+    int status;
+    uint64_t records;
+} sink_connection_t;
+
+static volatile sig_atomic_t sink_stop = 0;
+static bench_sink_result_t result;
+static uint8_t *decode_buf = NULL;
+static size_t decode_size = 0;
+
+static void sink_signal_handler(int sig) { sink_stop = 1; }
+
+static uint64_t monotonic_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + (uint64_t)ts.tv_nsec / 1000000;
+}
+
+static uint64_t realtime_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + (uint64_t)ts.tv_nsec / 1000000;
+}
+
+static void reset_connection(sink_connection_t *c) {
+    c->len = 0;
+    c->header_len = 0;
+    c->body_len = 0;
+    c->encoding[0] = '\0';
+    c->msgpack = false;
+    c->expect_continue = false;
+    c->respond_at = 0;
+}
+
+static void close_connection(sink_connection_t *c) {
+    close(c->fd);
+    free(c->buf);
+    memset(c, 0, sizeof(*c));
+    c->fd = -1;
+}
+
+static bool grow_decode_buf(size_t min_size) {
+    if (decode_size >= min_size) {
+        return true;
+    }
+    size_t size = decode_size ? decode_size : 64 * 1024;
+    while (size < min_size) {
+        size *= 2;
+    }
+    uint8_t *buf = realloc(decode_buf, size);
+    if (!buf) {
+        return false;
+    }
+    decode_buf = buf;
+    decode_size = size;
+    return true;
+}
+
+/**
+ * Undo the Content-Encoding of a request body
+ * @return decoded length, or -1 if the body could not be decoded
+ */
+static ssize_t decode_body(const char *encoding, const uint8_t *body, size_t len, const uint8_t **out) {
+    if (encoding[0] == '\0' || strcasecmp(encoding, "identity") == 0) {
+        *out = body;
+        return (ssize_t)len;
+    }
+
+    if (strcasecmp(encoding, "gzip") == 0 || strcasecmp(encoding, "deflate") == 0) {
+        z_stream zs;
+        memset(&zs, 0, sizeof(zs));
+        if (inflateInit2(&zs, 15 + 32) != Z_OK) { // +32: detect the gzip or zlib header
+            return -1;
+        }
+        zs.next_in = (Bytef *)body;
+        zs.avail_in = (uInt)len;
+
+        int ret;
+        do {
+            if (!grow_decode_buf(zs.total_out + 64 * 1024)) {
+                inflateEnd(&zs);
+                return -1;
+            }
+            zs.next_out = decode_buf + zs.total_out;
+            zs.avail_out = (uInt)(decode_size - zs.total_out);
+            ret = inflate(&zs, Z_NO_FLUSH);
+        } while (ret == Z_OK);
+
+        size_t total = zs.total_out;
+        inflateEnd(&zs);
+        if (ret != Z_STREAM_END) {
+            return -1;
+        }
+        *out = decode_buf;
+        return (ssize_t)total;
+    }
+
+#ifdef HAVE_ZSTD
+    if (strcasecmp(encoding, "zstd") == 0) {
+        ZSTD_DStream *zds = ZSTD_createDStream();
+        if (!zds) {
+            return -1;
+        }
+        ZSTD_inBuffer in = {body, len, 0};
+        size_t total = 0;
+        size_t ret = 1;
+        while (in.pos < in.size && ret != 0) {
+            if (!grow_decode_buf(total + 64 * 1024)) {
+                ZSTD_freeDStream(zds);
+                return -1;
+            }
+            ZSTD_outBuffer out_buf = {decode_buf + total, decode_size - total, 0};
+            ret = ZSTD_decompressStream(zds, &out_buf, &in);
+            if (ZSTD_isError(ret)) {
+                ZSTD_freeDStream(zds);
+                return -1;
+            }
+            total += out_buf.pos;
+        }
+        ZSTD_freeDStream(zds);
+        *out = decode_buf;
+        return (ssize_t)total;
+    }
+#endif
+
+    return -1;
+}
+
+/**
+ * Count the records of a batch and record the latency of each
+ * Matches the "time" member only: "last_time" ends in the same bytes but is
+ * preceded by an underscore, and quotes inside messages are escaped.
+ */
+static uint64_t scan_records(const uint8_t *json, size_t len, uint64_t now_ms) {
+    static const char key[] = "\"time\":";
+    const size_t key_len = sizeof(key) - 1;
+    uint64_t records = 0;
+
+    const uint8_t *p = json;
+    const uint8_t *end = json + len;
+    while ((p = memmem(p, (size_t)(end - p), key, key_len)) != NULL) {
+        p += key_len;
+        uint64_t time_ms = 0;
+        while (p < end && *p >= '0' && *p <= '9') {
+            time_ms = time_ms * 10 + (uint64_t)(*p++ - '0');
+        }
+        histogram_add(&result.latency, now_ms > time_ms ? (double)(now_ms - time_ms) : 0);
+        records++;
+    }
+
+    return records;
+}
+
+enum { MP_UINT, MP_STR, MP_BIN, MP_ARRAY, MP_MAP };
+
+/**
+ * Read a MessagePack header (the subset the collector writes)
+ * @param value Integer value, or length of a string, binary, array or map
+ * @return MP_* kind, -1 if malformed or unsupported
+ */
+static int mp_header(const uint8_t **p, const uint8_t *end, uint64_t *value) {
+    static const struct {
+        uint8_t tag;
+        uint8_t kind;
+        uint8_t size;
+    } sized[] = {
+        {0xcc, MP_UINT, 1}, {0xcd, MP_UINT, 2},  {0xce, MP_UINT, 4},  {0xcf, MP_UINT, 8},
+        {0xc4, MP_BIN, 1},  {0xc5, MP_BIN, 2},   {0xc6, MP_BIN, 4},   {0xd9, MP_STR, 1},
+        {0xda, MP_STR, 2},  {0xdb, MP_STR, 4},   {0xdc, MP_ARRAY, 2}, {0xdd, MP_ARRAY, 4},
+        {0xde, MP_MAP, 2},  {0xdf, MP_MAP, 4},
+    };
+
+    if (*p >= end) {
+        return -1;
+    }
+
+    uint8_t tag = *(*p)++;
+    if (tag < 0x80) {
+        *value = tag;
+        return MP_UINT;
+    }
+    if (tag <= 0x8f) {
+        *value = tag & 0x0f;
+        return MP_MAP;
+    }
+    if (tag <= 0x9f) {
+        *value = tag & 0x0f;
+        return MP_ARRAY;
+    }
+    if (tag <= 0xbf) {
+        *value = tag & 0x1f;
+        return MP_STR;
+    }
+
+    for (size_t i = 0; i < sizeof(sized) / sizeof(sized[0]); i++) {
+        if (sized[i].tag != tag) {
+            continue;
+        }
+        if ((size_t)(end - *p) < sized[i].size) {
+            return -1;
+        }
+        *value = 0;
+        for (uint8_t b = 0; b < sized[i].size; b++) {
+            *value = *value << 8 | *(*p)++;
+        }
+        return sized[i].kind;
+    }
+
+    return -1;
+}
+
+/**
+ * Skip one MessagePack value
+ * @return false if malformed
+ */
+static bool mp_skip(const uint8_t **p, const uint8_t *end) {
+    uint64_t value;
+    int kind = mp_header(p, end, &value);
+
+    switch (kind) {
+    case MP_UINT:
+        return true;
+    case MP_STR:
+    case MP_BIN:
+        if ((uint64_t)(end - *p) < value) {
+            return false;
+        }
+        *p += value;
+        return true;
+    case MP_MAP:
+        value *= 2;
+        // fallthrough
+    case MP_ARRAY:
+        for (uint64_t i = 0; i < value; i++) {
+            if (!mp_skip(p, end)) {
+                return false;
+            }
+        }
+        return true;
+    default:
+        return false;
+    }
+}
+
+/**
+ * Count the records of a MessagePack batch and record the latency of each
+ * Record times are deltas against base_time, which the collector writes before the logs.
+ */
+static uint64_t scan_msgpack_records(const uint8_t *body, size_t len, uint64_t now_ms) {
+    const uint8_t *p = body;
+    const uint8_t *end = body + len;
+    uint64_t base_time = 0;
+    uint64_t records = 0;
+    uint64_t fields, value;
+
+    if (mp_header(&p, end, &fields) != MP_MAP) {
+        return 0;
+    }
+
+    for (uint64_t f = 0; f < fields; f++) {
+        if (mp_header(&p, end, &value) != MP_STR || (uint64_t)(end - p) < value) {
+            return records;
+        }
+        const uint8_t *key = p;
+        size_t key_len = (size_t)value;
+        p += value;
+
+        if (key_len == 9 && memcmp(key, "base_time", 9) == 0) {
+            if (mp_header(&p, end, &base_time) != MP_UINT) {
+                return records;
+            }
+        } else if (key_len == 4 && memcmp(key, "logs", 4) == 0) {
+            uint64_t count;
+            if (mp_header(&p, end, &count) != MP_ARRAY) {
+                return records;
+            }
+            for (uint64_t i = 0; i < count; i++) {
+                uint64_t items, delta;
+                // [msg, priority index, source index, time delta, ...]
+                if (mp_header(&p, end, &items) != MP_ARRAY || items < 4 || !mp_skip(&p, end) ||
+                    !mp_skip(&p, end) || !mp_skip(&p, end) || mp_header(&p, end, &delta) != MP_UINT) {
+                    return records;
+                }
+                for (uint64_t j = 4; j < items; j++) {
+                    if (!mp_skip(&p, end)) {
+                        return records;
+                    }
+                }
+                uint64_t time_ms = base_time + delta;
+                histogram_add(&result.latency, now_ms > time_ms ? (double)(now_ms - time_ms) : 0);
+                records++;
+            }
+        } else if (!mp_skip(&p, end)) {
+            return records;
+        }
+    }
+
+    return records;
+}
+
+static void parse_header(sink_connection_t *c) {
+    const char *line = c->buf;
+    const char *end = c->buf + c->header_len;
+
+    while (line < end) {
+        const char *eol = memchr(line, '\n', (size_t)(end - line));
+        if (!eol) {
+            break;
+        }
+        if (strncasecmp(line, "Content-Length:", 15) == 0) {
+            c->body_len = strtoul(line + 15, NULL, 10);
+        } else if (strncasecmp(line, "Content-Encoding:", 17) == 0) {
+            sscanf(line + 17, " %15[^\r\n ]", c->encoding);
+        } else if (strncasecmp(line, "Content-Type:", 13) == 0) {
+            c->msgpack = strncasecmp(line + 13 + strspn(line + 13, " "), "application/msgpack", 19) == 0;
+        } else if (strncasecmp(line, "Expect:", 7) == 0) {
+            c->expect_continue = true;
+        }
+        line = eol + 1;
+    }
+}
+
+static void handle_request(sink_connection_t *c, uint32_t delay_ms, uint32_t fail_percent) {
+    const uint8_t *json;
+    ssize_t json_len = decode_body(c->encoding, (const uint8_t *)c->buf + c->header_len, c->body_len, &json);
+
+    result.body_bytes += c->body_len;
+    c->records = 0;
+
+    if (fail_percent > 0 && (uint32_t)(rand() % 100) < fail_percent) {
+        c->status = 500;
+    } else if (json_len < 0) {
+        result.undecoded++;
+        c->status = 415;
+    } else {
+        c->status = 200;
+        c->records = c->msgpack ? scan_msgpack_records(json, (size_t)json_len, realtime_ms())
+                                : scan_records(json, (size_t)json_len, realtime_ms());
+    }
+
+    c->respond_at = monotonic_ms() + delay_ms;
+}
+
+static void send_response(sink_connection_t *c) {
+    char body[128];
+    char response[256];
+    int body_len;
+
+    if (c->status == 200) {
+        body_len = snprintf(body, sizeof(body), "{\"status\":\"success\",\"received_count\":%llu}",
+                            (unsigned long long)c->records);
+        result.records += c->records;
+    } else {
+        body_len = snprintf(body, sizeof(body), "{\"error\":\"%s\",\"status_code\":%d}",
+                            c->status == 500 ? "Simulated server error" : "Unsupported Content-Encoding", c->status);
+        if (c->status == 500) {
+            result.failed++;
+        }
+    }
+    result.requests++;
+
+    int len = snprintf(response, sizeof(response),
+                       "HTTP/1.1 %d %s\r\nContent-Type: application/json\r\nContent-Length: %d\r\n\r\n%s", c->status,
+                       c->status == 200 ? "OK" : "Error", body_len, body);
+    if (write(c->fd, response, (size_t)len) != len) {
+        close_connection(c);
+        return;
+    }
+
+    reset_connection(c);
+}
+
+/**
+ * Read from a connection, returns false once it is closed
+ */
+static bool read_connection(sink_connection_t *c, uint32_t delay_ms, uint32_t fail_percent) {
+    if (c->len == c->size) {
+        size_t size = c->size ? c->size * 2 : 64 * 1024;
+        if (size > SINK_MAX_REQUEST) {
+            console_error(&csl, "Request exceeds %d bytes, closing connection", SINK_MAX_REQUEST);
+            return false;
+        }
+        char *buf = realloc(c->buf, size);
+        if (!buf) {
+            return false;
+        }
+        c->buf = buf;
+        c->size = size;
+    }
+
+    ssize_t n = read(c->fd, c->buf + c->len, c->size - c->len);
+    if (n <= 0) {
+        return n < 0 && (errno == EINTR || errno == EAGAIN);
+    }
+    c->len += (size_t)n;
+
+    if (c->header_len == 0) {
+        char *header_end = memmem(c->buf, c->len, "\r\n\r\n", 4);
+        if (!header_end) {
+            return true;
+        }
+        c->header_len = (size_t)(header_end - c->buf) + 4;
+        parse_header(c);
+        if (c->expect_continue && c->len < c->header_len + c->body_len) {
+            static const char cont[] = "HTTP/1.1 100 Continue\r\n\r\n";
+            if (write(c->fd, cont, sizeof(cont) - 1) < 0) {
+                return false;
+            }
+        }
+    }
+
+    if (c->len >= c->header_len + c->body_len) {
+        handle_request(c, delay_ms, fail_percent);
+    }
+    return true;
+}
+
+static void sink_run(int listen_fd, int result_fd, uint32_t delay_ms, uint32_t fail_percent) {
+    sink_connection_t conns[SINK_MAX_CONNECTIONS];
+    struct pollfd pfds[SINK_MAX_CONNECTIONS + 1];
+
+    memset(conns, 0, sizeof(conns));
+    for (int i = 0; i < SINK_MAX_CONNECTIONS; i++) {
+        conns[i].fd = -1;
+    }
+
+    while (!sink_stop) {
+        uint64_t now = monotonic_ms();
+        int timeout = -1;
+        int n = 0;
+
+        pfds[n++] = (struct pollfd){.fd = listen_fd, .events = POLLIN};
+        for (int i = 0; i < SINK_MAX_CONNECTIONS; i++) {
+            sink_connection_t *c = &conns[i];
+            if (c->fd < 0) {
+                continue;
+            }
+            if (c->respond_at) {
+                // Answer delayed responses on time, the client sends nothing meanwhile
+                if (c->respond_at <= now) {
+                    send_response(c);
+                } else if (timeout < 0 || (int)(c->respond_at - now) < timeout) {
+                    timeout = (int)(c->respond_at - now);
+                }
+            }
+            if (c->fd >= 0 && !c->respond_at) {
+                pfds[n++] = (struct pollfd){.fd = c->fd, .events = POLLIN};
+            }
+        }
+
+        // Bounded wait: a stop signal landing just before poll() would otherwise go unnoticed
+        if (timeout < 0 || timeout > SINK_POLL_MS) {
+            timeout = SINK_POLL_MS;
+        }
+        if (poll(pfds, (nfds_t)n, timeout) < 0) {
+            continue; // EINTR: check the stop flag
+        }
+
+        if (pfds[0].revents & POLLIN) {
+            int fd = accept(listen_fd, NULL, NULL);
+            for (int i = 0; fd >= 0 && i < SINK_MAX_CONNECTIONS; i++) {
+                if (conns[i].fd < 0) {
+                    conns[i].fd = fd;
+                    fd = -1;
+                }
+            }
+            if (fd >= 0) {
+                close(fd);
+            }
+        }
+
+        for (int p = 1; p < n; p++) {
+            if (!pfds[p].revents) {
+                continue;
+            }
+            for (int i = 0; i < SINK_MAX_CONNECTIONS; i++) {
+                if (conns[i].fd == pfds[p].fd) {
+                    if (!read_connection(&conns[i], delay_ms, fail_percent)) {
+                        close_connection(&conns[i]);
+                    }
+                    break;
+                }
+            }
+        }
+    }
+
+    if (write(result_fd, &result, sizeof(result)) != (ssize_t)sizeof(result)) {
+        console_error(&csl, "Failed to report sink result");
+    }
+}
+
+int bench_sink_start(bench_sink_t *sink, uint16_t port, uint32_t delay_ms, uint32_t fail_percent) {
+    int pipe_fds[2];
+    struct sockaddr_in addr = {
+        .sin_family = AF_INET,
+        .sin_port = htons(port),
+        .sin_addr.s_addr = htonl(INADDR_LOOPBACK),
+    };
+
+    // Listen before forking, so connection attempts never race the child
+    int listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (listen_fd < 0) {
+        return -errno;
+    }
+    int one = 1;
+    setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    if (bind(listen_fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 || listen(listen_fd, 16) < 0) {
+        int ret = -errno;
+        console_error(&csl, "Failed to listen on 127.0.0.1:%u: %s", port, strerror(errno));
+        close(listen_fd);
+        return ret;
+    }
+
+    if (pipe(pipe_fds) < 0) {
+        int ret = -errno;
+        close(listen_fd);
+        return ret;
+    }
+
+    pid_t pid = fork();
+    if (pid < 0) {
+        int ret = -errno;
+        close(listen_fd);
+        close(pipe_fds[0]);
+        close(pipe_fds[1]);
+        return ret;
+    }
+
+    if (pid == 0) {
+        close(pipe_fds[0]);
+        signal(SIGTERM, sink_signal_handler);
+        signal(SIGINT, SIG_IGN); // Ctrl+C stops the benchmark, which then stops the sink
+        signal(SIGPIPE, SIG_IGN);
+        histogram_init(&result.latency, 1);
+        sink_run(listen_fd, pipe_fds[1], delay_ms, fail_percent);
+        _exit(0);
+    }
+
+    close(listen_fd);
+    close(pipe_fds[1]);
+    sink->pid = pid;
+    sink->result_fd = pipe_fds[0];
+    return 0;
+}
+
+int bench_sink_stop(bench_sink_t *sink, bench_sink_result_t *out) {
+    kill(sink->pid, SIGTERM);
+
+    ssize_t n = read(sink->result_fd, out, sizeof(*out));
+    close(sink->result_fd);
+    waitpid(sink->pid, NULL, 0);
+
+    return n == (ssize_t)sizeof(*out) ? 0 : -EIO;
+}
@@ -0,0 +1,50 @@
+#ifndef BENCH_SINK_H
+#define BENCH_SINK_H
+
+#include "metrics.h"
+#include <stdint.h>
+#include <sys/types.h>
+
+/**
+ * What the sink saw during a benchmark run
+ */
+typedef struct bench_sink_result {
+    uint64_t requests;   // Upload requests answered
+    uint64_t failed;     // Requests answered with a simulated server error
+    uint64_t records;    // Log records in accepted requests
+    uint64_t body_bytes; // Request bodies as received (after compression)
+    uint64_t undecoded;  // Requests whose body could not be decoded
+    histogram_t latency; // Log time to arrival at the sink in ms
+} bench_sink_result_t;
+
+/**
+ * Loopback HTTP sink
+ * Runs in a child process so its CPU time and memory are not charged to the
+ * collector. It answers POST requests like scripts/dev/mock-backend.py and
+ * measures end-to-end latency from the "time" field of every record, which
+ * the benchmark stamps with the wall clock when the log is written.
+ */
+typedef struct bench_sink {
+    pid_t pid;
+    int result_fd; // Read end of the pipe the result arrives on
+} bench_sink_t;
+
+/**
+ * Start the sink listening on 127.0.0.1
+ * @param sink Sink to start
+ * @param port TCP port to listen on
+ * @param delay_ms Delay before each response, simulates the uplink RTT
+ * @param fail_percent Percentage of requests answered with HTTP 500
+ * @return 0 on success, negative error code on failure
+ */
+int bench_sink_start(bench_sink_t *sink, uint16_t port, uint32_t delay_ms, uint32_t fail_percent);
+
+/**
+ * Stop the sink and collect its result
+ * @param sink Sink to stop
+ * @param result Where to store the result
+ * @return 0 on success, negative error code on failure
+ */
+int bench_sink_stop(bench_sink_t *sink, bench_sink_result_t *result);
+
+#endif // BENCH_SINK_H
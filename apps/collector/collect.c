@@ -1,465 +1,1367 @@
 #include "collect.h"
+#include "adaptive.h"
+#include "backoff.h"
 #include "config.h"
 #include "core/console.h"
+#include "dedup.h"
+#include "log_arena.h"
+#include "membudget.h"
+#include "compress.h"
+#include "metrics.h"
+#include "payload.h"
+#include "ratelimit.h"
+#include "sampler.h"
+#include "sink.h"
+#include "spool.h"
+#include "syslog_input.h"
 #include "ubus.h"
 #include <asm-generic/errno-base.h>
+#include <errno.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <syslog.h>
 #include <time.h>
 #include <unistd.h>
 
-#include <curl/curl.h>
-#include <json-c/json.h>
 #include <libubox/uloop.h>
+#include <libubox/utils.h>
 
 static Console csl = {
     .topic = "collect",
 };
 
 // Single-threaded state - no mutexes needed
-static simple_log_queue_t queue;
-static compact_log_entry_t *entry_pool = NULL;
-static bool *pool_used = NULL;
-static uint32_t entry_pool_size = 0;
+static log_arena_t lanes[LOG_LANE_COUNT]; // One ring per priority lane, see lane_of()
+static uint32_t buffer_budget = 0;         // Bytes all lanes may hold together
+static uint32_t max_queued_records = 0;
+static membudget_t membudget;               // Sizes the lanes from MemAvailable when enabled
+static struct uloop_timeout membudget_timer; // Samples memory pressure
+static uint32_t arena_exhausted_count = 0;
+static uint64_t lane_evicted[LOG_LANE_COUNT];
+static uint32_t high_water_bytes = 0;
+static uint32_t high_water_records = 0;
 static uint32_t dropped_count = 0;
+static collect_ingest_stats_t ingest_stats; // Per-reason counters, collapsed/rate_limited/sampled live in their modules
+static rate_meter_t ingest_rate;
 static bool system_running = false;
+static bool storage_closed = false;            // Set by collect_cleanup(), settled_marks keep the final state
+static uint64_t settled_marks[LOG_LANE_COUNT]; // Oldest record each lane held when storage closed
+
+// Log storm protection: repeats are collapsed, then each source/facility is rate limited
+static dedup_table_t dedup;
+static ratelimit_t ratelimit;
+static sampler_t sampler;
 
 // Batch processing state
-static batch_context_t current_batch;
+static batch_context_t batches[MAX_INFLIGHT_BATCHES];
+static uint32_t inflight_limit = 1;         // Slots new batches may start in, busy ones above it still finish
+static batch_context_t *filling_batch;      // Slot currently claiming records, NULL if none
+static uint64_t instance_id = 0;            // Random per start, prefixes idempotency keys
+static uint64_t next_batch_seq = 1;
 static time_t last_batch_time = 0;
+static adaptive_batching_t adaptive; // Current batch size, timeout and urgent threshold
 
 // HTTP client state machine
-static CURL *curl_handle = NULL;
-static struct curl_slist *http_headers = NULL;
-static char curl_error_buffer[CURL_ERROR_SIZE];
+static struct uloop_timeout process_timer;
+static struct uloop_timeout batch_deadline; // Seals the filling batch batch_timeout_ms after its first record
+static bool batch_overdue = false;          // Deadline passed while no batch slot was free
+static struct uloop_timeout flush_timer;
+static bool flushing = false;
+
+// Payload serialization accounting
+static collect_payload_stats_t payload_stats;
+static histogram_t batch_size_hist; // Logs per batch
+static histogram_t latency_hist;    // Upload round trip in ms, live batches and replays
+static compressor_t compressor;
 
 // Network failure tracking
 static int consecutive_http_failures = 0;
+static backoff_t upload_backoff; // Shared by live batches and replays, the backend is one
+static uint64_t rejected_batches = 0; // Batches the backend refused for good, live and spooled
+
+// Output stage: every batch is uploaded over HTTP (retried, spooled on failure) and copied to the mirror sinks
+static sink_t *http_sink;
+static sink_set_t mirror_sinks;
+
+// Spool of batches that could not be delivered, replayed once uploads succeed again
+static spool_t spool;
+static bool replay_in_flight = false;
+static payload_buffer_t replay_body;
+static uint64_t replay_instance, replay_seq; // Spooled batch the replay in flight uploads
+static struct uloop_timeout replay_timer; // Backoff after a failed replay
+static bool spool_reopen_pending = false;  // Spool settings changed while a replay was in flight
+
+// Distinct priorities or sources a MessagePack batch can carry (a syslog priority is at most 191)
+#define VALUE_DICT_SIZE 256
+
+/**
+ * Values of one field seen in a batch, records refer to them by index
+ */
+typedef struct value_dict {
+    uint32_t values[VALUE_DICT_SIZE];
+    uint32_t count;
+    uint32_t last; // Index of the last hit, records of a lane tend to repeat it
+} value_dict_t;
+
+// Share of a batch each lane gets while several lanes have records queued
+static const uint32_t lane_weights[LOG_LANE_COUNT] = {4, 2, 1};
+
+// Quarters of the byte budget each lane ring holds, most logs are info and severe ones are rare
+static const uint32_t lane_shares[LOG_LANE_COUNT] = {1, 1, 2};
+#define LANE_SHARE_TOTAL 4
 
 // Configuration values are now obtained from config functions
 
 /**
- * Initialize the entry pool for memory optimization
+ * Priority lane of a log by its syslog severity
  */
-static int init_entry_pool(void) {
-    entry_pool_size = config_get_queue_size();
+static log_lane_t lane_of(uint32_t priority) {
+    uint32_t severity = priority & LOG_PRIMASK;
 
-    entry_pool = calloc(entry_pool_size, sizeof(compact_log_entry_t));
-    if (!entry_pool) {
-        console_error(&csl, "Failed to allocate entry pool");
-        return -ENOMEM;
+    if (severity <= LOG_ERR) {
+        return LOG_LANE_HIGH;
     }
+    return severity <= LOG_NOTICE ? LOG_LANE_MEDIUM : LOG_LANE_LOW;
+}
 
-    pool_used = calloc(entry_pool_size, sizeof(bool));
-    if (!pool_used) {
-        console_error(&csl, "Failed to allocate pool tracking array");
-        free(entry_pool);
-        entry_pool = NULL;
-        return -ENOMEM;
+/**
+ * Records waiting for a batch, all lanes
+ */
+static uint32_t queued_records(void) {
+    uint32_t count = 0;
+
+    for (int lane = 0; lane < LOG_LANE_COUNT; lane++) {
+        count += lanes[lane].queued;
     }
+    return count;
+}
 
-    for (uint32_t i = 0; i < entry_pool_size; i++) {
-        pool_used[i] = false;
-        entry_pool[i].pool_index = i;
-        entry_pool[i].in_use = false;
+/**
+ * Records queued or referenced by a batch, all lanes
+ */
+static uint32_t held_records(void) {
+    uint32_t count = 0;
+
+    for (int lane = 0; lane < LOG_LANE_COUNT; lane++) {
+        count += lanes[lane].records;
     }
+    return count;
+}
 
-    console_debug(&csl, "Entry pool initialized with %u entries", entry_pool_size);
-    return 0;
+/**
+ * Bytes a lane holds, not counting evicted records waiting for an older batch to be released
+ */
+static uint32_t lane_used_bytes(const log_arena_t *lane) { return lane->used - lane->skip_bytes; }
+
+/**
+ * Bytes held against the buffer budget, all lanes
+ */
+static uint32_t used_bytes(void) {
+    uint32_t bytes = 0;
+
+    for (int lane = 0; lane < LOG_LANE_COUNT; lane++) {
+        bytes += lane_used_bytes(&lanes[lane]);
+    }
+    return bytes;
+}
+
+/**
+ * Evict the oldest queued record of a lane
+ * @return true if a record was evicted
+ */
+static bool evict_lane_record(log_lane_t lane) {
+    if (!log_arena_evict(&lanes[lane])) {
+        return false;
+    }
+
+    lane_evicted[lane]++;
+    ingest_stats.evicted++;
+    dropped_count++;
+    return true;
 }
 
 /**
- * Get an entry from the pool
+ * Evict the oldest queued record of the least severe lane that has one
+ * @param limit Most severe lane records may be evicted from
+ * @return true if a record was evicted
  */
-compact_log_entry_t *collect_get_entry_from_pool(void) {
-    if (!entry_pool || !pool_used) {
-        return NULL;
+static bool evict_queued_record(log_lane_t limit) {
+    for (int lane = LOG_LANE_COUNT - 1; lane >= (int)limit; lane--) {
+        if (evict_lane_record((log_lane_t)lane)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * Ring size of a lane for a byte budget, at least one record of the longest message
+ */
+static uint32_t lane_capacity(uint32_t budget, log_lane_t lane) {
+    uint32_t capacity = (uint32_t)((uint64_t)budget * lane_shares[lane] / LANE_SHARE_TOTAL);
+    uint32_t min = log_arena_record_size(MAX_LOG_MSG_SIZE);
+    return capacity > min ? capacity : min;
+}
+
+/**
+ * Fill of the fullest lane ring in percent of its capacity
+ */
+static uint32_t lane_fill_percent(void) {
+    uint32_t fill = 0;
+
+    for (int lane = 0; lane < LOG_LANE_COUNT; lane++) {
+        if (lanes[lane].capacity) {
+            uint32_t percent = (uint32_t)((uint64_t)lane_used_bytes(&lanes[lane]) * 100 / lanes[lane].capacity);
+            fill = percent > fill ? percent : fill;
+        }
     }
+    return fill;
+}
+
+/**
+ * Byte budget of the lanes, from memory when sized by it, from buffer_size_kb otherwise
+ */
+static uint32_t storage_budget(void) {
+    return membudget.enabled ? membudget.budget_kb * 1024 : config_get_buffer_size_kb() * 1024;
+}
+
+/**
+ * Record limit that goes with storage_budget()
+ */
+static uint32_t storage_max_records(void) {
+    return membudget.enabled ? membudget_records(&membudget) : config_get_queue_size();
+}
 
-    for (uint32_t i = 0; i < entry_pool_size; i++) {
-        if (!pool_used[i]) {
-            pool_used[i] = true;
-            entry_pool[i].in_use = true;
-            return &entry_pool[i];
+/**
+ * Initialize the lane arenas sized by the byte budget
+ * Each lane ring gets a fixed share of the budget (lane_shares), so the rings
+ * together never take more memory than the budget, however long they run.
+ */
+static int init_log_storage(void) {
+    buffer_budget = storage_budget();
+
+    for (int lane = 0; lane < LOG_LANE_COUNT; lane++) {
+        if (log_arena_init(&lanes[lane], lane_capacity(buffer_budget, (log_lane_t)lane)) < 0) {
+            console_error(&csl, "Failed to allocate log arena");
+            while (--lane >= 0) {
+                log_arena_free(&lanes[lane]);
+            }
+            return -ENOMEM;
         }
     }
-    return NULL; // Pool exhausted
+
+    max_queued_records = storage_max_records();
+    arena_exhausted_count = 0;
+    memset(lane_evicted, 0, sizeof(lane_evicted));
+    high_water_bytes = 0;
+    high_water_records = 0;
+
+    const collector_config_t *config = config_get_current();
+    dedup_init(&dedup, config->dedup_window_ms);
+    ratelimit_init(&ratelimit, config->rate_limit, config->rate_limit_burst);
+    sampler_init(&sampler, config->sample_watermark, config->sample_max_rate);
+
+    console_debug(&csl, "Log storage initialized (%u bytes in %d lanes, max %u queued records)", buffer_budget,
+                  LOG_LANE_COUNT, max_queued_records);
+    return 0;
 }
 
 /**
- * Return an entry to the pool
+ * Apply a new byte budget and record limit to the lane arenas in place
+ * Queued records are evicted least severe first until the record limit is
+ * met, and oldest first in each lane until it fits its new share. Then each
+ * lane ring is reallocated with its records (queued and claimed by batches)
+ * packed at the start. A lane whose claimed records alone exceed its new
+ * share keeps its ring until the next resize.
  */
-void collect_return_entry_to_pool(compact_log_entry_t *entry) {
-    if (!entry || !pool_used || entry->pool_index >= entry_pool_size) {
+static void resize_log_storage(uint32_t budget, uint32_t max_records) {
+    uint32_t evicted = 0;
+
+    max_queued_records = max_records;
+    while (queued_records() > max_queued_records && evict_queued_record(LOG_LANE_HIGH)) {
+        evicted++;
+    }
+    for (int lane = 0; lane < LOG_LANE_COUNT; lane++) {
+        while (lane_used_bytes(&lanes[lane]) > lane_capacity(budget, (log_lane_t)lane) &&
+               evict_lane_record((log_lane_t)lane)) {
+            evicted++;
+        }
+    }
+    if (evicted) {
+        console_warn(&csl, "Evicted %u queued logs to fit the new buffer size", evicted);
+    }
+
+    if (budget == buffer_budget) {
         return;
     }
 
-    pool_used[entry->pool_index] = false;
-    entry->in_use = false;
-    memset(entry->msg, 0, sizeof(entry->msg));
-    entry->priority = 0;
-    entry->source = 0;
-    entry->time = 0;
+    for (int lane = 0; lane < LOG_LANE_COUNT; lane++) {
+        log_span_t *spans[MAX_INFLIGHT_BATCHES];
+        for (uint32_t i = 0; i < MAX_INFLIGHT_BATCHES; i++) {
+            spans[i] = &batches[i].spans[lane];
+        }
+
+        int ret = log_arena_resize(&lanes[lane], lane_capacity(budget, (log_lane_t)lane), spans, MAX_INFLIGHT_BATCHES);
+        if (ret < 0) {
+            console_warn(&csl, "Lane %d keeps its %u byte ring: %s", lane, lanes[lane].capacity, strerror(-ret));
+        }
+    }
+
+    // Records moved, the repeat lookup would point at stale offsets
+    dedup_reset(&dedup);
+
+    console_info(&csl, "Log buffer resized from %u to %u bytes (%u records held)", buffer_budget, budget,
+                 held_records());
+    buffer_budget = budget;
+}
+
+/**
+ * Follow memory pressure: shrink the lanes while it lasts, grow them back afterwards
+ */
+static void membudget_timer_cb(struct uloop_timeout *timeout) {
+    if (membudget_sample(&membudget)) {
+        resize_log_storage(storage_budget(), storage_max_records());
+    }
+    uloop_timeout_set(&membudget_timer, MEMBUDGET_INTERVAL_MS);
+}
+
+/**
+ * Set up memory-driven sizing from the configuration and start sampling
+ */
+static void init_membudget(const collector_config_t *config) {
+    uloop_timeout_cancel(&membudget_timer);
+    membudget_init(&membudget, config->memory_budget_percent, config->memory_budget_min_kb,
+                   config->memory_budget_max_kb, config->memory_low_percent);
+
+    membudget_timer.cb = membudget_timer_cb;
+    if (membudget.enabled) {
+        uloop_timeout_set(&membudget_timer, MEMBUDGET_INTERVAL_MS);
+    }
+}
+
+/**
+ * Queue fill level in percent (the higher of record count and the fullest lane ring)
+ */
+static uint32_t queue_fill_percent(void) {
+    uint32_t by_count = max_queued_records ? (uint32_t)((uint64_t)queued_records() * 100 / max_queued_records) : 0;
+    uint32_t by_bytes = lane_fill_percent();
+    return by_count > by_bytes ? by_count : by_bytes;
+}
+
+/**
+ * Monotonic time in milliseconds
+ */
+static uint64_t monotonic_ms(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000 + (uint64_t)now.tv_nsec / 1000000;
+}
+
+/**
+ * Pick a random collector instance id so idempotency keys stay unique across restarts
+ */
+static uint64_t generate_instance_id(void) {
+    uint64_t id = 0;
+    FILE *urandom = fopen("/dev/urandom", "rb");
+
+    if (urandom) {
+        if (fread(&id, sizeof(id), 1, urandom) != 1) {
+            id = 0;
+        }
+        fclose(urandom);
+    }
+
+    if (id == 0) {
+        struct timespec now;
+        clock_gettime(CLOCK_REALTIME, &now);
+        id = ((uint64_t)now.tv_sec << 32) ^ (uint64_t)now.tv_nsec ^ (uint64_t)getpid();
+    }
+
+    return id;
 }
 
 /**
- * Initialize the simple queue
+ * Format the idempotency key of a batch ("<instance>-<seq>")
  */
-static int init_simple_queue(simple_log_queue_t *q) {
-    uint32_t queue_size = config_get_queue_size();
+static void format_idempotency_key(char *key, size_t size, uint64_t instance, uint64_t seq) {
+    snprintf(key, size, "%016llx-%llu", (unsigned long long)instance, (unsigned long long)seq);
+}
 
-    q->entries = calloc(queue_size, sizeof(compact_log_entry_t *));
-    if (!q->entries) {
-        console_error(&csl, "Failed to allocate queue entries array");
+/**
+ * Hand the serialized bytes accumulated so far to the compressor
+ * Keeps the uncompressed scratch buffer bounded to about one chunk.
+ */
+static int flush_payload_chunk(batch_context_t *ctx) {
+    if (compressor.type == COMPRESSION_NONE || ctx->payload.len == 0) {
+        return 0;
+    }
+
+    int ret = compressor_write(&compressor, ctx->payload.data, ctx->payload.len, &ctx->compressed);
+    payload_stats.payload_bytes += ctx->payload.len;
+    payload_reset(&ctx->payload);
+    return ret;
+}
+
+/**
+ * Complete a serialized body, compressing what is left of it
+ * @return 0 on success, negative error code on failure
+ */
+static int finish_payload(batch_context_t *ctx) {
+    int ret;
+
+    if (ctx->payload.failed) {
         return -ENOMEM;
     }
 
-    q->head = 0;
-    q->tail = 0;
-    q->count = 0;
-    q->max_size = queue_size;
+    if (compressor.type == COMPRESSION_NONE) {
+        payload_stats.payload_bytes += ctx->payload.len;
+        return 0;
+    }
+
+    if ((ret = flush_payload_chunk(ctx)) < 0) {
+        return ret;
+    }
+    return compressor_finish(&compressor, &ctx->compressed);
+}
+
+/**
+ * Serialize batch entries as JSON straight into the reusable payload buffer
+ * With compression enabled the JSON is streamed through the compressor in
+ * chunks, so the full uncompressed body is never held in memory. Records are
+ * written lane by lane, most severe first.
+ * @return 0 on success, negative error code on failure
+ */
+static int create_json_payload(batch_context_t *ctx) {
+    payload_buffer_t *payload = &ctx->payload;
+    log_record_t *record;
+    bool first = true;
+    int ret = 0;
+
+    payload_reset(payload);
+    payload_append_str(payload, "{\"logs\":[");
+
+    for (int lane = 0; lane < LOG_LANE_COUNT; lane++) {
+        uint32_t pos = ctx->spans[lane].start;
+        uint32_t remaining = ctx->spans[lane].count;
+
+        while ((record = log_arena_next(&lanes[lane], &pos, &remaining))) {
+            payload_append_str(payload, first ? "{\"msg\":" : ",{\"msg\":");
+            payload_append_json_string(payload, record->msg, record->msg_len);
+            payload_append_str(payload, ",\"priority\":");
+            payload_append_u64(payload, record->priority);
+            payload_append_str(payload, ",\"source\":");
+            payload_append_u64(payload, record->source);
+            payload_append_str(payload, ",\"time\":");
+            payload_append_u64(payload, record->time);
+            if (record->repeats) {
+                payload_append_str(payload, ",\"repeat_count\":");
+                payload_append_u64(payload, (uint64_t)record->repeats + 1);
+                payload_append_str(payload, ",\"last_time\":");
+                payload_append_u64(payload, record->time + record->last_delta);
+            }
+            if (record->flags & LOG_RECORD_WEIGHT_MASK) {
+                payload_append_str(payload, ",\"sampled_weight\":");
+                payload_append_u64(payload, log_record_weight(record));
+            }
+            payload_append(payload, "}", 1);
+            first = false;
+
+            if (payload->len >= COMPRESS_CHUNK_SIZE && (ret = flush_payload_chunk(ctx)) < 0) {
+                return ret;
+            }
+        }
+    }
+
+    payload_append_str(payload, "],\"count\":");
+    payload_append_u64(payload, (uint64_t)ctx->count);
+    payload_append_str(payload, ",\"collector_version\":\"" COLLECTOR_VERSION "\"}");
+
+    return finish_payload(ctx);
+}
+
+/**
+ * Index of a value in a batch dictionary, adding it if new
+ * @return index, or -1 if the dictionary is full
+ */
+static int value_dict_index(value_dict_t *dict, uint32_t value) {
+    if (dict->count > 0 && dict->values[dict->last] == value) {
+        return (int)dict->last;
+    }
+
+    for (uint32_t i = 0; i < dict->count; i++) {
+        if (dict->values[i] == value) {
+            dict->last = i;
+            return (int)i;
+        }
+    }
+
+    if (dict->count == VALUE_DICT_SIZE) {
+        return -1;
+    }
+    dict->last = dict->count;
+    dict->values[dict->count++] = value;
+    return (int)dict->last;
+}
+
+/**
+ * Serialize batch entries as MessagePack
+ * A first pass over the records collects the priority and source
+ * dictionaries and the base time, the second writes the records as
+ * [msg, priority index, source index, time - base_time] arrays, with
+ * [..., repeat_count, last_time - time] appended for collapsed repeats and
+ * [..., repeat_count, last_time - time, sampled_weight] for sampled records.
+ * Messages are bin values, copied as they are.
+ * @return 0 on success, -E2BIG if a dictionary overflowed, other negative error code on failure
+ */
+static int create_msgpack_payload(batch_context_t *ctx) {
+    static value_dict_t priorities, sources;
+    payload_buffer_t *payload = &ctx->payload;
+    log_record_t *record;
+    uint64_t base_time = UINT64_MAX;
+    uint32_t count = 0;
+    int ret = 0;
+
+    priorities.count = 0;
+    sources.count = 0;
+    for (int lane = 0; lane < LOG_LANE_COUNT; lane++) {
+        uint32_t pos = ctx->spans[lane].start;
+        uint32_t remaining = ctx->spans[lane].count;
+
+        while ((record = log_arena_next(&lanes[lane], &pos, &remaining))) {
+            if (value_dict_index(&priorities, record->priority) < 0 ||
+                value_dict_index(&sources, record->source) < 0) {
+                return -E2BIG;
+            }
+            if (record->time < base_time) {
+                base_time = record->time;
+            }
+            count++;
+        }
+    }
+    if (count == 0) {
+        base_time = 0;
+    }
+
+    payload_reset(payload);
+    payload_append_mp_map(payload, 6);
+    payload_append_mp_str(payload, "collector_version", 17);
+    payload_append_mp_str(payload, COLLECTOR_VERSION, sizeof(COLLECTOR_VERSION) - 1);
+    payload_append_mp_str(payload, "count", 5);
+    payload_append_mp_uint(payload, count);
+    payload_append_mp_str(payload, "base_time", 9);
+    payload_append_mp_uint(payload, base_time);
+    payload_append_mp_str(payload, "priorities", 10);
+    payload_append_mp_array(payload, priorities.count);
+    for (uint32_t i = 0; i < priorities.count; i++) {
+        payload_append_mp_uint(payload, priorities.values[i]);
+    }
+    payload_append_mp_str(payload, "sources", 7);
+    payload_append_mp_array(payload, sources.count);
+    for (uint32_t i = 0; i < sources.count; i++) {
+        payload_append_mp_uint(payload, sources.values[i]);
+    }
+    payload_append_mp_str(payload, "logs", 4);
+    payload_append_mp_array(payload, count);
+
+    for (int lane = 0; lane < LOG_LANE_COUNT; lane++) {
+        uint32_t pos = ctx->spans[lane].start;
+        uint32_t remaining = ctx->spans[lane].count;
+
+        while ((record = log_arena_next(&lanes[lane], &pos, &remaining))) {
+            bool sampled = record->flags & LOG_RECORD_WEIGHT_MASK;
+            payload_append_mp_array(payload, sampled ? 7 : record->repeats ? 6 : 4);
+            payload_append_mp_bin(payload, record->msg, record->msg_len);
+            payload_append_mp_uint(payload, (uint64_t)value_dict_index(&priorities, record->priority));
+            payload_append_mp_uint(payload, (uint64_t)value_dict_index(&sources, record->source));
+            payload_append_mp_uint(payload, record->time - base_time);
+            if (record->repeats || sampled) {
+                payload_append_mp_uint(payload, (uint64_t)record->repeats + 1);
+                payload_append_mp_uint(payload, record->last_delta);
+            }
+            if (sampled) {
+                payload_append_mp_uint(payload, log_record_weight(record));
+            }
+
+            if (payload->len >= COMPRESS_CHUNK_SIZE && (ret = flush_payload_chunk(ctx)) < 0) {
+                return ret;
+            }
+        }
+    }
+
+    return finish_payload(ctx);
+}
+
+/**
+ * Prepare the batch payload and account for the serialization cost
+ */
+static int prepare_batch_payload(batch_context_t *ctx) {
+    struct timespec start, end;
+    int ret;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    ctx->body = &ctx->payload;
+    ctx->encoding = compressor.type;
+    if (compressor.type != COMPRESSION_NONE) {
+        ctx->body = &ctx->compressed;
+        ret = compressor_begin(&compressor, &ctx->compressed);
+        if (ret < 0) {
+            return ret;
+        }
+    }
+
+    // The dictionaries are checked before anything is written, a batch that does not fit them goes out as JSON
+    ctx->format = config_get_current()->format;
+    ret = ctx->format == PAYLOAD_FORMAT_MSGPACK ? create_msgpack_payload(ctx) : -E2BIG;
+    if (ret == -E2BIG) {
+        ctx->format = PAYLOAD_FORMAT_JSON;
+        ret = create_json_payload(ctx);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    if (ret < 0) {
+        return ret;
+    }
 
-    console_debug(&csl, "Queue initialized with %u entries", queue_size);
+    uint64_t elapsed_ns = (uint64_t)(end.tv_sec - start.tv_sec) * 1000000000ULL + (end.tv_nsec - start.tv_nsec);
+    payload_stats.batches++;
+    histogram_add(&batch_size_hist, ctx->count);
+    payload_stats.logs += (uint64_t)ctx->count;
+    payload_stats.wire_bytes += ctx->body->len;
+    payload_stats.serialize_ns += elapsed_ns;
+
+    console_debug(&csl, "Serialized %d logs into %zu bytes (%s, %s) in %llu ns (%llu ns/log)", ctx->count,
+                  ctx->body->len, payload_format_name(ctx->format), compression_name(compressor.type),
+                  (unsigned long long)elapsed_ns,
+                  (unsigned long long)(ctx->count ? elapsed_ns / (uint64_t)ctx->count : 0));
+
+    // Mirrors get the batch once, as serialized; retries and spool replays only go to the upload
+    sink_batch_t batch = {
+        .body = (const uint8_t *)ctx->body->data,
+        .len = ctx->body->len,
+        .format = ctx->format,
+        .encoding = ctx->encoding,
+        .count = (uint32_t)ctx->count,
+        .idempotency_key = ctx->idempotency_key,
+    };
+    sink_set_write(&mirror_sinks, &batch);
     return 0;
 }
 
+static void handle_send_result(batch_context_t *ctx, int error, uint32_t retry_after_ms);
+
 /**
- * Add entry to queue (single-threaded, no locks)
+ * Hand the batch payload to the HTTP sink
+ * The result is delivered to batch_upload_complete from the uloop context
  */
-static int enqueue_entry(simple_log_queue_t *q, compact_log_entry_t *entry) {
-    if (q->count >= q->max_size) {
-        return -1; // Queue full
+static int send_http_request(batch_context_t *ctx) {
+    if (!ctx->body || ctx->body->len == 0) {
+        return -1;
     }
 
-    q->entries[q->tail] = entry;
-    q->tail = (q->tail + 1) % q->max_size;
-    q->count++;
+    console_debug(&csl, "Sending batch %llu (%d logs, %zu bytes)", (unsigned long long)ctx->seq, ctx->count,
+                  ctx->body->len);
+
+    sink_batch_t batch = {
+        .body = (const uint8_t *)ctx->body->data,
+        .len = ctx->body->len,
+        .format = ctx->format,
+        .encoding = ctx->encoding,
+        .count = (uint32_t)ctx->count,
+        .idempotency_key = ctx->idempotency_key,
+    };
+    int ret = sink_write(http_sink, &batch, ctx);
+    if (ret < 0) {
+        collect_report_http_failure(ret);
+        return -1;
+    }
 
     return 0;
 }
 
 /**
- * Remove entry from queue (single-threaded, no locks)
+ * Upload of a live batch completed
+ */
+static void batch_upload_complete(batch_context_t *ctx, const sink_result_t *result) {
+    if (result->error == 0) {
+        console_info(&csl, "HTTP request successful (code: %ld) - took %.2f ms", result->status,
+                     result->duration_ms);
+        backoff_reset(&upload_backoff);
+        collect_report_http_success();
+    } else if (result->error == -EACCES) {
+        console_warn(&csl, "HTTP request failed with 401 Unauthorized, refreshing token - took %.2f ms",
+                     result->duration_ms);
+        // Try to refresh the token for next request
+        ubus_refresh_access_token();
+        collect_report_http_failure((int)result->status);
+    } else if (result->error == -EBADMSG) {
+        // The uplink works, the backend refuses this batch; it says nothing about the others
+        console_error(&csl, "HTTP request rejected with code: %ld - took %.2f ms", result->status,
+                      result->duration_ms);
+    } else if (result->status) {
+        console_warn(&csl, "HTTP request failed with code: %ld - took %.2f ms", result->status,
+                     result->duration_ms);
+        collect_report_http_failure((int)result->status);
+    } else {
+        console_warn(&csl, "HTTP request failed: %s - took %.2f ms", result->message, result->duration_ms);
+        collect_report_http_failure(result->error);
+    }
+
+    histogram_add(&latency_hist, result->duration_ms);
+    adaptive_record_upload(&adaptive, result->duration_ms, result->error == 0 || result->error == -EBADMSG,
+                           queue_fill_percent());
+
+    handle_send_result(ctx, result->error, result->retry_after_ms);
+}
+
+/**
+ * Append a batch that could not be delivered to the spool
+ * @return 0 if the batch is now owned by the spool, negative error code otherwise
+ */
+static int spool_batch(batch_context_t *ctx) {
+    if (!spool.open || !ctx->body || ctx->body->len == 0) {
+        return -ENODEV;
+    }
+
+    spool_entry_t entry = {
+        .body = (const uint8_t *)ctx->body->data,
+        .len = (uint32_t)ctx->body->len,
+        .format = ctx->format,
+        .encoding = ctx->encoding,
+        .count = (uint32_t)ctx->count,
+        .instance = instance_id,
+        .seq = ctx->seq,
+    };
+
+    int ret = spool_append(&spool, &entry);
+    if (ret < 0) {
+        console_error(&csl, "Failed to spool batch of %d logs: %s", ctx->count,
+                      ret == -EDQUOT ? "write budget exhausted" : strerror(-ret));
+        return ret;
+    }
+
+    console_info(&csl, "Spooled batch of %d logs (%zu bytes), %u batches pending replay", ctx->count, ctx->body->len,
+                 spool.stats.pending_batches);
+    return 0;
+}
+
+/**
+ * Reopen the spool with the current settings
+ * Segments already on disk are recovered from the (new) directory; the
+ * cumulative counters carry over.
+ */
+static void reopen_spool(void) {
+    const collector_config_t *config = config_get_current();
+    spool_stats_t stats = spool.stats;
+
+    spool_reopen_pending = false;
+    spool_close(&spool);
+    if (!config->spool_dir[0]) {
+        console_info(&csl, "Spool disabled");
+        return;
+    }
+
+    if (spool_open(&spool, config->spool_dir, config->spool_size_kb, config->spool_segment_kb,
+                   config->spool_write_budget_kb) < 0) {
+        console_warn(&csl, "Spool unavailable, failed batches will be dropped");
+        return;
+    }
+
+    spool.stats.written_batches += stats.written_batches;
+    spool.stats.written_bytes += stats.written_bytes;
+    spool.stats.replayed_batches += stats.replayed_batches;
+    spool.stats.dropped_batches += stats.dropped_batches;
+    spool.stats.budget_rejects += stats.budget_rejects;
+}
+
+/**
+ * Upload the oldest spooled batch, one at a time and in order
+ * Replay starts once uploads succeed again, or after a backoff if a replay attempt failed.
+ */
+static void spool_replay_next(void) {
+    spool_entry_t entry;
+
+    // The replayed entry is consumed from the spool it was read from, switch once it is done
+    if (spool_reopen_pending && !replay_in_flight) {
+        reopen_spool();
+    }
+
+    if (!system_running || replay_in_flight || !spool_has_pending(&spool)) {
+        return;
+    }
+
+    if (consecutive_http_failures > 0 && replay_timer.pending) {
+        return;
+    }
+
+    // The backend asked for a break, or failed recently
+    uint32_t wait_ms = backoff_remaining_ms(&upload_backoff, monotonic_ms());
+    if (wait_ms > 0) {
+        uloop_timeout_set(&replay_timer, (int)wait_ms);
+        return;
+    }
+
+    if (spool_peek(&spool, &entry) < 0) {
+        return;
+    }
+
+    // Nothing to send until a token arrives
+    if (!ubus_get_current_token()) {
+        return;
+    }
+
+    // Copy the body out of the mapping, the segment may be dropped while the request is in flight
+    payload_reset(&replay_body);
+    payload_append(&replay_body, entry.body, entry.len);
+    if (replay_body.failed) {
+        return;
+    }
+
+    char idempotency_key[40];
+    format_idempotency_key(idempotency_key, sizeof(idempotency_key), entry.instance, entry.seq);
+
+    sink_batch_t batch = {
+        .body = (const uint8_t *)replay_body.data,
+        .len = replay_body.len,
+        .format = entry.format,
+        .encoding = entry.encoding,
+        .count = entry.count,
+        .idempotency_key = idempotency_key,
+    };
+
+    console_debug(&csl, "Replaying spooled batch of %u logs (%u bytes)", entry.count, entry.len);
+    if (sink_write(http_sink, &batch, &replay_body) < 0) {
+        uloop_timeout_set(&replay_timer, SPOOL_REPLAY_BACKOFF_S * 1000);
+        return;
+    }
+    replay_instance = entry.instance;
+    replay_seq = entry.seq;
+    replay_in_flight = true;
+}
+
+/**
+ * Remove the replayed batch from the spool
+ * A live batch spooled while the replay was in flight may have rotated the
+ * spool and dropped the segment holding it (already counted as dropped).
+ */
+static void consume_replayed_batch(void) {
+    if (spool_consume(&spool, replay_instance, replay_seq) == -ESTALE) {
+        console_debug(&csl, "Replayed batch was dropped from the spool while in flight");
+    }
+}
+
+/**
+ * Spooled batch upload completed
+ */
+static void replay_upload_complete(const sink_result_t *result) {
+    replay_in_flight = false;
+    histogram_add(&latency_hist, result->duration_ms);
+
+    if (result->error == 0) {
+        consume_replayed_batch();
+        console_info(&csl, "Replayed spooled batch (code: %ld) - took %.2f ms, %u batches pending", result->status,
+                     result->duration_ms, spool.stats.pending_batches);
+        backoff_reset(&upload_backoff);
+        collect_report_http_success();
+        spool_replay_next();
+        return;
+    }
+
+    if (result->error == -EBADMSG) {
+        // The backend will never accept this batch, do not let it block the ones behind it
+        console_error(&csl, "Spooled batch rejected with code: %ld, discarding it", result->status);
+        rejected_batches++;
+        consume_replayed_batch();
+        spool_replay_next();
+        return;
+    }
+
+    if (result->error == -EACCES) {
+        ubus_refresh_access_token();
+    }
+
+    uint32_t delay_ms = backoff_failure(&upload_backoff, result->retry_after_ms, monotonic_ms());
+    console_warn(&csl, "Spooled batch replay failed (%s), retrying in %u ms",
+                 result->status ? "HTTP error" : result->message, delay_ms);
+    uloop_timeout_set(&replay_timer, (int)delay_ms);
+    collect_report_http_failure(result->status ? (int)result->status : result->error);
+}
+
+/**
+ * HTTP sink completion (called from uloop once curl finished the transfer)
+ * The owner is the batch context, or the replay buffer for a spooled batch.
+ */
+static void http_sink_complete_cb(sink_t *sink, void *owner, const sink_result_t *result) {
+    if (owner == &replay_body) {
+        replay_upload_complete(result);
+    } else {
+        batch_upload_complete(owner, result);
+    }
+}
+
+/**
+ * Replay backoff expired
+ */
+static void replay_timer_cb(struct uloop_timeout *timeout) { spool_replay_next(); }
+
+static void retry_timer_cb(struct uloop_timeout *timeout);
+
+/**
+ * Initialize batch context
+ */
+static int init_batch_context(batch_context_t *ctx) {
+    uint32_t batch_size = config_get_batch_size();
+
+    memset(ctx->spans, 0, sizeof(ctx->spans));
+    ctx->count = 0;
+    ctx->max_count = batch_size;
+    ctx->retry_count = 0;
+    ctx->state = HTTP_IDLE;
+    ctx->seq = 0;
+    ctx->idempotency_key[0] = '\0';
+    memset(&ctx->payload, 0, sizeof(ctx->payload));
+    memset(&ctx->compressed, 0, sizeof(ctx->compressed));
+    ctx->body = NULL;
+    ctx->format = PAYLOAD_FORMAT_JSON;
+    ctx->encoding = COMPRESSION_NONE;
+    memset(&ctx->retry_timer, 0, sizeof(ctx->retry_timer));
+    ctx->retry_timer.cb = retry_timer_cb;
+
+    return 0;
+}
+
+/**
+ * Clear batch context and release its records back to the lane arenas
+ */
+static void clear_batch_context(batch_context_t *ctx) {
+    for (int lane = 0; lane < LOG_LANE_COUNT; lane++) {
+        log_arena_release(&lanes[lane], &ctx->spans[lane]);
+    }
+
+    // Keep the payload allocations for the next batch
+    payload_reset(&ctx->payload);
+    payload_reset(&ctx->compressed);
+    ctx->body = NULL;
+
+    ctx->count = 0;
+    ctx->retry_count = 0;
+    ctx->state = HTTP_IDLE;
+    ctx->seq = 0;
+    ctx->idempotency_key[0] = '\0';
+}
+
+/**
+ * Whether the batch holds the oldest claimed records of every lane it has records in
+ */
+static bool batch_at_lane_heads(const batch_context_t *ctx) {
+    for (int lane = 0; lane < LOG_LANE_COUNT; lane++) {
+        const log_span_t *span = &ctx->spans[lane];
+        if ((span->count || span->bytes) && span->start != lanes[lane].head) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * Release finished batches back to the lane arenas in claim order
+ * A batch that completes before an older one keeps its records until the older one is done.
+ */
+static void release_completed_batches(void) {
+    bool released;
+
+    do {
+        released = false;
+        for (uint32_t i = 0; i < MAX_INFLIGHT_BATCHES; i++) {
+            batch_context_t *ctx = &batches[i];
+            if (ctx->state == HTTP_DONE && batch_at_lane_heads(ctx)) {
+                clear_batch_context(ctx);
+                released = true;
+            }
+        }
+    } while (released);
+}
+
+/**
+ * Mark a batch as finished (delivered, spooled or dropped)
+ */
+static void finish_batch(batch_context_t *ctx) {
+    ctx->state = HTTP_DONE;
+    release_completed_batches();
+}
+
+/**
+ * Find a free batch slot
+ * @return slot or NULL if all usable slots are busy
+ */
+static batch_context_t *acquire_batch_slot(void) {
+    for (uint32_t i = 0; i < inflight_limit; i++) {
+        if (batches[i].state == HTTP_IDLE && batches[i].count == 0 && &batches[i] != filling_batch) {
+            return &batches[i];
+        }
+    }
+    return NULL;
+}
+
+/**
+ * Number of batches with a request in flight or waiting for a retry
+ */
+static uint32_t batches_in_flight(void) {
+    uint32_t count = 0;
+
+    for (uint32_t i = 0; i < MAX_INFLIGHT_BATCHES; i++) {
+        if (batches[i].state == HTTP_SENDING || batches[i].state == HTTP_RETRY_WAIT) {
+            count++;
+        }
+    }
+    return count;
+}
+
+/**
+ * Close a batch for new records and assign its sequence number and idempotency key
+ */
+static void seal_batch(batch_context_t *ctx) {
+    ctx->seq = next_batch_seq++;
+    format_idempotency_key(ctx->idempotency_key, sizeof(ctx->idempotency_key), instance_id, ctx->seq);
+    ctx->state = HTTP_PREPARING;
+
+    if (ctx == filling_batch) {
+        filling_batch = NULL;
+        batch_overdue = false;
+        uloop_timeout_cancel(&batch_deadline);
+    }
+}
+
+static int advance_batch(batch_context_t *ctx);
+
+/**
+ * Wait before sending a batch (again)
+ */
+static void schedule_retry(batch_context_t *ctx, uint32_t delay_ms) {
+    ctx->state = HTTP_RETRY_WAIT;
+    uloop_timeout_set(&ctx->retry_timer, (int)delay_ms);
+}
+
+/**
+ * Handle the outcome of a send attempt (success, retry or give up)
+ * Failures back off exponentially with jitter, at least as long as the
+ * server asked for with Retry-After.
+ */
+static void handle_send_result(batch_context_t *ctx, int error, uint32_t retry_after_ms) {
+    if (error == 0) {
+        console_info(&csl, "Successfully sent batch %llu of %d logs", (unsigned long long)ctx->seq, ctx->count);
+        finish_batch(ctx);
+        last_batch_time = time(NULL);
+    } else if (error == -EBADMSG) {
+        // Retrying or spooling would only hold up the batches behind it, the backoff stays as it is
+        console_error(&csl, "Batch %llu of %d logs rejected by the backend, discarding it", (unsigned long long)ctx->seq,
+                      ctx->count);
+        rejected_batches++;
+        ctx->state = HTTP_FAILED;
+        advance_batch(ctx);
+    } else {
+        uint32_t delay_ms = backoff_failure(&upload_backoff, retry_after_ms, monotonic_ms());
+        ctx->retry_count++;
+
+        // With the uplink known to be down, hand the batch to the spool instead of retrying
+        bool uplink_down = consecutive_http_failures > (int)config_get_http_retries() && spool.open;
+
+        if (ctx->retry_count < (int)config_get_http_retries() && !uplink_down) {
+            console_warn(&csl, "HTTP send of batch %llu failed, retrying in %u ms (%d/%u)", (unsigned long long)ctx->seq,
+                         delay_ms, ctx->retry_count, config_get_http_retries());
+            schedule_retry(ctx, delay_ms);
+            return;
+        }
+
+        console_error(&csl, "HTTP send of batch %llu failed after %d attempts", (unsigned long long)ctx->seq,
+                      ctx->retry_count);
+        if (spool_batch(ctx) == 0) {
+            finish_batch(ctx);
+        } else if (!flushing) {
+            // Nowhere to put it, keep the records and try again once the backoff expired
+            console_warn(&csl, "Keeping batch %llu, retrying in %u ms", (unsigned long long)ctx->seq, delay_ms);
+            schedule_retry(ctx, delay_ms);
+            return;
+        } else {
+            ctx->state = HTTP_FAILED;
+            advance_batch(ctx);
+        }
+    }
+
+    if (flushing) {
+        if (batches_in_flight() == 0) {
+            uloop_end();
+        }
+        return;
+    }
+
+    // Pick up the next batch right away, a slot just became free
+    uloop_timeout_set(&process_timer, 0);
+}
+
+/**
+ * Retry timer callback, re-dispatches the batch owning the timer
+ * Another failure may have extended the backoff in the meantime.
+ */
+static void retry_timer_cb(struct uloop_timeout *timeout) {
+    batch_context_t *ctx = container_of(timeout, batch_context_t, retry_timer);
+
+    if (ctx->state != HTTP_RETRY_WAIT) {
+        return;
+    }
+
+    uint32_t wait_ms = backoff_remaining_ms(&upload_backoff, monotonic_ms());
+    if (wait_ms > 0 && !flushing) {
+        uloop_timeout_set(&ctx->retry_timer, (int)wait_ms);
+        return;
+    }
+
+    ctx->state = HTTP_SENDING;
+    if (send_http_request(ctx) < 0) {
+        handle_send_result(ctx, -EIO, 0);
+    }
+}
+
+/**
+ * Deferred batch processing after a request completed
+ */
+static void process_timer_cb(struct uloop_timeout *timeout) { collect_process_pending_batches(); }
+
+/**
+ * Records waiting to be sent in a sealed batch (claimed by the filling batch or still queued)
+ */
+static uint32_t unsealed_records(void) {
+    return queued_records() + (filling_batch ? (uint32_t)filling_batch->count : 0);
+}
+
+/**
+ * Arm the batch deadline when the first unsealed record arrived
+ * No timer is pending while nothing waits, so an idle collector does not wake up.
+ */
+static void schedule_batch_deadline(void) {
+    if (unsealed_records() == 0) {
+        uloop_timeout_cancel(&batch_deadline);
+        batch_overdue = false;
+    } else if (!batch_deadline.pending && !batch_overdue) {
+        uloop_timeout_set(&batch_deadline, (int)adaptive.batch_timeout_ms);
+    }
+}
+
+/**
+ * Batch timeout reached, seal whatever the filling batch holds
+ * Without a free slot the batch is sealed as soon as one becomes available.
  */
-static compact_log_entry_t *dequeue_entry(simple_log_queue_t *q) {
-    if (q->count == 0) {
-        return NULL;
-    }
-
-    compact_log_entry_t *entry = q->entries[q->head];
-    q->entries[q->head] = NULL;
-    q->head = (q->head + 1) % q->max_size;
-    q->count--;
+static void batch_deadline_cb(struct uloop_timeout *timeout) {
+    batch_overdue = true;
+    collect_process_pending_batches();
+}
 
-    return entry;
+/**
+ * Final flush deadline reached during shutdown
+ */
+static void flush_timer_cb(struct uloop_timeout *timeout) {
+    console_warn(&csl, "Final batch flush timed out after %d ms", FINAL_FLUSH_TIMEOUT_MS);
+    uloop_end();
 }
 
 /**
- * Initialize CURL for HTTP operations
+ * Advance the state machine of one batch slot
+ * Requests run asynchronously; SENDING and RETRY_WAIT are left by the
+ * completion callback and the retry timer respectively.
  */
-static int init_http_client(void) {
-    curl_global_init(CURL_GLOBAL_DEFAULT);
+static int advance_batch(batch_context_t *ctx) {
+    switch (ctx->state) {
+    case HTTP_IDLE:
+        // Only the batch being filled can be sealed
+        if (ctx != filling_batch) {
+            break;
+        }
 
-    curl_handle = curl_easy_init();
-    if (!curl_handle) {
-        console_error(&csl, "Failed to initialize CURL");
-        return -1;
-    }
+        if (ctx->count >= ctx->max_count) {
+            console_debug(&csl, "Starting batch: reached max size (%d)", ctx->count);
+            seal_batch(ctx);
+        } else if (ctx->count > 0 && batch_overdue) {
+            console_debug(&csl, "Starting batch: timeout reached (%d entries)", ctx->count);
+            seal_batch(ctx);
+        }
+        break;
 
-    // Set up common CURL options
-    curl_easy_setopt(curl_handle, CURLOPT_ERRORBUFFER, curl_error_buffer);
-    curl_easy_setopt(curl_handle, CURLOPT_TIMEOUT, (long)config_get_http_timeout());
-    curl_easy_setopt(curl_handle, CURLOPT_CONNECTTIMEOUT, 10L);
-    curl_easy_setopt(curl_handle, CURLOPT_FOLLOWLOCATION, 1L);
-    curl_easy_setopt(curl_handle, CURLOPT_SSL_VERIFYPEER, 1L);
-    curl_easy_setopt(curl_handle, CURLOPT_SSL_VERIFYHOST, 2L);
+    case HTTP_PREPARING:
+        // Create JSON payload
+        if (prepare_batch_payload(ctx) < 0) {
+            console_error(&csl, "Failed to create JSON payload");
+            ctx->state = HTTP_FAILED;
+            return advance_batch(ctx);
+        }
 
-    // Set up headers
-    http_headers = curl_slist_append(http_headers, "Content-Type: application/json");
-    http_headers = curl_slist_append(http_headers, "User-Agent: fry-collector/1.0");
+        // New batches wait out the backoff too, they would only add to the load
+        uint32_t wait_ms = backoff_remaining_ms(&upload_backoff, monotonic_ms());
+        if (wait_ms > 0 && !flushing) {
+            console_debug(&csl, "Holding batch %llu for %u ms, backing off", (unsigned long long)ctx->seq, wait_ms);
+            schedule_retry(ctx, wait_ms);
+            break;
+        }
 
-    console_debug(&csl, "HTTP client initialized");
-    return 0;
-}
+        console_debug(&csl, "Starting HTTP request for batch %llu with %d logs (%zu bytes), %u in flight",
+                      (unsigned long long)ctx->seq, ctx->count, ctx->body->len, batches_in_flight());
+        ctx->state = HTTP_SENDING;
+        if (send_http_request(ctx) < 0) {
+            handle_send_result(ctx, -EIO, 0);
+        }
+        break;
 
-/**
- * Cleanup HTTP client
- */
-static void cleanup_http_client(void) {
-    if (http_headers) {
-        curl_slist_free_all(http_headers);
-        http_headers = NULL;
-    }
+    case HTTP_SENDING:
+    case HTTP_RETRY_WAIT:
+    case HTTP_DONE:
+        // Waiting for the transfer, the retry timer or an older batch to be released
+        break;
 
-    if (curl_handle) {
-        curl_easy_cleanup(curl_handle);
-        curl_handle = NULL;
+    case HTTP_FAILED:
+        console_error(&csl, "Batch %llu processing failed, dropping %d entries", (unsigned long long)ctx->seq,
+                      ctx->count);
+        finish_batch(ctx);
+        return -1; // Failed
     }
 
-    curl_global_cleanup();
+    return 0; // Continue processing
 }
 
 /**
- * Create JSON payload from batch entries
+ * HTTP state machine implementation
+ * Every batch slot advances independently, up to max_inflight_batches
+ * requests are in flight at once.
  */
-static char *create_json_payload(compact_log_entry_t **entries, int count, size_t *payload_size) {
-    json_object *root = json_object_new_object();
-    json_object *logs_array = json_object_new_array();
-
-    for (int i = 0; i < count; i++) {
-        compact_log_entry_t *entry = entries[i];
-
-        json_object *log_obj = json_object_new_object();
-        json_object_object_add(log_obj, "msg", json_object_new_string(entry->msg));
-        json_object_object_add(log_obj, "priority", json_object_new_int64(entry->priority));
-        json_object_object_add(log_obj, "source", json_object_new_int64(entry->source));
-        json_object_object_add(log_obj, "time", json_object_new_int64(entry->time));
-
-        json_object_array_add(logs_array, log_obj);
-    }
+int collect_advance_http_state_machine(void) {
+    int result = 0;
 
-    json_object_object_add(root, "logs", logs_array);
-    json_object_object_add(root, "count", json_object_new_int(count));
-    json_object_object_add(root, "collector_version", json_object_new_string("1.0.0-raw-logs"));
+    // Slots above a lowered limit still finish the batches they hold
+    for (uint32_t i = 0; i < MAX_INFLIGHT_BATCHES; i++) {
+        batch_context_t *ctx = &batches[i];
 
-    const char *json_string = json_object_to_json_string(root);
-    *payload_size = strlen(json_string);
-    char *payload = malloc(*payload_size + 1);
+        if (advance_batch(ctx) < 0) {
+            result = -1;
+        }
 
-    if (payload) {
-        strcpy(payload, json_string);
+        // A batch sealed in this pass is sent right away
+        if (ctx->state == HTTP_PREPARING && advance_batch(ctx) < 0) {
+            result = -1;
+        }
     }
 
-    json_object_put(root);
-    return payload;
+    return result;
 }
 
 /**
- * Send HTTP request (non-blocking approach)
+ * Claim queued records into a batch, extending its lane spans
+ * While several lanes have records queued, each gets its weighted share of
+ * the room left in the batch; whatever a lane cannot fill goes to the others
+ * in priority order.
  */
-static int send_http_request(const char *payload, size_t payload_size) {
-    if (!curl_handle || !payload) {
-        return -1;
-    }
-    
-    // Track request start time
-    struct timespec start_time;
-    clock_gettime(CLOCK_MONOTONIC, &start_time);
+static void claim_lane_records(batch_context_t *ctx) {
+    uint32_t room = ctx->max_count > ctx->count ? (uint32_t)(ctx->max_count - ctx->count) : 0;
+    uint32_t weight_sum = 0;
 
-    // Get cached access token
-    const char *access_token = ubus_get_current_token();
-    if (!access_token) {
-        console_warn(&csl, "No valid access token available, aborting HTTP request");
-        collect_report_http_failure(-1);
-        return -1;
+    for (int lane = 0; lane < LOG_LANE_COUNT; lane++) {
+        if (lanes[lane].queued > 0) {
+            weight_sum += lane_weights[lane];
+        }
     }
 
-    // Update headers with authorization
-    struct curl_slist *request_headers = http_headers;
-    char auth_header[600]; // Token + "Authorization: Bearer " prefix
-    snprintf(auth_header, sizeof(auth_header), "Authorization: Bearer %s", access_token);
-    request_headers = curl_slist_append(request_headers, auth_header);
-    if (!request_headers) {
-        console_error(&csl, "Failed to add authorization header");
-        collect_report_http_failure(-1);
-        return -1;
+    if (room == 0 || weight_sum == 0) {
+        return;
     }
-    console_debug(&csl, "Added Bearer token to request");
-
-    const char *backend_url = config_get_logs_endpoint();
-    curl_easy_setopt(curl_handle, CURLOPT_URL, backend_url);
-    curl_easy_setopt(curl_handle, CURLOPT_POSTFIELDS, payload);
-    curl_easy_setopt(curl_handle, CURLOPT_POSTFIELDSIZE, payload_size);
-    curl_easy_setopt(curl_handle, CURLOPT_HTTPHEADER, request_headers);
 
-    CURLcode res = curl_easy_perform(curl_handle);
-
-    // Clean up authorization header if we added it
-    if (request_headers != http_headers) {
-        curl_slist_free_all(request_headers);
+    // Weighted shares, rounded up so every backlogged lane makes progress
+    uint32_t left = room;
+    for (int lane = 0; lane < LOG_LANE_COUNT && left > 0; lane++) {
+        if (lanes[lane].queued == 0) {
+            continue;
+        }
+        uint32_t share = (room * lane_weights[lane] + weight_sum - 1) / weight_sum;
+        if (share > left) {
+            share = left;
+        }
+        left -= log_arena_claim(&lanes[lane], &ctx->spans[lane], ctx->spans[lane].count + share);
     }
 
-    if (res != CURLE_OK) {
-        // Calculate duration for curl errors too
-        struct timespec error_time;
-        clock_gettime(CLOCK_MONOTONIC, &error_time);
-        double error_duration_ms = (error_time.tv_sec - start_time.tv_sec) * 1000.0 + 
-                                (error_time.tv_nsec - start_time.tv_nsec) / 1000000.0;
-        
-        console_warn(&csl, "HTTP request failed: %s - took %.2f ms", 
-                    curl_error_buffer, error_duration_ms);
-        collect_report_http_failure(-res);
-        return -1;
+    // Room the shares left unused
+    for (int lane = 0; lane < LOG_LANE_COUNT && left > 0; lane++) {
+        left -= log_arena_claim(&lanes[lane], &ctx->spans[lane], ctx->spans[lane].count + left);
     }
 
-    long response_code;
-    curl_easy_getinfo(curl_handle, CURLINFO_RESPONSE_CODE, &response_code);
-
-    // Calculate request duration
-    struct timespec end_time;
-    clock_gettime(CLOCK_MONOTONIC, &end_time);
-    double duration_ms = (end_time.tv_sec - start_time.tv_sec) * 1000.0 + 
-                        (end_time.tv_nsec - start_time.tv_nsec) / 1000000.0;
-    
-    if (response_code >= 200 && response_code < 300) {
-        console_info(&csl, "HTTP request successful (code: %ld) - took %.2f ms", 
-                    response_code, duration_ms);
-        collect_report_http_success();
-        return 0;
-    } else if (response_code == 401) {
-        console_warn(&csl, "HTTP request failed with 401 Unauthorized, refreshing token - took %.2f ms", 
-                    duration_ms);
-        // Try to refresh the token for next request
-        ubus_refresh_access_token();
-        collect_report_http_failure(response_code);
-        return -1;
-    } else {
-        console_warn(&csl, "HTTP request failed with code: %ld - took %.2f ms", 
-                    response_code, duration_ms);
-        collect_report_http_failure(response_code);
-        return -1;
-    }
+    ctx->count += (int)(room - left);
 }
 
 /**
- * Initialize batch context
+ * Collect entries for a batch
+ * Records are claimed into the batch being filled; a new one is started
+ * in a free slot while older batches are still in flight.
  */
-static int init_batch_context(batch_context_t *ctx) {
-    uint32_t batch_size = config_get_batch_size();
-
-    ctx->entries = calloc(batch_size, sizeof(compact_log_entry_t *));
-    if (!ctx->entries) {
-        console_error(&csl, "Failed to allocate batch entries array");
-        return -ENOMEM;
+static void collect_entries_for_batch(void) {
+    if (!filling_batch) {
+        if (queued_records() == 0 || !(filling_batch = acquire_batch_slot())) {
+            return;
+        }
+        filling_batch->max_count = (int)adaptive.batch_size;
     }
 
-    ctx->count = 0;
-    ctx->max_count = batch_size;
-    ctx->created_time = time(NULL);
-    ctx->retry_count = 0;
-    ctx->state = HTTP_IDLE;
-    ctx->json_payload = NULL;
-    ctx->payload_size = 0;
-
-    console_debug(&csl, "Batch context initialized with %u entries", batch_size);
-    return 0;
+    claim_lane_records(filling_batch);
 }
 
 /**
- * Clear batch context and return entries to pool
+ * Oldest batch that still holds records and is not finished
  */
-static void clear_batch_context(batch_context_t *ctx) {
-    for (int i = 0; i < ctx->count; i++) {
-        if (ctx->entries[i]) {
-            collect_return_entry_to_pool(ctx->entries[i]);
-            ctx->entries[i] = NULL;
+static batch_context_t *oldest_unfinished_batch(void) {
+    for (uint32_t i = 0; i < MAX_INFLIGHT_BATCHES; i++) {
+        batch_context_t *ctx = &batches[i];
+        if (ctx->count > 0 && ctx->state != HTTP_DONE && batch_at_lane_heads(ctx)) {
+            return ctx;
         }
     }
-
-    if (ctx->json_payload) {
-        free(ctx->json_payload);
-        ctx->json_payload = NULL;
-    }
-
-    ctx->count = 0;
-    ctx->created_time = time(NULL);
-    ctx->retry_count = 0;
-    ctx->state = HTTP_IDLE;
+    return NULL;
 }
 
 /**
- * HTTP state machine implementation
+ * Move unsent batches and everything still queued to the spool on shutdown
+ * Batches are spooled in claim order so replay preserves the log order.
  */
-int collect_advance_http_state_machine(void) {
-    time_t now = time(NULL);
+static void spool_remaining_logs(void) {
+    uint32_t spooled = 0;
 
-    switch (current_batch.state) {
-    case HTTP_IDLE:
-        // Check if we should start a new batch
-        if (current_batch.count >= (int)config_get_batch_size()) {
-            console_debug(&csl, "Starting batch: reached max size (%d)", current_batch.count);
-            current_batch.state = HTTP_PREPARING;
-        } else if (current_batch.count > 0 &&
-                   (now - current_batch.created_time) >= (config_get_batch_timeout_ms() / 1000)) {
-            console_debug(&csl, "Starting batch: timeout reached (%d entries)", current_batch.count);
-            current_batch.state = HTTP_PREPARING;
-        }
-        break;
+    if (!spool.open) {
+        return;
+    }
 
-    case HTTP_PREPARING:
-        // Create JSON payload
-        current_batch.json_payload =
-            create_json_payload(current_batch.entries, current_batch.count, &current_batch.payload_size);
+    for (;;) {
+        batch_context_t *ctx = oldest_unfinished_batch();
 
-        if (current_batch.json_payload) {
-            current_batch.state = HTTP_SENDING;
-            console_debug(&csl, "Prepared batch with %d entries (%zu bytes)", current_batch.count,
-                          current_batch.payload_size);
-        } else {
-            console_error(&csl, "Failed to create JSON payload");
-            current_batch.state = HTTP_FAILED;
+        if (!ctx) {
+            // Everything claimed is handled, batch up what is still queued
+            if (queued_records() == 0 || !(ctx = acquire_batch_slot())) {
+                break;
+            }
+            claim_lane_records(ctx);
         }
-        break;
 
-    case HTTP_SENDING: {
-        console_debug(&csl, "Starting HTTP request for batch with %d logs (%zu bytes)", 
-                     current_batch.count, current_batch.payload_size);
-        int result = send_http_request(current_batch.json_payload, current_batch.payload_size);
-
-        if (result == 0) {
-            console_info(&csl, "Successfully sent batch of %d logs", current_batch.count);
-            clear_batch_context(&current_batch);
-            last_batch_time = now;
-            return 1; // Batch completed successfully
-        } else {
-            current_batch.retry_count++;
-            if (current_batch.retry_count < (int)config_get_http_retries()) {
-                console_warn(&csl, "HTTP send failed, retrying (%d/%u)", current_batch.retry_count,
-                             config_get_http_retries());
-                current_batch.state = HTTP_RETRY_WAIT;
-            } else {
-                console_error(&csl, "HTTP send failed after %u attempts", config_get_http_retries());
-                current_batch.state = HTTP_FAILED;
+        // Batches that were sent already have their body; everything else is serialized now
+        if (ctx->state != HTTP_SENDING && ctx->state != HTTP_RETRY_WAIT) {
+            if (ctx->state == HTTP_IDLE) {
+                seal_batch(ctx);
+            }
+            if (prepare_batch_payload(ctx) < 0) {
+                break;
             }
         }
-    } break;
-
-    case HTTP_RETRY_WAIT:
-        // Simple delay before retry
-        sleep(HTTP_RETRY_DELAY_MS / 1000);
-        current_batch.state = HTTP_SENDING;
-        break;
-
-    case HTTP_FAILED:
-        console_error(&csl, "Batch processing failed, dropping %d entries", current_batch.count);
-        clear_batch_context(&current_batch);
-        return -1; // Failed
-    }
-
-    return 0; // Continue processing
-}
 
-/**
- * Collect entries for a batch
- */
-static void collect_entries_for_batch(void) {
-    // Don't start new batch if current one is being processed
-    if (current_batch.state != HTTP_IDLE) {
-        return;
+        if (spool_batch(ctx) < 0) {
+            break;
+        }
+        spooled += ctx->count;
+        finish_batch(ctx);
     }
 
-    // Collect entries from queue
-    while (current_batch.count < current_batch.max_count && queue.count > 0) {
-        compact_log_entry_t *entry = dequeue_entry(&queue);
-        if (entry) {
-            current_batch.entries[current_batch.count] = entry;
-            current_batch.count++;
-
-            if (current_batch.count == 1) {
-                current_batch.created_time = time(NULL);
-            }
-        }
+    if (spooled > 0) {
+        console_info(&csl, "Spooled %u undelivered logs for the next start", spooled);
     }
 }
 
@@ -485,56 +1387,190 @@ int collect_init(void) {
         return -1;
     }
 
-    if (init_simple_queue(&queue) < 0) {
-        console_error(&csl, "Failed to initialize queue");
+    init_membudget(config);
+    if (init_log_storage() < 0) {
+        console_error(&csl, "Failed to initialize log storage");
         return -1;
     }
 
-    if (init_entry_pool() < 0) {
-        console_error(&csl, "Failed to initialize entry pool");
-        return -1;
-    }
+    adaptive_init(&adaptive, config->adaptive_batching, config->batch_size, config->batch_size_min,
+                  config->batch_size_max, config->batch_timeout_ms, config->batch_timeout_min_ms,
+                  config->batch_timeout_max_ms, URGENT_THRESHOLD_PERCENT);
 
-    if (init_batch_context(&current_batch) < 0) {
-        console_error(&csl, "Failed to initialize batch context");
-        return -1;
+    inflight_limit = config->max_inflight_batches;
+    for (uint32_t i = 0; i < MAX_INFLIGHT_BATCHES; i++) {
+        if (init_batch_context(&batches[i]) < 0) {
+            console_error(&csl, "Failed to initialize batch context");
+            return -1;
+        }
     }
+    filling_batch = NULL;
+    instance_id = generate_instance_id();
+    next_batch_seq = 1;
+
+    // Seeded with the random instance id so devices that failed together spread their retries
+    backoff_init(&upload_backoff, HTTP_RETRY_DELAY_MS, HTTP_BACKOFF_MAX_MS, instance_id);
 
     dropped_count = 0;
+    memset(&ingest_stats, 0, sizeof(ingest_stats));
+    memset(&ingest_rate, 0, sizeof(ingest_rate));
+    histogram_init(&batch_size_hist, 1);
+    histogram_init(&latency_hist, 1);
     system_running = false;
     last_batch_time = time(NULL);
 
-    if (init_http_client() < 0) {
+    process_timer.cb = process_timer_cb;
+    flush_timer.cb = flush_timer_cb;
+    batch_deadline.cb = batch_deadline_cb;
+    batch_overdue = false;
+    replay_timer.cb = replay_timer_cb;
+
+    if (compressor_init(&compressor, config->compression, config->compression_level) < 0) {
+        console_error(&csl, "Failed to initialize %s compression", compression_name(config->compression));
+        return -1;
+    }
+
+    http_sink = sink_http_open(http_sink_complete_cb);
+    if (!http_sink) {
         console_error(&csl, "Failed to initialize HTTP client");
         return -1;
     }
+    sink_set_open(&mirror_sinks, config->sinks, config->sink_count);
 
+    if (config->spool_dir[0] && spool_open(&spool, config->spool_dir, config->spool_size_kb,
+                                           config->spool_segment_kb, config->spool_write_budget_kb) < 0) {
+        console_warn(&csl, "Spool unavailable, failed batches will be dropped");
+    }
     system_running = true;
+    storage_closed = false;
 
-    console_info(&csl, "Single-core collection system initialized (max_queue_size=%u, max_batch_size=%u)",
-                 config_get_queue_size(), config_get_batch_size());
+    console_info(&csl,
+                 "Single-core collection system initialized (buffer=%u bytes, max_queue_size=%u, max_batch_size=%u, "
+                 "max_inflight=%u, instance=%016llx)",
+                 buffer_budget, max_queued_records, adaptive.batch_size, inflight_limit,
+                 (unsigned long long)instance_id);
     config_print_current();
     return 0;
 }
 
+int collect_reload_config(void) {
+    static collector_config_t previous;
+
+    if (!system_running) {
+        return -EAGAIN;
+    }
+
+    previous = *config_get_current();
+    int ret = config_reload();
+    if (ret < 0) {
+        return ret;
+    }
+
+    const collector_config_t *config = config_get_current();
+    console_info(&csl, "Applying reloaded configuration");
+    console_set_level(config->console_log_level);
+
+    if (!config->enabled) {
+        console_warn(&csl, "Collector disabled in the reloaded configuration, this takes effect on restart");
+    }
+    if (config->ingest_thread != previous.ingest_thread) {
+        console_warn(&csl, "ingest_thread changed, this takes effect on restart");
+    }
+
+    // Log storm protection keeps its state, only the limits change
+    dedup.window = config->dedup_window_ms;
+    ratelimit_configure(&ratelimit, config->rate_limit, config->rate_limit_burst);
+    sampler_configure(&sampler, config->sample_watermark, config->sample_max_rate);
+
+    if (config->adaptive_batching != previous.adaptive_batching || config->batch_size != previous.batch_size ||
+        config->batch_size_min != previous.batch_size_min || config->batch_size_max != previous.batch_size_max ||
+        config->batch_timeout_ms != previous.batch_timeout_ms ||
+        config->batch_timeout_min_ms != previous.batch_timeout_min_ms ||
+        config->batch_timeout_max_ms != previous.batch_timeout_max_ms) {
+        adaptive_init(&adaptive, config->adaptive_batching, config->batch_size, config->batch_size_min,
+                      config->batch_size_max, config->batch_timeout_ms, config->batch_timeout_min_ms,
+                      config->batch_timeout_max_ms, URGENT_THRESHOLD_PERCENT);
+        if (filling_batch) {
+            filling_batch->max_count = (int)adaptive.batch_size;
+        }
+    }
+
+    // Lowering the limit only stops new batches from starting in the upper slots
+    inflight_limit = config->max_inflight_batches;
+
+    // Batches are serialized in one go, so the compressor is idle here; sealed batches keep their encoding
+    if (config->compression != previous.compression || config->compression_level != previous.compression_level) {
+        compressor_free(&compressor);
+        if (compressor_init(&compressor, config->compression, config->compression_level) < 0) {
+            console_warn(&csl, "Failed to initialize %s compression, sending uncompressed",
+                         compression_name(config->compression));
+            compressor_init(&compressor, COMPRESSION_NONE, 0);
+        }
+    }
+
+    if (strcmp(config->spool_dir, previous.spool_dir) != 0 || config->spool_size_kb != previous.spool_size_kb ||
+        config->spool_segment_kb != previous.spool_segment_kb ||
+        config->spool_write_budget_kb != previous.spool_write_budget_kb) {
+        spool_reopen_pending = true;
+        if (!replay_in_flight) {
+            reopen_spool();
+        }
+    }
+
+    // Mirrors hold no batches beyond a write, reopening them loses nothing but their counters
+    if (config->sink_count != previous.sink_count ||
+        memcmp(config->sinks, previous.sinks, sizeof(config->sinks[0]) * config->sink_count) != 0) {
+        sink_set_close(&mirror_sinks);
+        sink_set_open(&mirror_sinks, config->sinks, config->sink_count);
+    }
+
+    // A changed budget is picked again from the memory available now
+    if (config->memory_budget_percent != previous.memory_budget_percent ||
+        config->memory_budget_min_kb != previous.memory_budget_min_kb ||
+        config->memory_budget_max_kb != previous.memory_budget_max_kb ||
+        config->memory_low_percent != previous.memory_low_percent) {
+        init_membudget(config);
+    }
+    resize_log_storage(storage_budget(), storage_max_records());
+
+    // Filters apply to the next log received, the endpoint to the next request sent
+    ubus_apply_config();
+    syslog_input_apply_config();
+
+    if (strcmp(config->logs_endpoint, previous.logs_endpoint) != 0) {
+        console_info(&csl, "Logs endpoint changed to %s", config->logs_endpoint);
+    }
+
+    collect_process_pending_batches();
+    return 0;
+}
+
 int collect_process_pending_batches(void) {
     if (!system_running) {
         return -1;
     }
 
-    // Collect entries for batching
-    collect_entries_for_batch();
+    int result = 0;
+
+    // Fill and send batches until the queue is drained or every slot is busy
+    do {
+        collect_entries_for_batch();
 
-    // Advance state machine
-    int result = collect_advance_http_state_machine();
+        if (collect_advance_http_state_machine() < 0) {
+            result = -1;
+        }
+    } while (!filling_batch && queued_records() > 0 && acquire_batch_slot());
+
+    // Drain the spool alongside live batches
+    spool_replay_next();
 
     // Force processing if queue is getting full
-    uint32_t urgent_threshold = config_get_queue_size() * 80 / 100;
-    if (queue.count >= urgent_threshold && current_batch.state == HTTP_IDLE) {
+    if (queue_fill_percent() >= adaptive.urgent_percent && filling_batch) {
         console_warn(&csl, "Queue urgent threshold reached, forcing batch processing");
-        return collect_force_batch_processing();
+        result = collect_force_batch_processing();
     }
 
+    schedule_batch_deadline();
     return result;
 }
 
@@ -543,47 +1579,58 @@ void collect_cleanup(void) {
 
     system_running = false;
 
-    // Process any remaining batch
-    if (current_batch.count > 0) {
-        console_info(&csl, "Processing final batch of %d entries", current_batch.count);
-        current_batch.state = HTTP_PREPARING;
-        while (current_batch.state != HTTP_IDLE && current_batch.state != HTTP_FAILED) {
-            collect_advance_http_state_machine();
-        }
+    // Send the partially filled batch, running the event loop until all uploads complete
+    if (filling_batch && filling_batch->count > 0) {
+        console_info(&csl, "Processing final batch of %d entries", filling_batch->count);
+        batch_context_t *ctx = filling_batch;
+        seal_batch(ctx);
+        advance_batch(ctx);
     }
 
-    // Clear batch context
-    clear_batch_context(&current_batch);
-    if (current_batch.entries) {
-        free(current_batch.entries);
-        current_batch.entries = NULL;
+    if (batches_in_flight() > 0) {
+        flushing = true;
+        uloop_timeout_set(&flush_timer, FINAL_FLUSH_TIMEOUT_MS);
+        uloop_run();
+        uloop_timeout_cancel(&flush_timer);
+        flushing = false;
     }
 
-    // Return remaining queue entries to pool
-    while (queue.count > 0) {
-        compact_log_entry_t *entry = dequeue_entry(&queue);
-        if (entry) {
-            collect_return_entry_to_pool(entry);
-        }
+    uloop_timeout_cancel(&process_timer);
+    uloop_timeout_cancel(&batch_deadline);
+    uloop_timeout_cancel(&replay_timer);
+    uloop_timeout_cancel(&membudget_timer);
+    for (uint32_t i = 0; i < MAX_INFLIGHT_BATCHES; i++) {
+        uloop_timeout_cancel(&batches[i].retry_timer);
     }
-
-    // Free queue entries array
-    if (queue.entries) {
-        free(queue.entries);
-        queue.entries = NULL;
+    sink_close(http_sink);
+    http_sink = NULL;
+    replay_in_flight = false;
+
+    // Keep undelivered logs across the restart (an upload cut off by the flush deadline may be sent twice)
+    spool_remaining_logs();
+
+    // Drop anything still queued or held by a batch, the log cursor stays in front of it
+    collect_get_settled_marks(settled_marks);
+    storage_closed = true;
+    for (int lane = 0; lane < LOG_LANE_COUNT; lane++) {
+        log_arena_reset(&lanes[lane]);
     }
-
-    // Free entry pool
-    if (entry_pool) {
-        free(entry_pool);
-        entry_pool = NULL;
+    dedup_reset(&dedup);
+    for (uint32_t i = 0; i < MAX_INFLIGHT_BATCHES; i++) {
+        memset(batches[i].spans, 0, sizeof(batches[i].spans));
+        clear_batch_context(&batches[i]);
+        payload_free(&batches[i].payload);
+        payload_free(&batches[i].compressed);
     }
-    if (pool_used) {
-        free(pool_used);
-        pool_used = NULL;
+    filling_batch = NULL;
+    payload_free(&replay_body);
+    compressor_free(&compressor);
+    spool_close(&spool);
+    sink_set_close(&mirror_sinks);
+    for (int lane = 0; lane < LOG_LANE_COUNT; lane++) {
+        log_arena_free(&lanes[lane]);
     }
 
-    cleanup_http_client();
     config_cleanup();
 
     console_info(&csl, "Single-core collection cleanup complete");
@@ -594,38 +1641,98 @@ int collect_enqueue_log(const log_data_t *log_data) {
         return -EINVAL;
     }
 
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    ingest_stats.received++;
+    rate_meter_add(&ingest_rate, now.tv_sec, 1);
+
     // Check if we should accept logs (short circuit logic)
     if (!ubus_should_accept_logs()) {
+        ingest_stats.rejected++;
         console_debug(&csl, "Rejecting log - log acceptance disabled");
         return -EPERM;
     }
 
-    // Get entry from pool
-    compact_log_entry_t *entry = collect_get_entry_from_pool();
-    if (!entry) {
+    // Longer messages are truncated
+    size_t msg_len = log_data->msg_len < MAX_LOG_MSG_SIZE ? log_data->msg_len : MAX_LOG_MSG_SIZE;
+
+    // Count repeats of a queued message on its record, they take no space
+    uint64_t hash = dedup_hash(log_data->msg, msg_len, log_data->source, log_data->priority);
+    if (dedup_collapse(&dedup, hash, log_data->msg, msg_len, log_data->source, log_data->priority, log_data->time)) {
+        return 0;
+    }
+
+    // Past the overload watermark only a share of the low-severity logs is kept, each standing for the rest
+    sampler_update(&sampler, queue_fill_percent());
+    uint32_t weight = sampler_keep(&sampler, log_data->source, log_data->origin, log_data->priority);
+    if (!weight) {
+        return -EAGAIN;
+    }
+
+    if (!ratelimit_allow(&ratelimit, log_data->source, log_data->origin, log_data->priority,
+                         (uint64_t)now.tv_sec * 1000 + now.tv_nsec / 1000000)) {
+        return -EAGAIN;
+    }
+
+    // At the record limit, evict the oldest records of the least severe lanes, never of a more severe one
+    log_lane_t lane = lane_of(log_data->priority);
+    log_arena_t *arena = &lanes[lane];
+    bool queue_full;
+    while ((queue_full = queued_records() >= max_queued_records)) {
+        if (!evict_queued_record(lane)) {
+            break;
+        }
+    }
+
+    if (queue_full) {
+        ingest_stats.queue_full++;
         dropped_count++;
-        console_debug(&csl, "Entry pool exhausted, dropping log");
+        console_debug(&csl, "Queue full, dropping log");
         return -ENOSPC;
     }
 
-    // Store raw log fields without processing
-    strncpy(entry->msg, log_data->msg, MAX_LOG_ENTRY_SIZE - 1);
-    entry->msg[MAX_LOG_ENTRY_SIZE - 1] = '\0';
-    
-    entry->priority = log_data->priority;
-    entry->source = log_data->source;
-    entry->time = log_data->time;
-
-    // Add to queue
-    int result = enqueue_entry(&queue, entry);
-    if (result < 0) {
-        // Queue is full, drop the entry
-        collect_return_entry_to_pool(entry);
+    // Reserve a record sized to the message, a full lane ring makes room by evicting its own oldest records.
+    // Evicting behind records batches still hold frees nothing until they are released.
+    log_record_t *record = log_arena_reserve(arena, (uint32_t)msg_len);
+    while (!record && arena->read == arena->head && evict_lane_record(lane)) {
+        record = log_arena_reserve(arena, (uint32_t)msg_len);
+    }
+    if (!record) {
+        arena_exhausted_count++;
+        ingest_stats.buffer_exhausted++;
         dropped_count++;
-        console_debug(&csl, "Queue full, dropping log");
+        console_debug(&csl, "Log buffer exhausted, dropping log");
         return -ENOSPC;
     }
 
+    // Store raw log fields without processing
+    memcpy(record->msg, log_data->msg, msg_len);
+    record->msg[msg_len] = '\0';
+    record->msg_len = (uint16_t)msg_len;
+    record->priority = log_data->priority;
+    record->source = log_data->source;
+    record->time = log_data->time;
+    log_record_set_weight(record, weight);
+
+    log_arena_commit(arena, record);
+    dedup_remember(&dedup, arena, hash, record);
+    ingest_stats.enqueued++;
+
+    uint32_t held_bytes = used_bytes(), held = held_records();
+    if (held_bytes > high_water_bytes) {
+        high_water_bytes = held_bytes;
+    }
+    if (held > high_water_records) {
+        high_water_records = held;
+    }
+
+    // Seal and send as soon as a batch is full, otherwise make sure the deadline is running
+    uint32_t target = filling_batch ? (uint32_t)filling_batch->max_count : adaptive.batch_size;
+    if (unsealed_records() >= target && (filling_batch || acquire_batch_slot())) {
+        collect_process_pending_batches();
+    } else {
+        schedule_batch_deadline();
+    }
     return 0;
 }
 
@@ -634,12 +1741,158 @@ int collect_get_stats(uint32_t *queue_size, uint32_t *dropped_count_out) {
         return -EINVAL;
     }
 
-    *queue_size = queue.count;
+    *queue_size = queued_records();
     *dropped_count_out = dropped_count;
 
     return 0;
 }
 
+int collect_get_buffer_stats(collect_buffer_stats_t *stats) {
+    if (!stats) {
+        return -EINVAL;
+    }
+
+    stats->capacity_bytes = buffer_budget;
+    stats->used_bytes = used_bytes();
+    stats->queued_records = queued_records();
+    stats->held_records = held_records();
+    stats->high_water_bytes = high_water_bytes;
+    stats->high_water_records = high_water_records;
+    stats->exhausted = arena_exhausted_count;
+    stats->fill_percent = queue_fill_percent();
+
+    for (int lane = 0; lane < LOG_LANE_COUNT; lane++) {
+        stats->lanes[lane].queued_records = lanes[lane].queued;
+        stats->lanes[lane].held_records = lanes[lane].records;
+        stats->lanes[lane].used_bytes = lane_used_bytes(&lanes[lane]);
+        stats->lanes[lane].capacity_bytes = lanes[lane].capacity;
+        stats->lanes[lane].evicted = lane_evicted[lane];
+    }
+
+    return 0;
+}
+
+int collect_get_memory_stats(membudget_t *stats) {
+    if (!stats) {
+        return -EINVAL;
+    }
+
+    *stats = membudget;
+    return 0;
+}
+
+int collect_get_ingest_stats(collect_ingest_stats_t *stats) {
+    if (!stats) {
+        return -EINVAL;
+    }
+
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    *stats = ingest_stats;
+    stats->collapsed = dedup.collapsed;
+    stats->rate_limited = ratelimit.dropped;
+    stats->sampled = sampler.sampled;
+    stats->sample_rate = sampler.rate;
+    stats->rate_per_s = rate_meter_rate(&ingest_rate, now.tv_sec);
+    return 0;
+}
+
+void collect_get_commit_marks(uint64_t marks[LOG_LANE_COUNT]) {
+    for (int lane = 0; lane < LOG_LANE_COUNT; lane++) {
+        marks[lane] = lanes[lane].committed;
+    }
+}
+
+void collect_get_settled_marks(uint64_t marks[LOG_LANE_COUNT]) {
+    if (storage_closed) {
+        memcpy(marks, settled_marks, sizeof(settled_marks));
+        return;
+    }
+
+    // Queued records are the last ones committed, records claimed by a batch start at its span
+    for (int lane = 0; lane < LOG_LANE_COUNT; lane++) {
+        marks[lane] = lanes[lane].committed - lanes[lane].queued;
+        for (uint32_t i = 0; i < MAX_INFLIGHT_BATCHES; i++) {
+            const log_span_t *span = &batches[i].spans[lane];
+            if (span->count > 0 && span->first_seq < marks[lane]) {
+                marks[lane] = span->first_seq;
+            }
+        }
+    }
+}
+
+int collect_get_http_stats(collect_http_stats_t *stats) {
+    if (!stats) {
+        return -EINVAL;
+    }
+
+    stats->requests = latency_hist.count;
+    stats->consecutive_failures = (uint32_t)consecutive_http_failures;
+    stats->rejected_batches = rejected_batches;
+    stats->backoff_ms = backoff_remaining_ms(&upload_backoff, monotonic_ms());
+    stats->backoff_level = upload_backoff.attempt;
+    stats->latency_p50_ms = histogram_percentile(&latency_hist, 50);
+    stats->latency_p95_ms = histogram_percentile(&latency_hist, 95);
+    stats->latency_p99_ms = histogram_percentile(&latency_hist, 99);
+    stats->latency_max_ms = latency_hist.max;
+    stats->batch_size_p50 = histogram_percentile(&batch_size_hist, 50);
+    stats->batch_size_p95 = histogram_percentile(&batch_size_hist, 95);
+    stats->batch_size_p99 = histogram_percentile(&batch_size_hist, 99);
+    stats->batch_size_max = batch_size_hist.max;
+    return 0;
+}
+
+int collect_get_batching_stats(collect_batching_stats_t *stats) {
+    if (!stats) {
+        return -EINVAL;
+    }
+
+    stats->adaptive = adaptive.enabled;
+    stats->batch_size = adaptive.batch_size;
+    stats->batch_timeout_ms = adaptive.batch_timeout_ms;
+    stats->urgent_percent = adaptive.urgent_percent;
+    stats->rtt_ms = adaptive.rtt_ms;
+    stats->success_percent = adaptive.success * 100.0;
+    stats->grown = adaptive.grown;
+    stats->shrunk = adaptive.shrunk;
+    return 0;
+}
+
+int collect_get_spool_stats(spool_stats_t *stats) {
+    if (!stats) {
+        return -EINVAL;
+    }
+
+    spool_get_stats(&spool, stats);
+    return 0;
+}
+
+int collect_get_sinks(const sink_t **sinks, uint32_t max) {
+    uint32_t count = 0;
+
+    if (!sinks) {
+        return -EINVAL;
+    }
+
+    if (http_sink && count < max) {
+        sinks[count++] = http_sink;
+    }
+    for (uint32_t i = 0; i < mirror_sinks.count && count < max; i++) {
+        sinks[count++] = mirror_sinks.sinks[i];
+    }
+    return (int)count;
+}
+
+int collect_get_payload_stats(collect_payload_stats_t *stats) {
+    if (!stats) {
+        return -EINVAL;
+    }
+
+    *stats = payload_stats;
+    return 0;
+}
+
 bool collect_is_running(void) { return system_running; }
 
 int collect_force_batch_processing(void) {
@@ -647,16 +1900,24 @@ int collect_force_batch_processing(void) {
         return -1;
     }
 
-    // Force current batch to be processed immediately
-    if (current_batch.count > 0) {
-        current_batch.state = HTTP_PREPARING;
-        return collect_advance_http_state_machine();
+    // Queued records without a batch yet are picked up first when a slot is free
+    if (!filling_batch && queued_records() > 0) {
+        collect_entries_for_batch();
     }
 
-    return 0;
+    // Seal the batch being filled and send it immediately
+    int result = 0;
+    if (filling_batch && filling_batch->count > 0) {
+        batch_context_t *ctx = filling_batch;
+        seal_batch(ctx);
+        result = advance_batch(ctx);
+    }
+
+    schedule_batch_deadline();
+    return result;
 }
 
-batch_context_t *collect_get_current_batch(void) { return &current_batch; }
+batch_context_t *collect_get_current_batch(void) { return filling_batch; }
 
 /**
  * Report HTTP request failure for network monitoring
@@ -664,7 +1925,12 @@ batch_context_t *collect_get_current_batch(void) { return &current_batch; }
 void collect_report_http_failure(int error_code) {
     consecutive_http_failures++;
     console_warn(&csl, "HTTP failure reported (code: %d), consecutive failures: %d", error_code, consecutive_http_failures);
-    
+
+    // While failed batches can be spooled there is no reason to stop accepting logs
+    if (spool_can_accept(&spool, 0)) {
+        return;
+    }
+
     // Report to UBUS module to potentially stop log acceptance
     ubus_report_network_failure(consecutive_http_failures);
 }
@@ -1,73 +1,162 @@
 #ifndef COLLECT_H
 #define COLLECT_H
 
+#include "log_arena.h"
+#include "membudget.h"
+#include "payload.h"
+#include "sink.h"
+#include "spool.h"
 #include <stdbool.h>
 #include <stdint.h>
 #include <time.h>
 
+#include <libubox/uloop.h>
+
 // Forward declarations for configuration functions
 uint32_t config_get_batch_size(void);
 uint32_t config_get_queue_size(void);
 uint32_t config_get_batch_timeout_ms(void);
+uint32_t config_get_buffer_size_kb(void);
 
-// Static configuration (data structure sizes)
-#define MAX_LOG_ENTRY_SIZE 512 // Fixed for memory layout
+// Static configuration
+#define MAX_LOG_MSG_SIZE 4096 // Longer messages are truncated
 
 // Dynamic configuration macros (use configuration functions)
 #define MAX_BATCH_SIZE config_get_batch_size()
 #define MAX_QUEUE_SIZE config_get_queue_size()
 #define BATCH_TIMEOUT_MS config_get_batch_timeout_ms()
-#define URGENT_THRESHOLD (config_get_queue_size() * 80 / 100)
-#define HTTP_RETRY_DELAY_MS 2000 // TODO: Add to config
-
-// Entry pool for memory optimization
-#define ENTRY_POOL_SIZE config_get_queue_size()
-
-/**
- * Compact log entry structure optimized for memory usage
- * Now stores raw log fields for backend processing
- */
-typedef struct compact_log_entry {
-    char msg[MAX_LOG_ENTRY_SIZE];
-    uint32_t priority;   // Raw syslog priority (facility | severity)
-    uint32_t source;     // Raw log source (klog, syslog, etc)
-    uint64_t time;       // Raw timestamp from log system
-    uint16_t pool_index; // Index in entry pool
-    bool in_use;         // Pool management flag
-} compact_log_entry_t;
+#define URGENT_THRESHOLD_PERCENT 80 // Of queued records or buffer bytes, whichever is fuller
+#define HTTP_RETRY_DELAY_MS 2000   // Upper bound of the first retry delay, doubles with every failure
+#define HTTP_BACKOFF_MAX_MS 300000 // Upper bound of the jittered retry delay (Retry-After may ask for more)
+#define FINAL_FLUSH_TIMEOUT_MS 20000 // Must stay below the procd term_timeout
+#define COLLECTOR_VERSION "1.0.0-raw-logs"
+#define COMPRESS_CHUNK_SIZE 16384 // Serialized bytes buffered before feeding the compressor
+#define SPOOL_REPLAY_BACKOFF_S 30 // Wait after a replay could not be dispatched before trying again
 
 /**
- * Simple circular queue for single-threaded access
- * Note: MAX_QUEUE_SIZE is now dynamic, so we use a pointer to entries array
+ * Priority lanes, each queued in its own ring by syslog severity
  */
-typedef struct simple_log_queue {
-    compact_log_entry_t **entries; // Dynamic array based on config
-    uint32_t head;
-    uint32_t tail;
-    uint32_t count;
-    uint32_t max_size;
-} simple_log_queue_t;
+typedef enum {
+    LOG_LANE_HIGH,   // emerg, alert, crit, err
+    LOG_LANE_MEDIUM, // warning, notice
+    LOG_LANE_LOW,    // info, debug
+    LOG_LANE_COUNT
+} log_lane_t;
 
 /**
  * HTTP state machine states
+ * HTTP_SENDING means a request is in flight; the state machine never blocks on it
+ * HTTP_DONE means the batch finished but its records wait for older batches to be released
  */
-typedef enum { HTTP_IDLE, HTTP_PREPARING, HTTP_SENDING, HTTP_RETRY_WAIT, HTTP_FAILED } http_state_t;
+typedef enum { HTTP_IDLE, HTTP_PREPARING, HTTP_SENDING, HTTP_RETRY_WAIT, HTTP_FAILED, HTTP_DONE } http_state_t;
 
 /**
  * Batch processing context
- * Note: MAX_BATCH_SIZE is now dynamic, so we use a pointer to entries array
+ * The batch references its records in the lane arenas instead of copying them
  */
 typedef struct batch_context {
-    compact_log_entry_t **entries; // Dynamic array based on config
+    log_span_t spans[LOG_LANE_COUNT]; // Records claimed from each lane
     int count;
     int max_count; // Store the configured batch size
-    time_t created_time;
     int retry_count;
     http_state_t state;
-    char *json_payload;
-    size_t payload_size;
+    uint64_t seq;                     // Batch sequence number, assigned when the batch is sealed
+    char idempotency_key[40];         // "<instance>-<seq>", identical across retries and spool replays
+    struct uloop_timeout retry_timer; // Per-batch retry delay
+    payload_buffer_t payload;         // Serialized body (or compressor input chunk), reused across batches
+    payload_buffer_t compressed;      // Compressed body, reused across batches
+    payload_format_t format;          // Content-Type of the body, kept across a format change
+    compression_t encoding;           // Content-Encoding of the body, kept across a compression change
+    const payload_buffer_t *body;     // Bytes to upload (payload or compressed)
 } batch_context_t;
 
+/**
+ * Per-lane queue statistics
+ */
+typedef struct collect_lane_stats {
+    uint32_t queued_records; // Records waiting for a batch
+    uint32_t held_records;   // Records queued or referenced by a batch
+    uint32_t used_bytes;     // Bytes held by those records
+    uint32_t capacity_bytes; // Ring size, the lane's share of the budget
+    uint64_t evicted;        // Queued records dropped to make room
+} collect_lane_stats_t;
+
+/**
+ * Log buffer statistics
+ */
+typedef struct collect_buffer_stats {
+    uint32_t capacity_bytes;     // Byte budget shared by all lanes
+    uint32_t used_bytes;         // Bytes held by queued and in-flight records
+    uint32_t queued_records;     // Records waiting for a batch
+    uint32_t held_records;       // Records queued or referenced by a batch
+    uint32_t high_water_bytes;   // Peak used_bytes
+    uint32_t high_water_records; // Peak held_records
+    uint32_t exhausted;          // Logs dropped because the arena had no room
+    uint32_t fill_percent;       // Queue fill level used for the urgent threshold
+    collect_lane_stats_t lanes[LOG_LANE_COUNT];
+} collect_buffer_stats_t;
+
+/**
+ * Payload serialization statistics (cumulative)
+ */
+typedef struct collect_payload_stats {
+    uint64_t batches;       // Batches serialized
+    uint64_t logs;          // Log records serialized
+    uint64_t payload_bytes; // Serialized bytes produced (before compression)
+    uint64_t wire_bytes;    // Body bytes handed to the uploader (after compression)
+    uint64_t serialize_ns;  // Time spent serializing
+} collect_payload_stats_t;
+
+/**
+ * Current batching parameters (adjusted at runtime with adaptive batching)
+ */
+typedef struct collect_batching_stats {
+    bool adaptive;
+    uint32_t batch_size;
+    uint32_t batch_timeout_ms;
+    uint32_t urgent_percent; // Queue fill that forces the filling batch out
+    double rtt_ms;           // Moving average of the upload round trip
+    double success_percent;  // Moving average of the upload success rate
+    uint32_t grown;          // Adjustments towards larger batches
+    uint32_t shrunk;         // Adjustments towards smaller batches
+} collect_batching_stats_t;
+
+/**
+ * Ingest statistics (cumulative)
+ */
+typedef struct collect_ingest_stats {
+    uint64_t received;         // Logs handed to collect_enqueue_log()
+    uint64_t enqueued;         // Logs stored in the buffer
+    uint64_t collapsed;        // Repeats counted on an earlier queued record
+    uint64_t rate_limited;     // Logs dropped by the per source/facility rate limit
+    uint64_t sampled;          // Low-severity logs dropped by overload sampling
+    uint32_t sample_rate;      // Current overload sampling rate (1 in N), 1 while not overloaded
+    uint64_t rejected;         // Logs dropped while log acceptance was disabled
+    uint64_t queue_full;       // Logs dropped because queue_size records were queued
+    uint64_t buffer_exhausted; // Logs dropped because the buffer had no room
+    uint64_t evicted;          // Queued records dropped to make room for newer or more severe logs
+    double rate_per_s;         // Logs received per second over the last minute
+} collect_ingest_stats_t;
+
+/**
+ * Upload statistics
+ */
+typedef struct collect_http_stats {
+    uint64_t requests;             // Completed uploads, live batches and spool replays
+    uint32_t consecutive_failures; // Failed uploads since the last success
+    uint64_t rejected_batches;     // Batches the backend refused for good (4xx), dropped without retry
+    uint32_t backoff_ms;           // Time left before uploads resume, 0 if not backing off
+    uint32_t backoff_level;        // Doublings of the retry delay bound
+    double latency_p50_ms;         // Upload round trip percentiles
+    double latency_p95_ms;
+    double latency_p99_ms;
+    double latency_max_ms;
+    double batch_size_p50; // Logs per batch percentiles
+    double batch_size_p95;
+    double batch_size_p99;
+    double batch_size_max;
+} collect_http_stats_t;
+
 /**
  * Log data structure for passing log entries
  */
@@ -75,7 +164,10 @@ typedef struct log_data {
     uint64_t time;         // Raw timestamp from log system
     uint32_t priority;     // Raw syslog priority (facility | severity)
     uint32_t source;       // Raw log source (klog, syslog, etc)
-    const char *msg;       // Raw log message
+    uint32_t id;           // logd record id, 0 if the source has none
+    uint32_t origin;       // Hash of the remote sender address, 0 for local logs
+    const char *msg;       // Raw log message, need not outlive collect_enqueue_log()
+    size_t msg_len;        // Message length without the terminating NUL
 } log_data_t;
 
 /**
@@ -84,6 +176,14 @@ typedef struct log_data {
  */
 int collect_init(void);
 
+/**
+ * Re-read the configuration file and apply it without losing queued logs
+ * Buffer and queue are resized in place, batches already sealed are sent as
+ * they are; new batches use the new endpoint, compression and filters.
+ * @return 0 on success, negative error code on failure (the old configuration stays in effect)
+ */
+int collect_reload_config(void);
+
 /**
  * Process any pending batches (called from timer)
  * This replaces the blocking worker thread approach
@@ -98,8 +198,9 @@ void collect_cleanup(void);
 
 /**
  * Enqueue a log entry for processing (single-threaded, no locks needed)
+ * A repeat of a still queued message is counted on that record instead.
  * @param log_data Pointer to log data structure
- * @return 0 on success, negative error code on failure
+ * @return 0 on success (enqueued or collapsed), -EAGAIN if rate limited, other negative error code on failure
  */
 int collect_enqueue_log(const log_data_t *log_data);
 
@@ -112,32 +213,92 @@ int collect_enqueue_log(const log_data_t *log_data);
 int collect_get_stats(uint32_t *queue_size, uint32_t *dropped_count);
 
 /**
- * Check if collection system is running
- * @return true if system is active, false otherwise
+ * Get log buffer statistics
+ * @param stats Pointer to store the statistics
+ * @return 0 on success, negative error code on failure
  */
-bool collect_is_running(void);
+int collect_get_buffer_stats(collect_buffer_stats_t *stats);
 
 /**
- * Force immediate batch processing (for urgent situations)
+ * Get memory budget statistics
+ * @param stats Pointer to store the statistics, enabled is false with fixed sizing
  * @return 0 on success, negative error code on failure
  */
-int collect_force_batch_processing(void);
+int collect_get_memory_stats(membudget_t *stats);
+
+/**
+ * Get payload serialization statistics
+ * @param stats Pointer to store the statistics
+ * @return 0 on success, negative error code on failure
+ */
+int collect_get_payload_stats(collect_payload_stats_t *stats);
+
+/**
+ * Get spool statistics
+ * @param stats Pointer to store the statistics
+ * @return 0 on success, negative error code on failure
+ */
+int collect_get_spool_stats(spool_stats_t *stats);
+
+/**
+ * Get the output sinks, the HTTP upload first, then the mirrors in configuration order
+ * @param sinks Array to store the sinks in
+ * @param max Size of the array
+ * @return number of sinks stored, negative error code on failure
+ */
+int collect_get_sinks(const sink_t **sinks, uint32_t max);
+
+/**
+ * Get the current batching parameters
+ * @param stats Pointer to store the statistics
+ * @return 0 on success, negative error code on failure
+ */
+int collect_get_batching_stats(collect_batching_stats_t *stats);
+
+/**
+ * Get duplicate collapsing and rate limiting statistics
+ * @param stats Pointer to store the statistics
+ * @return 0 on success, negative error code on failure
+ */
+int collect_get_ingest_stats(collect_ingest_stats_t *stats);
 
 /**
- * Get entry from pool (memory optimization)
- * @return pointer to available entry or NULL if pool exhausted
+ * Get the commit position of every lane
+ * A log enqueued before the call has a sequence number below the mark of its lane.
+ * @param marks Receives the number of records committed to each lane so far
  */
-compact_log_entry_t *collect_get_entry_from_pool(void);
+void collect_get_commit_marks(uint64_t marks[LOG_LANE_COUNT]);
 
 /**
- * Return entry to pool (memory optimization)
- * @param entry Entry to return to pool
+ * Get the position below which every lane's records were delivered, spooled or dropped
+ * Records at or above the mark are still queued, in a batch in flight or
+ * were lost with the buffer at shutdown.
+ * @param marks Receives the sequence number of the oldest record each lane still holds
+ */
+void collect_get_settled_marks(uint64_t marks[LOG_LANE_COUNT]);
+
+/**
+ * Get upload latency and batch size statistics
+ * @param stats Pointer to store the statistics
+ * @return 0 on success, negative error code on failure
  */
-void collect_return_entry_to_pool(compact_log_entry_t *entry);
+int collect_get_http_stats(collect_http_stats_t *stats);
+
+/**
+ * Check if collection system is running
+ * @return true if system is active, false otherwise
+ */
+bool collect_is_running(void);
+
+/**
+ * Force immediate batch processing (for urgent situations)
+ * @return 0 on success, negative error code on failure
+ */
+int collect_force_batch_processing(void);
 
 /**
- * Get current batch context for state machine processing
- * @return pointer to current batch context
+ * Get the batch currently claiming queued records
+ * @return pointer to the batch being filled, or NULL if none is open
  */
 batch_context_t *collect_get_current_batch(void);
 
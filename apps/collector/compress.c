@@ -0,0 +1,220 @@
+#include "compress.h"
+#include "core/console.h"
+#include <errno.h>
+#include <string.h>
+
+static Console csl = {
+    .topic = "compress",
+};
+
+// Output space requested from the payload buffer per deflate/zstd round
+#define COMPRESS_OUT_CHUNK 4096
+
+int compression_from_string(const char *name, compression_t *type) {
+    if (!name || !type) {
+        return -EINVAL;
+    }
+
+    if (strcmp(name, "none") == 0 || strcmp(name, "0") == 0 || name[0] == '\0') {
+        *type = COMPRESSION_NONE;
+    } else if (strcmp(name, "gzip") == 0) {
+        *type = COMPRESSION_GZIP;
+    } else if (strcmp(name, "deflate") == 0) {
+        *type = COMPRESSION_DEFLATE;
+    } else if (strcmp(name, "zstd") == 0) {
+#ifdef HAVE_ZSTD
+        *type = COMPRESSION_ZSTD;
+#else
+        return -ENOTSUP;
+#endif
+    } else {
+        return -EINVAL;
+    }
+
+    return 0;
+}
+
+const char *compression_name(compression_t type) {
+    switch (type) {
+    case COMPRESSION_GZIP:
+        return "gzip";
+    case COMPRESSION_DEFLATE:
+        return "deflate";
+    case COMPRESSION_ZSTD:
+        return "zstd";
+    case COMPRESSION_NONE:
+    default:
+        return "none";
+    }
+}
+
+const char *compression_content_encoding(compression_t type) {
+    return type == COMPRESSION_NONE ? NULL : compression_name(type);
+}
+
+int compressor_init(compressor_t *c, compression_t type, int level) {
+    memset(c, 0, sizeof(*c));
+    c->type = type;
+    c->level = level;
+
+    switch (type) {
+    case COMPRESSION_NONE:
+        return 0;
+
+    case COMPRESSION_GZIP:
+    case COMPRESSION_DEFLATE: {
+        // windowBits + 16 selects the gzip wrapper, plain windowBits the zlib one used by HTTP "deflate"
+        int window_bits = type == COMPRESSION_GZIP ? 15 + 16 : 15;
+        if (deflateInit2(&c->zs, level, Z_DEFLATED, window_bits, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+            console_error(&csl, "Failed to initialize %s stream", compression_name(type));
+            return -ENOMEM;
+        }
+        c->zs_ready = true;
+        return 0;
+    }
+
+    case COMPRESSION_ZSTD:
+#ifdef HAVE_ZSTD
+        c->zstd = ZSTD_createCCtx();
+        if (!c->zstd) {
+            console_error(&csl, "Failed to initialize zstd stream");
+            return -ENOMEM;
+        }
+        ZSTD_CCtx_setParameter(c->zstd, ZSTD_c_compressionLevel, level);
+        return 0;
+#else
+        return -ENOTSUP;
+#endif
+    }
+
+    return -EINVAL;
+}
+
+void compressor_free(compressor_t *c) {
+    if (c->zs_ready) {
+        deflateEnd(&c->zs);
+        c->zs_ready = false;
+    }
+#ifdef HAVE_ZSTD
+    if (c->zstd) {
+        ZSTD_freeCCtx(c->zstd);
+        c->zstd = NULL;
+    }
+#endif
+}
+
+int compressor_begin(compressor_t *c, payload_buffer_t *out) {
+    payload_reset(out);
+
+    if (c->zs_ready && deflateReset(&c->zs) != Z_OK) {
+        return -EIO;
+    }
+#ifdef HAVE_ZSTD
+    if (c->zstd) {
+        ZSTD_CCtx_reset(c->zstd, ZSTD_reset_session_only);
+    }
+#endif
+    return 0;
+}
+
+/**
+ * Run deflate over the input until it is consumed (or the stream ends on Z_FINISH)
+ */
+static int deflate_into(compressor_t *c, const void *data, size_t len, int flush, payload_buffer_t *out) {
+    c->zs.next_in = (Bytef *)data;
+    c->zs.avail_in = (uInt)len;
+
+    do {
+        if (!payload_reserve(out, COMPRESS_OUT_CHUNK)) {
+            return -ENOMEM;
+        }
+
+        size_t room = out->capacity - out->len - 1;
+        c->zs.next_out = (Bytef *)(out->data + out->len);
+        c->zs.avail_out = (uInt)room;
+
+        int ret = deflate(&c->zs, flush);
+        if (ret == Z_STREAM_ERROR) {
+            return -EIO;
+        }
+
+        out->len += room - c->zs.avail_out;
+        if (ret == Z_STREAM_END) {
+            break;
+        }
+    } while (c->zs.avail_out == 0 || c->zs.avail_in > 0 || flush == Z_FINISH);
+
+    return 0;
+}
+
+#ifdef HAVE_ZSTD
+/**
+ * Run zstd over the input until it is consumed (or the frame is complete on ZSTD_e_end)
+ */
+static int zstd_into(compressor_t *c, const void *data, size_t len, ZSTD_EndDirective mode, payload_buffer_t *out) {
+    ZSTD_inBuffer in = {.src = data, .size = len, .pos = 0};
+    size_t remaining;
+
+    do {
+        if (!payload_reserve(out, COMPRESS_OUT_CHUNK)) {
+            return -ENOMEM;
+        }
+
+        ZSTD_outBuffer ob = {.dst = out->data + out->len, .size = out->capacity - out->len - 1, .pos = 0};
+        remaining = ZSTD_compressStream2(c->zstd, &ob, &in, mode);
+        if (ZSTD_isError(remaining)) {
+            console_error(&csl, "zstd compression failed: %s", ZSTD_getErrorName(remaining));
+            return -EIO;
+        }
+        out->len += ob.pos;
+    } while (mode == ZSTD_e_end ? remaining != 0 : in.pos < in.size);
+
+    return 0;
+}
+#endif
+
+int compressor_write(compressor_t *c, const void *data, size_t len, payload_buffer_t *out) {
+    if (len == 0) {
+        return 0;
+    }
+
+    switch (c->type) {
+    case COMPRESSION_NONE:
+        payload_append(out, data, len);
+        return out->failed ? -ENOMEM : 0;
+    case COMPRESSION_GZIP:
+    case COMPRESSION_DEFLATE:
+        return deflate_into(c, data, len, Z_NO_FLUSH, out);
+    case COMPRESSION_ZSTD:
+#ifdef HAVE_ZSTD
+        return zstd_into(c, data, len, ZSTD_e_continue, out);
+#else
+        break;
+#endif
+    }
+
+    return -ENOTSUP;
+}
+
+int compressor_finish(compressor_t *c, payload_buffer_t *out) {
+    int ret = -ENOTSUP;
+
+    switch (c->type) {
+    case COMPRESSION_NONE:
+        return 0;
+    case COMPRESSION_GZIP:
+    case COMPRESSION_DEFLATE:
+        ret = deflate_into(c, NULL, 0, Z_FINISH, out);
+        break;
+    case COMPRESSION_ZSTD:
+#ifdef HAVE_ZSTD
+        ret = zstd_into(c, NULL, 0, ZSTD_e_end, out);
+#endif
+        break;
+    }
+
+    if (ret == 0 && out->data) {
+        out->data[out->len] = '\0';
+    }
+    return ret;
+}
@@ -0,0 +1,101 @@
+#ifndef COMPRESS_H
+#define COMPRESS_H
+
+#include "payload.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <zlib.h>
+
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+/**
+ * Supported batch compression schemes
+ */
+typedef enum {
+    COMPRESSION_NONE,
+    COMPRESSION_GZIP,
+    COMPRESSION_DEFLATE,
+    COMPRESSION_ZSTD,
+} compression_t;
+
+/**
+ * Streaming compressor
+ * The stream state is allocated once and reset between batches.
+ */
+typedef struct compressor {
+    compression_t type;
+    int level;
+    z_stream zs;
+    bool zs_ready;
+#ifdef HAVE_ZSTD
+    ZSTD_CCtx *zstd;
+#endif
+} compressor_t;
+
+/**
+ * Parse a compression name from configuration
+ * @param name One of "none", "gzip", "deflate", "zstd"
+ * @param type Pointer to store the parsed type
+ * @return 0 on success, negative error code if unknown or not built in
+ */
+int compression_from_string(const char *name, compression_t *type);
+
+/**
+ * Get the configuration name of a compression type
+ * @param type Compression type
+ * @return name string
+ */
+const char *compression_name(compression_t type);
+
+/**
+ * Get the HTTP Content-Encoding token for a compression type
+ * @param type Compression type
+ * @return encoding token, or NULL for COMPRESSION_NONE
+ */
+const char *compression_content_encoding(compression_t type);
+
+/**
+ * Allocate the stream state
+ * @param c Compressor to initialize
+ * @param type Compression type (COMPRESSION_NONE is a no-op)
+ * @param level Compression level (scheme specific)
+ * @return 0 on success, negative error code on failure
+ */
+int compressor_init(compressor_t *c, compression_t type, int level);
+
+/**
+ * Release the stream state
+ * @param c Compressor to free
+ */
+void compressor_free(compressor_t *c);
+
+/**
+ * Start a new compressed body
+ * @param c Compressor
+ * @param out Output buffer (reset)
+ * @return 0 on success, negative error code on failure
+ */
+int compressor_begin(compressor_t *c, payload_buffer_t *out);
+
+/**
+ * Compress a chunk of input and append the output
+ * @param c Compressor
+ * @param data Input bytes
+ * @param len Number of input bytes
+ * @param out Output buffer
+ * @return 0 on success, negative error code on failure
+ */
+int compressor_write(compressor_t *c, const void *data, size_t len, payload_buffer_t *out);
+
+/**
+ * Flush the remaining output and terminate the stream
+ * @param c Compressor
+ * @param out Output buffer
+ * @return 0 on success, negative error code on failure
+ */
+int compressor_finish(compressor_t *c, payload_buffer_t *out);
+
+#endif // COMPRESS_H
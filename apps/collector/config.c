@@ -57,6 +57,21 @@ static bool parse_bool(const char *value) {
             strcasecmp(value, "on") == 0);
 }
 
+/**
+ * Parse the ingest_thread option: "auto" or a boolean
+ */
+static ingest_thread_mode_t parse_ingest_thread(const char *value) {
+    if (value && strcasecmp(value, "auto") == 0) {
+        return INGEST_THREAD_AUTO;
+    }
+
+    return parse_bool(value) ? INGEST_THREAD_ON : INGEST_THREAD_OFF;
+}
+
+static const char *ingest_thread_name(ingest_thread_mode_t mode) {
+    return mode == INGEST_THREAD_AUTO ? "auto" : mode == INGEST_THREAD_ON ? "on" : "off";
+}
+
 /**
  * Parse unsigned integer value from string
  */
@@ -89,9 +104,11 @@ static void remove_quotes(char *str) {
 }
 
 /**
- * Parse a single configuration option line
+ * Split an "option" or "list" line into name and value
+ * @return true if the line is an option or list entry
  */
-static int parse_config_option(collector_config_t *config, const char *line) {
+static bool split_option_line(const char *line, bool *is_list, char *name, size_t name_size, char *value,
+                              size_t value_size) {
     char line_copy[512];
     strncpy(line_copy, line, sizeof(line_copy) - 1);
     line_copy[sizeof(line_copy) - 1] = '\0';
@@ -99,33 +116,39 @@ static int parse_config_option(collector_config_t *config, const char *line) {
     // Trim whitespace
     trim_whitespace(line_copy);
 
-    // Skip empty lines and comments
-    if (line_copy[0] == '\0' || line_copy[0] == '#') {
-        return 0;
-    }
-
-    // Look for "option" keyword
-    if (strncmp(line_copy, "option", 6) != 0) {
-        return 0; // Not an option line
+    // Look for "option" or "list" keyword
+    size_t keyword_len;
+    if (strncmp(line_copy, "option", 6) == 0) {
+        keyword_len = 6;
+        *is_list = false;
+    } else if (strncmp(line_copy, "list", 4) == 0) {
+        keyword_len = 4;
+        *is_list = true;
+    } else {
+        return false;
     }
 
     // Find the option name and value
-    char *token = strtok(line_copy + 6, " \t");
-    if (!token) return 0;
+    char *token = strtok(line_copy + keyword_len, " \t");
+    if (!token) return false;
 
-    char option_name[64];
-    strncpy(option_name, token, sizeof(option_name) - 1);
-    option_name[sizeof(option_name) - 1] = '\0';
+    strncpy(name, token, name_size - 1);
+    name[name_size - 1] = '\0';
 
     token = strtok(NULL, "");
-    if (!token) return 0;
+    if (!token) return false;
 
-    char option_value[256];
-    strncpy(option_value, token, sizeof(option_value) - 1);
-    option_value[sizeof(option_value) - 1] = '\0';
-    trim_whitespace(option_value);
-    remove_quotes(option_value);
+    strncpy(value, token, value_size - 1);
+    value[value_size - 1] = '\0';
+    trim_whitespace(value);
+    remove_quotes(value);
+    return true;
+}
 
+/**
+ * Parse a single option of the fry_collector section
+ */
+static int parse_config_option(collector_config_t *config, const char *option_name, const char *option_value) {
     // Parse specific options
     if (strcmp(option_name, "enabled") == 0) {
         config->enabled = parse_bool(option_value);
@@ -140,18 +163,128 @@ static int parse_config_option(collector_config_t *config, const char *line) {
     } else if (strcmp(option_name, "batch_timeout_ms") == 0) {
         config->batch_timeout_ms = parse_uint32(option_value, DEFAULT_BATCH_TIMEOUT_MS);
         console_debug(&csl, "Parsed batch_timeout_ms: %u", config->batch_timeout_ms);
+    } else if (strcmp(option_name, "adaptive_batching") == 0) {
+        config->adaptive_batching = parse_bool(option_value);
+        console_debug(&csl, "Parsed adaptive_batching: %s", config->adaptive_batching ? "true" : "false");
+    } else if (strcmp(option_name, "batch_size_min") == 0) {
+        config->batch_size_min = parse_uint32(option_value, DEFAULT_BATCH_SIZE_MIN);
+        console_debug(&csl, "Parsed batch_size_min: %u", config->batch_size_min);
+    } else if (strcmp(option_name, "batch_size_max") == 0) {
+        config->batch_size_max = parse_uint32(option_value, DEFAULT_BATCH_SIZE_MAX);
+        console_debug(&csl, "Parsed batch_size_max: %u", config->batch_size_max);
+    } else if (strcmp(option_name, "batch_timeout_min_ms") == 0) {
+        config->batch_timeout_min_ms = parse_uint32(option_value, DEFAULT_BATCH_TIMEOUT_MIN_MS);
+        console_debug(&csl, "Parsed batch_timeout_min_ms: %u", config->batch_timeout_min_ms);
+    } else if (strcmp(option_name, "batch_timeout_max_ms") == 0) {
+        config->batch_timeout_max_ms = parse_uint32(option_value, DEFAULT_BATCH_TIMEOUT_MAX_MS);
+        console_debug(&csl, "Parsed batch_timeout_max_ms: %u", config->batch_timeout_max_ms);
     } else if (strcmp(option_name, "queue_size") == 0) {
         config->queue_size = parse_uint32(option_value, DEFAULT_QUEUE_SIZE);
         console_debug(&csl, "Parsed queue_size: %u", config->queue_size);
+    } else if (strcmp(option_name, "buffer_size_kb") == 0) {
+        config->buffer_size_kb = parse_uint32(option_value, DEFAULT_BUFFER_SIZE_KB);
+        console_debug(&csl, "Parsed buffer_size_kb: %u", config->buffer_size_kb);
+    } else if (strcmp(option_name, "memory_budget_percent") == 0) {
+        config->memory_budget_percent = parse_uint32(option_value, DEFAULT_MEMORY_BUDGET_PERCENT);
+        console_debug(&csl, "Parsed memory_budget_percent: %u", config->memory_budget_percent);
+    } else if (strcmp(option_name, "memory_budget_min_kb") == 0) {
+        config->memory_budget_min_kb = parse_uint32(option_value, DEFAULT_MEMORY_BUDGET_MIN_KB);
+        console_debug(&csl, "Parsed memory_budget_min_kb: %u", config->memory_budget_min_kb);
+    } else if (strcmp(option_name, "memory_budget_max_kb") == 0) {
+        config->memory_budget_max_kb = parse_uint32(option_value, DEFAULT_MEMORY_BUDGET_MAX_KB);
+        console_debug(&csl, "Parsed memory_budget_max_kb: %u", config->memory_budget_max_kb);
+    } else if (strcmp(option_name, "memory_low_percent") == 0) {
+        config->memory_low_percent = parse_uint32(option_value, DEFAULT_MEMORY_LOW_PERCENT);
+        console_debug(&csl, "Parsed memory_low_percent: %u", config->memory_low_percent);
+    } else if (strcmp(option_name, "dedup_window_ms") == 0) {
+        config->dedup_window_ms = parse_uint32(option_value, DEFAULT_DEDUP_WINDOW_MS);
+        console_debug(&csl, "Parsed dedup_window_ms: %u", config->dedup_window_ms);
+    } else if (strcmp(option_name, "rate_limit") == 0) {
+        config->rate_limit = parse_uint32(option_value, DEFAULT_RATE_LIMIT);
+        console_debug(&csl, "Parsed rate_limit: %u", config->rate_limit);
+    } else if (strcmp(option_name, "rate_limit_burst") == 0) {
+        config->rate_limit_burst = parse_uint32(option_value, DEFAULT_RATE_LIMIT_BURST);
+        console_debug(&csl, "Parsed rate_limit_burst: %u", config->rate_limit_burst);
+    } else if (strcmp(option_name, "sample_watermark") == 0) {
+        config->sample_watermark = parse_uint32(option_value, DEFAULT_SAMPLE_WATERMARK);
+        console_debug(&csl, "Parsed sample_watermark: %u", config->sample_watermark);
+    } else if (strcmp(option_name, "sample_max_rate") == 0) {
+        config->sample_max_rate = parse_uint32(option_value, DEFAULT_SAMPLE_MAX_RATE);
+        console_debug(&csl, "Parsed sample_max_rate: %u", config->sample_max_rate);
+    } else if (strcmp(option_name, "ingest_thread") == 0) {
+        config->ingest_thread = parse_ingest_thread(option_value);
+        console_debug(&csl, "Parsed ingest_thread: %s", ingest_thread_name(config->ingest_thread));
+    } else if (strcmp(option_name, "ingest_ring_kb") == 0) {
+        config->ingest_ring_kb = parse_uint32(option_value, DEFAULT_INGEST_RING_KB);
+        console_debug(&csl, "Parsed ingest_ring_kb: %u", config->ingest_ring_kb);
+    } else if (strcmp(option_name, "cursor_file") == 0) {
+        strncpy(config->cursor_file, option_value, sizeof(config->cursor_file) - 1);
+        config->cursor_file[sizeof(config->cursor_file) - 1] = '\0';
+        console_debug(&csl, "Parsed cursor_file: %s", config->cursor_file);
+    } else if (strcmp(option_name, "catchup_lines") == 0) {
+        config->catchup_lines = parse_uint32(option_value, DEFAULT_CATCHUP_LINES);
+        console_debug(&csl, "Parsed catchup_lines: %u", config->catchup_lines);
+    } else if (strcmp(option_name, "catchup_rate") == 0) {
+        config->catchup_rate = parse_uint32(option_value, DEFAULT_CATCHUP_RATE);
+        console_debug(&csl, "Parsed catchup_rate: %u", config->catchup_rate);
+    } else if (strcmp(option_name, "syslog_bind") == 0) {
+        strncpy(config->syslog_bind, option_value, sizeof(config->syslog_bind) - 1);
+        config->syslog_bind[sizeof(config->syslog_bind) - 1] = '\0';
+        console_debug(&csl, "Parsed syslog_bind: %s", config->syslog_bind);
+    } else if (strcmp(option_name, "syslog_udp_port") == 0) {
+        config->syslog_udp_port = parse_uint32(option_value, DEFAULT_SYSLOG_UDP_PORT);
+        console_debug(&csl, "Parsed syslog_udp_port: %u", config->syslog_udp_port);
+    } else if (strcmp(option_name, "syslog_tcp_port") == 0) {
+        config->syslog_tcp_port = parse_uint32(option_value, DEFAULT_SYSLOG_TCP_PORT);
+        console_debug(&csl, "Parsed syslog_tcp_port: %u", config->syslog_tcp_port);
     } else if (strcmp(option_name, "http_timeout") == 0) {
         config->http_timeout = parse_uint32(option_value, DEFAULT_HTTP_TIMEOUT);
         console_debug(&csl, "Parsed http_timeout: %u", config->http_timeout);
     } else if (strcmp(option_name, "http_retries") == 0) {
         config->http_retries = parse_uint32(option_value, DEFAULT_HTTP_RETRIES);
         console_debug(&csl, "Parsed http_retries: %u", config->http_retries);
+    } else if (strcmp(option_name, "max_inflight_batches") == 0) {
+        config->max_inflight_batches = parse_uint32(option_value, DEFAULT_MAX_INFLIGHT_BATCHES);
+        console_debug(&csl, "Parsed max_inflight_batches: %u", config->max_inflight_batches);
     } else if (strcmp(option_name, "reconnect_delay_ms") == 0) {
         config->reconnect_delay_ms = parse_uint32(option_value, DEFAULT_RECONNECT_DELAY_MS);
         console_debug(&csl, "Parsed reconnect_delay_ms: %u", config->reconnect_delay_ms);
+    } else if (strcmp(option_name, "compression") == 0) {
+        if (compression_from_string(option_value, &config->compression) < 0) {
+            console_warn(&csl, "Unsupported compression '%s', falling back to none", option_value);
+            config->compression = COMPRESSION_NONE;
+        }
+        console_debug(&csl, "Parsed compression: %s", compression_name(config->compression));
+    } else if (strcmp(option_name, "compression_level") == 0) {
+        config->compression_level = (int)parse_uint32(option_value, DEFAULT_COMPRESSION_LEVEL);
+        console_debug(&csl, "Parsed compression_level: %d", config->compression_level);
+    } else if (strcmp(option_name, "format") == 0) {
+        if (payload_format_from_string(option_value, &config->format) < 0) {
+            console_warn(&csl, "Unsupported format '%s', falling back to json", option_value);
+            config->format = PAYLOAD_FORMAT_JSON;
+        }
+        console_debug(&csl, "Parsed format: %s", payload_format_name(config->format));
+    } else if (strcmp(option_name, "spool_dir") == 0) {
+        strncpy(config->spool_dir, option_value, sizeof(config->spool_dir) - 1);
+        config->spool_dir[sizeof(config->spool_dir) - 1] = '\0';
+        console_debug(&csl, "Parsed spool_dir: %s", config->spool_dir);
+    } else if (strcmp(option_name, "spool_size_kb") == 0) {
+        config->spool_size_kb = parse_uint32(option_value, DEFAULT_SPOOL_SIZE_KB);
+        console_debug(&csl, "Parsed spool_size_kb: %u", config->spool_size_kb);
+    } else if (strcmp(option_name, "spool_segment_kb") == 0) {
+        config->spool_segment_kb = parse_uint32(option_value, DEFAULT_SPOOL_SEGMENT_KB);
+        console_debug(&csl, "Parsed spool_segment_kb: %u", config->spool_segment_kb);
+    } else if (strcmp(option_name, "spool_write_budget_kb") == 0) {
+        config->spool_write_budget_kb = parse_uint32(option_value, DEFAULT_SPOOL_WRITE_BUDGET_KB);
+        console_debug(&csl, "Parsed spool_write_budget_kb: %u", config->spool_write_budget_kb);
+    } else if (strcmp(option_name, "filter_level") == 0) {
+        int level = filter_parse_level(option_value);
+        if (level < 0) {
+            console_warn(&csl, "Invalid filter_level '%s', keeping %d", option_value, config->filters.default_level);
+        } else {
+            config->filters.default_level = level;
+        }
+        console_debug(&csl, "Parsed filter_level: %d", config->filters.default_level);
     } else if (strcmp(option_name, "dev_mode") == 0) {
         config->dev_mode = parse_bool(option_value);
         console_debug(&csl, "Parsed dev_mode: %s", config->dev_mode ? "true" : "false");
@@ -165,6 +298,125 @@ static int parse_config_option(collector_config_t *config, const char *line) {
     return 0;
 }
 
+/**
+ * Parse a single option or list entry of a filter section
+ */
+static int parse_filter_option(collector_config_t *config, uint32_t rule_index, bool is_list,
+                               const char *option_name, const char *option_value) {
+    filter_rule_t *rule = &config->filters.rules[rule_index];
+    int value;
+
+    if (!is_list && strcmp(option_name, "source") == 0) {
+        value = filter_parse_source(option_value);
+        if (value < FILTER_ANY) {
+            console_warn(&csl, "Invalid filter source '%s'", option_value);
+            return -EINVAL;
+        }
+        rule->source = value;
+        console_debug(&csl, "Parsed filter source: %d", rule->source);
+    } else if (!is_list && strcmp(option_name, "facility") == 0) {
+        value = filter_parse_facility(option_value);
+        if (value < FILTER_ANY) {
+            console_warn(&csl, "Invalid filter facility '%s'", option_value);
+            return -EINVAL;
+        }
+        rule->facility = value;
+        console_debug(&csl, "Parsed filter facility: %d", rule->facility);
+    } else if (!is_list && strcmp(option_name, "level") == 0) {
+        value = filter_parse_level(option_value);
+        if (value < 0) {
+            console_warn(&csl, "Invalid filter level '%s'", option_value);
+            return -EINVAL;
+        }
+        rule->level = value;
+        console_debug(&csl, "Parsed filter level: %d", rule->level);
+    } else if (strcmp(option_name, "include") == 0 || strcmp(option_name, "include_prefix") == 0 ||
+               strcmp(option_name, "exclude") == 0 || strcmp(option_name, "exclude_prefix") == 0) {
+        uint16_t flags = 0;
+        if (option_name[0] == 'i') flags |= FILTER_PATTERN_INCLUDE;
+        if (strstr(option_name, "_prefix")) flags |= FILTER_PATTERN_PREFIX;
+
+        int ret = filter_rules_add_pattern(&config->filters, rule_index, option_value, flags);
+        if (ret < 0) {
+            console_warn(&csl, "Cannot add filter pattern '%s': %d", option_value, ret);
+            return ret;
+        }
+        console_debug(&csl, "Parsed filter %s: %s", option_name, option_value);
+    } else {
+        console_debug(&csl, "Unknown filter option: %s", option_name);
+    }
+
+    return 0;
+}
+
+/**
+ * Start a sink section with default options
+ * @param name Section name, empty for an anonymous section
+ * @return sink index or -ENOSPC if all slots are taken
+ */
+static int add_sink(collector_config_t *config, const char *name) {
+    if (config->sink_count >= SINK_MAX) {
+        return -ENOSPC;
+    }
+
+    sink_config_t *sink = &config->sinks[config->sink_count];
+    memset(sink, 0, sizeof(*sink));
+    if (name[0]) {
+        snprintf(sink->name, sizeof(sink->name), "%s", name);
+    } else {
+        snprintf(sink->name, sizeof(sink->name), "sink%u", config->sink_count);
+    }
+    sink->type = SINK_FILE;
+    sink->max_size_kb = DEFAULT_SINK_MAX_SIZE_KB;
+    sink->files = DEFAULT_SINK_FILES;
+    snprintf(sink->host, sizeof(sink->host), "%s", DEFAULT_SINK_HOST);
+    sink->port = DEFAULT_SINK_PORT;
+    snprintf(sink->topic, sizeof(sink->topic), "%s", DEFAULT_SINK_TOPIC);
+    sink->keepalive = DEFAULT_SINK_KEEPALIVE;
+    sink->queue_kb = DEFAULT_SINK_QUEUE_KB;
+
+    return (int)config->sink_count++;
+}
+
+/**
+ * Parse a single option of a sink section
+ */
+static int parse_sink_option(collector_config_t *config, uint32_t sink_index, const char *option_name,
+                             const char *option_value) {
+    sink_config_t *sink = &config->sinks[sink_index];
+
+    if (strcmp(option_name, "type") == 0) {
+        if (sink_parse_type(option_value, &sink->type) < 0) {
+            console_warn(&csl, "Invalid sink type '%s'", option_value);
+            return -EINVAL;
+        }
+    } else if (strcmp(option_name, "path") == 0) {
+        snprintf(sink->path, sizeof(sink->path), "%s", option_value);
+    } else if (strcmp(option_name, "max_size_kb") == 0) {
+        sink->max_size_kb = parse_uint32(option_value, DEFAULT_SINK_MAX_SIZE_KB);
+    } else if (strcmp(option_name, "files") == 0) {
+        sink->files = parse_uint32(option_value, DEFAULT_SINK_FILES);
+    } else if (strcmp(option_name, "host") == 0) {
+        snprintf(sink->host, sizeof(sink->host), "%s", option_value);
+    } else if (strcmp(option_name, "port") == 0) {
+        sink->port = parse_uint32(option_value, DEFAULT_SINK_PORT);
+    } else if (strcmp(option_name, "topic") == 0) {
+        snprintf(sink->topic, sizeof(sink->topic), "%s", option_value);
+    } else if (strcmp(option_name, "client_id") == 0) {
+        snprintf(sink->client_id, sizeof(sink->client_id), "%s", option_value);
+    } else if (strcmp(option_name, "keepalive") == 0) {
+        sink->keepalive = parse_uint32(option_value, DEFAULT_SINK_KEEPALIVE);
+    } else if (strcmp(option_name, "queue_kb") == 0) {
+        sink->queue_kb = parse_uint32(option_value, DEFAULT_SINK_QUEUE_KB);
+    } else {
+        console_debug(&csl, "Unknown sink option: %s", option_name);
+        return 0;
+    }
+
+    console_debug(&csl, "Parsed sink %s %s: %s", sink->name, option_name, option_value);
+    return 0;
+}
+
 void config_init_defaults(collector_config_t *config) {
     memset(config, 0, sizeof(collector_config_t));
 
@@ -174,11 +426,51 @@ void config_init_defaults(collector_config_t *config) {
 
     config->batch_size = DEFAULT_BATCH_SIZE;
     config->batch_timeout_ms = DEFAULT_BATCH_TIMEOUT_MS;
+    config->adaptive_batching = DEFAULT_ADAPTIVE_BATCHING;
+    config->batch_size_min = DEFAULT_BATCH_SIZE_MIN;
+    config->batch_size_max = DEFAULT_BATCH_SIZE_MAX;
+    config->batch_timeout_min_ms = DEFAULT_BATCH_TIMEOUT_MIN_MS;
+    config->batch_timeout_max_ms = DEFAULT_BATCH_TIMEOUT_MAX_MS;
     config->queue_size = DEFAULT_QUEUE_SIZE;
+    config->buffer_size_kb = DEFAULT_BUFFER_SIZE_KB;
+    config->memory_budget_percent = DEFAULT_MEMORY_BUDGET_PERCENT;
+    config->memory_budget_min_kb = DEFAULT_MEMORY_BUDGET_MIN_KB;
+    config->memory_budget_max_kb = DEFAULT_MEMORY_BUDGET_MAX_KB;
+    config->memory_low_percent = DEFAULT_MEMORY_LOW_PERCENT;
+
+    config->dedup_window_ms = DEFAULT_DEDUP_WINDOW_MS;
+    config->rate_limit = DEFAULT_RATE_LIMIT;
+    config->rate_limit_burst = DEFAULT_RATE_LIMIT_BURST;
+    config->sample_watermark = DEFAULT_SAMPLE_WATERMARK;
+    config->sample_max_rate = DEFAULT_SAMPLE_MAX_RATE;
+
+    config->ingest_thread = DEFAULT_INGEST_THREAD;
+    config->ingest_ring_kb = DEFAULT_INGEST_RING_KB;
+    strncpy(config->cursor_file, DEFAULT_CURSOR_FILE, sizeof(config->cursor_file) - 1);
+    config->cursor_file[sizeof(config->cursor_file) - 1] = '\0';
+    config->catchup_lines = DEFAULT_CATCHUP_LINES;
+    config->catchup_rate = DEFAULT_CATCHUP_RATE;
+
+    strncpy(config->syslog_bind, DEFAULT_SYSLOG_BIND, sizeof(config->syslog_bind) - 1);
+    config->syslog_bind[sizeof(config->syslog_bind) - 1] = '\0';
+    config->syslog_udp_port = DEFAULT_SYSLOG_UDP_PORT;
+    config->syslog_tcp_port = DEFAULT_SYSLOG_TCP_PORT;
 
     config->http_timeout = DEFAULT_HTTP_TIMEOUT;
     config->http_retries = DEFAULT_HTTP_RETRIES;
+    config->max_inflight_batches = DEFAULT_MAX_INFLIGHT_BATCHES;
     config->reconnect_delay_ms = DEFAULT_RECONNECT_DELAY_MS;
+    config->compression = DEFAULT_COMPRESSION;
+    config->compression_level = DEFAULT_COMPRESSION_LEVEL;
+    config->format = DEFAULT_FORMAT;
+
+    strncpy(config->spool_dir, DEFAULT_SPOOL_DIR, sizeof(config->spool_dir) - 1);
+    config->spool_dir[sizeof(config->spool_dir) - 1] = '\0';
+    config->spool_size_kb = DEFAULT_SPOOL_SIZE_KB;
+    config->spool_segment_kb = DEFAULT_SPOOL_SEGMENT_KB;
+    config->spool_write_budget_kb = DEFAULT_SPOOL_WRITE_BUDGET_KB;
+
+    filter_rules_init(&config->filters, DEFAULT_FILTER_LEVEL);
 
     config->dev_mode = false;
     config->console_log_level = DEFAULT_CONSOLE_LOG_LEVEL;
@@ -193,7 +485,9 @@ int config_load_from_file(collector_config_t *config, const char *file_path) {
     FILE *file;
     char line[512];
     int line_number = 0;
-    bool in_collector_section = false;
+    enum { SECTION_OTHER, SECTION_COLLECTOR, SECTION_FILTER, SECTION_SINK } section = SECTION_OTHER;
+    uint32_t filter_rule = 0;
+    uint32_t sink_index = 0;
 
     if (!config || !file_path) {
         return -EINVAL;
@@ -216,25 +510,61 @@ int config_load_from_file(collector_config_t *config, const char *file_path) {
             continue;
         }
 
-        // Check for section header
-        if (strncmp(line, "config fry_collector", 22) == 0) {
-            in_collector_section = true;
-            console_debug(&csl, "Found fry_collector section at line %d", line_number);
+        // Check for section header: config <type> ['<name>']
+        if (strncmp(line, "config", 6) == 0 && (line[6] == ' ' || line[6] == '\t')) {
+            char type[64] = {0};
+            char name[SINK_NAME_SIZE] = {0};
+            sscanf(line + 6, " %63[^ \t'\"] %31[^ \t]", type, name);
+            remove_quotes(name);
+
+            if (strcmp(type, "fry_collector") == 0) {
+                section = SECTION_COLLECTOR;
+                console_debug(&csl, "Found fry_collector section at line %d", line_number);
+            } else if (strcmp(type, "filter") == 0) {
+                int ret = filter_rules_add(&config->filters);
+                if (ret < 0) {
+                    console_warn(&csl, "Too many filter sections, ignoring line %d", line_number);
+                    section = SECTION_OTHER;
+                } else {
+                    filter_rule = (uint32_t)ret;
+                    section = SECTION_FILTER;
+                    console_debug(&csl, "Found filter section at line %d", line_number);
+                }
+            } else if (strcmp(type, "sink") == 0) {
+                int ret = add_sink(config, name);
+                if (ret < 0) {
+                    console_warn(&csl, "Too many sink sections, ignoring line %d", line_number);
+                    section = SECTION_OTHER;
+                } else {
+                    sink_index = (uint32_t)ret;
+                    section = SECTION_SINK;
+                    console_debug(&csl, "Found sink section %s at line %d", config->sinks[sink_index].name,
+                                  line_number);
+                }
+            } else {
+                section = SECTION_OTHER;
+            }
             continue;
         }
 
-        // Check for new section (end of our section)
-        if (strncmp(line, "config ", 7) == 0 && strncmp(line, "config fry_collector", 22) != 0) {
-            in_collector_section = false;
+        bool is_list;
+        char option_name[64];
+        char option_value[256];
+        if (section == SECTION_OTHER ||
+            !split_option_line(line, &is_list, option_name, sizeof(option_name), option_value, sizeof(option_value))) {
             continue;
         }
 
-        // Parse options only if we're in the collector section
-        if (in_collector_section) {
-            int ret = parse_config_option(config, line);
-            if (ret < 0) {
-                console_warn(&csl, "Error parsing line %d: %s", line_number, line);
-            }
+        int ret = 0;
+        if (section == SECTION_COLLECTOR && !is_list) {
+            ret = parse_config_option(config, option_name, option_value);
+        } else if (section == SECTION_FILTER) {
+            ret = parse_filter_option(config, filter_rule, is_list, option_name, option_value);
+        } else if (section == SECTION_SINK && !is_list) {
+            ret = parse_sink_option(config, sink_index, option_name, option_value);
+        }
+        if (ret < 0) {
+            console_warn(&csl, "Error parsing line %d: %s", line_number, line);
         }
     }
 
@@ -298,23 +628,160 @@ int config_validate(const collector_config_t *config) {
     }
 
     // Validate queue size
-    if (config->queue_size == 0 || config->queue_size > 10000) {
-        console_error(&csl, "Invalid configuration: queue_size must be between 1 and 10000");
+    if (config->queue_size == 0 || config->queue_size > 100000) {
+        console_error(&csl, "Invalid configuration: queue_size must be between 1 and 100000");
         return -EINVAL;
     }
 
+    // Validate log buffer size
+    if (config->buffer_size_kb < 16 || config->buffer_size_kb > 65536) {
+        console_error(&csl, "Invalid configuration: buffer_size_kb must be between 16 and 65536");
+        return -EINVAL;
+    }
+
+    // Validate memory-driven sizing, its bounds follow buffer_size_kb
+    if (config->memory_budget_percent) {
+        if (config->memory_budget_percent > 50) {
+            console_error(&csl, "Invalid configuration: memory_budget_percent must be between 0 and 50");
+            return -EINVAL;
+        }
+
+        if (config->memory_budget_min_kb < 16 || config->memory_budget_max_kb > 65536 ||
+            config->memory_budget_min_kb > config->memory_budget_max_kb) {
+            console_error(&csl, "Invalid configuration: memory_budget_min_kb and memory_budget_max_kb must be "
+                                "ordered and between 16 and 65536");
+            return -EINVAL;
+        }
+
+        if (config->memory_low_percent == 0 || config->memory_low_percent > 50) {
+            console_error(&csl, "Invalid configuration: memory_low_percent must be between 1 and 50");
+            return -EINVAL;
+        }
+    }
+
     // Validate batch timeout
     if (config->batch_timeout_ms < 1000 || config->batch_timeout_ms > 300000) {
         console_error(&csl, "Invalid configuration: batch_timeout_ms must be between 1000 and 300000");
         return -EINVAL;
     }
 
+    // Validate adaptive batching bounds (same limits as the static values, which must lie within them)
+    if (config->adaptive_batching) {
+        if (config->batch_size_min == 0 || config->batch_size_min > config->batch_size ||
+            config->batch_size_max < config->batch_size || config->batch_size_max > 1000) {
+            console_error(&csl, "Invalid configuration: batch_size must lie within batch_size_min and batch_size_max "
+                                "(1-1000)");
+            return -EINVAL;
+        }
+
+        if (config->batch_timeout_min_ms < 1000 || config->batch_timeout_min_ms > config->batch_timeout_ms ||
+            config->batch_timeout_max_ms < config->batch_timeout_ms || config->batch_timeout_max_ms > 300000) {
+            console_error(&csl, "Invalid configuration: batch_timeout_ms must lie within batch_timeout_min_ms and "
+                                "batch_timeout_max_ms (1000-300000)");
+            return -EINVAL;
+        }
+    }
+
+    // Validate storm protection (the window is stored as a 32-bit timestamp delta per record)
+    if (config->dedup_window_ms > 3600000) {
+        console_error(&csl, "Invalid configuration: dedup_window_ms must be at most 3600000");
+        return -EINVAL;
+    }
+
+    if (config->rate_limit && config->rate_limit_burst == 0) {
+        console_error(&csl, "Invalid configuration: rate_limit_burst must be at least 1");
+        return -EINVAL;
+    }
+
+    // Sampling must start below a full queue, the rate is stored as a power of two per record
+    if (config->sample_watermark > 95) {
+        console_error(&csl, "Invalid configuration: sample_watermark must not exceed 95");
+        return -EINVAL;
+    }
+
+    if (config->sample_max_rate < 2 || config->sample_max_rate > 1024 ||
+        (config->sample_max_rate & (config->sample_max_rate - 1))) {
+        console_error(&csl, "Invalid configuration: sample_max_rate must be a power of two between 2 and 1024");
+        return -EINVAL;
+    }
+
+    // A record may take up to half the ring, logd messages stay well below 8 KB
+    if (config->ingest_ring_kb < 16 || config->ingest_ring_kb > 16384) {
+        console_error(&csl, "Invalid configuration: ingest_ring_kb must be between 16 and 16384");
+        return -EINVAL;
+    }
+
+    // logd replays from its ring buffer, anything larger only costs start-up time
+    if (config->catchup_lines > 100000) {
+        console_error(&csl, "Invalid configuration: catchup_lines must not exceed 100000");
+        return -EINVAL;
+    }
+
+    if (config->syslog_udp_port > 65535 || config->syslog_tcp_port > 65535) {
+        console_error(&csl, "Invalid configuration: syslog_udp_port and syslog_tcp_port must be between 0 and 65535");
+        return -EINVAL;
+    }
+
     // Validate HTTP timeout
     if (config->http_timeout == 0 || config->http_timeout > 300) {
         console_error(&csl, "Invalid configuration: http_timeout must be between 1 and 300 seconds");
         return -EINVAL;
     }
 
+    // Validate concurrent uploads
+    if (config->max_inflight_batches == 0 || config->max_inflight_batches > MAX_INFLIGHT_BATCHES) {
+        console_error(&csl, "Invalid configuration: max_inflight_batches must be between 1 and %d",
+                      MAX_INFLIGHT_BATCHES);
+        return -EINVAL;
+    }
+
+    // Validate compression level (zlib accepts 1-9, zstd up to 19 for our purposes)
+    int max_level = config->compression == COMPRESSION_ZSTD ? 19 : 9;
+    if (config->compression != COMPRESSION_NONE &&
+        (config->compression_level < 1 || config->compression_level > max_level)) {
+        console_error(&csl, "Invalid configuration: compression_level must be between 1 and %d", max_level);
+        return -EINVAL;
+    }
+
+    // Validate spool sizing (a spool needs at least two segments to rotate)
+    if (config->spool_dir[0]) {
+        if (config->spool_segment_kb < 16 || config->spool_segment_kb > 16384) {
+            console_error(&csl, "Invalid configuration: spool_segment_kb must be between 16 and 16384");
+            return -EINVAL;
+        }
+
+        if (config->spool_size_kb < 2 * config->spool_segment_kb) {
+            console_error(&csl, "Invalid configuration: spool_size_kb must be at least twice spool_segment_kb");
+            return -EINVAL;
+        }
+    }
+
+    // Validate mirror sinks
+    for (uint32_t i = 0; i < config->sink_count; i++) {
+        const sink_config_t *sink = &config->sinks[i];
+
+        for (uint32_t j = 0; j < i; j++) {
+            if (strcmp(config->sinks[j].name, sink->name) == 0) {
+                console_error(&csl, "Invalid configuration: sink name '%s' is used twice", sink->name);
+                return -EINVAL;
+            }
+        }
+
+        if (sink->type == SINK_FILE && (!sink->path[0] || sink->max_size_kb == 0)) {
+            console_error(&csl, "Invalid configuration: file sink '%s' needs a path and a max_size_kb above 0",
+                          sink->name);
+            return -EINVAL;
+        }
+
+        if (sink->type == SINK_MQTT &&
+            (!sink->host[0] || !sink->topic[0] || sink->port == 0 || sink->port > 65535 || sink->queue_kb == 0)) {
+            console_error(&csl, "Invalid configuration: mqtt sink '%s' needs a host, a port, a topic and a "
+                                "queue_kb above 0",
+                          sink->name);
+            return -EINVAL;
+        }
+    }
+
     console_debug(&csl, "Configuration validation passed");
     return 0;
 }
@@ -329,6 +796,44 @@ const collector_config_t *config_get_current(void) {
     return &g_config;
 }
 
+int config_use_file(const char *file_path) {
+    config_init_defaults(&g_config);
+    g_config_initialized = true;
+
+    return config_load_from_file(&g_config, file_path);
+}
+
+int config_reload(void) {
+    static collector_config_t staged;
+    int ret;
+
+    config_init_defaults(&staged);
+    if (g_config.config_loaded) {
+        // Re-read the file in use rather than searching again
+        ret = config_load_from_file(&staged, g_config.config_file_path);
+    } else {
+        ret = config_load(&staged);
+        if (ret == -ENOENT) {
+            ret = 0; // Still no file, the defaults are reapplied
+        }
+    }
+
+    if (ret < 0) {
+        console_error(&csl, "Failed to reload configuration: %s", strerror(-ret));
+        return ret;
+    }
+
+    ret = config_validate(&staged);
+    if (ret < 0) {
+        console_error(&csl, "Reloaded configuration is invalid, keeping the current one");
+        return ret;
+    }
+
+    g_config = staged;
+    g_config_initialized = true;
+    return 0;
+}
+
 bool config_is_enabled(void) {
     const collector_config_t *config = config_get_current();
     return config ? config->enabled : DEFAULT_ENABLED;
@@ -354,6 +859,11 @@ uint32_t config_get_queue_size(void) {
     return config ? config->queue_size : DEFAULT_QUEUE_SIZE;
 }
 
+uint32_t config_get_buffer_size_kb(void) {
+    const collector_config_t *config = config_get_current();
+    return config ? config->buffer_size_kb : DEFAULT_BUFFER_SIZE_KB;
+}
+
 uint32_t config_get_http_timeout(void) {
     const collector_config_t *config = config_get_current();
     return config ? config->http_timeout : DEFAULT_HTTP_TIMEOUT;
@@ -377,10 +887,69 @@ void config_print_current(void) {
     console_info(&csl, "  logs_endpoint: %s", config->logs_endpoint);
     console_info(&csl, "  batch_size: %u", config->batch_size);
     console_info(&csl, "  batch_timeout_ms: %u", config->batch_timeout_ms);
+    if (config->adaptive_batching) {
+        console_info(&csl, "  adaptive_batching: size %u-%u, timeout %u-%u ms", config->batch_size_min,
+                     config->batch_size_max, config->batch_timeout_min_ms, config->batch_timeout_max_ms);
+    } else {
+        console_info(&csl, "  adaptive_batching: false");
+    }
     console_info(&csl, "  queue_size: %u", config->queue_size);
+    console_info(&csl, "  buffer_size_kb: %u", config->buffer_size_kb);
+    if (config->memory_budget_percent) {
+        console_info(&csl, "  memory_budget: %u%% of MemAvailable (%u-%u KB, low watermark %u%%)",
+                     config->memory_budget_percent, config->memory_budget_min_kb, config->memory_budget_max_kb,
+                     config->memory_low_percent);
+    }
+    console_info(&csl, "  dedup_window_ms: %u", config->dedup_window_ms);
+    if (config->rate_limit) {
+        console_info(&csl, "  rate_limit: %u logs/s (burst %u)", config->rate_limit, config->rate_limit_burst);
+    } else {
+        console_info(&csl, "  rate_limit: unlimited");
+    }
+    if (config->sample_watermark) {
+        console_info(&csl, "  overload sampling: from %u%% queue fill, up to 1 in %u", config->sample_watermark,
+                     config->sample_max_rate);
+    } else {
+        console_info(&csl, "  overload sampling: disabled");
+    }
+    console_info(&csl, "  ingest_thread: %s (ring %u KB)", ingest_thread_name(config->ingest_thread),
+                 config->ingest_ring_kb);
+    if (config->cursor_file[0]) {
+        console_info(&csl, "  catch-up: %u lines at %u logs/s, cursor %s", config->catchup_lines,
+                     config->catchup_rate, config->cursor_file);
+    } else {
+        console_info(&csl, "  catch-up: disabled");
+    }
+    if (config->syslog_udp_port || config->syslog_tcp_port) {
+        console_info(&csl, "  syslog listener: %s udp %u, tcp %u", config->syslog_bind[0] ? config->syslog_bind : "*",
+                     config->syslog_udp_port, config->syslog_tcp_port);
+    }
     console_info(&csl, "  http_timeout: %u", config->http_timeout);
     console_info(&csl, "  http_retries: %u", config->http_retries);
+    console_info(&csl, "  max_inflight_batches: %u", config->max_inflight_batches);
     console_info(&csl, "  reconnect_delay_ms: %u", config->reconnect_delay_ms);
+    console_info(&csl, "  compression: %s (level %d)", compression_name(config->compression),
+                 config->compression_level);
+    console_info(&csl, "  format: %s", payload_format_name(config->format));
+    if (config->spool_dir[0]) {
+        console_info(&csl, "  spool: %s (%u KB in %u KB segments, budget %u KB/h)", config->spool_dir,
+                     config->spool_size_kb, config->spool_segment_kb, config->spool_write_budget_kb);
+    } else {
+        console_info(&csl, "  spool: disabled");
+    }
+    console_info(&csl, "  filter_level: %d (%u rules, %u patterns)", config->filters.default_level,
+                 config->filters.rule_count, config->filters.pattern_count);
+    for (uint32_t i = 0; i < config->sink_count; i++) {
+        const sink_config_t *sink = &config->sinks[i];
+
+        if (sink->type == SINK_FILE) {
+            console_info(&csl, "  sink %s: file %s (%u KB, %u rotated)", sink->name, sink->path, sink->max_size_kb,
+                         sink->files);
+        } else {
+            console_info(&csl, "  sink %s: mqtt %s:%u topic %s (queue %u KB)", sink->name, sink->host, sink->port,
+                         sink->topic, sink->queue_kb);
+        }
+    }
     console_info(&csl, "  dev_mode: %s", config->dev_mode ? "true" : "false");
     console_info(&csl, "  console_log_level: %u", config->console_log_level);
 
@@ -1,6 +1,10 @@
 #ifndef CONFIG_H
 #define CONFIG_H
 
+#include "compress.h"
+#include "filter.h"
+#include "payload.h"
+#include "sink.h"
 #include <stdbool.h>
 #include <stdint.h>
 
@@ -15,10 +19,59 @@
 #define DEFAULT_CONSOLE_LOG_LEVEL 1
 #define DEFAULT_BATCH_SIZE 50
 #define DEFAULT_BATCH_TIMEOUT_MS 10000
-#define DEFAULT_QUEUE_SIZE 500
+#define DEFAULT_ADAPTIVE_BATCHING false
+#define DEFAULT_BATCH_SIZE_MIN 10
+#define DEFAULT_BATCH_SIZE_MAX 500
+#define DEFAULT_BATCH_TIMEOUT_MIN_MS 2000
+#define DEFAULT_BATCH_TIMEOUT_MAX_MS 60000
+#define DEFAULT_QUEUE_SIZE 5000
+#define DEFAULT_BUFFER_SIZE_KB 256
+#define DEFAULT_MEMORY_BUDGET_PERCENT 0 // Fixed buffer_size_kb and queue_size
+#define DEFAULT_MEMORY_BUDGET_MIN_KB 64
+#define DEFAULT_MEMORY_BUDGET_MAX_KB 4096
+#define DEFAULT_MEMORY_LOW_PERCENT 10
 #define DEFAULT_HTTP_TIMEOUT 30
 #define DEFAULT_HTTP_RETRIES 2
+#define DEFAULT_MAX_INFLIGHT_BATCHES 4
+#define MAX_INFLIGHT_BATCHES 8 // Upper bound of max_inflight_batches
 #define DEFAULT_RECONNECT_DELAY_MS 5000
+#define DEFAULT_COMPRESSION COMPRESSION_NONE
+#define DEFAULT_COMPRESSION_LEVEL 6
+#define DEFAULT_FORMAT PAYLOAD_FORMAT_JSON
+#define DEFAULT_SPOOL_DIR "/tmp/fry-collector/spool"
+#define DEFAULT_SPOOL_SIZE_KB 2048
+#define DEFAULT_SPOOL_SEGMENT_KB 256
+#define DEFAULT_SPOOL_WRITE_BUDGET_KB 8192
+#define DEFAULT_DEDUP_WINDOW_MS 10000
+#define DEFAULT_RATE_LIMIT 100 // Logs per second per source/facility
+#define DEFAULT_RATE_LIMIT_BURST 1000
+#define DEFAULT_SAMPLE_WATERMARK 0 // Queue fill percent where low-severity logs are sampled, 0 disables
+#define DEFAULT_SAMPLE_MAX_RATE 16
+#define DEFAULT_FILTER_LEVEL 6 // LOG_INFO, debug messages are dropped
+#define DEFAULT_INGEST_THREAD INGEST_THREAD_OFF
+#define DEFAULT_INGEST_RING_KB 256
+#define DEFAULT_CURSOR_FILE "/tmp/fry-collector/logd.cursor"
+#define DEFAULT_CATCHUP_LINES 1000
+#define DEFAULT_CATCHUP_RATE 200 // Backlog records read per second
+#define DEFAULT_SYSLOG_BIND ""    // All addresses
+#define DEFAULT_SYSLOG_UDP_PORT 0 // Listener disabled
+#define DEFAULT_SYSLOG_TCP_PORT 0
+#define DEFAULT_SINK_MAX_SIZE_KB 1024
+#define DEFAULT_SINK_FILES 3
+#define DEFAULT_SINK_HOST "127.0.0.1"
+#define DEFAULT_SINK_PORT 1883
+#define DEFAULT_SINK_TOPIC "fry/logs"
+#define DEFAULT_SINK_KEEPALIVE 60
+#define DEFAULT_SINK_QUEUE_KB 256
+
+/**
+ * Where logd records are read and filtered
+ */
+typedef enum {
+    INGEST_THREAD_OFF,  // On the event loop, next to batching and uploads
+    INGEST_THREAD_ON,   // On a reader thread feeding the event loop through a ring
+    INGEST_THREAD_AUTO, // On a reader thread if two or more CPUs are online
+} ingest_thread_mode_t;
 
 /**
  * Configuration structure for the collector
@@ -32,12 +85,60 @@ typedef struct collector_config {
     // Batching configuration
     uint32_t batch_size;
     uint32_t batch_timeout_ms;
-    uint32_t queue_size;
+    bool adaptive_batching;        // Tune batch size and timeout by upload RTT and queue depth
+    uint32_t batch_size_min;       // Bounds of the adaptive batch size
+    uint32_t batch_size_max;
+    uint32_t batch_timeout_min_ms; // Bounds of the adaptive batch timeout
+    uint32_t batch_timeout_max_ms;
+    uint32_t queue_size;     // Maximum number of queued records
+    uint32_t buffer_size_kb; // Byte budget of the log arena
+
+    // Memory-driven sizing, replaces buffer_size_kb and queue_size when enabled
+    uint32_t memory_budget_percent; // Share of MemAvailable at start for the log buffer, 0 disables
+    uint32_t memory_budget_min_kb;  // Bounds of the budget
+    uint32_t memory_budget_max_kb;
+    uint32_t memory_low_percent; // MemAvailable watermark (share of MemTotal) below which the buffer shrinks
+
+    // Log storm protection
+    uint32_t dedup_window_ms;  // Collapse repeats of a queued message within this window, 0 disables
+    uint32_t rate_limit;       // Logs per second per source/facility, 0 for unlimited
+    uint32_t rate_limit_burst; // Logs a source/facility may send at once
+    uint32_t sample_watermark; // Queue fill percent where notice/info/debug logs are sampled, 0 disables
+    uint32_t sample_max_rate;  // Keep at least 1 in this many of them (power of two)
+
+    // Log ingestion
+    ingest_thread_mode_t ingest_thread; // Read and filter logd records on a thread of their own
+    uint32_t ingest_ring_kb;            // Ring from the reader thread to the event loop
+    char cursor_file[128];              // Last processed logd record, empty disables catch-up
+    uint32_t catchup_lines;             // Backlog requested from logd when the stream (re)starts
+    uint32_t catchup_rate;              // Backlog records read per second, 0 for unlimited
+
+    // Syslog listener for devices behind the access point
+    char syslog_bind[64];     // Listen address, empty for all addresses
+    uint32_t syslog_udp_port; // 0 disables the UDP listener
+    uint32_t syslog_tcp_port; // 0 disables the TCP listener
 
     // HTTP configuration
     uint32_t http_timeout;
     uint32_t http_retries;
+    uint32_t max_inflight_batches; // Concurrent batch uploads
     uint32_t reconnect_delay_ms;
+    compression_t compression; // Content-Encoding applied to batch uploads
+    int compression_level;
+    payload_format_t format; // Body format of batch uploads, sent as Content-Type
+
+    // Spool for undelivered batches
+    char spool_dir[128];            // Empty disables spooling
+    uint32_t spool_size_kb;         // Upper bound of all segment files
+    uint32_t spool_segment_kb;      // Size of one segment file
+    uint32_t spool_write_budget_kb; // Writes allowed per hour, 0 for unlimited
+
+    // Log filtering ("config filter" sections)
+    filter_rules_t filters;
+
+    // Mirror sinks batches are copied to besides the upload ("config sink" sections)
+    sink_config_t sinks[SINK_MAX];
+    uint32_t sink_count;
 
     // Development settings
     bool dev_mode;
@@ -82,6 +183,20 @@ int config_validate(const collector_config_t *config);
  */
 const collector_config_t *config_get_current(void);
 
+/**
+ * Make the given file the current configuration instead of searching the default paths
+ * @param file_path Path to configuration file
+ * @return 0 on success, negative error code on failure (defaults stay in effect)
+ */
+int config_use_file(const char *file_path);
+
+/**
+ * Re-read the current configuration file
+ * The new configuration replaces the current one only if it loads and validates.
+ * @return 0 on success, negative error code on failure (current configuration stays in effect)
+ */
+int config_reload(void);
+
 /**
  * Check if collector is enabled in configuration
  * @return true if enabled, false otherwise
@@ -112,6 +227,12 @@ uint32_t config_get_batch_timeout_ms(void);
  */
 uint32_t config_get_queue_size(void);
 
+/**
+ * Get log buffer size in kilobytes
+ * @return Configured log arena byte budget in KB
+ */
+uint32_t config_get_buffer_size_kb(void);
+
 /**
  * Get HTTP timeout in seconds
  * @return Configured HTTP timeout
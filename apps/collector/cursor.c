@@ -0,0 +1,121 @@
+#include "cursor.h"
+#include "core/console.h"
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static Console csl = {
+    .topic = "cursor",
+};
+
+#define BOOT_ID_PATH "/proc/sys/kernel/random/boot_id"
+
+/**
+ * Read the id of the running boot, "-" if the kernel does not provide one
+ */
+static void read_boot_id(char *boot_id, size_t size) {
+    FILE *file = fopen(BOOT_ID_PATH, "r");
+
+    snprintf(boot_id, size, "-");
+    if (!file) {
+        return;
+    }
+
+    if (fgets(boot_id, (int)size, file)) {
+        boot_id[strcspn(boot_id, "\n")] = '\0';
+    }
+    fclose(file);
+}
+
+/**
+ * Create the directory holding the cursor file
+ */
+static void make_parent_dir(const char *path) {
+    char dir[sizeof(((log_cursor_t *)0)->path)];
+    char *slash;
+
+    snprintf(dir, sizeof(dir), "%s", path);
+    slash = strrchr(dir, '/');
+    if (!slash || slash == dir) {
+        return;
+    }
+
+    *slash = '\0';
+    if (mkdir(dir, 0700) < 0 && errno != EEXIST) {
+        console_warn(&csl, "Failed to create %s: %s", dir, strerror(errno));
+    }
+}
+
+int cursor_load(log_cursor_t *cursor, const char *path) {
+    char boot_id[CURSOR_BOOT_ID_SIZE];
+    unsigned int id;
+    unsigned long long time;
+
+    memset(cursor, 0, sizeof(*cursor));
+    read_boot_id(cursor->boot_id, sizeof(cursor->boot_id));
+
+    if (!path || !path[0]) {
+        return 0;
+    }
+    snprintf(cursor->path, sizeof(cursor->path), "%s", path);
+
+    FILE *file = fopen(cursor->path, "r");
+    if (!file) {
+        return errno == ENOENT ? 0 : -errno;
+    }
+
+    int fields = fscanf(file, "%39s %u %llu", boot_id, &id, &time);
+    fclose(file);
+    if (fields != 3) {
+        console_warn(&csl, "Ignoring malformed cursor file %s", cursor->path);
+        return -EINVAL;
+    }
+
+    // logd starts numbering over on every boot
+    if (strcmp(boot_id, cursor->boot_id) != 0) {
+        console_info(&csl, "Cursor in %s is from an earlier boot, reading the whole log buffer", cursor->path);
+        return 0;
+    }
+
+    cursor->id = id;
+    cursor->time = time;
+    cursor->valid = true;
+    console_info(&csl, "Resuming after logd record %u", cursor->id);
+    return 0;
+}
+
+int cursor_save(log_cursor_t *cursor) {
+    char tmp_path[sizeof(cursor->path) + 8];
+
+    if (!cursor->path[0] || !cursor->dirty || !cursor->valid) {
+        return 0;
+    }
+
+    make_parent_dir(cursor->path);
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", cursor->path);
+
+    FILE *file = fopen(tmp_path, "w");
+    if (!file) {
+        return -errno;
+    }
+
+    fprintf(file, "%s %u %llu\n", cursor->boot_id, cursor->id,
+            (unsigned long long)cursor->time);
+    if (fclose(file) != 0 || rename(tmp_path, cursor->path) < 0) {
+        int ret = -errno;
+        unlink(tmp_path);
+        return ret;
+    }
+
+    cursor->dirty = false;
+    return 0;
+}
+
+void cursor_advance(log_cursor_t *cursor, uint32_t id, uint64_t time) {
+    cursor->id = id;
+    cursor->time = time;
+    cursor->valid = true;
+    cursor->dirty = true;
+}
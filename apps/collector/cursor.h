@@ -0,0 +1,58 @@
+#ifndef CURSOR_H
+#define CURSOR_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define CURSOR_BOOT_ID_SIZE 40 // UUID from /proc/sys/kernel/random/boot_id plus NUL
+
+/**
+ * Position in the logd stream up to which records were processed
+ * logd numbers records from 0 when it starts, so the cursor is only
+ * meaningful within the boot it was written in. The timestamp of the
+ * record tells a logd restart (ids start over, times do not) from a record
+ * that was seen before.
+ */
+typedef struct log_cursor {
+    char path[128];                     // Cursor file, empty if not persisted
+    char boot_id[CURSOR_BOOT_ID_SIZE];  // Boot the id belongs to
+    uint32_t id;                        // Id of the last processed record
+    uint64_t time;                      // Timestamp of that record (ms)
+    bool valid;                         // A record was processed in this boot
+    bool dirty;                         // Changed since the last save
+} log_cursor_t;
+
+/**
+ * Load the cursor file
+ * A missing file or one written in an earlier boot leaves the cursor empty.
+ * @param cursor Cursor to initialize
+ * @param path Cursor file, NULL or empty to keep the cursor in memory only
+ * @return 0 on success (including a missing file), negative error code on failure
+ */
+int cursor_load(log_cursor_t *cursor, const char *path);
+
+/**
+ * Write the cursor file if it changed
+ * The file is replaced atomically, a crash leaves the old or the new cursor.
+ * @return 0 on success, negative error code on failure
+ */
+int cursor_save(log_cursor_t *cursor);
+
+/**
+ * Move the cursor to a processed record
+ */
+void cursor_advance(log_cursor_t *cursor, uint32_t id, uint64_t time);
+
+/**
+ * Check if a record is at or below a resume point
+ * Records of a restarted logd reuse old ids with later times and do not count as seen.
+ * @param id Resume point id
+ * @param time Resume point timestamp
+ * @param record_id Record id
+ * @param record_time Record timestamp
+ */
+static inline bool cursor_covers(uint32_t id, uint64_t time, uint32_t record_id, uint64_t record_time) {
+    return record_id <= id && record_time <= time;
+}
+
+#endif // CURSOR_H
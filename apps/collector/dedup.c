@@ -0,0 +1,80 @@
+#include "dedup.h"
+#include <string.h>
+
+#define FNV_OFFSET 0xcbf29ce484222325ULL
+#define FNV_PRIME 0x100000001b3ULL
+
+void dedup_init(dedup_table_t *table, uint32_t window) {
+    memset(table, 0, sizeof(*table));
+    table->window = window;
+}
+
+void dedup_reset(dedup_table_t *table) { memset(table->entries, 0, sizeof(table->entries)); }
+
+uint64_t dedup_hash(const char *msg, size_t len, uint32_t source, uint32_t priority) {
+    uint64_t hash = FNV_OFFSET ^ ((uint64_t)source << 32 | priority);
+
+    for (size_t i = 0; i < len; i++) {
+        hash ^= (uint8_t)msg[i];
+        hash *= FNV_PRIME;
+    }
+
+    return hash ? hash : 1;
+}
+
+bool dedup_collapse(dedup_table_t *table, uint64_t hash, const char *msg, size_t len, uint32_t source,
+                    uint32_t priority, uint64_t time) {
+    if (!table->window) {
+        return false;
+    }
+
+    for (uint32_t i = 0; i < DEDUP_PROBE; i++) {
+        dedup_entry_t *entry = &table->entries[(hash + i) & (DEDUP_TABLE_SIZE - 1)];
+
+        if (entry->hash != hash || entry->source != source || entry->priority != priority) {
+            continue;
+        }
+
+        log_record_t *record = log_arena_queued(entry->arena, entry->offset, entry->seq);
+        if (!record) {
+            // Already claimed by a batch, the next occurrence starts a new record
+            entry->hash = 0;
+            return false;
+        }
+
+        if (time < record->time || time - record->time > table->window || record->repeats == UINT32_MAX ||
+            record->msg_len != len || memcmp(record->msg, msg, len) != 0) {
+            return false;
+        }
+
+        record->repeats++;
+        record->last_delta = (uint32_t)(time - record->time);
+        table->collapsed++;
+        return true;
+    }
+
+    return false;
+}
+
+void dedup_remember(dedup_table_t *table, const log_arena_t *arena, uint64_t hash, const log_record_t *record) {
+    if (!table->window) {
+        return;
+    }
+
+    // Take an empty or stale slot, otherwise replace the first one probed
+    dedup_entry_t *slot = &table->entries[hash & (DEDUP_TABLE_SIZE - 1)];
+    for (uint32_t i = 0; i < DEDUP_PROBE; i++) {
+        dedup_entry_t *entry = &table->entries[(hash + i) & (DEDUP_TABLE_SIZE - 1)];
+        if (!entry->hash || entry->hash == hash || !log_arena_queued(entry->arena, entry->offset, entry->seq)) {
+            slot = entry;
+            break;
+        }
+    }
+
+    slot->hash = hash;
+    slot->arena = arena;
+    slot->seq = arena->committed - 1;
+    slot->offset = (uint32_t)((const uint8_t *)record - arena->buf);
+    slot->source = record->source;
+    slot->priority = record->priority;
+}
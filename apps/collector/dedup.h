@@ -0,0 +1,79 @@
+#ifndef DEDUP_H
+#define DEDUP_H
+
+#include "log_arena.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define DEDUP_TABLE_SIZE 256 // Entries, power of two
+#define DEDUP_PROBE 4        // Slots searched per lookup
+
+/**
+ * Recently enqueued record, identified by its arena position
+ */
+typedef struct dedup_entry {
+    uint64_t hash;            // Hash of source, priority and message, 0 for an empty slot
+    const log_arena_t *arena; // Arena (priority lane) holding the record
+    uint64_t seq;             // Arena sequence number of the record
+    uint32_t offset;
+    uint32_t source;
+    uint32_t priority;
+} dedup_entry_t;
+
+/**
+ * Table of recent messages used to collapse repeats
+ * A repeat of a message whose record is still queued within the window is
+ * counted on that record (repeat count and last timestamp) instead of taking
+ * a new one. Once the record was claimed by a batch, the next repeat starts a
+ * new record.
+ */
+typedef struct dedup_table {
+    dedup_entry_t entries[DEDUP_TABLE_SIZE];
+    uint32_t window;    // Collapse window in log timestamp units (ms), 0 disables
+    uint64_t collapsed; // Messages counted on an earlier record
+} dedup_table_t;
+
+/**
+ * Initialize the table
+ * @param table Table to initialize
+ * @param window Collapse window in log timestamp units (ms), 0 disables collapsing
+ */
+void dedup_init(dedup_table_t *table, uint32_t window);
+
+/**
+ * Hash a message for dedup_collapse() and dedup_remember()
+ * @return hash value (never 0)
+ */
+uint64_t dedup_hash(const char *msg, size_t len, uint32_t source, uint32_t priority);
+
+/**
+ * Try to count a message as a repeat of a queued record
+ * @param table Dedup table
+ * @param hash Message hash from dedup_hash()
+ * @param msg Message text
+ * @param len Message length
+ * @param source Log source
+ * @param priority Syslog priority
+ * @param time Log timestamp
+ * @return true if the message was collapsed and must not be enqueued
+ */
+bool dedup_collapse(dedup_table_t *table, uint64_t hash, const char *msg, size_t len, uint32_t source,
+                    uint32_t priority, uint64_t time);
+
+/**
+ * Remember the record that was just committed
+ * @param table Dedup table
+ * @param arena Arena the record was committed to
+ * @param hash Message hash from dedup_hash()
+ * @param record Committed record
+ */
+void dedup_remember(dedup_table_t *table, const log_arena_t *arena, uint64_t hash, const log_record_t *record);
+
+/**
+ * Forget all records (after the arena was reset)
+ * @param table Dedup table
+ */
+void dedup_reset(dedup_table_t *table);
+
+#endif // DEDUP_H
@@ -0,0 +1,356 @@
+#include "filter.h"
+#include "core/console.h"
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <syslog.h>
+
+static Console csl = {
+    .topic = "filter",
+};
+
+static const char *const level_names[] = {"emerg", "alert", "crit", "err", "warning", "notice", "info", "debug"};
+
+static const struct {
+    const char *name;
+    int facility;
+} facility_names[] = {
+    {"kern", 0},   {"user", 1},    {"mail", 2},    {"daemon", 3},  {"auth", 4},    {"syslog", 5},
+    {"lpr", 6},    {"news", 7},    {"uucp", 8},    {"cron", 9},    {"authpriv", 10}, {"ftp", 11},
+    {"local0", 16}, {"local1", 17}, {"local2", 18}, {"local3", 19}, {"local4", 20},   {"local5", 21},
+    {"local6", 22}, {"local7", 23},
+};
+
+/**
+ * Parse a small non-negative number, -1 if the string is not one
+ */
+static int parse_number(const char *str, int max) {
+    char *end;
+    long value = strtol(str, &end, 10);
+
+    if (!str[0] || *end != '\0' || value < 0 || value > max) {
+        return -1;
+    }
+    return (int)value;
+}
+
+void filter_rules_init(filter_rules_t *rules, int default_level) {
+    memset(rules, 0, sizeof(*rules));
+    rules->default_level = default_level;
+}
+
+int filter_rules_add(filter_rules_t *rules) {
+    if (rules->rule_count >= FILTER_MAX_RULES) {
+        return -ENOSPC;
+    }
+
+    filter_rule_t *rule = &rules->rules[rules->rule_count];
+    rule->source = FILTER_ANY;
+    rule->facility = FILTER_ANY;
+    rule->level = FILTER_ANY;
+    return (int)rules->rule_count++;
+}
+
+int filter_rules_add_pattern(filter_rules_t *rules, uint32_t rule, const char *pattern, uint16_t flags) {
+    size_t len = strlen(pattern);
+
+    if (rule >= rules->rule_count || len == 0) {
+        return -EINVAL;
+    }
+
+    if (rules->pattern_count >= FILTER_MAX_PATTERNS || rules->pool_used + len > sizeof(rules->pool)) {
+        return -ENOSPC;
+    }
+
+    filter_pattern_t *entry = &rules->patterns[rules->pattern_count++];
+    entry->rule = (uint16_t)rule;
+    entry->flags = flags;
+    entry->offset = (uint16_t)rules->pool_used;
+    entry->len = (uint16_t)len;
+
+    memcpy(rules->pool + rules->pool_used, pattern, len);
+    rules->pool_used += len;
+    return 0;
+}
+
+int filter_parse_level(const char *name) {
+    for (size_t i = 0; i < sizeof(level_names) / sizeof(level_names[0]); i++) {
+        if (strcasecmp(name, level_names[i]) == 0) {
+            return (int)i;
+        }
+    }
+
+    if (strcasecmp(name, "error") == 0) {
+        return LOG_ERR;
+    }
+    if (strcasecmp(name, "warn") == 0) {
+        return LOG_WARNING;
+    }
+
+    int level = parse_number(name, LOG_DEBUG);
+    return level >= 0 ? level : -EINVAL;
+}
+
+int filter_parse_facility(const char *name) {
+    if (strcmp(name, "*") == 0 || strcasecmp(name, "any") == 0) {
+        return FILTER_ANY;
+    }
+
+    for (size_t i = 0; i < sizeof(facility_names) / sizeof(facility_names[0]); i++) {
+        if (strcasecmp(name, facility_names[i].name) == 0) {
+            return facility_names[i].facility;
+        }
+    }
+
+    int facility = parse_number(name, 23);
+    return facility >= 0 ? facility : -EINVAL;
+}
+
+int filter_parse_source(const char *name) {
+    if (strcmp(name, "*") == 0 || strcasecmp(name, "any") == 0) {
+        return FILTER_ANY;
+    }
+    if (strcasecmp(name, "klog") == 0 || strcasecmp(name, "kernel") == 0) {
+        return FILTER_SOURCE_KLOG;
+    }
+    if (strcasecmp(name, "syslog") == 0) {
+        return FILTER_SOURCE_SYSLOG;
+    }
+    if (strcasecmp(name, "internal") == 0) {
+        return FILTER_SOURCE_INTERNAL;
+    }
+    if (strcasecmp(name, "remote") == 0) {
+        return FILTER_SOURCE_REMOTE;
+    }
+
+    int source = parse_number(name, 255);
+    return source >= 0 ? source : -EINVAL;
+}
+
+void filter_free(log_filter_t *filter) {
+    free(filter->next);
+    free(filter->out);
+    free(filter->dict);
+    free(filter->pattern_next);
+    filter->next = NULL;
+    filter->out = NULL;
+    filter->dict = NULL;
+    filter->pattern_next = NULL;
+    filter->state_count = 0;
+}
+
+/**
+ * Build the automaton for all patterns
+ */
+static int build_automaton(log_filter_t *filter, const filter_rules_t *rules) {
+    uint32_t max_states = 1;
+    int ret = -ENOMEM;
+
+    // Bytes that never occur in a pattern share class 0
+    memset(filter->byte_class, 0, sizeof(filter->byte_class));
+    filter->class_count = 1;
+    for (uint32_t p = 0; p < rules->pattern_count; p++) {
+        const uint8_t *str = (const uint8_t *)rules->pool + rules->patterns[p].offset;
+        for (uint32_t i = 0; i < rules->patterns[p].len; i++) {
+            if (!filter->byte_class[str[i]]) {
+                filter->byte_class[str[i]] = (uint8_t)filter->class_count++;
+            }
+        }
+        max_states += rules->patterns[p].len;
+    }
+
+    if (max_states > UINT16_MAX) {
+        return -E2BIG;
+    }
+
+    uint32_t classes = filter->class_count;
+    uint16_t *fail = calloc(max_states, sizeof(*fail));
+    uint16_t *queue = calloc(max_states, sizeof(*queue));
+    filter->next = calloc((size_t)max_states * classes, sizeof(*filter->next));
+    filter->out = malloc(max_states * sizeof(*filter->out));
+    filter->dict = calloc(max_states, sizeof(*filter->dict));
+    filter->pattern_next = malloc(rules->pattern_count * sizeof(*filter->pattern_next) + 1);
+    if (!fail || !queue || !filter->next || !filter->out || !filter->dict || !filter->pattern_next) {
+        goto out;
+    }
+
+    for (uint32_t s = 0; s < max_states; s++) {
+        filter->out[s] = -1;
+    }
+
+    // Trie of all patterns, transition 0 means "no child yet" (the root is never a child)
+    filter->state_count = 1;
+    for (uint32_t p = 0; p < rules->pattern_count; p++) {
+        const uint8_t *str = (const uint8_t *)rules->pool + rules->patterns[p].offset;
+        uint32_t state = 0;
+
+        for (uint32_t i = 0; i < rules->patterns[p].len; i++) {
+            uint16_t *slot = &filter->next[state * classes + filter->byte_class[str[i]]];
+            if (!*slot) {
+                *slot = (uint16_t)filter->state_count++;
+            }
+            state = *slot;
+        }
+
+        filter->pattern_next[p] = filter->out[state];
+        filter->out[state] = (int16_t)p;
+    }
+
+    // Breadth-first: failure links, dictionary links and the remaining DFA transitions
+    uint32_t head = 0, tail = 0;
+    for (uint32_t c = 0; c < classes; c++) {
+        uint16_t child = filter->next[c];
+        if (child) {
+            fail[child] = 0;
+            queue[tail++] = child;
+        }
+    }
+
+    while (head < tail) {
+        uint16_t state = queue[head++];
+        uint16_t link = fail[state];
+
+        filter->dict[state] = filter->out[link] >= 0 ? link : filter->dict[link];
+
+        for (uint32_t c = 0; c < classes; c++) {
+            uint16_t *slot = &filter->next[state * classes + c];
+            uint16_t fallback = filter->next[link * classes + c];
+            if (*slot) {
+                fail[*slot] = fallback;
+                queue[tail++] = *slot;
+            } else {
+                *slot = fallback;
+            }
+        }
+    }
+
+    ret = 0;
+
+out:
+    free(fail);
+    free(queue);
+    if (ret < 0) {
+        filter_free(filter);
+    }
+    return ret;
+}
+
+int filter_compile(log_filter_t *filter, const filter_rules_t *rules) {
+    memset(filter, 0, sizeof(*filter));
+
+    filter->default_level = rules->default_level;
+    filter->rule_count = rules->rule_count;
+    memcpy(filter->rules, rules->rules, sizeof(filter->rules));
+    filter->pattern_count = rules->pattern_count;
+    memcpy(filter->patterns, rules->patterns, sizeof(filter->patterns));
+
+    for (uint32_t p = 0; p < rules->pattern_count; p++) {
+        uint32_t bit = 1U << rules->patterns[p].rule;
+        filter->pattern_rules |= bit;
+        if (rules->patterns[p].flags & FILTER_PATTERN_INCLUDE) {
+            filter->include_rules |= bit;
+        } else {
+            filter->exclude_rules |= bit;
+        }
+    }
+
+    int ret = build_automaton(filter, rules);
+    if (ret < 0) {
+        // Keep the severity thresholds working without patterns
+        console_error(&csl, "Failed to compile %u filter patterns: %d", rules->pattern_count, ret);
+        filter->pattern_count = 0;
+        filter->pattern_rules = 0;
+        filter->include_rules = 0;
+        filter->exclude_rules = 0;
+        return ret;
+    }
+
+    console_info(&csl, "Compiled %u filter rules with %u patterns (%u states, %u byte classes)", filter->rule_count,
+                 filter->pattern_count, filter->state_count, filter->class_count);
+    return 0;
+}
+
+/**
+ * Run the automaton over a message
+ * @return 1 if an include pattern matched, -1 if an exclude pattern matched, 0 otherwise
+ */
+static int match_patterns(const log_filter_t *filter, const uint8_t *msg, size_t len, uint32_t rules) {
+    uint32_t classes = filter->class_count;
+    uint32_t state = 0;
+    int result = 0;
+
+    for (size_t i = 0; i < len; i++) {
+        state = filter->next[state * classes + filter->byte_class[msg[i]]];
+
+        for (uint32_t hit = filter->out[state] >= 0 ? state : filter->dict[state]; hit; hit = filter->dict[hit]) {
+            for (int p = filter->out[hit]; p >= 0; p = filter->pattern_next[p]) {
+                const filter_pattern_t *pattern = &filter->patterns[p];
+
+                if (!(rules & (1U << pattern->rule))) {
+                    continue;
+                }
+                if ((pattern->flags & FILTER_PATTERN_PREFIX) && i + 1 != pattern->len) {
+                    continue;
+                }
+                if (!(pattern->flags & FILTER_PATTERN_INCLUDE)) {
+                    return -1;
+                }
+                result = 1;
+            }
+        }
+    }
+
+    return result;
+}
+
+bool filter_accept(log_filter_t *filter, const char *msg, size_t len, uint32_t priority, uint32_t source) {
+    int severity = LOG_PRI(priority);
+    int facility = (int)((priority & LOG_FACMASK) >> 3);
+    int level = filter->default_level;
+    int best = -1;
+    uint32_t rules = 0;
+
+    // Rules that apply to the message; the most specific one sets the threshold
+    for (uint32_t r = 0; r < filter->rule_count; r++) {
+        const filter_rule_t *rule = &filter->rules[r];
+
+        if ((rule->source != FILTER_ANY && rule->source != (int)source) ||
+            (rule->facility != FILTER_ANY && rule->facility != facility)) {
+            continue;
+        }
+
+        rules |= 1U << r;
+
+        int specificity = (rule->source != FILTER_ANY) + 2 * (rule->facility != FILTER_ANY);
+        if (rule->level != FILTER_ANY && specificity >= best) {
+            best = specificity;
+            level = rule->level;
+        }
+    }
+
+    bool below = severity > level;
+
+    // Only scan the message if a pattern could change the outcome
+    if ((below && !(rules & filter->include_rules)) || (!below && !(rules & filter->exclude_rules))) {
+        if (below) {
+            filter->stats.dropped_level++;
+            return false;
+        }
+        filter->stats.accepted++;
+        return true;
+    }
+
+    int match = match_patterns(filter, (const uint8_t *)msg, len, rules);
+    if (match < 0) {
+        filter->stats.dropped_pattern++;
+        return false;
+    }
+    if (below && match == 0) {
+        filter->stats.dropped_level++;
+        return false;
+    }
+
+    filter->stats.accepted++;
+    return true;
+}
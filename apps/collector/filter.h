@@ -0,0 +1,161 @@
+#ifndef FILTER_H
+#define FILTER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define FILTER_MAX_RULES 32
+#define FILTER_MAX_PATTERNS 256
+#define FILTER_POOL_SIZE 8192 // Bytes for all pattern strings together
+#define FILTER_ANY (-1)
+
+// Pattern flags
+#define FILTER_PATTERN_INCLUDE 0x1 // Keep matching messages (otherwise drop them)
+#define FILTER_PATTERN_PREFIX 0x2  // Match at the start of the message only
+
+// logd message sources
+#define FILTER_SOURCE_KLOG 0
+#define FILTER_SOURCE_SYSLOG 1
+#define FILTER_SOURCE_INTERNAL 2
+#define FILTER_SOURCE_REMOTE 3 // Received by the syslog listener, not a logd source
+
+/**
+ * Filter rule selecting messages by source and facility
+ */
+typedef struct filter_rule {
+    int source;   // logd source or FILTER_ANY
+    int facility; // Syslog facility number or FILTER_ANY
+    int level;    // Keep messages up to this severity, FILTER_ANY to inherit
+} filter_rule_t;
+
+/**
+ * Include or exclude pattern belonging to a rule
+ */
+typedef struct filter_pattern {
+    uint16_t rule;
+    uint16_t flags;
+    uint16_t offset; // Into filter_rules_t.pool
+    uint16_t len;
+} filter_pattern_t;
+
+/**
+ * Filter rules as loaded from the configuration
+ */
+typedef struct filter_rules {
+    int default_level; // Severity threshold for messages no rule sets one for
+    filter_rule_t rules[FILTER_MAX_RULES];
+    uint32_t rule_count;
+    filter_pattern_t patterns[FILTER_MAX_PATTERNS];
+    uint32_t pattern_count;
+    char pool[FILTER_POOL_SIZE];
+    uint32_t pool_used;
+} filter_rules_t;
+
+/**
+ * Filter statistics
+ */
+typedef struct filter_stats {
+    uint64_t accepted;
+    uint64_t dropped_level;   // Below the severity threshold
+    uint64_t dropped_pattern; // Matched an exclude pattern
+} filter_stats_t;
+
+/**
+ * Compiled filter
+ * All patterns are compiled into one Aho-Corasick automaton, expanded to a
+ * DFA over the byte classes that occur in patterns, so a message is matched
+ * against every pattern in a single pass with one table lookup per byte.
+ */
+typedef struct log_filter {
+    filter_rule_t rules[FILTER_MAX_RULES];
+    uint32_t rule_count;
+    int default_level;
+
+    filter_pattern_t patterns[FILTER_MAX_PATTERNS];
+    uint32_t pattern_count;
+    uint32_t pattern_rules; // Rules with at least one pattern
+    uint32_t include_rules; // Rules with include patterns
+    uint32_t exclude_rules; // Rules with exclude patterns
+
+    uint8_t byte_class[256];
+    uint32_t class_count;
+    uint32_t state_count;
+    uint16_t *next;          // DFA transitions, state_count * class_count
+    int16_t *out;            // First pattern ending in a state, -1 if none
+    uint16_t *dict;          // Next state on the failure chain with output, 0 if none
+    int16_t *pattern_next;   // Next pattern ending in the same state, -1 if none
+
+    filter_stats_t stats;
+} log_filter_t;
+
+/**
+ * Initialize an empty rule set
+ * @param rules Rule set to initialize
+ * @param default_level Default severity threshold
+ */
+void filter_rules_init(filter_rules_t *rules, int default_level);
+
+/**
+ * Add a rule
+ * @param rules Rule set
+ * @return index of the new rule, or negative error code if the rule table is full
+ */
+int filter_rules_add(filter_rules_t *rules);
+
+/**
+ * Add a pattern to a rule
+ * @param rules Rule set
+ * @param rule Rule index
+ * @param pattern Pattern string (not empty)
+ * @param flags FILTER_PATTERN_* flags
+ * @return 0 on success, negative error code on failure
+ */
+int filter_rules_add_pattern(filter_rules_t *rules, uint32_t rule, const char *pattern, uint16_t flags);
+
+/**
+ * Parse a severity name ("err", "warning", ...) or number
+ * @return severity (0-7) or negative error code
+ */
+int filter_parse_level(const char *name);
+
+/**
+ * Parse a facility name ("daemon", "local0", ...), number or "*"
+ * @return facility number, FILTER_ANY, or negative error code below FILTER_ANY
+ */
+int filter_parse_facility(const char *name);
+
+/**
+ * Parse a source name ("klog", "syslog", "internal", "remote"), number or "*"
+ * @return source, FILTER_ANY, or negative error code below FILTER_ANY
+ */
+int filter_parse_source(const char *name);
+
+/**
+ * Compile rules into a filter
+ * @param filter Filter to build
+ * @param rules Rules to compile (may be freed afterwards)
+ * @return 0 on success, negative error code on failure (the filter then applies severity thresholds only)
+ */
+int filter_compile(log_filter_t *filter, const filter_rules_t *rules);
+
+/**
+ * Release the compiled automaton
+ * @param filter Filter to free (safe to call on a zeroed filter)
+ */
+void filter_free(log_filter_t *filter);
+
+/**
+ * Decide whether a message is kept
+ * Exclude patterns win over include patterns, and include patterns keep
+ * a message even if it is below the severity threshold.
+ * @param filter Compiled filter
+ * @param msg Message text
+ * @param len Message length
+ * @param priority Syslog priority (facility and severity)
+ * @param source logd source
+ * @return true if the message should be collected
+ */
+bool filter_accept(log_filter_t *filter, const char *msg, size_t len, uint32_t priority, uint32_t source);
+
+#endif // FILTER_H
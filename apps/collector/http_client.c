@@ -0,0 +1,291 @@
+#include "http_client.h"
+#include "config.h"
+#include "core/console.h"
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <libubox/uloop.h>
+
+static Console csl = {
+    .topic = "http",
+};
+
+/**
+ * Socket registered with uloop on behalf of curl
+ */
+typedef struct http_socket {
+    struct uloop_fd fd;
+    curl_socket_t sockfd;
+} http_socket_t;
+
+static CURLM *multi_handle = NULL;
+static struct uloop_timeout multi_timer;
+static int active_transfers = 0;
+
+static void check_multi_info(void);
+
+/**
+ * Discard response bodies, we only care about the status code
+ */
+static size_t discard_body_cb(void *contents, size_t size, size_t nmemb, void *userp) { return size * nmemb; }
+
+/**
+ * Socket activity reported by uloop
+ */
+static void socket_event_cb(struct uloop_fd *u, unsigned int events) {
+    http_socket_t *sock = container_of(u, http_socket_t, fd);
+    int action = 0;
+    int running;
+
+    if (events & ULOOP_READ) action |= CURL_CSELECT_IN;
+    if (events & ULOOP_WRITE) action |= CURL_CSELECT_OUT;
+    if (u->error) action |= CURL_CSELECT_ERR;
+
+    curl_multi_socket_action(multi_handle, sock->sockfd, action, &running);
+    check_multi_info();
+}
+
+/**
+ * Curl asks us to watch (or stop watching) a socket
+ */
+static int socket_cb(CURL *easy, curl_socket_t s, int what, void *userp, void *socketp) {
+    http_socket_t *sock = socketp;
+
+    if (what == CURL_POLL_REMOVE) {
+        if (sock) {
+            uloop_fd_delete(&sock->fd);
+            curl_multi_assign(multi_handle, s, NULL);
+            free(sock);
+        }
+        return 0;
+    }
+
+    if (!sock) {
+        sock = calloc(1, sizeof(*sock));
+        if (!sock) {
+            console_error(&csl, "Failed to allocate socket watcher");
+            return -1;
+        }
+        sock->sockfd = s;
+        sock->fd.fd = s;
+        sock->fd.cb = socket_event_cb;
+        curl_multi_assign(multi_handle, s, sock);
+    }
+
+    unsigned int flags = 0;
+    if (what == CURL_POLL_IN || what == CURL_POLL_INOUT) flags |= ULOOP_READ;
+    if (what == CURL_POLL_OUT || what == CURL_POLL_INOUT) flags |= ULOOP_WRITE;
+
+    uloop_fd_add(&sock->fd, flags);
+    return 0;
+}
+
+/**
+ * Curl timeout expired
+ */
+static void multi_timer_cb(struct uloop_timeout *timeout) {
+    int running;
+
+    curl_multi_socket_action(multi_handle, CURL_SOCKET_TIMEOUT, 0, &running);
+    check_multi_info();
+}
+
+/**
+ * Curl asks us to (re)arm its single timeout
+ */
+static int timer_cb(CURLM *multi, long timeout_ms, void *userp) {
+    if (timeout_ms < 0) {
+        uloop_timeout_cancel(&multi_timer);
+    } else {
+        // Never call back into curl from here, let uloop fire the timer instead
+        uloop_timeout_set(&multi_timer, (int)timeout_ms);
+    }
+    return 0;
+}
+
+/**
+ * Reap completed transfers and notify their owners
+ */
+static void check_multi_info(void) {
+    CURLMsg *msg;
+    int pending;
+
+    while ((msg = curl_multi_info_read(multi_handle, &pending))) {
+        if (msg->msg != CURLMSG_DONE) {
+            continue;
+        }
+
+        CURL *easy = msg->easy_handle;
+        CURLcode result = msg->data.result;
+        http_request_t *request = NULL;
+
+        curl_easy_getinfo(easy, CURLINFO_PRIVATE, (char **)&request);
+        curl_multi_remove_handle(multi_handle, easy);
+        active_transfers--;
+
+        if (!request) {
+            continue;
+        }
+
+        struct timespec end_time;
+        clock_gettime(CLOCK_MONOTONIC, &end_time);
+
+        http_response_t response = {
+            .curl_code = result,
+            .status_code = 0,
+            .duration_ms = (end_time.tv_sec - request->start_time.tv_sec) * 1000.0 +
+                           (end_time.tv_nsec - request->start_time.tv_nsec) / 1000000.0,
+            .error = request->error_buffer[0] ? request->error_buffer : curl_easy_strerror(result),
+        };
+
+        if (result == CURLE_OK) {
+            curl_easy_getinfo(easy, CURLINFO_RESPONSE_CODE, &response.status_code);
+
+            // curl parses both the delay-seconds and the HTTP-date form
+            curl_off_t retry_after = 0;
+            if (curl_easy_getinfo(easy, CURLINFO_RETRY_AFTER, &retry_after) == CURLE_OK && retry_after > 0) {
+                response.retry_after_s = (long)retry_after;
+            }
+        }
+
+        if (request->headers) {
+            curl_slist_free_all(request->headers);
+            request->headers = NULL;
+        }
+        request->in_flight = false;
+
+        if (request->complete_cb) {
+            request->complete_cb(request, &response);
+        }
+    }
+}
+
+int http_client_init(void) {
+    if (curl_global_init(CURL_GLOBAL_DEFAULT) != CURLE_OK) {
+        console_error(&csl, "Failed to initialize CURL");
+        return -1;
+    }
+
+    multi_handle = curl_multi_init();
+    if (!multi_handle) {
+        console_error(&csl, "Failed to initialize CURL multi handle");
+        curl_global_cleanup();
+        return -1;
+    }
+
+    curl_multi_setopt(multi_handle, CURLMOPT_SOCKETFUNCTION, socket_cb);
+    curl_multi_setopt(multi_handle, CURLMOPT_TIMERFUNCTION, timer_cb);
+
+    // Let concurrent batch uploads share one HTTP/2 connection when the backend supports it
+    curl_multi_setopt(multi_handle, CURLMOPT_PIPELINING, CURLPIPE_MULTIPLEX);
+
+    memset(&multi_timer, 0, sizeof(multi_timer));
+    multi_timer.cb = multi_timer_cb;
+    active_transfers = 0;
+
+    console_debug(&csl, "HTTP client initialized");
+    return 0;
+}
+
+void http_client_cleanup(void) {
+    uloop_timeout_cancel(&multi_timer);
+
+    if (multi_handle) {
+        curl_multi_cleanup(multi_handle);
+        multi_handle = NULL;
+    }
+
+    active_transfers = 0;
+    curl_global_cleanup();
+}
+
+int http_client_post(http_request_t *request,
+                     const char *url,
+                     struct curl_slist *headers,
+                     const char *body,
+                     size_t body_size,
+                     http_complete_cb cb) {
+    if (!multi_handle || !request || !url || !body) {
+        curl_slist_free_all(headers);
+        return -EINVAL;
+    }
+
+    if (request->in_flight) {
+        curl_slist_free_all(headers);
+        return -EBUSY;
+    }
+
+    if (!request->easy) {
+        request->easy = curl_easy_init();
+        if (!request->easy) {
+            console_error(&csl, "Failed to initialize CURL easy handle");
+            curl_slist_free_all(headers);
+            return -ENOMEM;
+        }
+    }
+
+    CURL *easy = request->easy;
+    request->error_buffer[0] = '\0';
+    request->headers = headers;
+    request->complete_cb = cb;
+
+    curl_easy_setopt(easy, CURLOPT_PRIVATE, request);
+    curl_easy_setopt(easy, CURLOPT_ERRORBUFFER, request->error_buffer);
+    curl_easy_setopt(easy, CURLOPT_NOSIGNAL, 1L);
+    curl_easy_setopt(easy, CURLOPT_TIMEOUT, (long)config_get_http_timeout());
+    curl_easy_setopt(easy, CURLOPT_CONNECTTIMEOUT, 10L);
+    curl_easy_setopt(easy, CURLOPT_FOLLOWLOCATION, 1L);
+    curl_easy_setopt(easy, CURLOPT_PIPEWAIT, 1L);
+    curl_easy_setopt(easy, CURLOPT_SSL_VERIFYPEER, 1L);
+    curl_easy_setopt(easy, CURLOPT_SSL_VERIFYHOST, 2L);
+    curl_easy_setopt(easy, CURLOPT_WRITEFUNCTION, discard_body_cb);
+    curl_easy_setopt(easy, CURLOPT_URL, url);
+    curl_easy_setopt(easy, CURLOPT_POSTFIELDS, body);
+    curl_easy_setopt(easy, CURLOPT_POSTFIELDSIZE_LARGE, (curl_off_t)body_size);
+    curl_easy_setopt(easy, CURLOPT_HTTPHEADER, headers);
+
+    clock_gettime(CLOCK_MONOTONIC, &request->start_time);
+
+    CURLMcode mc = curl_multi_add_handle(multi_handle, easy);
+    if (mc != CURLM_OK) {
+        console_error(&csl, "Failed to add transfer: %s", curl_multi_strerror(mc));
+        curl_slist_free_all(request->headers);
+        request->headers = NULL;
+        return -1;
+    }
+
+    request->in_flight = true;
+    active_transfers++;
+    return 0;
+}
+
+void http_client_abort(http_request_t *request) {
+    if (!request || !request->in_flight) {
+        return;
+    }
+
+    curl_multi_remove_handle(multi_handle, request->easy);
+    active_transfers--;
+    request->in_flight = false;
+
+    if (request->headers) {
+        curl_slist_free_all(request->headers);
+        request->headers = NULL;
+    }
+}
+
+void http_client_release(http_request_t *request) {
+    if (!request) {
+        return;
+    }
+
+    http_client_abort(request);
+
+    if (request->easy) {
+        curl_easy_cleanup(request->easy);
+        request->easy = NULL;
+    }
+}
+
+int http_client_active_count(void) { return active_transfers; }
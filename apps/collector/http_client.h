@@ -0,0 +1,91 @@
+#ifndef HTTP_CLIENT_H
+#define HTTP_CLIENT_H
+
+#include <curl/curl.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <time.h>
+
+/**
+ * Outcome of a completed HTTP request
+ */
+typedef struct http_response {
+    CURLcode curl_code; // CURLE_OK if the transfer itself succeeded
+    long status_code;   // HTTP status code (0 if no response was received)
+    double duration_ms; // Wall time from dispatch to completion
+    long retry_after_s; // Retry-After header in seconds (delay or date), 0 if absent
+    const char *error;  // Human readable curl error (valid during callback only)
+} http_response_t;
+
+struct http_request;
+
+/**
+ * Completion callback, invoked from the uloop context once the transfer finished
+ * The request may be reused (or re-posted) from within the callback
+ */
+typedef void (*http_complete_cb)(struct http_request *request, const http_response_t *response);
+
+/**
+ * A single asynchronous HTTP request
+ * Owned by the caller and must stay valid until the completion callback fired.
+ * The underlying easy handle is kept between requests so connections are reused.
+ */
+typedef struct http_request {
+    CURL *easy;
+    struct curl_slist *headers;
+    char error_buffer[CURL_ERROR_SIZE];
+    struct timespec start_time;
+    bool in_flight;
+    http_complete_cb complete_cb;
+    void *priv;
+} http_request_t;
+
+/**
+ * Initialize the curl multi handle and hook it into uloop
+ * @return 0 on success, negative error code on failure
+ */
+int http_client_init(void);
+
+/**
+ * Abort all transfers and release the multi handle
+ */
+void http_client_cleanup(void);
+
+/**
+ * Start an asynchronous POST request
+ * Takes ownership of the header list, which is freed once the request completes.
+ * The body must stay valid until the completion callback fired.
+ * @param request Caller owned request slot (must not be in flight)
+ * @param url Target URL
+ * @param headers Request headers (ownership transferred)
+ * @param body Request body
+ * @param body_size Size of the request body
+ * @param cb Completion callback
+ * @return 0 if the request was dispatched, negative error code on failure
+ */
+int http_client_post(http_request_t *request,
+                     const char *url,
+                     struct curl_slist *headers,
+                     const char *body,
+                     size_t body_size,
+                     http_complete_cb cb);
+
+/**
+ * Abort an in-flight request without invoking its completion callback
+ * @param request Request to abort
+ */
+void http_client_abort(http_request_t *request);
+
+/**
+ * Release the resources held by a request slot
+ * @param request Request to release (aborted first if still in flight)
+ */
+void http_client_release(http_request_t *request);
+
+/**
+ * Get number of requests currently in flight
+ * @return number of active transfers
+ */
+int http_client_active_count(void);
+
+#endif // HTTP_CLIENT_H
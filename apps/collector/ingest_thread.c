@@ -0,0 +1,496 @@
+#include "ingest_thread.h"
+#include "core/console.h"
+#include "spsc_ring.h"
+#include <errno.h>
+#include <libubox/uloop.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+static Console csl = {
+    .topic = "ingest",
+};
+
+#define INGEST_READ_SIZE 65536         // Read buffer, holds any logd record
+#define INGEST_STACK_SIZE (128 * 1024) // The thread only parses and filters
+
+enum {
+    INGEST_MSG_LOG,    // A record that passed the filter
+    INGEST_MSG_COUNTS, // Counter deltas
+};
+
+/**
+ * Record copied into the ring
+ */
+typedef struct ingest_msg {
+    uint32_t type;
+    uint32_t msg_len;  // Message length without the terminating NUL
+    uint32_t priority; // Raw syslog priority (facility | severity)
+    uint32_t source;   // Raw log source (klog, syslog, etc)
+    uint32_t id;       // logd record id
+    uint32_t reserved;
+    uint64_t time;     // Raw timestamp from log system
+    char msg[];        // NUL-terminated message
+} ingest_msg_t;
+
+typedef struct ingest_counts_msg {
+    uint32_t type;
+    uint32_t reserved;
+    ingest_thread_counts_t counts;
+} ingest_counts_msg_t;
+
+/**
+ * Reader thread state
+ * The ring, the descriptors and the ops are set up before the thread starts
+ * and torn down after it was joined. While it runs, the filter, the read
+ * buffer and the counters belong to the thread; the loop only touches the
+ * consumer side of the ring and the atomics.
+ */
+static struct {
+    bool running; // Loop side: a thread was started and not joined yet
+    pthread_t thread;
+    int fd;               // Log stream
+    int stop_fd;          // eventfd, loop -> thread
+    struct uloop_fd wake; // eventfd, thread -> loop
+    spsc_ring_t ring;
+    const ingest_thread_ops_t *ops;
+
+    // Thread side
+    log_filter_t filter;
+    ingest_thread_counts_t counts; // Not reported yet, filter outcomes are counted in filter.stats
+    uint8_t *buf;
+    size_t buf_len;
+
+    // Shared, accessed atomically
+    log_filter_t *pending_filter; // Handed over by ingest_thread_set_filter()
+    int ended;                    // Set once the thread gave up the stream
+    int error;                    // 0 at EOF, negative error code on failure
+} ingest = {
+    .fd = -1,
+    .stop_fd = -1,
+    .wake = {.fd = -1},
+};
+
+/**
+ * Switch to a filter handed over by the loop
+ * The statistics not yet reported carry over to it.
+ */
+static void adopt_pending_filter(void) {
+    log_filter_t *staged = __atomic_exchange_n(&ingest.pending_filter, NULL, __ATOMIC_ACQ_REL);
+
+    if (!staged) {
+        return;
+    }
+
+    staged->stats = ingest.filter.stats;
+    filter_free(&ingest.filter);
+    ingest.filter = *staged;
+    free(staged);
+}
+
+/**
+ * Check if any counter changed since the last report
+ */
+static bool counts_pending(void) {
+    const filter_stats_t *filter = &ingest.filter.stats;
+
+    return filter->accepted || filter->dropped_level || filter->dropped_pattern || ingest.counts.generic_parsed ||
+           ingest.counts.ring_dropped || ingest.counts.skipped || ingest.counts.advanced;
+}
+
+/**
+ * Take the counter deltas since the last report
+ */
+static void take_counts(ingest_thread_counts_t *counts) {
+    *counts = ingest.counts;
+    counts->filter = ingest.filter.stats;
+    memset(&ingest.counts, 0, sizeof(ingest.counts));
+    memset(&ingest.filter.stats, 0, sizeof(ingest.filter.stats));
+}
+
+/**
+ * Report counters through the ring, they wait for a later read if it is full
+ */
+static bool push_counts(void) {
+    ingest_counts_msg_t *msg;
+
+    if (!counts_pending() || !(msg = spsc_ring_reserve(&ingest.ring, sizeof(*msg)))) {
+        return false;
+    }
+
+    msg->type = INGEST_MSG_COUNTS;
+    take_counts(&msg->counts);
+    spsc_ring_commit(&ingest.ring);
+    return true;
+}
+
+/**
+ * Copy a record that passed the filter into the ring
+ */
+static bool push_log(const log_data_t *log_data) {
+    ingest_msg_t *msg = spsc_ring_reserve(&ingest.ring, (uint32_t)(sizeof(*msg) + log_data->msg_len + 1));
+
+    if (!msg) {
+        ingest.counts.ring_dropped++;
+        return false;
+    }
+
+    msg->type = INGEST_MSG_LOG;
+    msg->msg_len = (uint32_t)log_data->msg_len;
+    msg->priority = log_data->priority;
+    msg->source = log_data->source;
+    msg->id = log_data->id;
+    msg->time = log_data->time;
+    memcpy(msg->msg, log_data->msg, log_data->msg_len);
+    msg->msg[log_data->msg_len] = '\0';
+    spsc_ring_commit(&ingest.ring);
+    return true;
+}
+
+/**
+ * Parse, filter and queue the complete records in the read buffer
+ * Stops early at a record the stream owner wants to hold back.
+ * @param delay_ms Set to the pause requested before the next record
+ * @return number of bytes consumed
+ */
+static size_t process_records(bool *pushed, uint32_t *delay_ms) {
+    size_t offset = 0;
+
+    while (ingest.buf_len - offset >= sizeof(struct blob_attr)) {
+        struct blob_attr *record = (struct blob_attr *)(ingest.buf + offset);
+        size_t len = blob_len(record) + sizeof(*record);
+        log_data_t log_data;
+        bool generic = false;
+
+        if (ingest.buf_len - offset < len) {
+            break;
+        }
+
+        if (ingest.ops->parse(record, &log_data, &generic)) {
+            if (ingest.ops->seen(&log_data)) {
+                ingest.counts.skipped++;
+                offset += len;
+                continue;
+            }
+
+            // The record is parsed again after the pause
+            if ((*delay_ms = ingest.ops->pace(&log_data)) > 0) {
+                break;
+            }
+
+            if (generic) {
+                ingest.counts.generic_parsed++;
+            }
+            if (filter_accept(&ingest.filter, log_data.msg, log_data.msg_len, log_data.priority,
+                              log_data.source) &&
+                push_log(&log_data)) {
+                *pushed = true;
+            }
+
+            ingest.counts.advanced = true;
+            ingest.counts.last_id = log_data.id;
+            ingest.counts.last_time = log_data.time;
+        }
+
+        offset += len;
+    }
+
+    return offset;
+}
+
+static void wake_loop(void) {
+    uint64_t one = 1;
+
+    if (write(ingest.wake.fd, &one, sizeof(one)) < 0) {
+        // Counter saturated, the loop is awake already
+    }
+}
+
+/**
+ * Thread body: read until EOF, an error or a stop request
+ * No console output here, the console is not thread safe; failures are
+ * reported to the loop through ingest.error.
+ */
+static void *ingest_thread_main(void *arg) {
+    struct pollfd fds[2] = {
+        {.fd = ingest.fd, .events = POLLIN},
+        {.fd = ingest.stop_fd, .events = POLLIN},
+    };
+    uint32_t delay_ms = 0;
+    int error = 0;
+
+    while (true) {
+        // While paced, only a stop request cuts the pause short and the
+        // records already buffered are processed before reading on
+        int nfds = delay_ms ? 1 : 2;
+        struct pollfd *wait = delay_ms ? &fds[1] : fds;
+
+        if (poll(wait, nfds, delay_ms ? (int)delay_ms : -1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            error = -errno;
+            break;
+        }
+
+        if (fds[1].revents) {
+            // Stopped by the loop, which takes care of the rest
+            return NULL;
+        }
+
+        adopt_pending_filter();
+
+        if (!delay_ms) {
+            ssize_t n = read(ingest.fd, ingest.buf + ingest.buf_len, INGEST_READ_SIZE - ingest.buf_len);
+            if (n < 0) {
+                if (errno == EINTR || errno == EAGAIN) {
+                    continue;
+                }
+                error = -errno;
+                break;
+            }
+            if (n == 0) {
+                break;
+            }
+            ingest.buf_len += (size_t)n;
+        }
+
+        bool pushed = false;
+        delay_ms = 0;
+        size_t consumed = process_records(&pushed, &delay_ms);
+        if (consumed == 0 && !delay_ms && ingest.buf_len == INGEST_READ_SIZE) {
+            error = -EMSGSIZE;
+            break;
+        }
+        ingest.buf_len -= consumed;
+        memmove(ingest.buf, ingest.buf + consumed, ingest.buf_len);
+
+        // One wakeup per read, however many records it carried
+        if (push_counts() || pushed) {
+            wake_loop();
+        }
+    }
+
+    push_counts();
+    __atomic_store_n(&ingest.error, error, __ATOMIC_RELAXED);
+    __atomic_store_n(&ingest.ended, 1, __ATOMIC_RELEASE);
+    wake_loop();
+    return NULL;
+}
+
+/**
+ * Deliver the ring contents, called from uloop
+ */
+/**
+ * Hand a message from the ring to the event loop hooks
+ */
+static void deliver_msg(const void *data) {
+    const ingest_msg_t *msg = data;
+
+    if (msg->type == INGEST_MSG_COUNTS) {
+        ingest.ops->counts(&((const ingest_counts_msg_t *)data)->counts);
+        return;
+    }
+
+    log_data_t log_data = {
+        .time = msg->time,
+        .priority = msg->priority,
+        .source = msg->source,
+        .id = msg->id,
+        .msg = msg->msg,
+        .msg_len = msg->msg_len,
+    };
+    ingest.ops->log(&log_data);
+}
+
+static void wake_cb(struct uloop_fd *fd, unsigned int events) {
+    uint64_t value;
+    const void *data;
+    uint32_t len;
+
+    if (read(fd->fd, &value, sizeof(value)) < 0) {
+        // Spurious wakeup, the ring is checked anyway
+    }
+
+    // Everything committed before the thread ended is visible after this
+    int ended = __atomic_load_n(&ingest.ended, __ATOMIC_ACQUIRE);
+
+    while ((data = spsc_ring_peek(&ingest.ring, &len))) {
+        deliver_msg(data);
+
+        // The hook may have stopped the stream, the ring is gone then
+        if (!ingest.running) {
+            return;
+        }
+        spsc_ring_release(&ingest.ring);
+    }
+
+    if (ended) {
+        ingest.ops->ended(__atomic_load_n(&ingest.error, __ATOMIC_RELAXED));
+    }
+}
+
+static void close_fd(int *fd) {
+    if (*fd >= 0) {
+        close(*fd);
+        *fd = -1;
+    }
+}
+
+/**
+ * Release everything but the filter
+ */
+static void release_resources(void) {
+    close_fd(&ingest.stop_fd);
+    close_fd(&ingest.wake.fd);
+    spsc_ring_free(&ingest.ring);
+    free(ingest.buf);
+    ingest.buf = NULL;
+    ingest.buf_len = 0;
+    ingest.fd = -1;
+}
+
+bool ingest_thread_wanted(ingest_thread_mode_t mode) {
+    switch (mode) {
+    case INGEST_THREAD_ON:
+        return true;
+    case INGEST_THREAD_AUTO:
+        return sysconf(_SC_NPROCESSORS_ONLN) >= 2;
+    default:
+        return false;
+    }
+}
+
+int ingest_thread_start(int fd, log_filter_t *filter, uint32_t ring_size, const ingest_thread_ops_t *ops) {
+    pthread_attr_t attr;
+    int ret;
+
+    if (ingest.running) {
+        return -EBUSY;
+    }
+
+    ret = spsc_ring_init(&ingest.ring, ring_size);
+    if (ret < 0) {
+        return ret;
+    }
+
+    ingest.buf = malloc(INGEST_READ_SIZE);
+    ingest.stop_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    ingest.wake.fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (!ingest.buf || ingest.stop_fd < 0 || ingest.wake.fd < 0) {
+        ret = ingest.buf ? -errno : -ENOMEM;
+        release_resources();
+        return ret;
+    }
+
+    ingest.fd = fd;
+    ingest.ops = ops;
+    ingest.buf_len = 0;
+    ingest.ended = 0;
+    ingest.error = 0;
+    memset(&ingest.counts, 0, sizeof(ingest.counts));
+
+    // The thread works on its own copy, the caller's is cleared once it runs
+    ingest.filter = *filter;
+    memset(&ingest.filter.stats, 0, sizeof(ingest.filter.stats));
+
+    pthread_attr_init(&attr);
+    pthread_attr_setstacksize(&attr, INGEST_STACK_SIZE);
+    ret = pthread_create(&ingest.thread, &attr, ingest_thread_main, NULL);
+    pthread_attr_destroy(&attr);
+    if (ret != 0) {
+        memset(&ingest.filter, 0, sizeof(ingest.filter));
+        release_resources();
+        return -ret;
+    }
+
+    filter_stats_t stats = filter->stats;
+    memset(filter, 0, sizeof(*filter));
+    filter->stats = stats;
+
+    ingest.wake.cb = wake_cb;
+    uloop_fd_add(&ingest.wake, ULOOP_READ);
+    ingest.running = true;
+
+    console_debug(&csl, "Reading logs from descriptor %d on a separate thread (%u byte ring)", fd, ingest.ring.size);
+    return 0;
+}
+
+void ingest_thread_set_filter(log_filter_t *filter) {
+    log_filter_t *staged = malloc(sizeof(*staged));
+
+    if (!staged) {
+        console_warn(&csl, "Keeping the previous log filter");
+        filter_free(filter);
+        return;
+    }
+
+    *staged = *filter;
+    memset(filter, 0, sizeof(*filter));
+
+    // A filter the thread has not picked up yet is replaced
+    log_filter_t *unused = __atomic_exchange_n(&ingest.pending_filter, staged, __ATOMIC_ACQ_REL);
+    if (unused) {
+        filter_free(unused);
+        free(unused);
+    }
+}
+
+void ingest_thread_stop(log_filter_t *filter) {
+    uint64_t one = 1;
+    ingest_thread_counts_t counts;
+    const void *data;
+    uint32_t len;
+
+    if (!ingest.running) {
+        return;
+    }
+
+    ingest.running = false;
+    uloop_fd_delete(&ingest.wake);
+    if (write(ingest.stop_fd, &one, sizeof(one)) < 0) {
+        console_warn(&csl, "Failed to signal the ingest thread: %s", strerror(errno));
+    }
+    pthread_join(ingest.thread, NULL);
+
+    // Everything below runs on the loop now
+    adopt_pending_filter();
+
+    // Records the thread already handed over are delivered in order, the counts
+    // behind them may move the cursor past them
+    while ((data = spsc_ring_peek(&ingest.ring, &len))) {
+        deliver_msg(data);
+        spsc_ring_release(&ingest.ring);
+    }
+    if (counts_pending()) {
+        take_counts(&counts);
+        ingest.ops->counts(&counts);
+    }
+
+    filter_stats_t stats = filter->stats;
+    filter_free(filter);
+    *filter = ingest.filter;
+    filter->stats = stats;
+    memset(&ingest.filter, 0, sizeof(ingest.filter));
+
+    release_resources();
+    console_debug(&csl, "Ingest thread stopped");
+}
+
+bool ingest_thread_running(void) { return ingest.running; }
+
+void ingest_thread_get_stats(ingest_thread_stats_t *stats) {
+    memset(stats, 0, sizeof(*stats));
+
+    if (!ingest.running) {
+        return;
+    }
+
+    stats->running = true;
+    stats->ring_bytes = ingest.ring.size;
+    stats->used_bytes = spsc_ring_used(&ingest.ring);
+    stats->high_water = spsc_ring_high_water(&ingest.ring);
+}
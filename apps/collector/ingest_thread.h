@@ -0,0 +1,119 @@
+#ifndef INGEST_THREAD_H
+#define INGEST_THREAD_H
+
+#include "collect.h"
+#include "config.h"
+#include "filter.h"
+#include <libubox/blob.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+ * Counters the reader thread reports to the event loop
+ * Sent as deltas since the previous report.
+ */
+typedef struct ingest_thread_counts {
+    filter_stats_t filter;   // Filter outcomes
+    uint64_t generic_parsed; // Records that needed the generic parser
+    uint64_t ring_dropped;   // Records dropped because the ring was full
+    uint64_t skipped;        // Records the stream owner had seen before
+    bool advanced;           // The fields below moved since the previous report
+    uint32_t last_id;        // Id of the last record read
+    uint64_t last_time;      // Timestamp of the last record read
+} ingest_thread_counts_t;
+
+/**
+ * Ring statistics
+ */
+typedef struct ingest_thread_stats {
+    bool running;        // A reader thread owns the log stream
+    uint32_t ring_bytes; // Ring size
+    uint32_t used_bytes; // Bytes not yet drained by the event loop
+    uint32_t high_water; // Peak of used_bytes
+} ingest_thread_stats_t;
+
+/**
+ * Hooks of the log stream owner
+ */
+typedef struct ingest_thread_ops {
+    /**
+     * Parse a logd record, called on the reader thread
+     * @param generic Set if the record needed the generic parser
+     * @return true if log_data was filled
+     */
+    bool (*parse)(struct blob_attr *record, log_data_t *log_data, bool *generic);
+
+    /**
+     * Check if a record was processed before, called on the reader thread
+     * Seen records are counted and skipped before the filter.
+     */
+    bool (*seen)(const log_data_t *log_data);
+
+    /**
+     * Pace a record, called on the reader thread before the filter
+     * @return milliseconds to wait before the record is processed, 0 to go on
+     */
+    uint32_t (*pace)(const log_data_t *log_data);
+
+    /**
+     * A record passed the filter, called from uloop
+     */
+    void (*log)(const log_data_t *log_data);
+
+    /**
+     * Counters accumulated by the thread, called from uloop
+     */
+    void (*counts)(const ingest_thread_counts_t *counts);
+
+    /**
+     * The stream reached EOF or failed, called from uloop once every
+     * record read before was delivered
+     * @param error 0 at EOF, negative error code on a read failure
+     */
+    void (*ended)(int error);
+} ingest_thread_ops_t;
+
+/**
+ * Check whether logs should be read on a thread of their own
+ * @param mode Configured mode, INGEST_THREAD_AUTO asks for two or more online CPUs
+ */
+bool ingest_thread_wanted(ingest_thread_mode_t mode);
+
+/**
+ * Read and filter a log stream on a new thread
+ * Records are handed to the event loop through a lock-free single
+ * producer/single consumer ring, the thread wakes the loop with an eventfd.
+ * @param fd Log stream descriptor, stays open after ingest_thread_stop()
+ * @param filter Compiled filter, moved to the thread (only the statistics stay behind)
+ * @param ring_size Ring size in bytes
+ * @param ops Stream owner hooks
+ * @return 0 on success, negative error code on failure (the filter is left in place)
+ */
+int ingest_thread_start(int fd, log_filter_t *filter, uint32_t ring_size, const ingest_thread_ops_t *ops);
+
+/**
+ * Hand a newly compiled filter to the running thread
+ * It applies from the next read on; the thread frees the one it replaces.
+ * @param filter Compiled filter, moved (statistics are not carried over)
+ */
+void ingest_thread_set_filter(log_filter_t *filter);
+
+/**
+ * Stop the thread and take the filter back
+ * Records still in the ring are delivered through the log hook first;
+ * data the thread had not read yet stays in the stream.
+ * @param filter Receives the compiled filter, its statistics are kept and updated
+ */
+void ingest_thread_stop(log_filter_t *filter);
+
+/**
+ * Check if a reader thread owns the log stream
+ */
+bool ingest_thread_running(void);
+
+/**
+ * Get ring statistics
+ */
+void ingest_thread_get_stats(ingest_thread_stats_t *stats);
+
+#endif // INGEST_THREAD_H
@@ -0,0 +1,367 @@
+#include "log_arena.h"
+#include "core/console.h"
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+static Console csl = {
+    .topic = "arena",
+};
+
+#define ALIGN_UP(x) (((x) + LOG_ARENA_ALIGN - 1) & ~(uint32_t)(LOG_ARENA_ALIGN - 1))
+
+static inline log_record_t *record_at(const log_arena_t *arena, uint32_t offset) {
+    return (log_record_t *)(arena->buf + offset);
+}
+
+int log_arena_init(log_arena_t *arena, uint32_t capacity) {
+    memset(arena, 0, sizeof(*arena));
+
+    capacity &= ~(uint32_t)(LOG_ARENA_ALIGN - 1);
+    if (capacity < log_arena_record_size(0)) {
+        console_error(&csl, "Arena capacity too small: %u bytes", capacity);
+        return -EINVAL;
+    }
+
+    arena->buf = malloc(capacity);
+    if (!arena->buf) {
+        console_error(&csl, "Failed to allocate %u byte log arena", capacity);
+        return -ENOMEM;
+    }
+
+    arena->capacity = capacity;
+    console_debug(&csl, "Log arena initialized with %u bytes", capacity);
+    return 0;
+}
+
+void log_arena_free(log_arena_t *arena) {
+    free(arena->buf);
+    memset(arena, 0, sizeof(*arena));
+}
+
+uint32_t log_arena_record_size(uint32_t msg_len) { return ALIGN_UP((uint32_t)sizeof(log_record_t) + msg_len + 1); }
+
+log_record_t *log_arena_reserve(log_arena_t *arena, uint32_t msg_len) {
+    uint32_t need = log_arena_record_size(msg_len);
+
+    if (!arena->buf || need > arena->capacity || arena->used == arena->capacity) {
+        return NULL;
+    }
+
+    // Empty arena: restart at offset 0 to get the largest contiguous run
+    if (arena->used == 0) {
+        arena->head = arena->read = arena->tail = 0;
+    }
+
+    if (arena->tail >= arena->head) {
+        // Free space is [tail, capacity) followed by [0, head)
+        uint32_t to_end = arena->capacity - arena->tail;
+        if (need > to_end) {
+            if (need > arena->head) {
+                return NULL;
+            }
+
+            // Pad the end of the buffer and continue at the start
+            log_record_t *marker = record_at(arena, arena->tail);
+            marker->size = to_end;
+            marker->msg_len = 0;
+            marker->flags = LOG_RECORD_WRAP;
+
+            arena->used += to_end;
+            arena->queued_bytes += to_end;
+            arena->tail = 0;
+        }
+    } else if (need > arena->head - arena->tail) {
+        return NULL;
+    }
+
+    log_record_t *record = record_at(arena, arena->tail);
+    record->size = need;
+    record->msg_len = 0;
+    record->flags = 0;
+    record->repeats = 0;
+    record->last_delta = 0;
+    return record;
+}
+
+void log_arena_commit(log_arena_t *arena, log_record_t *record) {
+    arena->tail += record->size;
+    if (arena->tail == arena->capacity) {
+        arena->tail = 0;
+    }
+
+    arena->used += record->size;
+    arena->queued++;
+    arena->queued_bytes += record->size;
+    arena->records++;
+    arena->committed++;
+
+    if (arena->used > arena->high_water_bytes) {
+        arena->high_water_bytes = arena->used;
+    }
+    if (arena->records > arena->high_water_records) {
+        arena->high_water_records = arena->records;
+    }
+}
+
+log_record_t *log_arena_queued(const log_arena_t *arena, uint32_t offset, uint64_t seq) {
+    // Records are claimed in commit order, so the queued ones are the last arena->queued committed
+    if (seq >= arena->committed || arena->committed - seq > arena->queued) {
+        return NULL;
+    }
+
+    return record_at(arena, offset);
+}
+
+uint32_t log_arena_claim(log_arena_t *arena, log_span_t *span, uint32_t max_count) {
+    uint32_t added = 0;
+
+    if (span->count == 0) {
+        span->start = arena->read;
+        span->end = arena->read;
+        span->bytes = 0;
+        span->first_seq = arena->committed - arena->queued;
+    }
+
+    // The span takes over the gap of evicted records in front of the read offset
+    if (arena->skip_bytes && arena->queued > 0 && span->count < max_count) {
+        if (span->count == 0) {
+            span->start = arena->skip_start;
+        }
+        span->bytes += arena->skip_bytes;
+        arena->skip_bytes = 0;
+    }
+
+    while (span->count < max_count && arena->queued > 0) {
+        log_record_t *record = record_at(arena, arena->read);
+        uint32_t size = record->size;
+
+        span->bytes += size;
+        arena->queued_bytes -= size;
+
+        if (record->flags & LOG_RECORD_WRAP) {
+            arena->read = 0;
+            continue;
+        }
+
+        arena->read += size;
+        if (arena->read == arena->capacity) {
+            arena->read = 0;
+        }
+        arena->queued--;
+        span->count++;
+        added++;
+    }
+
+    span->end = arena->read;
+    return added;
+}
+
+uint32_t log_arena_evict(log_arena_t *arena) {
+    uint32_t start = arena->read;
+    uint32_t bytes = 0;
+    uint32_t record_bytes = 0;
+
+    while (arena->queued > 0) {
+        log_record_t *record = record_at(arena, arena->read);
+        uint32_t size = record->size;
+
+        bytes += size;
+        arena->queued_bytes -= size;
+
+        if (record->flags & LOG_RECORD_WRAP) {
+            arena->read = 0;
+            continue;
+        }
+
+        arena->read += size;
+        if (arena->read == arena->capacity) {
+            arena->read = 0;
+        }
+        arena->queued--;
+        arena->records--;
+        record->flags |= LOG_RECORD_EVICTED;
+        record_bytes = size;
+        break;
+    }
+
+    if (bytes == 0) {
+        return 0;
+    }
+
+    if (arena->head == start && arena->skip_bytes == 0) {
+        // Nothing older is held, the bytes are free right away
+        arena->head = arena->read;
+        arena->used -= bytes;
+        if (arena->used == 0) {
+            arena->head = arena->read = arena->tail = 0;
+        }
+    } else {
+        // Older records are still claimed by a batch, leave a gap
+        if (arena->skip_bytes == 0) {
+            arena->skip_start = start;
+        }
+        arena->skip_bytes += bytes;
+    }
+
+    return record_bytes;
+}
+
+int log_arena_release(log_arena_t *arena, log_span_t *span) {
+    if (span->count == 0 && span->bytes == 0) {
+        return 0;
+    }
+
+    if (span->start != arena->head) {
+        console_error(&csl, "Out of order span release (start=%u, head=%u)", span->start, arena->head);
+        return -EINVAL;
+    }
+
+    arena->used -= span->bytes;
+    arena->records -= span->count;
+    arena->head = span->end;
+
+    // Records evicted right behind the span are free now as well
+    if (arena->skip_bytes && arena->head == arena->skip_start) {
+        arena->used -= arena->skip_bytes;
+        arena->head = arena->read;
+        arena->skip_bytes = 0;
+    }
+
+    if (arena->used == 0) {
+        arena->head = arena->read = arena->tail = 0;
+    }
+
+    memset(span, 0, sizeof(*span));
+    return 0;
+}
+
+log_record_t *log_arena_next(const log_arena_t *arena, uint32_t *pos, uint32_t *remaining) {
+    while (*remaining > 0) {
+        log_record_t *record = record_at(arena, *pos);
+
+        if (record->flags & LOG_RECORD_WRAP) {
+            *pos = 0;
+            continue;
+        }
+
+        *pos += record->size;
+        if (*pos == arena->capacity) {
+            *pos = 0;
+        }
+
+        // Evicted records in a span's leading gap are not part of the batch
+        if (record->flags & LOG_RECORD_EVICTED) {
+            continue;
+        }
+        (*remaining)--;
+        return record;
+    }
+
+    return NULL;
+}
+
+/**
+ * Copy count records starting at pos to the end of the packed buffer
+ * @return bytes copied
+ */
+static uint32_t pack_records(const log_arena_t *arena, uint8_t *buf, uint32_t out, uint32_t pos, uint32_t count) {
+    uint32_t start = out;
+    log_record_t *record;
+
+    while ((record = log_arena_next(arena, &pos, &count))) {
+        memcpy(buf + out, record, record->size);
+        out += record->size;
+    }
+    return out - start;
+}
+
+int log_arena_resize(log_arena_t *arena, uint32_t capacity, log_span_t **spans, uint32_t span_count) {
+    log_span_t **ordered = spans;
+    uint32_t ordered_count = 0;
+    uint32_t needed = 0;
+
+    capacity &= ~(uint32_t)(LOG_ARENA_ALIGN - 1);
+    if (capacity < log_arena_record_size(0)) {
+        return -EINVAL;
+    }
+
+    // Spans were claimed in ring order starting at the head, sort them by their distance from it in place
+    // (the non-empty ones end up at the front of the array)
+    for (uint32_t i = 0; i < span_count; i++) {
+        log_span_t *span = spans[i];
+        if (span->count == 0 && span->bytes == 0) {
+            continue;
+        }
+
+        uint32_t distance = (span->start + arena->capacity - arena->head) % arena->capacity;
+        uint32_t j = ordered_count++;
+        while (j > 0 && (ordered[j - 1]->start + arena->capacity - arena->head) % arena->capacity > distance) {
+            ordered[j] = ordered[j - 1];
+            j--;
+        }
+        ordered[j] = span;
+    }
+
+    // Bytes of the records themselves, without padding and gaps
+    for (uint32_t i = 0; i <= ordered_count; i++) {
+        uint32_t pos = i < ordered_count ? ordered[i]->start : arena->read;
+        uint32_t count = i < ordered_count ? ordered[i]->count : arena->queued;
+        log_record_t *record;
+        while ((record = log_arena_next(arena, &pos, &count))) {
+            needed += record->size;
+        }
+    }
+
+    if (needed > capacity) {
+        return -ENOSPC;
+    }
+
+    uint8_t *buf = malloc(capacity);
+    if (!buf) {
+        console_error(&csl, "Failed to allocate %u byte log arena", capacity);
+        return -ENOMEM;
+    }
+
+    uint32_t out = 0;
+    uint32_t records = arena->queued;
+    for (uint32_t i = 0; i < ordered_count; i++) {
+        log_span_t *span = ordered[i];
+        uint32_t bytes = pack_records(arena, buf, out, span->start, span->count);
+        span->start = out;
+        span->bytes = bytes;
+        out += bytes;
+        span->end = out == capacity ? 0 : out;
+        records += span->count;
+    }
+
+    uint32_t read = out;
+    out += pack_records(arena, buf, out, arena->read, arena->queued);
+
+    free(arena->buf);
+    arena->buf = buf;
+    arena->capacity = capacity;
+    arena->head = 0;
+    arena->read = read == capacity ? 0 : read;
+    arena->tail = out == capacity ? 0 : out;
+    arena->used = out;
+    arena->records = records;
+    arena->queued_bytes = out - read;
+    arena->skip_start = 0;
+    arena->skip_bytes = 0;
+
+    console_debug(&csl, "Log arena resized to %u bytes, %u bytes in use", capacity, out);
+    return 0;
+}
+
+void log_arena_reset(log_arena_t *arena) {
+    arena->head = 0;
+    arena->read = 0;
+    arena->tail = 0;
+    arena->used = 0;
+    arena->queued = 0;
+    arena->queued_bytes = 0;
+    arena->records = 0;
+    arena->skip_start = 0;
+    arena->skip_bytes = 0;
+}
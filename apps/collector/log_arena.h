@@ -0,0 +1,192 @@
+#ifndef LOG_ARENA_H
+#define LOG_ARENA_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define LOG_ARENA_ALIGN 8
+#define LOG_RECORD_WRAP 0x0001    // Padding up to the end of the buffer, reader restarts at offset 0
+#define LOG_RECORD_EVICTED 0x0002 // Dropped while queued, still occupies its bytes until released
+#define LOG_RECORD_WEIGHT_SHIFT 8
+#define LOG_RECORD_WEIGHT_MASK 0x0f00 // log2 of the sampling weight, 0 for records that were not sampled
+
+/**
+ * Variable-length log record stored contiguously in the arena
+ * size and flags come first so an 8-byte wrap marker is always readable.
+ */
+typedef struct log_record {
+    uint32_t size;       // Total record size including header, padded to LOG_ARENA_ALIGN
+    uint16_t msg_len;    // Message length without the terminating NUL
+    uint16_t flags;      // LOG_RECORD_* flags
+    uint32_t priority;   // Raw syslog priority (facility | severity)
+    uint32_t source;     // Raw log source (klog, syslog, etc)
+    uint64_t time;       // Raw timestamp from log system
+    uint32_t repeats;    // Further identical messages collapsed into this record
+    uint32_t last_delta; // Timestamp of the last repeat relative to time
+    char msg[];          // NUL-terminated message
+} log_record_t;
+
+/**
+ * Number of logs a record stands for by overload sampling (1 if it was not sampled)
+ */
+static inline uint32_t log_record_weight(const log_record_t *record) {
+    return 1u << ((record->flags & LOG_RECORD_WEIGHT_MASK) >> LOG_RECORD_WEIGHT_SHIFT);
+}
+
+/**
+ * Store the sampling weight of a record, a power of two up to 2^15
+ */
+static inline void log_record_set_weight(log_record_t *record, uint32_t weight) {
+    uint16_t shift = 0;
+    while (weight > 1 && shift < 15) {
+        weight >>= 1;
+        shift++;
+    }
+    record->flags = (uint16_t)((record->flags & ~LOG_RECORD_WEIGHT_MASK) | (shift << LOG_RECORD_WEIGHT_SHIFT));
+}
+
+/**
+ * Contiguous range of records claimed by a batch
+ * Spans are released in the order they were claimed.
+ */
+typedef struct log_span {
+    uint32_t start;     // Offset of the first record
+    uint32_t end;       // Offset just past the last record
+    uint32_t bytes;     // Arena bytes covered, including wrap padding
+    uint32_t count;     // Number of records
+    uint64_t first_seq; // Sequence number (commit order) of the first record
+} log_span_t;
+
+/**
+ * Ring buffer of length-prefixed records sized by a byte budget
+ *
+ *   head ........ read ........ tail
+ *   | claimed by   | queued,      | free
+ *   | batches      | not claimed  |
+ *
+ * Queued records evicted while older ones are still claimed leave a gap right
+ * before read (skip_start, skip_bytes). The gap is freed with the span that is
+ * claimed next or as soon as the head reaches it.
+ */
+typedef struct log_arena {
+    uint8_t *buf;
+    uint32_t capacity;           // Byte budget
+    uint32_t head;               // Oldest record still referenced by a batch or the queue
+    uint32_t read;               // Oldest record not yet claimed by a batch
+    uint32_t tail;               // Next write offset
+    uint32_t used;               // Bytes between head and tail (records and wrap padding)
+    uint32_t queued;             // Records between read and tail
+    uint32_t queued_bytes;       // Bytes between read and tail
+    uint32_t high_water_bytes;   // Peak value of used
+    uint32_t high_water_records; // Peak number of records held (queued and claimed)
+    uint32_t records;            // Records between head and tail
+    uint32_t skip_start;         // Offset of the gap left by evicted records
+    uint32_t skip_bytes;         // Bytes in that gap, 0 if there is none
+    uint64_t committed;          // Records committed since init, the sequence number of the next record
+} log_arena_t;
+
+/**
+ * Allocate the arena buffer
+ * @param arena Arena to initialize
+ * @param capacity Byte budget (rounded down to LOG_ARENA_ALIGN)
+ * @return 0 on success, negative error code on failure
+ */
+int log_arena_init(log_arena_t *arena, uint32_t capacity);
+
+/**
+ * Release the arena buffer
+ * @param arena Arena to free
+ */
+void log_arena_free(log_arena_t *arena);
+
+/**
+ * Bytes a record with a message of msg_len bytes occupies
+ * @param msg_len Message length without terminator
+ * @return record size in bytes
+ */
+uint32_t log_arena_record_size(uint32_t msg_len);
+
+/**
+ * Reserve space for a record at the tail
+ * The caller fills in the message and fields, then calls log_arena_commit().
+ * Only one reservation may be outstanding at a time.
+ * @param arena Arena to write to
+ * @param msg_len Message length without terminator
+ * @return record to fill in, or NULL if the arena has no room
+ */
+log_record_t *log_arena_reserve(log_arena_t *arena, uint32_t msg_len);
+
+/**
+ * Publish the record returned by the last log_arena_reserve()
+ * @param arena Arena the record was reserved in
+ * @param record Reserved record
+ */
+void log_arena_commit(log_arena_t *arena, log_record_t *record);
+
+/**
+ * Look up a record that has not been claimed by a batch yet
+ * Records that are still queued may be updated in place.
+ * @param arena Arena the record was committed to
+ * @param offset Offset of the record in the buffer
+ * @param seq Sequence number of the record (arena->committed before its commit)
+ * @return the record, or NULL if it was claimed or dropped since
+ */
+log_record_t *log_arena_queued(const log_arena_t *arena, uint32_t offset, uint64_t seq);
+
+/**
+ * Claim up to max_count queued records, extending span
+ * An empty span starts at the current read offset; a non-empty span must
+ * end there (i.e. it was the last one claimed).
+ * @param arena Arena to claim from
+ * @param span Span to extend
+ * @param max_count Maximum number of records the span may hold in total
+ * @return number of records added to the span
+ */
+uint32_t log_arena_claim(log_arena_t *arena, log_span_t *span, uint32_t max_count);
+
+/**
+ * Drop the oldest queued record to make room for newer ones
+ * @param arena Arena to evict from
+ * @return size of the evicted record, 0 if nothing was queued
+ */
+uint32_t log_arena_evict(log_arena_t *arena);
+
+/**
+ * Release a span once its batch is done, freeing its bytes
+ * @param arena Arena the span was claimed from
+ * @param span Span to release (must start at the arena head)
+ * @return 0 on success, negative error code if the span is not the oldest one
+ */
+int log_arena_release(log_arena_t *arena, log_span_t *span);
+
+/**
+ * Iterate over the records of a span
+ * @param arena Arena the span was claimed from
+ * @param pos Iterator state, initialize to span->start
+ * @param remaining Records left in the span, initialize to span->count, decremented on each call
+ * @return next record, or NULL once the span is exhausted
+ */
+log_record_t *log_arena_next(const log_arena_t *arena, uint32_t *pos, uint32_t *remaining);
+
+/**
+ * Move the held records into a new buffer of a different capacity
+ * Records keep their order and are packed from offset 0, dropping wrap
+ * padding and evicted records. Every span claimed from the arena must be
+ * passed (in any order); they are rewritten to the new offsets. Record
+ * offsets change, so lookups by offset (dedup) must be reset afterwards.
+ * @param arena Arena to resize
+ * @param capacity New byte capacity (rounded down to LOG_ARENA_ALIGN)
+ * @param spans Spans claimed from the arena, empty ones are ignored; the array is reordered
+ * @param span_count Number of spans
+ * @return 0 on success, -ENOSPC if the held records do not fit, -ENOMEM
+ */
+int log_arena_resize(log_arena_t *arena, uint32_t capacity, log_span_t **spans, uint32_t span_count);
+
+/**
+ * Drop every record (queued and claimed) and reset the offsets
+ * @param arena Arena to reset
+ */
+void log_arena_reset(log_arena_t *arena);
+
+#endif // LOG_ARENA_H
@@ -1,7 +1,11 @@
+#define _GNU_SOURCE // pipe2()
 #include "collect.h"
 #include "config.h"
 #include "core/console.h"
+#include "syslog_input.h"
 #include "ubus.h"
+#include <errno.h>
+#include <fcntl.h>
 #include <libubox/uloop.h>
 #include <signal.h>
 #include <stdbool.h>
@@ -16,10 +20,12 @@ static Console csl = {
 static volatile bool running = true;
 static bool dev_env = false;
 
-// Timer for batch processing
-static struct uloop_timeout batch_timer;
+// Periodic status output
 static struct uloop_timeout status_timer;
-static struct uloop_timeout token_refresh_timer;
+
+// SIGHUP is forwarded through a pipe so the reload runs from the event loop
+static int reload_pipe[2] = {-1, -1};
+static struct uloop_fd reload_fd;
 
 /**
  * Signal handler for graceful shutdown
@@ -31,16 +37,44 @@ static void signal_handler(int sig) {
 }
 
 /**
- * Batch processing timer callback
+ * SIGHUP handler, wakes the event loop to reload the configuration
  */
-static void batch_timer_cb(struct uloop_timeout *timeout) {
-    if (!running) return;
+static void reload_signal_handler(int sig) {
+    int saved_errno = errno;
+    if (write(reload_pipe[1], "", 1) < 0) {
+        // A reload is pending already
+    }
+    errno = saved_errno;
+}
 
-    // Process any pending batches
-    collect_process_pending_batches();
+/**
+ * Reload requested by SIGHUP
+ */
+static void reload_fd_cb(struct uloop_fd *fd, unsigned int events) {
+    char buf[16];
+
+    while (read(fd->fd, buf, sizeof(buf)) > 0) {
+    }
+
+    console_info(&csl, "Received SIGHUP, reloading configuration");
+    if (collect_reload_config() < 0) {
+        console_warn(&csl, "Configuration reload failed, keeping the current configuration");
+    }
+}
+
+/**
+ * Forward SIGHUP to the event loop
+ */
+static int setup_reload_signal(void) {
+    if (pipe2(reload_pipe, O_NONBLOCK | O_CLOEXEC) < 0) {
+        return -errno;
+    }
 
-    // Schedule next batch check
-    uloop_timeout_set(&batch_timer, 1000); // Check every second
+    reload_fd.fd = reload_pipe[0];
+    reload_fd.cb = reload_fd_cb;
+    uloop_fd_add(&reload_fd, ULOOP_READ);
+    signal(SIGHUP, reload_signal_handler);
+    return 0;
 }
 
 /**
@@ -51,15 +85,66 @@ static void status_timer_cb(struct uloop_timeout *timeout) {
 
     uint32_t queue_size, dropped_count;
     if (collect_get_stats(&queue_size, &dropped_count) == 0) {
+        collect_buffer_stats_t buffer;
+        collect_get_buffer_stats(&buffer);
+
         if (dev_env) {
-            console_info(&csl, "Status: queue_size=%u, dropped=%u, ubus_connected=%s", queue_size, dropped_count,
+            collect_payload_stats_t payload;
+            collect_get_payload_stats(&payload);
+            console_info(&csl, "Payload: batches=%llu, logs=%llu, bytes_in=%llu, bytes_out=%llu, serialize=%llu ns/log",
+                         (unsigned long long)payload.batches, (unsigned long long)payload.logs,
+                         (unsigned long long)payload.payload_bytes, (unsigned long long)payload.wire_bytes,
+                         (unsigned long long)(payload.logs ? payload.serialize_ns / payload.logs : 0));
+            console_info(&csl, "Status: queue_size=%u, dropped=%u, buffer_used=%u/%u, buffer_high_water=%u, "
+                         "records_high_water=%u, buffer_exhausted=%u, ubus_connected=%s",
+                         queue_size, dropped_count, buffer.used_bytes, buffer.capacity_bytes,
+                         buffer.high_water_bytes, buffer.high_water_records, buffer.exhausted,
                          ubus_is_connected() ? "yes" : "no");
+
+            spool_stats_t spool;
+            collect_get_spool_stats(&spool);
+            console_info(&csl, "Spool: pending=%u (%u logs), segments=%u, written=%llu, replayed=%llu, dropped=%llu, "
+                         "budget_rejects=%llu",
+                         spool.pending_batches, spool.pending_records, spool.segments,
+                         (unsigned long long)spool.written_batches, (unsigned long long)spool.replayed_batches,
+                         (unsigned long long)spool.dropped_batches, (unsigned long long)spool.budget_rejects);
+
+            collect_batching_stats_t batching;
+            collect_get_batching_stats(&batching);
+            console_info(&csl, "Batching: %s, size=%u, timeout=%u ms, urgent=%u%%, rtt=%.0f ms, success=%.0f%%, "
+                         "grown=%u, shrunk=%u",
+                         batching.adaptive ? "adaptive" : "static", batching.batch_size, batching.batch_timeout_ms,
+                         batching.urgent_percent, batching.rtt_ms, batching.success_percent, batching.grown,
+                         batching.shrunk);
+
+            collect_ingest_stats_t ingest;
+            collect_get_ingest_stats(&ingest);
+            console_info(&csl, "Ingest: received=%llu, rate=%.1f/s, collapsed=%llu, rate_limited=%llu, evicted=%llu, "
+                         "sampled=%llu (1 in %u)",
+                         (unsigned long long)ingest.received, ingest.rate_per_s, (unsigned long long)ingest.collapsed,
+                         (unsigned long long)ingest.rate_limited, (unsigned long long)ingest.evicted,
+                         (unsigned long long)ingest.sampled, ingest.sample_rate);
+            console_info(&csl, "Lanes: high=%u (%u bytes), medium=%u (%u bytes), low=%u (%u bytes)",
+                         buffer.lanes[LOG_LANE_HIGH].queued_records, buffer.lanes[LOG_LANE_HIGH].used_bytes,
+                         buffer.lanes[LOG_LANE_MEDIUM].queued_records, buffer.lanes[LOG_LANE_MEDIUM].used_bytes,
+                         buffer.lanes[LOG_LANE_LOW].queued_records, buffer.lanes[LOG_LANE_LOW].used_bytes);
+
+            collect_http_stats_t http;
+            collect_get_http_stats(&http);
+            console_info(&csl, "HTTP: requests=%llu, latency p50=%.0f ms, p95=%.0f ms, p99=%.0f ms, batch p50=%.0f",
+                         (unsigned long long)http.requests, http.latency_p50_ms, http.latency_p95_ms,
+                         http.latency_p99_ms, http.batch_size_p50);
+
+            filter_stats_t filter;
+            ubus_get_filter_stats(&filter);
+            console_info(&csl, "Filter: accepted=%llu, dropped_level=%llu, dropped_pattern=%llu",
+                         (unsigned long long)filter.accepted, (unsigned long long)filter.dropped_level,
+                         (unsigned long long)filter.dropped_pattern);
         }
 
         // Warn if queue is getting full
-        uint32_t urgent_threshold = config_get_queue_size() * 80 / 100;
-        if (queue_size > urgent_threshold) {
-            console_warn(&csl, "Log queue getting full: %u entries (threshold: %u)", queue_size, urgent_threshold);
+        if (buffer.fill_percent >= URGENT_THRESHOLD_PERCENT) {
+            console_warn(&csl, "Log queue getting full: %u entries, %u%% used", queue_size, buffer.fill_percent);
         }
 
         // Warn about dropped logs
@@ -72,68 +157,6 @@ static void status_timer_cb(struct uloop_timeout *timeout) {
     uloop_timeout_set(&status_timer, 30000); // Every 30 seconds
 }
 
-/**
- * Access token refresh timer callback
- */
-static void token_refresh_timer_cb(struct uloop_timeout *timeout) {
-    // Defensive check - should not happen but prevents crashes
-    if (!timeout) {
-        console_error(&csl, "Token refresh timer callback called with null timeout");
-        return;
-    }
-
-    if (!running) {
-        console_debug(&csl, "Service not running, skipping token refresh");
-        return;
-    }
-
-    // Check if UBUS is available before attempting token operations
-    if (!ubus_is_connected()) {
-        console_warn(&csl, "UBUS not connected, skipping token refresh");
-        // Schedule next check with shorter interval to retry sooner
-        uloop_timeout_set(&token_refresh_timer, 10000); // 10 second retry when UBUS down
-        return;
-    }
-
-    // Check if current token is still valid
-    bool token_valid = ubus_is_access_token_valid();
-    bool currently_accepting = ubus_should_accept_logs();
-
-    if (!token_valid) {
-        console_info(&csl, "Access token expired or invalid, refreshing...");
-
-        // Attempt token refresh with error handling
-        int ret = ubus_refresh_access_token();
-        if (ret < 0) {
-            console_warn(&csl, "Failed to refresh access token: %d", ret);
-
-            // Disable log acceptance if token refresh fails
-            if (currently_accepting) {
-                console_warn(&csl, "Disabling log acceptance due to token refresh failure");
-                ubus_set_log_acceptance(false);
-            }
-
-            // On failure, schedule shorter retry interval based on whether we had a token before
-            uint32_t retry_interval = currently_accepting ? 60000 : 10000; // 1 minute if we had token, 10 seconds for initial acquisition
-            console_info(&csl, "Scheduling token refresh retry in %u ms", retry_interval);
-            uloop_timeout_set(&token_refresh_timer, retry_interval);
-            return;
-        } else {
-            console_info(&csl, "Access token refreshed successfully");
-            // Token refresh function handles enabling log acceptance
-        }
-    } else if (dev_env) {
-        console_debug(&csl, "Access token still valid");
-    }
-
-    // Schedule next token check (every 5 minutes for normal operation)
-    uint32_t normal_interval = 300000; // 5 minutes
-    if (dev_env) {
-        console_debug(&csl, "Scheduling next token check in %u ms", normal_interval);
-    }
-    uloop_timeout_set(&token_refresh_timer, normal_interval);
-}
-
 /**
  * Process command line arguments
  */
@@ -205,19 +228,27 @@ int main(int argc, char *argv[]) {
         return 1;
     }
 
+    // Listen for syslog from devices behind the access point, logd stays the main source
+    ret = syslog_input_init();
+    if (ret < 0) {
+        console_warn(&csl, "Syslog listener unavailable: %s", strerror(-ret));
+    }
+
+    // Reload the configuration on SIGHUP (procd reload_signal) without restarting
+    ret = setup_reload_signal();
+    if (ret < 0) {
+        console_warn(&csl, "Failed to set up SIGHUP reload: %s", strerror(-ret));
+    }
+
     console_info(&csl, "Starting event loop");
 
-    // Set up batch processing timer
-    batch_timer.cb = batch_timer_cb;
-    uloop_timeout_set(&batch_timer, 1000); // Start in 1 second
+    // Batches are sealed when full or by their deadline timer in collect.c, no polling needed
 
     // Set up status monitoring timer
     status_timer.cb = status_timer_cb;
     uloop_timeout_set(&status_timer, 30000); // First status check in 30 seconds
 
-    // Set up access token refresh timer - try to get initial token immediately
-    token_refresh_timer.cb = token_refresh_timer_cb;
-    uloop_timeout_set(&token_refresh_timer, 1000); // First token check in 1 second
+    // The access token was requested from fry-agent in ubus_init(), ubus.c refreshes it ahead of its expiry
 
     console_info(&csl, "Collector service running with event-driven architecture");
     console_info(&csl, "Log streaming will start once access token is acquired");
@@ -228,16 +259,23 @@ int main(int argc, char *argv[]) {
     console_info(&csl, "Shutting down collector service...");
 
     // Cancel timers
-    uloop_timeout_cancel(&batch_timer);
     uloop_timeout_cancel(&status_timer);
-    uloop_timeout_cancel(&token_refresh_timer);
+
+    // Reloads are not handled past this point
+    signal(SIGHUP, SIG_IGN);
+    if (reload_pipe[0] >= 0) {
+        uloop_fd_delete(&reload_fd);
+        close(reload_pipe[0]);
+        close(reload_pipe[1]);
+    }
 
     // Process any final batches
     collect_process_pending_batches();
 
-    // Cleanup
-    ubus_cleanup();
+    // Cleanup, the log cursor is written last so it covers what the final flush delivered or spooled
+    syslog_input_cleanup();
     collect_cleanup();
+    ubus_cleanup();
     uloop_done();
 
     console_info(&csl, "Collector service stopped");
@@ -0,0 +1,131 @@
+#include "membudget.h"
+#include "core/console.h"
+#include "core/stats.h"
+#include <stdio.h>
+#include <string.h>
+
+static Console csl = {
+    .topic = "membudget",
+};
+
+#define PSI_MEMORY_PATH "/proc/pressure/memory"
+
+static uint32_t clamp_u32(uint64_t value, uint32_t min, uint32_t max) {
+    if (value < min) return min;
+    if (value > max) return max;
+    return (uint32_t)value;
+}
+
+/**
+ * Read the share of time some task stalled on memory over the last 10 seconds
+ * @return percent, negative if the kernel has no PSI support
+ */
+static double read_psi_avg10(void) {
+    FILE *file = fopen(PSI_MEMORY_PATH, "r");
+    double avg10 = -1.0;
+    char line[128];
+
+    if (!file) {
+        return avg10;
+    }
+
+    while (fgets(line, sizeof(line), file)) {
+        if (sscanf(line, "some avg10=%lf", &avg10) == 1) {
+            break;
+        }
+    }
+
+    fclose(file);
+    return avg10;
+}
+
+/**
+ * Read MemTotal and MemAvailable
+ * Kernels before 3.14 lack MemAvailable, free memory plus page cache stands in.
+ * @return false if /proc/meminfo could not be read
+ */
+static bool read_memory(membudget_t *mb) {
+    MemoryStats mem = get_memory_stats();
+
+    if (mem.total_kb == 0) {
+        return false;
+    }
+
+    mb->total_kb = mem.total_kb;
+    mb->available_kb = mem.available_kb ? mem.available_kb : mem.free_kb + mem.buffered_kb;
+    mb->psi_avg10 = read_psi_avg10();
+    return true;
+}
+
+void membudget_init(membudget_t *mb, uint32_t percent, uint32_t min_kb, uint32_t max_kb, uint32_t low_percent) {
+    memset(mb, 0, sizeof(*mb));
+
+    mb->enabled = percent > 0;
+    mb->percent = percent;
+    mb->min_kb = min_kb;
+    mb->max_kb = max_kb;
+    mb->low_percent = low_percent;
+
+    if (!mb->enabled) {
+        return;
+    }
+
+    if (!read_memory(mb)) {
+        console_warn(&csl, "Failed to read /proc/meminfo, using the smallest budget");
+        mb->target_kb = mb->budget_kb = min_kb;
+        return;
+    }
+
+    mb->target_kb = clamp_u32(mb->available_kb * percent / 100, min_kb, max_kb);
+    mb->budget_kb = mb->target_kb;
+    console_info(&csl, "Log buffer budget %u KB (%u%% of %llu KB available)", mb->budget_kb, percent,
+                 (unsigned long long)mb->available_kb);
+}
+
+bool membudget_sample(membudget_t *mb) {
+    if (!mb->enabled || !read_memory(mb)) {
+        return false;
+    }
+
+    uint64_t low_kb = mb->total_kb * mb->low_percent / 100;
+    bool psi = mb->psi_avg10 >= 0;
+    bool pressure = mb->available_kb < low_kb || (psi && mb->psi_avg10 >= MEMBUDGET_PSI_HIGH);
+    bool calm = mb->available_kb >= low_kb * MEMBUDGET_RECOVER_FACTOR && (!psi || mb->psi_avg10 < MEMBUDGET_PSI_LOW);
+    uint32_t budget = mb->budget_kb;
+
+    if (pressure) {
+        if (!mb->pressure) {
+            mb->pressure_events++;
+            console_warn(&csl, "Memory pressure (%llu KB available, PSI %.2f), shrinking the log buffer",
+                         (unsigned long long)mb->available_kb, mb->psi_avg10);
+        }
+        budget = clamp_u32(budget / 2, mb->min_kb, mb->max_kb);
+    } else if (calm) {
+        if (mb->pressure) {
+            console_info(&csl, "Memory pressure eased (%llu KB available)", (unsigned long long)mb->available_kb);
+        }
+        if (budget < mb->target_kb) {
+            uint32_t step = mb->target_kb / MEMBUDGET_GROW_DIVISOR;
+            budget = clamp_u32((uint64_t)budget + (step ? step : 1), mb->min_kb, mb->target_kb);
+        }
+    }
+
+    // Between the watermarks the budget holds, so it does not flap around one
+    mb->pressure = pressure || (mb->pressure && !calm);
+
+    if (budget == mb->budget_kb) {
+        return false;
+    }
+
+    if (budget < mb->budget_kb) {
+        mb->shrunk++;
+    } else {
+        mb->grown++;
+    }
+    mb->budget_kb = budget;
+    return true;
+}
+
+uint32_t membudget_records(const membudget_t *mb) {
+    return clamp_u32((uint64_t)mb->budget_kb * 1024 / MEMBUDGET_RECORD_BYTES, 1, MEMBUDGET_MAX_RECORDS);
+}
@@ -0,0 +1,64 @@
+#ifndef MEMBUDGET_H
+#define MEMBUDGET_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define MEMBUDGET_INTERVAL_MS 5000   // MemAvailable and PSI sampling period
+#define MEMBUDGET_RECORD_BYTES 96    // Typical arena record (32 byte header and message), sets the record limit
+#define MEMBUDGET_MAX_RECORDS 100000 // Upper bound of the record limit, like queue_size
+#define MEMBUDGET_RECOVER_FACTOR 2   // MemAvailable must reach this multiple of the watermark to grow again
+#define MEMBUDGET_PSI_HIGH 10.0      // PSI "some" avg10 (percent stalled) that counts as pressure
+#define MEMBUDGET_PSI_LOW 2.0        // PSI "some" avg10 below which growing is allowed
+#define MEMBUDGET_GROW_DIVISOR 4     // Each calm sample grows the budget by 1/4 of the target
+
+/**
+ * Log buffer budget derived from the memory of the device
+ * At start the target is a share of MemAvailable, kept within the
+ * configured bounds. It is the byte budget of all lane rings together. Under memory pressure
+ * (MemAvailable below the watermark or a PSI stall above MEMBUDGET_PSI_HIGH)
+ * the budget halves on every sample; once memory is plentiful again it grows
+ * back towards the target in steps.
+ */
+typedef struct membudget {
+    bool enabled;
+    uint32_t percent;     // Share of MemAvailable the rings may take together
+    uint32_t min_kb;      // Bounds of the budget
+    uint32_t max_kb;
+    uint32_t low_percent; // MemAvailable watermark as a share of MemTotal
+
+    uint32_t target_kb; // Budget picked at start, growth stops there
+    uint32_t budget_kb; // Current budget
+
+    uint64_t total_kb;        // Last MemTotal
+    uint64_t available_kb;    // Last MemAvailable
+    double psi_avg10;         // Last PSI "some" avg10, negative without PSI support
+    bool pressure;            // Under memory pressure since the last sample
+    uint64_t pressure_events; // Transitions into pressure
+    uint32_t shrunk;          // Budget reductions
+    uint32_t grown;           // Budget increases
+} membudget_t;
+
+/**
+ * Sample memory and pick the target budget
+ * With percent 0 the budget stays disabled and the fixed sizes apply.
+ * @param mb Budget to initialize
+ * @param percent Share of MemAvailable for all rings, 0 disables
+ * @param min_kb Lower bound of the budget
+ * @param max_kb Upper bound of the budget
+ * @param low_percent MemAvailable watermark in percent of MemTotal
+ */
+void membudget_init(membudget_t *mb, uint32_t percent, uint32_t min_kb, uint32_t max_kb, uint32_t low_percent);
+
+/**
+ * Sample MemAvailable and memory PSI and adjust the budget
+ * @return true if budget_kb changed
+ */
+bool membudget_sample(membudget_t *mb);
+
+/**
+ * Record limit that goes with the current budget
+ */
+uint32_t membudget_records(const membudget_t *mb);
+
+#endif // MEMBUDGET_H
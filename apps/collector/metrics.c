@@ -0,0 +1,89 @@
+#include "metrics.h"
+#include <string.h>
+
+#define HISTOGRAM_STEP 1.189207115002721 // 2^(1/4)
+
+void histogram_init(histogram_t *hist, double base) {
+    memset(hist, 0, sizeof(*hist));
+
+    double bound = base;
+    for (int i = 0; i < HISTOGRAM_BUCKETS; i++) {
+        hist->bounds[i] = bound;
+        bound *= HISTOGRAM_STEP;
+    }
+}
+
+void histogram_add(histogram_t *hist, double value) {
+    // Binary search for the first bucket whose upper bound holds the value
+    int lo = 0, hi = HISTOGRAM_BUCKETS - 1;
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (value <= hist->bounds[mid]) {
+            hi = mid;
+        } else {
+            lo = mid + 1;
+        }
+    }
+
+    hist->buckets[lo]++;
+    hist->count++;
+    hist->sum += value;
+    if (value > hist->max) {
+        hist->max = value;
+    }
+}
+
+double histogram_percentile(const histogram_t *hist, double percentile) {
+    if (hist->count == 0) {
+        return 0;
+    }
+
+    double rank = percentile / 100.0 * (double)hist->count;
+    uint64_t seen = 0;
+
+    for (int i = 0; i < HISTOGRAM_BUCKETS; i++) {
+        if (hist->buckets[i] == 0 || (double)(seen + hist->buckets[i]) < rank) {
+            seen += hist->buckets[i];
+            continue;
+        }
+
+        double lower = i > 0 ? hist->bounds[i - 1] : 0;
+        double upper = i < HISTOGRAM_BUCKETS - 1 ? hist->bounds[i] : hist->max;
+        double value = lower + (upper - lower) * (rank - (double)seen) / hist->buckets[i];
+        return value < hist->max ? value : hist->max;
+    }
+
+    return hist->max;
+}
+
+void rate_meter_add(rate_meter_t *meter, time_t now, uint32_t count) {
+    if (now != meter->last) {
+        // Clear the slots of the seconds without events
+        time_t gap = now - meter->last;
+        if (gap < 0 || gap >= RATE_WINDOW_S) {
+            memset(meter->slots, 0, sizeof(meter->slots));
+        } else {
+            for (time_t t = meter->last + 1; t <= now; t++) {
+                meter->slots[t % RATE_WINDOW_S] = 0;
+            }
+        }
+        meter->last = now;
+    }
+
+    meter->slots[now % RATE_WINDOW_S] += count;
+}
+
+double rate_meter_rate(const rate_meter_t *meter, time_t now) {
+    uint64_t total = 0;
+
+    // Slots hold the seconds up to meter->last, sum those still inside the window
+    time_t first = now - RATE_WINDOW_S + 1;
+    if (first < meter->last - RATE_WINDOW_S + 1) {
+        first = meter->last - RATE_WINDOW_S + 1;
+    }
+    for (time_t t = first; t <= meter->last; t++) {
+        total += meter->slots[t % RATE_WINDOW_S];
+    }
+
+    return (double)total / RATE_WINDOW_S;
+}
@@ -0,0 +1,69 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <stdint.h>
+#include <time.h>
+
+#define HISTOGRAM_BUCKETS 64 // Four buckets per doubling, covering base to base * 2^16
+#define RATE_WINDOW_S 60
+
+/**
+ * Fixed-bucket histogram with exponentially growing bucket bounds
+ * Each bucket is about 19% wider than the previous one, so percentiles are
+ * accurate to within that step without storing samples.
+ */
+typedef struct histogram {
+    double bounds[HISTOGRAM_BUCKETS]; // Upper bound of each bucket, the last one is open-ended
+    uint32_t buckets[HISTOGRAM_BUCKETS];
+    uint64_t count;
+    double sum;
+    double max;
+} histogram_t;
+
+/**
+ * Event counter over a sliding window of one-second slots
+ */
+typedef struct rate_meter {
+    uint32_t slots[RATE_WINDOW_S];
+    time_t last; // Second of the most recent event
+} rate_meter_t;
+
+/**
+ * Initialize a histogram
+ * @param hist Histogram to initialize
+ * @param base Upper bound of the first bucket
+ */
+void histogram_init(histogram_t *hist, double base);
+
+/**
+ * Record a sample
+ * @param hist Histogram
+ * @param value Sample value
+ */
+void histogram_add(histogram_t *hist, double value);
+
+/**
+ * Estimate a percentile, interpolated within the bucket it falls into
+ * @param hist Histogram
+ * @param percentile Percentile (0-100)
+ * @return estimated value, 0 if the histogram is empty
+ */
+double histogram_percentile(const histogram_t *hist, double percentile);
+
+/**
+ * Count events at the given time
+ * @param meter Rate meter
+ * @param now Current time in seconds
+ * @param count Number of events
+ */
+void rate_meter_add(rate_meter_t *meter, time_t now, uint32_t count);
+
+/**
+ * Average events per second over the window
+ * @param meter Rate meter
+ * @param now Current time in seconds
+ * @return events per second
+ */
+double rate_meter_rate(const rate_meter_t *meter, time_t now);
+
+#endif // METRICS_H
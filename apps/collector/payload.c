@@ -0,0 +1,241 @@
+#include "payload.h"
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Characters that must be escaped inside a JSON string: controls, quote and backslash
+static const uint8_t json_escape_table[256] = {
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, // 0x00
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, // 0x10
+    0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, // 0x20 '"'
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, // 0x30
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, // 0x40
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, // 0x50 '\\'
+};
+
+static const char hex_digits[] = "0123456789abcdef";
+
+int payload_format_from_string(const char *name, payload_format_t *format) {
+    if (!name || !format) {
+        return -EINVAL;
+    }
+
+    if (strcmp(name, "json") == 0 || name[0] == '\0') {
+        *format = PAYLOAD_FORMAT_JSON;
+    } else if (strcmp(name, "msgpack") == 0) {
+        *format = PAYLOAD_FORMAT_MSGPACK;
+    } else {
+        return -EINVAL;
+    }
+
+    return 0;
+}
+
+const char *payload_format_name(payload_format_t format) {
+    return format == PAYLOAD_FORMAT_MSGPACK ? "msgpack" : "json";
+}
+
+const char *payload_format_content_type(payload_format_t format) {
+    return format == PAYLOAD_FORMAT_MSGPACK ? "application/msgpack" : "application/json";
+}
+
+void payload_free(payload_buffer_t *buf) {
+    free(buf->data);
+    buf->data = NULL;
+    buf->len = 0;
+    buf->capacity = 0;
+    buf->failed = false;
+}
+
+void payload_reset(payload_buffer_t *buf) {
+    buf->len = 0;
+    buf->failed = false;
+}
+
+bool payload_reserve(payload_buffer_t *buf, size_t extra) {
+    if (buf->failed) {
+        return false;
+    }
+
+    // Keep one spare byte so the payload can always be NUL-terminated
+    size_t needed = buf->len + extra + 1;
+    if (needed <= buf->capacity) {
+        return true;
+    }
+
+    size_t capacity = buf->capacity ? buf->capacity : PAYLOAD_INITIAL_CAPACITY;
+    while (capacity < needed) {
+        capacity *= 2;
+    }
+
+    char *data = realloc(buf->data, capacity);
+    if (!data) {
+        buf->failed = true;
+        return false;
+    }
+
+    buf->data = data;
+    buf->capacity = capacity;
+    return true;
+}
+
+void payload_append(payload_buffer_t *buf, const void *data, size_t len) {
+    if (!payload_reserve(buf, len)) {
+        return;
+    }
+
+    memcpy(buf->data + buf->len, data, len);
+    buf->len += len;
+    buf->data[buf->len] = '\0';
+}
+
+void payload_append_str(payload_buffer_t *buf, const char *str) { payload_append(buf, str, strlen(str)); }
+
+void payload_append_u64(payload_buffer_t *buf, uint64_t value) {
+    char digits[20];
+    size_t n = 0;
+
+    do {
+        digits[sizeof(digits) - 1 - n++] = (char)('0' + value % 10);
+        value /= 10;
+    } while (value);
+
+    payload_append(buf, digits + sizeof(digits) - n, n);
+}
+
+void payload_append_json_string(payload_buffer_t *buf, const char *str, size_t len) {
+    const uint8_t *src = (const uint8_t *)str;
+    size_t i = 0;
+
+    // Fast path: find the first character that needs escaping
+    while (i < len && !json_escape_table[src[i]]) {
+        i++;
+    }
+
+    // Worst case every remaining byte becomes a 6-byte \u00XX sequence
+    if (!payload_reserve(buf, len + 2 + (len - i) * 5)) {
+        return;
+    }
+
+    char *out = buf->data + buf->len;
+    *out++ = '"';
+    memcpy(out, src, i);
+    out += i;
+
+    while (i < len) {
+        size_t run = i;
+        while (run < len && !json_escape_table[src[run]]) {
+            run++;
+        }
+        memcpy(out, src + i, run - i);
+        out += run - i;
+        i = run;
+        if (i == len) {
+            break;
+        }
+
+        uint8_t c = src[i++];
+        *out++ = '\\';
+        switch (c) {
+        case '"':
+            *out++ = '"';
+            break;
+        case '\\':
+            *out++ = '\\';
+            break;
+        case '\n':
+            *out++ = 'n';
+            break;
+        case '\r':
+            *out++ = 'r';
+            break;
+        case '\t':
+            *out++ = 't';
+            break;
+        case '\b':
+            *out++ = 'b';
+            break;
+        case '\f':
+            *out++ = 'f';
+            break;
+        default:
+            *out++ = 'u';
+            *out++ = '0';
+            *out++ = '0';
+            *out++ = hex_digits[c >> 4];
+            *out++ = hex_digits[c & 0xf];
+            break;
+        }
+    }
+
+    *out++ = '"';
+    *out = '\0';
+    buf->len = (size_t)(out - buf->data);
+}
+
+/**
+ * Append a MessagePack type byte followed by a big-endian value of size bytes
+ */
+static void append_mp_tagged(payload_buffer_t *buf, uint8_t tag, uint64_t value, size_t size) {
+    uint8_t bytes[9];
+
+    bytes[0] = tag;
+    for (size_t i = 0; i < size; i++) {
+        bytes[size - i] = (uint8_t)(value >> (8 * i));
+    }
+    payload_append(buf, bytes, size + 1);
+}
+
+/**
+ * Append a container or string header: fixed form below fix_limit, else 16 or 32 bit length
+ */
+static void append_mp_header(payload_buffer_t *buf, uint8_t fix_tag, uint32_t fix_limit, uint8_t tag16,
+                             uint32_t count) {
+    if (count < fix_limit) {
+        append_mp_tagged(buf, (uint8_t)(fix_tag | count), 0, 0);
+    } else if (count <= 0xffff) {
+        append_mp_tagged(buf, tag16, count, 2);
+    } else {
+        append_mp_tagged(buf, (uint8_t)(tag16 + 1), count, 4);
+    }
+}
+
+void payload_append_mp_map(payload_buffer_t *buf, uint32_t count) { append_mp_header(buf, 0x80, 16, 0xde, count); }
+
+void payload_append_mp_array(payload_buffer_t *buf, uint32_t count) { append_mp_header(buf, 0x90, 16, 0xdc, count); }
+
+void payload_append_mp_uint(payload_buffer_t *buf, uint64_t value) {
+    if (value < 0x80) {
+        append_mp_tagged(buf, (uint8_t)value, 0, 0);
+    } else if (value <= 0xff) {
+        append_mp_tagged(buf, 0xcc, value, 1);
+    } else if (value <= 0xffff) {
+        append_mp_tagged(buf, 0xcd, value, 2);
+    } else if (value <= 0xffffffff) {
+        append_mp_tagged(buf, 0xce, value, 4);
+    } else {
+        append_mp_tagged(buf, 0xcf, value, 8);
+    }
+}
+
+void payload_append_mp_str(payload_buffer_t *buf, const char *str, size_t len) {
+    if (len < 32) {
+        append_mp_tagged(buf, (uint8_t)(0xa0 | len), 0, 0);
+    } else if (len <= 0xff) {
+        append_mp_tagged(buf, 0xd9, len, 1);
+    } else {
+        append_mp_header(buf, 0, 0, 0xda, (uint32_t)len);
+    }
+    payload_append(buf, str, len);
+}
+
+void payload_append_mp_bin(payload_buffer_t *buf, const void *data, size_t len) {
+    if (len <= 0xff) {
+        append_mp_tagged(buf, 0xc4, len, 1);
+    } else if (len <= 0xffff) {
+        append_mp_tagged(buf, 0xc5, len, 2);
+    } else {
+        append_mp_tagged(buf, 0xc6, len, 4);
+    }
+    payload_append(buf, data, len);
+}
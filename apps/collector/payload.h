@@ -0,0 +1,136 @@
+#ifndef PAYLOAD_H
+#define PAYLOAD_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define PAYLOAD_INITIAL_CAPACITY 4096
+
+/**
+ * Batch body format
+ */
+typedef enum {
+    PAYLOAD_FORMAT_JSON,    // {"logs":[{"msg":...}]}
+    PAYLOAD_FORMAT_MSGPACK, // MessagePack with dictionary-encoded priority/source and delta timestamps
+} payload_format_t;
+
+/**
+ * Append-only byte buffer used to build request bodies
+ * The buffer grows geometrically and is kept between batches, so
+ * serialization does not allocate once it reached its working size.
+ */
+typedef struct payload_buffer {
+    char *data;
+    size_t len;
+    size_t capacity;
+    bool failed; // Set once an allocation failed, further appends are ignored
+} payload_buffer_t;
+
+/**
+ * Parse a body format name ("json", "msgpack")
+ * @param name Format name
+ * @param format Pointer to store the format
+ * @return 0 on success, -EINVAL if unknown
+ */
+int payload_format_from_string(const char *name, payload_format_t *format);
+
+/**
+ * Name of a body format
+ */
+const char *payload_format_name(payload_format_t format);
+
+/**
+ * Content-Type header value of a body format
+ */
+const char *payload_format_content_type(payload_format_t format);
+
+/**
+ * Release the buffer memory
+ * @param buf Buffer to free
+ */
+void payload_free(payload_buffer_t *buf);
+
+/**
+ * Discard the contents but keep the allocation
+ * @param buf Buffer to reset
+ */
+void payload_reset(payload_buffer_t *buf);
+
+/**
+ * Make room for at least extra more bytes
+ * @param buf Buffer to grow
+ * @param extra Number of bytes about to be appended
+ * @return true if the space is available, false on allocation failure
+ */
+bool payload_reserve(payload_buffer_t *buf, size_t extra);
+
+/**
+ * Append raw bytes
+ * @param buf Buffer to append to
+ * @param data Bytes to append
+ * @param len Number of bytes
+ */
+void payload_append(payload_buffer_t *buf, const void *data, size_t len);
+
+/**
+ * Append a NUL-terminated string literal or constant
+ * @param buf Buffer to append to
+ * @param str String to append
+ */
+void payload_append_str(payload_buffer_t *buf, const char *str);
+
+/**
+ * Append an unsigned integer in decimal
+ * @param buf Buffer to append to
+ * @param value Value to append
+ */
+void payload_append_u64(payload_buffer_t *buf, uint64_t value);
+
+/**
+ * Append a JSON string literal (including quotes), escaping as needed
+ * Lines without characters that need escaping are copied in one go.
+ * @param buf Buffer to append to
+ * @param str String bytes
+ * @param len Number of bytes
+ */
+void payload_append_json_string(payload_buffer_t *buf, const char *str, size_t len);
+
+/**
+ * Append a MessagePack map header
+ * @param buf Buffer to append to
+ * @param count Number of key/value pairs that follow
+ */
+void payload_append_mp_map(payload_buffer_t *buf, uint32_t count);
+
+/**
+ * Append a MessagePack array header
+ * @param buf Buffer to append to
+ * @param count Number of elements that follow
+ */
+void payload_append_mp_array(payload_buffer_t *buf, uint32_t count);
+
+/**
+ * Append an unsigned integer in the smallest MessagePack encoding
+ * @param buf Buffer to append to
+ * @param value Value to append
+ */
+void payload_append_mp_uint(payload_buffer_t *buf, uint64_t value);
+
+/**
+ * Append a MessagePack string
+ * @param buf Buffer to append to
+ * @param str UTF-8 bytes
+ * @param len Number of bytes
+ */
+void payload_append_mp_str(payload_buffer_t *buf, const char *str, size_t len);
+
+/**
+ * Append MessagePack binary data (length-prefixed bytes, no encoding implied)
+ * @param buf Buffer to append to
+ * @param data Bytes to append
+ * @param len Number of bytes
+ */
+void payload_append_mp_bin(payload_buffer_t *buf, const void *data, size_t len);
+
+#endif // PAYLOAD_H
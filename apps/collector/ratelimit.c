@@ -0,0 +1,66 @@
+#include "ratelimit.h"
+#include "core/console.h"
+#include <string.h>
+
+static Console csl = {
+    .topic = "ratelimit",
+};
+
+void ratelimit_init(ratelimit_t *limiter, uint32_t rate, uint32_t burst) {
+    memset(limiter, 0, sizeof(*limiter));
+    limiter->rate = rate;
+    limiter->burst = burst ? burst : 1;
+}
+
+void ratelimit_configure(ratelimit_t *limiter, uint32_t rate, uint32_t burst) {
+    limiter->rate = rate;
+    limiter->burst = burst ? burst : 1;
+
+    // A smaller bucket takes effect right away
+    for (size_t i = 0; i < sizeof(limiter->buckets) / sizeof(limiter->buckets[0]); i++) {
+        if (limiter->buckets[i].tokens > limiter->burst) {
+            limiter->buckets[i].tokens = limiter->burst;
+        }
+    }
+}
+
+bool ratelimit_allow(ratelimit_t *limiter, uint32_t source, uint32_t origin, uint32_t priority, uint64_t now_ms) {
+    if (limiter->rate <= 0) {
+        return true;
+    }
+
+    uint32_t facility = (priority >> 3) % RATELIMIT_FACILITIES;
+    uint32_t lane = origin ? RATELIMIT_SOURCES + origin % RATELIMIT_SENDERS
+                           : source < RATELIMIT_SOURCES ? source : RATELIMIT_SOURCES - 1;
+    ratelimit_bucket_t *bucket = &limiter->buckets[lane * RATELIMIT_FACILITIES + facility];
+
+    // Refill for the time since the last message
+    if (!bucket->refilled_ms) {
+        bucket->tokens = limiter->burst;
+    } else if (now_ms > bucket->refilled_ms) {
+        bucket->tokens += (double)(now_ms - bucket->refilled_ms) * limiter->rate / 1000.0;
+        if (bucket->tokens > limiter->burst) {
+            bucket->tokens = limiter->burst;
+        }
+    }
+    bucket->refilled_ms = now_ms ? now_ms : 1;
+
+    if (bucket->tokens >= 1.0) {
+        bucket->tokens -= 1.0;
+        if (bucket->limiting) {
+            console_info(&csl, "Source %u%s facility %u below rate limit again (%llu dropped so far)", source,
+                         origin ? " (one sender)" : "", facility, (unsigned long long)bucket->dropped);
+            bucket->limiting = false;
+        }
+        return true;
+    }
+
+    if (!bucket->limiting) {
+        console_warn(&csl, "Source %u%s facility %u exceeds %.0f logs/s, dropping", source,
+                     origin ? " (one sender)" : "", facility, limiter->rate);
+        bucket->limiting = true;
+    }
+    bucket->dropped++;
+    limiter->dropped++;
+    return false;
+}
@@ -0,0 +1,62 @@
+#ifndef RATELIMIT_H
+#define RATELIMIT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define RATELIMIT_SOURCES 4     // klog, syslog, internal, remote (and anything else)
+#define RATELIMIT_SENDERS 16    // Bucket sets of remote senders, picked by their address hash
+#define RATELIMIT_FACILITIES 24 // Syslog facilities kern ... local7
+
+/**
+ * Token bucket of one source/facility pair
+ */
+typedef struct ratelimit_bucket {
+    double tokens;
+    uint64_t refilled_ms; // Last refill, 0 before the first message
+    uint64_t dropped;     // Messages dropped by this bucket
+    bool limiting;        // Currently dropping (for logging transitions)
+} ratelimit_bucket_t;
+
+/**
+ * Per source/facility rate limiter
+ * Each pair may enqueue `rate` messages per second on average, with bursts
+ * of up to `burst` messages. Remote senders get bucket sets of their own, so
+ * one chatty device does not use up the tokens of the others; senders whose
+ * address hashes collide share a set.
+ */
+typedef struct ratelimit {
+    double rate;  // Messages per second, 0 for unlimited
+    double burst; // Bucket size
+    ratelimit_bucket_t buckets[(RATELIMIT_SOURCES + RATELIMIT_SENDERS) * RATELIMIT_FACILITIES];
+    uint64_t dropped; // Messages dropped by all buckets
+} ratelimit_t;
+
+/**
+ * Initialize the limiter
+ * @param limiter Limiter to initialize
+ * @param rate Messages per second per source/facility, 0 disables limiting
+ * @param burst Bucket size (at least 1)
+ */
+void ratelimit_init(ratelimit_t *limiter, uint32_t rate, uint32_t burst);
+
+/**
+ * Change rate and burst, keeping the bucket state and counters
+ * @param limiter Limiter to update
+ * @param rate Messages per second per source/facility, 0 disables limiting
+ * @param burst Bucket size (at least 1)
+ */
+void ratelimit_configure(ratelimit_t *limiter, uint32_t rate, uint32_t burst);
+
+/**
+ * Take a token for a message
+ * @param limiter Limiter
+ * @param source Log source
+ * @param origin Hash of the remote sender address, 0 for local logs
+ * @param priority Syslog priority (the facility selects the bucket)
+ * @param now_ms Monotonic time in milliseconds
+ * @return true if the message may be enqueued, false if it is dropped
+ */
+bool ratelimit_allow(ratelimit_t *limiter, uint32_t source, uint32_t origin, uint32_t priority, uint64_t now_ms);
+
+#endif // RATELIMIT_H
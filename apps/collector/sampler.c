@@ -0,0 +1,95 @@
+#include "sampler.h"
+#include "core/console.h"
+#include <string.h>
+#include <syslog.h>
+
+static Console csl = {
+    .topic = "sampler",
+};
+
+void sampler_init(sampler_t *sampler, uint32_t watermark, uint32_t max_rate) {
+    memset(sampler, 0, sizeof(*sampler));
+    sampler->rate = 1;
+    sampler_configure(sampler, watermark, max_rate);
+}
+
+void sampler_configure(sampler_t *sampler, uint32_t watermark, uint32_t max_rate) {
+    sampler->watermark = watermark;
+    sampler->max_rate = max_rate > 1 ? max_rate : 2;
+    if (sampler->rate > sampler->max_rate) {
+        sampler->rate = sampler->max_rate;
+    }
+}
+
+/**
+ * Sampling rate for a queue fill, 1 below the watermark
+ */
+static uint32_t rate_for_fill(const sampler_t *sampler, uint32_t fill_percent) {
+    if (!sampler->watermark || fill_percent < sampler->watermark) {
+        return 1;
+    }
+
+    uint32_t step = (100 - sampler->watermark) / SAMPLER_GRADES;
+    uint32_t grade = 1 + (fill_percent - sampler->watermark) / (step ? step : 1);
+    uint32_t rate = 1;
+    while (grade-- > 0 && rate < sampler->max_rate) {
+        rate <<= 1;
+    }
+    return rate;
+}
+
+void sampler_update(sampler_t *sampler, uint32_t fill_percent) {
+    uint32_t rate = rate_for_fill(sampler, fill_percent);
+
+    // Ease off only once the queue drained a little below the grade's threshold
+    if (rate < sampler->rate) {
+        rate = rate_for_fill(sampler, fill_percent + SAMPLER_HYSTERESIS_PERCENT);
+        if (rate > sampler->rate) {
+            rate = sampler->rate;
+        }
+    }
+    if (rate == sampler->rate) {
+        return;
+    }
+
+    if (sampler->rate == 1) {
+        console_warn(&csl, "Queue at %u%%, keeping 1 in %u notice/info/debug logs", fill_percent, rate);
+        sampler->activations++;
+    } else if (rate == 1) {
+        console_info(&csl, "Queue at %u%%, sampling stopped (%llu logs sampled out so far)", fill_percent,
+                     (unsigned long long)sampler->sampled);
+    } else {
+        console_debug(&csl, "Queue at %u%%, keeping 1 in %u notice/info/debug logs", fill_percent, rate);
+    }
+    sampler->rate = rate;
+}
+
+/**
+ * Mix a 64-bit value (splitmix64 finalizer)
+ */
+static uint64_t mix64(uint64_t x) {
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ULL;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebULL;
+    x ^= x >> 31;
+    return x;
+}
+
+uint32_t sampler_keep(sampler_t *sampler, uint32_t source, uint32_t origin, uint32_t priority) {
+    if (sampler->rate <= 1 || (priority & LOG_PRIMASK) < LOG_NOTICE) {
+        return 1;
+    }
+
+    uint32_t facility = (priority >> 3) % SAMPLER_FACILITIES;
+    uint32_t lane = origin ? SAMPLER_SOURCES + origin % SAMPLER_SENDERS
+                           : source < SAMPLER_SOURCES ? source : SAMPLER_SOURCES - 1;
+    uint32_t key = lane * SAMPLER_FACILITIES + facility;
+
+    // The rate is a power of two, so the low bits pick 1 in rate
+    if ((mix64(((uint64_t)key << 48) ^ sampler->seq[key]++) & (sampler->rate - 1)) == 0) {
+        return sampler->rate;
+    }
+    sampler->sampled++;
+    return 0;
+}
@@ -0,0 +1,64 @@
+#ifndef SAMPLER_H
+#define SAMPLER_H
+
+#include <stdint.h>
+
+#define SAMPLER_SOURCES 4            // klog, syslog, internal, remote (and anything else)
+#define SAMPLER_SENDERS 16           // Sequences of remote senders, picked by their address hash
+#define SAMPLER_FACILITIES 24        // Syslog facilities kern ... local7
+#define SAMPLER_GRADES 4             // Doublings of the rate between the watermark and a full queue
+#define SAMPLER_HYSTERESIS_PERCENT 5 // Queue fill below a grade's threshold before sampling eases
+
+/**
+ * Overload sampler for low-severity logs
+ * Once the queue fills past `watermark` percent, notice, info and debug logs
+ * are kept 1 in `rate` per source/facility, starting at 1 in 2 and doubling
+ * every SAMPLER_GRADES-th of the remaining fill up to `max_rate`. Whether a
+ * log is kept is decided by a hash of its source/facility and sequence number,
+ * so a periodic pattern of messages is not sampled in step with it. Kept logs
+ * carry the rate as their weight.
+ */
+typedef struct sampler {
+    uint32_t watermark; // Queue fill percent where sampling starts, 0 disables
+    uint32_t max_rate;  // Largest sampling rate, a power of two
+    uint32_t rate;      // Current rate, 1 while not overloaded
+    uint64_t seq[(SAMPLER_SOURCES + SAMPLER_SENDERS) * SAMPLER_FACILITIES];
+    uint64_t sampled;     // Logs dropped by sampling
+    uint64_t activations; // Times the queue crossed the watermark
+} sampler_t;
+
+/**
+ * Initialize the sampler
+ * @param sampler Sampler to initialize
+ * @param watermark Queue fill percent where sampling starts, 0 disables sampling
+ * @param max_rate Largest sampling rate, a power of two
+ */
+void sampler_init(sampler_t *sampler, uint32_t watermark, uint32_t max_rate);
+
+/**
+ * Change watermark and maximum rate, keeping the counters
+ * @param sampler Sampler to update
+ * @param watermark Queue fill percent where sampling starts, 0 disables sampling
+ * @param max_rate Largest sampling rate, a power of two
+ */
+void sampler_configure(sampler_t *sampler, uint32_t watermark, uint32_t max_rate);
+
+/**
+ * Pick the sampling rate for the current queue fill
+ * @param sampler Sampler
+ * @param fill_percent Queue fill in percent of its record or byte limit
+ */
+void sampler_update(sampler_t *sampler, uint32_t fill_percent);
+
+/**
+ * Decide whether a log is kept
+ * Warnings and more severe logs are always kept with weight 1.
+ * @param sampler Sampler
+ * @param source Log source
+ * @param origin Hash of the remote sender address, 0 for local logs
+ * @param priority Syslog priority (the facility selects the sequence)
+ * @return weight of the kept log (the number of logs it stands for), 0 if it is dropped
+ */
+uint32_t sampler_keep(sampler_t *sampler, uint32_t source, uint32_t origin, uint32_t priority);
+
+#endif // SAMPLER_H
@@ -6,7 +6,9 @@ Development server for testing collector log submission functionality
 """
 
 import json
+import struct
 import time
+import zlib
 import random
 from datetime import datetime
 from http.server import HTTPServer, BaseHTTPRequestHandler
@@ -14,6 +16,73 @@ from urllib.parse import urlparse, parse_qs
 import argparse
 import threading
 
+try:
+    import zstandard
+except ImportError:
+    zstandard = None
+
+def decode_msgpack(data):
+    """Decode one MessagePack value (the subset the collector writes: maps, arrays, ints, str, bin)"""
+    def read(pos, size):
+        if pos + size > len(data):
+            raise ValueError("truncated body")
+        return data[pos:pos + size], pos + size
+
+    def value(pos):
+        tag = data[pos]
+        pos += 1
+        if tag < 0x80:
+            return tag, pos
+        if tag >= 0xe0:
+            return tag - 0x100, pos
+        if 0x80 <= tag <= 0x8f:
+            return container(pos, tag & 0x0f, True)
+        if 0x90 <= tag <= 0x9f:
+            return container(pos, tag & 0x0f, False)
+        if 0xa0 <= tag <= 0xbf:
+            raw, pos = read(pos, tag & 0x1f)
+            return raw.decode('utf-8'), pos
+        sizes = {0xcc: 'B', 0xcd: '>H', 0xce: '>I', 0xcf: '>Q', 0xd0: 'b', 0xd1: '>h', 0xd2: '>i', 0xd3: '>q'}
+        if tag in sizes:
+            fmt = sizes[tag]
+            raw, pos = read(pos, struct.calcsize(fmt))
+            return struct.unpack(fmt, raw)[0], pos
+        lengths = {0xc4: 'B', 0xc5: '>H', 0xc6: '>I', 0xd9: 'B', 0xda: '>H', 0xdb: '>I',
+                   0xdc: '>H', 0xdd: '>I', 0xde: '>H', 0xdf: '>I'}
+        if tag in lengths:
+            fmt = lengths[tag]
+            raw, pos = read(pos, struct.calcsize(fmt))
+            length = struct.unpack(fmt, raw)[0]
+            if tag in (0xdc, 0xdd):
+                return container(pos, length, False)
+            if tag in (0xde, 0xdf):
+                return container(pos, length, True)
+            raw, pos = read(pos, length)
+            return (bytes(raw) if tag <= 0xc6 else raw.decode('utf-8')), pos
+        if tag == 0xc0:
+            return None, pos
+        if tag in (0xc2, 0xc3):
+            return tag == 0xc3, pos
+        raise ValueError(f"unsupported MessagePack type 0x{tag:02x}")
+
+    def container(pos, count, is_map):
+        if is_map:
+            result = {}
+            for _ in range(count):
+                key, pos = value(pos)
+                result[key], pos = value(pos)
+        else:
+            result = []
+            for _ in range(count):
+                item, pos = value(pos)
+                result.append(item)
+        return result, pos
+
+    result, pos = value(0)
+    if pos != len(data):
+        raise ValueError(f"{len(data) - pos} trailing bytes")
+    return result
+
 class MockBackendHandler(BaseHTTPRequestHandler):
     """HTTP request handler for mock backend server"""
 
@@ -48,13 +117,32 @@ class MockBackendHandler(BaseHTTPRequestHandler):
 
             post_data = self.rfile.read(content_length)
 
-            # Parse JSON
+            # Decode compressed bodies
+            encoding = self.headers.get('Content-Encoding', '').strip().lower()
             try:
-                log_data = json.loads(post_data.decode('utf-8'))
-            except json.JSONDecodeError as e:
-                self._send_error(400, f"Invalid JSON: {e}")
+                post_data = self._decode_body(post_data, encoding)
+            except ValueError as e:
+                self._send_error(415, str(e))
+                return
+            except Exception as e:
+                self._send_error(400, f"Invalid {encoding} body: {e}")
                 return
 
+            # Parse the body by its Content-Type
+            content_type = self.headers.get('Content-Type', 'application/json').split(';')[0].strip().lower()
+            if content_type == 'application/msgpack':
+                try:
+                    log_data = self._expand_msgpack_batch(decode_msgpack(post_data))
+                except (ValueError, KeyError, IndexError, TypeError) as e:
+                    self._send_error(400, f"Invalid MessagePack: {e}")
+                    return
+            else:
+                try:
+                    log_data = json.loads(post_data.decode('utf-8'))
+                except json.JSONDecodeError as e:
+                    self._send_error(400, f"Invalid JSON: {e}")
+                    return
+
             # Validate log data structure
             if not self._validate_log_data(log_data):
                 self._send_error(400, "Invalid log data structure")
@@ -72,8 +160,16 @@ class MockBackendHandler(BaseHTTPRequestHandler):
                     self._send_error(500, "Simulated server error")
                     return
 
-            # Log the received data
-            self._log_received_data(log_data)
+            # Deduplicate retried and replayed batches by their idempotency key
+            key = self.headers.get('Idempotency-Key')
+            seen = self.server.__dict__.setdefault('seen_keys', set())
+            if key and key in seen:
+                print(f"Duplicate batch {key}, already processed")
+            else:
+                if key:
+                    seen.add(key)
+                # Log the received data
+                self._log_received_data(log_data)
 
             # Send success response
             response = {
@@ -113,6 +209,45 @@ class MockBackendHandler(BaseHTTPRequestHandler):
         }
         self._send_json_response(200, stats_data)
 
+    def _decode_body(self, data, encoding):
+        """Undo the Content-Encoding applied by the collector"""
+        if encoding in ('', 'identity'):
+            return data
+        if encoding == 'gzip':
+            return zlib.decompress(data, 16 + zlib.MAX_WBITS)
+        if encoding == 'deflate':
+            return zlib.decompress(data)
+        if encoding == 'zstd':
+            if zstandard is None:
+                raise ValueError("zstd encoding requires the 'zstandard' module")
+            return zstandard.ZstdDecompressor().decompressobj().decompress(data)
+        raise ValueError(f"Unsupported Content-Encoding: {encoding}")
+
+    def _expand_msgpack_batch(self, batch):
+        """Turn a MessagePack batch into the JSON batch structure"""
+        base_time = batch['base_time']
+        priorities = batch['priorities']
+        sources = batch['sources']
+        logs = []
+
+        for record in batch['logs']:
+            entry = {
+                'msg': record[0].decode('utf-8', errors='replace'),
+                'priority': priorities[record[1]],
+                'source': sources[record[2]],
+                'time': base_time + record[3],
+            }
+            if len(record) >= 6:
+                entry['repeat_count'] = record[4]
+                entry['last_time'] = entry['time'] + record[5]
+                if record[4] == 1:
+                    del entry['repeat_count'], entry['last_time']
+            if len(record) >= 7:
+                entry['sampled_weight'] = record[6]
+            logs.append(entry)
+
+        return {'logs': logs, 'count': batch['count'], 'collector_version': batch['collector_version']}
+
     def _validate_log_data(self, data):
         """Validate log data structure"""
         required_fields = ['logs', 'count', 'collector_version']
@@ -137,8 +272,8 @@ class MockBackendHandler(BaseHTTPRequestHandler):
         return True
 
     def _validate_log_entry(self, entry, index):
-        """Validate individual log entry"""
-        required_fields = ['program', 'message', 'timestamp']
+        """Validate individual log entry (raw logd fields)"""
+        required_fields = ['msg', 'priority', 'source', 'time']
 
         for field in required_fields:
             if field not in entry:
@@ -146,12 +281,21 @@ class MockBackendHandler(BaseHTTPRequestHandler):
                 return False
 
         # Validate data types
-        if not isinstance(entry['timestamp'], int):
-            print(f"Log entry {index}: timestamp must be integer")
+        for field in ('priority', 'source', 'time'):
+            if not isinstance(entry[field], int):
+                print(f"Log entry {index}: {field} must be integer")
+                return False
+
+        if not isinstance(entry['msg'], str):
+            print(f"Log entry {index}: msg must be a string")
             return False
 
-        if not isinstance(entry['message'], str) or len(entry['message']) == 0:
-            print(f"Log entry {index}: message must be non-empty string")
+        if 'repeat_count' in entry and not isinstance(entry['repeat_count'], int):
+            print(f"Log entry {index}: repeat_count must be integer")
+            return False
+
+        if 'sampled_weight' in entry and not isinstance(entry['sampled_weight'], int):
+            print(f"Log entry {index}: sampled_weight must be integer")
             return False
 
         return True
@@ -174,12 +318,15 @@ class MockBackendHandler(BaseHTTPRequestHandler):
         # Print log details in verbose mode
         if self.config.get('verbose', False):
             for i, log_entry in enumerate(data.get('logs', [])):
-                program = log_entry.get('program', 'unknown')
-                message = log_entry.get('message', '')
-                facility = log_entry.get('facility', '')
-                priority = log_entry.get('priority', '')
-
-                print(f"  [{i+1}] {program}.{facility}.{priority}: {message[:100]}")
+                priority = log_entry.get('priority', 0)
+                source = 'kernel' if log_entry.get('source') == 0 else 'syslog'
+                message = log_entry.get('msg', '')
+                repeats = log_entry.get('repeat_count')
+                weight = log_entry.get('sampled_weight')
+                suffix = f" (x{repeats})" if repeats else ''
+                suffix += f" (1 of {weight})" if weight else ''
+
+                print(f"  [{i+1}] {source} {priority >> 3}.{priority & 7}: {message[:100]}{suffix}")
 
     def _send_json_response(self, status_code, data):
         """Send JSON response"""
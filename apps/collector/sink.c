@@ -0,0 +1,90 @@
+#include "sink.h"
+#include "core/console.h"
+#include <errno.h>
+#include <string.h>
+
+static Console csl = {
+    .topic = "sink",
+};
+
+int sink_parse_type(const char *name, sink_type_t *type) {
+    if (!name || !type) {
+        return -EINVAL;
+    }
+
+    if (strcmp(name, "file") == 0) {
+        *type = SINK_FILE;
+    } else if (strcmp(name, "mqtt") == 0) {
+        *type = SINK_MQTT;
+    } else {
+        return -EINVAL;
+    }
+
+    return 0;
+}
+
+const char *sink_type_name(sink_type_t type) {
+    switch (type) {
+    case SINK_FILE:
+        return "file";
+    case SINK_MQTT:
+        return "mqtt";
+    default:
+        return "unknown";
+    }
+}
+
+int sink_write(sink_t *sink, const sink_batch_t *batch, void *owner) {
+    int ret = sink->ops->write(sink, batch, owner);
+
+    if (ret == 0) {
+        sink->stats.batches++;
+        sink->stats.bytes += batch->len;
+    } else if (ret == -EAGAIN) {
+        sink->stats.dropped++;
+    } else {
+        sink->stats.errors++;
+    }
+    return ret;
+}
+
+void sink_close(sink_t *sink) {
+    if (sink) {
+        sink->ops->close(sink);
+    }
+}
+
+void sink_set_open(sink_set_t *set, const sink_config_t *configs, uint32_t count) {
+    memset(set, 0, sizeof(*set));
+
+    for (uint32_t i = 0; i < count && set->count < SINK_MAX; i++) {
+        const sink_config_t *config = &configs[i];
+        sink_t *sink = config->type == SINK_FILE ? sink_file_open(config) : sink_mqtt_open(config);
+
+        if (!sink) {
+            console_warn(&csl, "Sink %s (%s) unavailable, batches are not copied to it", config->name,
+                         sink_type_name(config->type));
+            continue;
+        }
+
+        set->sinks[set->count++] = sink;
+        console_info(&csl, "Copying batches to %s sink %s", sink_type_name(config->type), config->name);
+    }
+}
+
+void sink_set_write(sink_set_t *set, const sink_batch_t *batch) {
+    for (uint32_t i = 0; i < set->count; i++) {
+        int ret = sink_write(set->sinks[i], batch, NULL);
+        if (ret < 0 && ret != -EAGAIN) {
+            console_debug(&csl, "Sink %s failed to take a batch of %u logs: %s", set->sinks[i]->name, batch->count,
+                          strerror(-ret));
+        }
+    }
+}
+
+void sink_set_close(sink_set_t *set) {
+    for (uint32_t i = 0; i < set->count; i++) {
+        sink_close(set->sinks[i]);
+    }
+    memset(set, 0, sizeof(*set));
+}
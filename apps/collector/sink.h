@@ -0,0 +1,182 @@
+#ifndef SINK_H
+#define SINK_H
+
+#include "compress.h"
+#include "payload.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define SINK_MAX 4 // Mirror sinks ("config sink" sections)
+#define SINK_NAME_SIZE 32
+
+typedef enum {
+    SINK_FILE, // Rotating local file
+    SINK_MQTT, // Publish to a local broker
+} sink_type_t;
+
+/**
+ * Mirror sink as loaded from a "config sink" section
+ */
+typedef struct sink_config {
+    char name[SINK_NAME_SIZE];
+    sink_type_t type;
+
+    // File sink
+    char path[128];       // File batches are appended to
+    uint32_t max_size_kb; // Rotate once the file would grow beyond this
+    uint32_t files;       // Rotated files kept next to it (<path>.1 is the newest)
+
+    // MQTT sink
+    char host[64];
+    uint32_t port;
+    char topic[128];
+    char client_id[64]; // Empty for "fry-collector-<name>"
+    uint32_t keepalive; // Seconds
+    uint32_t queue_kb;  // Bytes published but not yet written to the socket, batches beyond are dropped
+} sink_config_t;
+
+/**
+ * A serialized batch as handed to every sink
+ * The body is shared, sinks copy what they need to keep beyond the call.
+ */
+typedef struct sink_batch {
+    const uint8_t *body;
+    size_t len;
+    payload_format_t format;     // Content-Type of the body
+    compression_t encoding;      // Content-Encoding of the body
+    uint32_t count;              // Log records in the batch
+    const char *idempotency_key; // "<instance>-<seq>", identical across retries and spool replays
+} sink_batch_t;
+
+/**
+ * Outcome of an acknowledged write
+ */
+typedef struct sink_result {
+    int error;               // 0 delivered, -EACCES token refused, -EBADMSG refused for good, else transient
+    long status;             // Protocol status (HTTP code), 0 if there was no response
+    double duration_ms;      // Dispatch to completion
+    uint32_t retry_after_ms; // Delay requested by the receiver (HTTP Retry-After), 0 if none
+    const char *message;     // Human readable transport error (valid during callback only)
+} sink_result_t;
+
+/**
+ * Per sink counters
+ */
+typedef struct sink_stats {
+    uint64_t batches;      // Batches accepted
+    uint64_t bytes;        // Body bytes accepted
+    uint64_t errors;       // Writes or deliveries that failed
+    uint64_t dropped;      // Batches refused by backpressure (queue full, not connected)
+    uint32_t queued_bytes; // Bytes accepted but not yet handed to the OS
+    bool connected;        // Sink can take batches right now
+} sink_stats_t;
+
+typedef struct sink sink_t;
+
+/**
+ * Completion of an acknowledged write, called from uloop
+ * @param owner Owner passed to sink_write()
+ */
+typedef void (*sink_complete_cb)(sink_t *sink, void *owner, const sink_result_t *result);
+
+/**
+ * Sink implementation
+ */
+typedef struct sink_ops {
+    const char *type;
+
+    /**
+     * Take a batch
+     * Acknowledged sinks report the outcome through the complete callback
+     * later; the others are done with the batch when this returns.
+     * @return 0 if accepted, -EAGAIN if the sink is busy, other negative error code on failure
+     */
+    int (*write)(sink_t *sink, const sink_batch_t *batch, void *owner);
+
+    /**
+     * Abort pending writes and free the sink
+     */
+    void (*close)(sink_t *sink);
+} sink_ops_t;
+
+/**
+ * Output stage a batch is delivered to
+ */
+struct sink {
+    const sink_ops_t *ops;
+    char name[SINK_NAME_SIZE];
+    sink_complete_cb complete; // Acknowledged sinks only
+    sink_stats_t stats;
+};
+
+/**
+ * Mirror sinks every serialized batch is copied to
+ */
+typedef struct sink_set {
+    sink_t *sinks[SINK_MAX];
+    uint32_t count;
+} sink_set_t;
+
+/**
+ * Parse a sink type name ("file", "mqtt")
+ * @return 0 on success, -EINVAL if unknown
+ */
+int sink_parse_type(const char *name, sink_type_t *type);
+
+/**
+ * Name of a sink type
+ */
+const char *sink_type_name(sink_type_t type);
+
+/**
+ * Hand a batch to a sink and account for it
+ * @return see sink_ops_t.write
+ */
+int sink_write(sink_t *sink, const sink_batch_t *batch, void *owner);
+
+/**
+ * Close a sink and free it
+ */
+void sink_close(sink_t *sink);
+
+/**
+ * Open the mirror sinks of a configuration
+ * A sink that fails to open is skipped with a warning.
+ * @param set Set to initialize
+ * @param configs Sink sections
+ * @param count Number of sections
+ */
+void sink_set_open(sink_set_t *set, const sink_config_t *configs, uint32_t count);
+
+/**
+ * Copy a batch to every mirror sink
+ * Backpressure of one sink never holds up the others or the upload.
+ */
+void sink_set_write(sink_set_t *set, const sink_batch_t *batch);
+
+/**
+ * Close every sink of the set
+ */
+void sink_set_close(sink_set_t *set);
+
+/**
+ * Open the HTTP sink posting batches to the configured logs endpoint
+ * @param complete Called with the outcome of every write
+ * @return sink or NULL on failure
+ */
+sink_t *sink_http_open(sink_complete_cb complete);
+
+/**
+ * Open a rotating file sink
+ * @return sink or NULL on failure
+ */
+sink_t *sink_file_open(const sink_config_t *config);
+
+/**
+ * Open an MQTT sink publishing to a broker (QoS 0)
+ * @return sink or NULL on failure
+ */
+sink_t *sink_mqtt_open(const sink_config_t *config);
+
+#endif // SINK_H
@@ -0,0 +1,151 @@
+#include "core/console.h"
+#include "sink.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+static Console csl = {
+    .topic = "sink-file",
+};
+
+/**
+ * Rotating file sink
+ * Each batch body is appended as written to the uplink: one JSON document
+ * per line without compression, concatenated gzip members or zstd frames
+ * with it (both decompress as a single stream). MessagePack bodies are
+ * self-delimiting and appended back to back. Once the file would exceed
+ * its size it is renamed to <path>.1, older copies shift up to <path>.<files>.
+ */
+typedef struct file_sink {
+    sink_t base;
+    char path[128];
+    uint64_t max_size;
+    uint32_t files;
+    int fd;
+    uint64_t size;
+} file_sink_t;
+
+/**
+ * Open (or create) the current file and pick up its size
+ */
+static int open_file(file_sink_t *file) {
+    struct stat st;
+
+    file->fd = open(file->path, O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC, 0640);
+    if (file->fd < 0) {
+        return -errno;
+    }
+
+    file->size = fstat(file->fd, &st) == 0 ? (uint64_t)st.st_size : 0;
+    file->base.stats.connected = true;
+    return 0;
+}
+
+/**
+ * Shift the rotated copies up by one and start a new file
+ */
+static int rotate_file(file_sink_t *file) {
+    char from[sizeof(file->path) + 12];
+    char to[sizeof(file->path) + 12];
+
+    close(file->fd);
+    file->fd = -1;
+
+    if (file->files == 0) {
+        unlink(file->path);
+    } else {
+        for (uint32_t i = file->files - 1; i > 0; i--) {
+            snprintf(from, sizeof(from), "%s.%u", file->path, i);
+            snprintf(to, sizeof(to), "%s.%u", file->path, i + 1);
+            rename(from, to);
+        }
+        snprintf(to, sizeof(to), "%s.1", file->path);
+        if (rename(file->path, to) < 0) {
+            console_warn(&csl, "Failed to rotate %s: %s", file->path, strerror(errno));
+        }
+    }
+
+    return open_file(file);
+}
+
+static int file_sink_write(sink_t *sink, const sink_batch_t *batch, void *owner) {
+    file_sink_t *file = (file_sink_t *)sink;
+    bool newline = batch->format == PAYLOAD_FORMAT_JSON && batch->encoding == COMPRESSION_NONE;
+    size_t len = batch->len + (newline ? 1 : 0);
+    int ret;
+
+    if (file->fd < 0 && (ret = open_file(file)) < 0) {
+        return ret;
+    }
+
+    if (file->size > 0 && file->size + len > file->max_size && (ret = rotate_file(file)) < 0) {
+        console_error(&csl, "Failed to reopen %s: %s", file->path, strerror(-ret));
+        file->base.stats.connected = false;
+        return ret;
+    }
+
+    struct iovec iov[2] = {
+        {.iov_base = (void *)batch->body, .iov_len = batch->len},
+        {.iov_base = "\n", .iov_len = 1},
+    };
+    ssize_t written = writev(file->fd, iov, newline ? 2 : 1);
+    if (written < 0) {
+        ret = -errno;
+        console_warn(&csl, "Failed to write %zu bytes to %s: %s", len, file->path, strerror(errno));
+        return ret;
+    }
+
+    // A short write leaves a torn batch at the end, the next one starts on a fresh line after rotation
+    file->size += (uint64_t)written;
+    if ((size_t)written < len) {
+        console_warn(&csl, "Short write to %s (%zd of %zu bytes)", file->path, written, len);
+        file->size = file->max_size;
+        return -ENOSPC;
+    }
+
+    return 0;
+}
+
+static void file_sink_close(sink_t *sink) {
+    file_sink_t *file = (file_sink_t *)sink;
+
+    if (file->fd >= 0) {
+        close(file->fd);
+    }
+    free(file);
+}
+
+static const sink_ops_t file_sink_ops = {
+    .type = "file",
+    .write = file_sink_write,
+    .close = file_sink_close,
+};
+
+sink_t *sink_file_open(const sink_config_t *config) {
+    file_sink_t *file = calloc(1, sizeof(*file));
+    if (!file) {
+        return NULL;
+    }
+
+    file->base.ops = &file_sink_ops;
+    snprintf(file->base.name, sizeof(file->base.name), "%s", config->name);
+    snprintf(file->path, sizeof(file->path), "%s", config->path);
+    file->max_size = (uint64_t)config->max_size_kb * 1024;
+    file->files = config->files;
+
+    int ret = open_file(file);
+    if (ret < 0) {
+        console_error(&csl, "Failed to open %s: %s", file->path, strerror(-ret));
+        free(file);
+        return NULL;
+    }
+
+    console_debug(&csl, "Appending batches to %s (%u KB, %u rotated files, %llu bytes present)", file->path,
+                  config->max_size_kb, file->files, (unsigned long long)file->size);
+    return &file->base;
+}
@@ -0,0 +1,182 @@
+#include "config.h"
+#include "core/console.h"
+#include "http_client.h"
+#include "sink.h"
+#include "ubus.h"
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static Console csl = {
+    .topic = "sink-http",
+};
+
+#define HTTP_SINK_REQUESTS (MAX_INFLIGHT_BATCHES + 1) // Live batches plus the spool replay
+#define HTTP_RETRY_AFTER_MAX_S 3600                   // Longer Retry-After values are capped
+
+/**
+ * HTTP sink, posts batches to the logs endpoint
+ * Requests run on the shared curl multi handle; each write takes one of a
+ * fixed set of request slots until the transfer completes.
+ */
+typedef struct http_sink {
+    sink_t base;
+    http_request_t requests[HTTP_SINK_REQUESTS];
+    void *owners[HTTP_SINK_REQUESTS];
+    uint32_t lengths[HTTP_SINK_REQUESTS];
+} http_sink_t;
+
+/**
+ * Build the request headers for a batch upload
+ * @return header list (owned by caller) or NULL on failure
+ */
+static struct curl_slist *build_request_headers(const char *access_token, payload_format_t format,
+                                                compression_t compression, const char *idempotency_key) {
+    struct curl_slist *headers = NULL;
+    struct curl_slist *tmp;
+    char type_header[64];
+    char auth_header[600]; // Token + "Authorization: Bearer " prefix
+    char key_header[64];
+    char encoding_header[64];
+    const char *encoding = compression_content_encoding(compression);
+
+    snprintf(type_header, sizeof(type_header), "Content-Type: %s", payload_format_content_type(format));
+    snprintf(auth_header, sizeof(auth_header), "Authorization: Bearer %s", access_token);
+    snprintf(key_header, sizeof(key_header), "Idempotency-Key: %s", idempotency_key);
+    snprintf(encoding_header, sizeof(encoding_header), "Content-Encoding: %s", encoding ? encoding : "");
+
+    const char *lines[] = {type_header, "User-Agent: fry-collector/1.0", auth_header, key_header,
+                           encoding ? encoding_header : NULL};
+    for (size_t i = 0; i < sizeof(lines) / sizeof(lines[0]) && lines[i]; i++) {
+        tmp = curl_slist_append(headers, lines[i]);
+        if (!tmp) {
+            curl_slist_free_all(headers);
+            return NULL;
+        }
+        headers = tmp;
+    }
+
+    return headers;
+}
+
+/**
+ * Transfer completed, classify the response and hand it to the owner
+ */
+static void request_complete_cb(http_request_t *request, const http_response_t *response) {
+    http_sink_t *http = request->priv;
+    size_t slot = (size_t)(request - http->requests);
+    sink_result_t result = {
+        .status = response->status_code,
+        .duration_ms = response->duration_ms,
+        .message = response->error,
+    };
+
+    if (response->retry_after_s > 0) {
+        long retry_after_s = response->retry_after_s < HTTP_RETRY_AFTER_MAX_S ? response->retry_after_s
+                                                                              : HTTP_RETRY_AFTER_MAX_S;
+        result.retry_after_ms = (uint32_t)retry_after_s * 1000;
+    }
+
+    if (response->curl_code != CURLE_OK) {
+        result.status = 0;
+        result.error = -EIO;
+    } else if (response->status_code >= 200 && response->status_code < 300) {
+        result.error = 0;
+    } else if (response->status_code == 401) {
+        result.error = -EACCES;
+    } else if (response->status_code >= 400 && response->status_code < 500 && response->status_code != 408 &&
+               response->status_code != 429) {
+        result.error = -EBADMSG;
+    } else {
+        result.error = -EREMOTEIO;
+    }
+
+    http->base.stats.queued_bytes -= http->lengths[slot];
+    http->base.stats.connected = result.error == 0;
+    if (result.error < 0) {
+        http->base.stats.errors++;
+    }
+
+    void *owner = http->owners[slot];
+    http->owners[slot] = NULL;
+    http->base.complete(&http->base, owner, &result);
+}
+
+static int http_sink_write(sink_t *sink, const sink_batch_t *batch, void *owner) {
+    http_sink_t *http = (http_sink_t *)sink;
+    http_request_t *request = NULL;
+    size_t slot;
+
+    for (slot = 0; slot < HTTP_SINK_REQUESTS; slot++) {
+        if (!http->requests[slot].in_flight) {
+            request = &http->requests[slot];
+            break;
+        }
+    }
+    if (!request) {
+        return -EAGAIN;
+    }
+
+    // Get cached access token
+    const char *access_token = ubus_get_current_token();
+    if (!access_token) {
+        console_warn(&csl, "No valid access token available, aborting HTTP request");
+        return -EACCES;
+    }
+
+    struct curl_slist *headers = build_request_headers(access_token, batch->format, batch->encoding,
+                                                       batch->idempotency_key);
+    if (!headers) {
+        console_error(&csl, "Failed to add authorization header");
+        return -ENOMEM;
+    }
+
+    request->priv = http;
+    int ret = http_client_post(request, config_get_logs_endpoint(), headers, (const char *)batch->body, batch->len,
+                               request_complete_cb);
+    if (ret < 0) {
+        console_error(&csl, "Failed to dispatch HTTP request: %d", ret);
+        return ret;
+    }
+
+    http->owners[slot] = owner;
+    http->lengths[slot] = (uint32_t)batch->len;
+    http->base.stats.queued_bytes += (uint32_t)batch->len;
+    return 0;
+}
+
+static void http_sink_close(sink_t *sink) {
+    http_sink_t *http = (http_sink_t *)sink;
+
+    for (size_t i = 0; i < HTTP_SINK_REQUESTS; i++) {
+        http_client_release(&http->requests[i]);
+    }
+    http_client_cleanup();
+    free(http);
+}
+
+static const sink_ops_t http_sink_ops = {
+    .type = "http",
+    .write = http_sink_write,
+    .close = http_sink_close,
+};
+
+sink_t *sink_http_open(sink_complete_cb complete) {
+    http_sink_t *http = calloc(1, sizeof(*http));
+    if (!http) {
+        return NULL;
+    }
+
+    if (http_client_init() < 0) {
+        console_error(&csl, "Failed to initialize HTTP client");
+        free(http);
+        return NULL;
+    }
+
+    http->base.ops = &http_sink_ops;
+    snprintf(http->base.name, sizeof(http->base.name), "http");
+    http->base.complete = complete;
+    http->base.stats.connected = true;
+    return &http->base;
+}
@@ -0,0 +1,264 @@
+#include "core/console.h"
+#include "sink.h"
+#include <errno.h>
+#include <libubox/uloop.h>
+#include <mosquitto.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static Console csl = {
+    .topic = "sink-mqtt",
+};
+
+#define MQTT_PENDING_MAX 64        // Publishes not yet written to the socket
+#define MQTT_MISC_INTERVAL_MS 1000 // Keepalive and timeout handling
+#define MQTT_RECONNECT_DELAY_MS 5000
+
+/**
+ * MQTT sink, publishes every batch body to one topic with QoS 0
+ * libmosquitto runs on the collector's event loop: the socket is a uloop fd
+ * and a timer drives keepalives. Batches are only published while the
+ * broker connection is up and the bytes not yet written to the socket stay
+ * below queue_kb; anything else is dropped so a slow or missing broker never
+ * holds up the upload path.
+ */
+typedef struct mqtt_sink {
+    sink_t base;
+    struct mosquitto *mosq;
+    char host[64];
+    int port;
+    char topic[128];
+    int keepalive;
+    uint32_t queue_limit;
+
+    struct uloop_fd fd;
+    struct uloop_timeout timer; // Keepalive while connected, reconnect delay otherwise
+    bool socket_open;           // fd is registered with uloop
+    bool connected;             // CONNACK received
+
+    // Sizes of the publishes libmosquitto has queued, QoS 0 ones are written in order
+    uint32_t pending[MQTT_PENDING_MAX];
+    uint32_t pending_head;
+    uint32_t pending_count;
+} mqtt_sink_t;
+
+static void connection_lost(mqtt_sink_t *mqtt, int rc);
+
+/**
+ * Watch the socket for writes only while libmosquitto has data queued
+ */
+static void update_fd(mqtt_sink_t *mqtt) {
+    int sock = mosquitto_socket(mqtt->mosq);
+
+    if (sock < 0) {
+        return;
+    }
+
+    if (mqtt->socket_open && mqtt->fd.fd != sock) {
+        uloop_fd_delete(&mqtt->fd);
+        mqtt->socket_open = false;
+    }
+
+    mqtt->fd.fd = sock;
+    uloop_fd_add(&mqtt->fd, ULOOP_READ | (mosquitto_want_write(mqtt->mosq) ? ULOOP_WRITE : 0));
+    mqtt->socket_open = true;
+}
+
+/**
+ * Forget publishes that will never be written
+ */
+static void drop_pending(mqtt_sink_t *mqtt) {
+    mqtt->base.stats.dropped += mqtt->pending_count;
+    mqtt->base.stats.queued_bytes = 0;
+    mqtt->pending_head = 0;
+    mqtt->pending_count = 0;
+}
+
+static void on_connect(struct mosquitto *mosq, void *obj, int rc) {
+    mqtt_sink_t *mqtt = obj;
+
+    if (rc) {
+        console_warn(&csl, "Broker %s:%d refused sink %s: %s", mqtt->host, mqtt->port, mqtt->base.name,
+                     mosquitto_connack_string(rc));
+        return;
+    }
+
+    console_info(&csl, "Sink %s connected to %s:%d", mqtt->base.name, mqtt->host, mqtt->port);
+    mqtt->connected = true;
+    mqtt->base.stats.connected = true;
+}
+
+static void on_disconnect(struct mosquitto *mosq, void *obj, int rc) {
+    mqtt_sink_t *mqtt = obj;
+
+    mqtt->connected = false;
+    mqtt->base.stats.connected = false;
+}
+
+/**
+ * A QoS 0 publish is reported once it was written to the socket
+ */
+static void on_publish(struct mosquitto *mosq, void *obj, int mid) {
+    mqtt_sink_t *mqtt = obj;
+
+    if (mqtt->pending_count > 0) {
+        mqtt->base.stats.queued_bytes -= mqtt->pending[mqtt->pending_head];
+        mqtt->pending_head = (mqtt->pending_head + 1) % MQTT_PENDING_MAX;
+        mqtt->pending_count--;
+    }
+}
+
+static void socket_cb(struct uloop_fd *fd, unsigned int events) {
+    mqtt_sink_t *mqtt = container_of(fd, mqtt_sink_t, fd);
+    int rc = MOSQ_ERR_SUCCESS;
+
+    if (events & ULOOP_READ) {
+        rc = mosquitto_loop_read(mqtt->mosq, 1);
+    }
+    if (rc == MOSQ_ERR_SUCCESS && (events & ULOOP_WRITE)) {
+        rc = mosquitto_loop_write(mqtt->mosq, 1);
+    }
+
+    if (rc != MOSQ_ERR_SUCCESS) {
+        connection_lost(mqtt, rc);
+        return;
+    }
+    update_fd(mqtt);
+}
+
+static void timer_cb(struct uloop_timeout *timeout) {
+    mqtt_sink_t *mqtt = container_of(timeout, mqtt_sink_t, timer);
+    int rc;
+
+    if (mqtt->socket_open) {
+        rc = mosquitto_loop_misc(mqtt->mosq);
+    } else {
+        rc = mosquitto_reconnect_async(mqtt->mosq);
+    }
+
+    if (rc != MOSQ_ERR_SUCCESS) {
+        connection_lost(mqtt, rc);
+        return;
+    }
+
+    update_fd(mqtt);
+    uloop_timeout_set(&mqtt->timer, MQTT_MISC_INTERVAL_MS);
+}
+
+/**
+ * Tear down the socket and retry after a delay
+ */
+static void connection_lost(mqtt_sink_t *mqtt, int rc) {
+    if (mqtt->connected || mqtt->socket_open) {
+        console_warn(&csl, "Sink %s lost %s:%d: %s, reconnecting in %d ms", mqtt->base.name, mqtt->host, mqtt->port,
+                     mosquitto_strerror(rc), MQTT_RECONNECT_DELAY_MS);
+    }
+
+    if (mqtt->socket_open) {
+        uloop_fd_delete(&mqtt->fd);
+        mqtt->socket_open = false;
+    }
+    mqtt->connected = false;
+    mqtt->base.stats.connected = false;
+    drop_pending(mqtt);
+    uloop_timeout_set(&mqtt->timer, MQTT_RECONNECT_DELAY_MS);
+}
+
+static int mqtt_sink_write(sink_t *sink, const sink_batch_t *batch, void *owner) {
+    mqtt_sink_t *mqtt = (mqtt_sink_t *)sink;
+
+    if (!mqtt->connected || mqtt->pending_count == MQTT_PENDING_MAX ||
+        mqtt->base.stats.queued_bytes + batch->len > mqtt->queue_limit) {
+        return -EAGAIN;
+    }
+
+    // Record the publish before handing it over, it may be written (and reported) right away
+    mqtt->pending[(mqtt->pending_head + mqtt->pending_count) % MQTT_PENDING_MAX] = (uint32_t)batch->len;
+    mqtt->pending_count++;
+    mqtt->base.stats.queued_bytes += (uint32_t)batch->len;
+
+    int rc = mosquitto_publish(mqtt->mosq, NULL, mqtt->topic, (int)batch->len, batch->body, 0, false);
+    if (rc != MOSQ_ERR_SUCCESS) {
+        // Nothing was queued for this batch
+        mqtt->pending_count--;
+        mqtt->base.stats.queued_bytes -= (uint32_t)batch->len;
+        connection_lost(mqtt, rc);
+        return -EIO;
+    }
+
+    update_fd(mqtt);
+    return 0;
+}
+
+static void mqtt_sink_close(sink_t *sink) {
+    mqtt_sink_t *mqtt = (mqtt_sink_t *)sink;
+
+    uloop_timeout_cancel(&mqtt->timer);
+    if (mqtt->connected) {
+        mosquitto_disconnect(mqtt->mosq);
+    }
+    if (mqtt->socket_open) {
+        uloop_fd_delete(&mqtt->fd);
+    }
+    mosquitto_destroy(mqtt->mosq);
+    mosquitto_lib_cleanup();
+    free(mqtt);
+}
+
+static const sink_ops_t mqtt_sink_ops = {
+    .type = "mqtt",
+    .write = mqtt_sink_write,
+    .close = mqtt_sink_close,
+};
+
+sink_t *sink_mqtt_open(const sink_config_t *config) {
+    char client_id[sizeof(config->client_id)];
+
+    mqtt_sink_t *mqtt = calloc(1, sizeof(*mqtt));
+    if (!mqtt) {
+        return NULL;
+    }
+
+    mqtt->base.ops = &mqtt_sink_ops;
+    snprintf(mqtt->base.name, sizeof(mqtt->base.name), "%s", config->name);
+    snprintf(mqtt->host, sizeof(mqtt->host), "%s", config->host);
+    snprintf(mqtt->topic, sizeof(mqtt->topic), "%s", config->topic);
+    mqtt->port = (int)config->port;
+    mqtt->keepalive = (int)config->keepalive;
+    mqtt->queue_limit = config->queue_kb * 1024;
+    mqtt->fd.cb = socket_cb;
+    mqtt->timer.cb = timer_cb;
+
+    if (config->client_id[0]) {
+        snprintf(client_id, sizeof(client_id), "%s", config->client_id);
+    } else {
+        snprintf(client_id, sizeof(client_id), "fry-collector-%s", config->name);
+    }
+
+    mosquitto_lib_init();
+    mqtt->mosq = mosquitto_new(client_id, true, mqtt);
+    if (!mqtt->mosq) {
+        console_error(&csl, "Failed to create MQTT client for sink %s", config->name);
+        mosquitto_lib_cleanup();
+        free(mqtt);
+        return NULL;
+    }
+
+    mosquitto_connect_callback_set(mqtt->mosq, on_connect);
+    mosquitto_disconnect_callback_set(mqtt->mosq, on_disconnect);
+    mosquitto_publish_callback_set(mqtt->mosq, on_publish);
+
+    // The broker may come up after the collector, keep retrying in the background
+    int rc = mosquitto_connect_async(mqtt->mosq, mqtt->host, mqtt->port, mqtt->keepalive);
+    if (rc != MOSQ_ERR_SUCCESS) {
+        connection_lost(mqtt, rc);
+    } else {
+        update_fd(mqtt);
+        uloop_timeout_set(&mqtt->timer, MQTT_MISC_INTERVAL_MS);
+    }
+
+    console_debug(&csl, "Publishing batches to %s:%d topic %s as %s (queue %u KB)", mqtt->host, mqtt->port,
+                  mqtt->topic, client_id, config->queue_kb);
+    return &mqtt->base;
+}
@@ -0,0 +1,542 @@
+#include "spool.h"
+#include "core/console.h"
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <zlib.h>
+
+static Console csl = {
+    .topic = "spool",
+};
+
+#define ALIGN_UP(x) (((x) + SPOOL_ALIGN - 1) & ~(uint32_t)(SPOOL_ALIGN - 1))
+#define SEGMENT_DATA_OFFSET ALIGN_UP((uint32_t)sizeof(spool_segment_header_t))
+#define SEGMENT_NAME_FMT "%08x.seg"
+
+static inline uint32_t record_size(uint32_t len) { return ALIGN_UP((uint32_t)sizeof(spool_record_t) + len); }
+
+static inline spool_segment_header_t *segment_header(const spool_segment_t *seg) {
+    return (spool_segment_header_t *)seg->map;
+}
+
+static void segment_path(const spool_t *spool, uint32_t id, char *path, size_t size) {
+    snprintf(path, size, "%s/" SEGMENT_NAME_FMT, spool->dir, id);
+}
+
+/**
+ * Create the spool directory including missing parents
+ */
+static int mkdir_p(const char *dir) {
+    char path[sizeof(((spool_t *)0)->dir)];
+
+    strncpy(path, dir, sizeof(path) - 1);
+    path[sizeof(path) - 1] = '\0';
+
+    for (char *p = path + 1; *p; p++) {
+        if (*p != '/') {
+            continue;
+        }
+        *p = '\0';
+        if (mkdir(path, 0700) < 0 && errno != EEXIST) {
+            return -errno;
+        }
+        *p = '/';
+    }
+
+    if (mkdir(path, 0700) < 0 && errno != EEXIST) {
+        return -errno;
+    }
+    return 0;
+}
+
+/**
+ * Map a segment file, creating and sizing it if requested
+ */
+static int segment_map(spool_t *spool, uint32_t id, bool create, spool_segment_t *seg) {
+    char path[sizeof(spool->dir) + 16];
+    struct stat st;
+    int ret;
+
+    segment_path(spool, id, path, sizeof(path));
+
+    int fd = open(path, O_RDWR | O_CLOEXEC | (create ? O_CREAT | O_EXCL : 0), 0600);
+    if (fd < 0) {
+        return -errno;
+    }
+
+    if (create && ftruncate(fd, spool->segment_size) < 0) {
+        ret = -errno;
+        goto fail;
+    }
+
+    if (fstat(fd, &st) < 0) {
+        ret = -errno;
+        goto fail;
+    }
+
+    if (st.st_size < (off_t)SEGMENT_DATA_OFFSET || st.st_size > UINT32_MAX) {
+        ret = -EBADMSG;
+        goto fail;
+    }
+
+    uint8_t *map = mmap(NULL, (size_t)st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (map == MAP_FAILED) {
+        ret = -errno;
+        goto fail;
+    }
+
+    seg->id = id;
+    seg->fd = fd;
+    seg->map = map;
+    seg->size = (uint32_t)st.st_size;
+
+    spool_segment_header_t *header = segment_header(seg);
+    if (create) {
+        header->version = SPOOL_VERSION;
+        header->size = seg->size;
+        header->read_off = SEGMENT_DATA_OFFSET;
+        header->magic = SPOOL_SEGMENT_MAGIC;
+    } else if (header->magic != SPOOL_SEGMENT_MAGIC || header->version != SPOOL_VERSION ||
+               header->size != seg->size || header->read_off < SEGMENT_DATA_OFFSET || header->read_off > seg->size) {
+        munmap(map, seg->size);
+        seg->map = NULL;
+        ret = -EBADMSG;
+        goto fail;
+    }
+
+    return 0;
+
+fail:
+    if (create) {
+        unlink(path);
+    }
+    close(fd);
+    seg->fd = -1;
+    return ret;
+}
+
+static void segment_unmap(spool_segment_t *seg) {
+    if (seg->map) {
+        munmap(seg->map, seg->size);
+        seg->map = NULL;
+    }
+    if (seg->fd >= 0) {
+        close(seg->fd);
+        seg->fd = -1;
+    }
+}
+
+static void segment_remove(spool_t *spool, uint32_t id) {
+    char path[sizeof(spool->dir) + 16];
+
+    segment_path(spool, id, path, sizeof(path));
+    if (unlink(path) < 0 && errno != ENOENT) {
+        console_warn(&csl, "Failed to remove segment %s: %s", path, strerror(errno));
+    }
+}
+
+/**
+ * Get the record at an offset if it is complete and intact
+ */
+static const spool_record_t *record_at(const spool_segment_t *seg, uint32_t off, uint32_t end) {
+    if (off + sizeof(spool_record_t) > end) {
+        return NULL;
+    }
+
+    const spool_record_t *record = (const spool_record_t *)(seg->map + off);
+    if (record->magic != SPOOL_RECORD_MAGIC || record->len > end - off - sizeof(spool_record_t)) {
+        return NULL;
+    }
+
+    if (crc32(0L, (const Bytef *)(record + 1), record->len) != record->crc) {
+        console_warn(&csl, "Checksum mismatch in segment %08x at offset %u", seg->id, off);
+        return NULL;
+    }
+
+    return record;
+}
+
+/**
+ * Walk the intact records from an offset, counting what is still pending
+ * @return offset just past the last intact record
+ */
+static uint32_t segment_scan(const spool_segment_t *seg, uint32_t off, uint32_t *batches, uint32_t *records) {
+    const spool_record_t *record;
+
+    while ((record = record_at(seg, off, seg->size))) {
+        (*batches)++;
+        *records += record->count;
+        off += record_size(record->len);
+    }
+
+    return off;
+}
+
+static void pending_sub(spool_t *spool, uint32_t batches, uint32_t records) {
+    spool->stats.pending_batches -= batches < spool->stats.pending_batches ? batches : spool->stats.pending_batches;
+    spool->stats.pending_records -= records < spool->stats.pending_records ? records : spool->stats.pending_records;
+}
+
+/**
+ * Get the segment replay reads from, mapping it on first use
+ * @return segment or NULL if the oldest segment could not be mapped
+ */
+static spool_segment_t *read_segment(spool_t *spool) {
+    if (spool->first_id == spool->write.id) {
+        return &spool->write;
+    }
+
+    if (!spool->read.map && segment_map(spool, spool->first_id, false, &spool->read) < 0) {
+        return NULL;
+    }
+
+    return &spool->read;
+}
+
+/**
+ * Remove the oldest segment and move on to the next one
+ * @param dropped true if the segment still held undelivered batches
+ */
+static void advance_first_segment(spool_t *spool, bool dropped) {
+    uint32_t batches = 0, records = 0;
+    spool_segment_t *seg = read_segment(spool);
+
+    if (dropped && seg) {
+        segment_scan(seg, segment_header(seg)->read_off, &batches, &records);
+        if (batches > 0) {
+            console_warn(&csl, "Spool full, dropping segment %08x with %u batches (%u logs)", seg->id, batches,
+                         records);
+            spool->stats.dropped_batches += batches;
+            pending_sub(spool, batches, records);
+        }
+    }
+
+    segment_unmap(&spool->read);
+    segment_remove(spool, spool->first_id);
+    spool->first_id++;
+}
+
+/**
+ * Seal the write segment and start a new one, dropping the oldest if the size bound is reached
+ */
+static int rotate_segment(spool_t *spool) {
+    uint32_t next_id = spool->write.id + 1;
+
+    // Segments on disk after the rotation: [first_id, next_id]
+    while (next_id - spool->first_id + 1 > spool->max_segments && spool->first_id != spool->write.id) {
+        advance_first_segment(spool, true);
+    }
+
+    if (spool->first_id == spool->write.id) {
+        // The write segment still has batches to replay, keep it mapped for the reader
+        segment_unmap(&spool->read);
+        spool->read = spool->write;
+    } else {
+        segment_unmap(&spool->write);
+    }
+
+    spool->write.fd = -1;
+    spool->write.map = NULL;
+
+    int ret = segment_map(spool, next_id, true, &spool->write);
+    if (ret < 0) {
+        console_error(&csl, "Failed to create spool segment %08x: %s", next_id, strerror(-ret));
+        spool->open = false;
+        return ret;
+    }
+
+    spool->write_off = SEGMENT_DATA_OFFSET;
+    return 0;
+}
+
+/**
+ * Top up the write budget for the time passed since the last refill
+ */
+static void budget_refill(spool_t *spool) {
+    struct timespec now;
+
+    if (!spool->budget_bytes) {
+        return;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    double elapsed = (double)(now.tv_sec - spool->refilled.tv_sec) + (now.tv_nsec - spool->refilled.tv_nsec) / 1e9;
+    spool->refilled = now;
+
+    spool->budget_tokens += elapsed * (double)spool->budget_bytes / 3600.0;
+    if (spool->budget_tokens > (double)spool->budget_bytes) {
+        spool->budget_tokens = (double)spool->budget_bytes;
+    }
+}
+
+/**
+ * Find the segment ids present in the spool directory
+ */
+static int scan_directory(spool_t *spool, uint32_t *min_id, uint32_t *max_id) {
+    DIR *dir = opendir(spool->dir);
+    struct dirent *entry;
+    int found = 0;
+
+    if (!dir) {
+        return -errno;
+    }
+
+    while ((entry = readdir(dir))) {
+        unsigned int id;
+        char tail;
+
+        if (strlen(entry->d_name) != 12 || sscanf(entry->d_name, "%8x.se%c", &id, &tail) != 2 || tail != 'g') {
+            continue;
+        }
+
+        if (!found || id < *min_id) {
+            *min_id = id;
+        }
+        if (!found || id > *max_id) {
+            *max_id = id;
+        }
+        found++;
+    }
+
+    closedir(dir);
+    return found;
+}
+
+int spool_open(spool_t *spool, const char *dir, uint32_t size_kb, uint32_t segment_kb, uint32_t budget_kb_per_hour) {
+    uint32_t min_id = 0, max_id = 0;
+    int ret;
+
+    memset(spool, 0, sizeof(*spool));
+    spool->write.fd = -1;
+    spool->read.fd = -1;
+
+    if (!dir || !dir[0] || strlen(dir) >= sizeof(spool->dir) || segment_kb == 0) {
+        return -EINVAL;
+    }
+
+    strcpy(spool->dir, dir);
+    spool->segment_size = ALIGN_UP(segment_kb * 1024);
+    spool->max_segments = size_kb / segment_kb;
+    if (spool->max_segments < SPOOL_MIN_SEGMENTS) {
+        spool->max_segments = SPOOL_MIN_SEGMENTS;
+    }
+
+    spool->budget_bytes = (uint64_t)budget_kb_per_hour * 1024;
+    spool->budget_tokens = (double)spool->budget_bytes;
+    clock_gettime(CLOCK_MONOTONIC, &spool->refilled);
+
+    ret = mkdir_p(dir);
+    if (ret < 0) {
+        console_error(&csl, "Failed to create spool directory %s: %s", dir, strerror(-ret));
+        return ret;
+    }
+
+    int found = scan_directory(spool, &min_id, &max_id);
+    if (found < 0) {
+        console_error(&csl, "Failed to read spool directory %s: %s", dir, strerror(-found));
+        return found;
+    }
+
+    if (found == 0) {
+        spool->first_id = 1;
+        ret = segment_map(spool, 1, true, &spool->write);
+        if (ret < 0) {
+            console_error(&csl, "Failed to create spool segment: %s", strerror(-ret));
+            return ret;
+        }
+        spool->write_off = SEGMENT_DATA_OFFSET;
+        spool->open = true;
+        console_info(&csl, "Spool initialized in %s (%u x %u KB segments)", dir, spool->max_segments, segment_kb);
+        return 0;
+    }
+
+    // Recover: count what is still pending and continue appending to the newest segment
+    spool->first_id = min_id;
+    for (uint32_t id = min_id; id != max_id + 1; id++) {
+        spool_segment_t seg = {.fd = -1};
+        uint32_t batches = 0, records = 0;
+
+        if (segment_map(spool, id, false, &seg) < 0) {
+            if (id == spool->first_id) {
+                segment_remove(spool, id);
+                spool->first_id++;
+            }
+            continue;
+        }
+
+        uint32_t end = segment_scan(&seg, segment_header(&seg)->read_off, &batches, &records);
+        spool->stats.pending_batches += batches;
+        spool->stats.pending_records += records;
+
+        if (id == max_id) {
+            spool->write = seg;
+            spool->write_off = end;
+        } else if (batches == 0 && id == spool->first_id) {
+            // Fully delivered before the restart
+            segment_unmap(&seg);
+            segment_remove(spool, id);
+            spool->first_id++;
+        } else {
+            segment_unmap(&seg);
+        }
+    }
+
+    if (!spool->write.map) {
+        // The newest segment is unreadable, start a fresh one after it
+        ret = segment_map(spool, max_id + 1, true, &spool->write);
+        if (ret < 0) {
+            console_error(&csl, "Failed to create spool segment: %s", strerror(-ret));
+            return ret;
+        }
+        spool->write_off = SEGMENT_DATA_OFFSET;
+        if (spool->first_id > max_id) {
+            spool->first_id = max_id + 1;
+        }
+    }
+
+    spool->open = true;
+    console_info(&csl, "Spool recovered from %s: %u batches (%u logs) pending", dir, spool->stats.pending_batches,
+                 spool->stats.pending_records);
+    return 0;
+}
+
+void spool_close(spool_t *spool) {
+    segment_unmap(&spool->read);
+    segment_unmap(&spool->write);
+    spool->open = false;
+}
+
+bool spool_can_accept(spool_t *spool, uint32_t len) {
+    uint32_t need = record_size(len);
+
+    if (!spool->open || need > spool->segment_size - SEGMENT_DATA_OFFSET) {
+        return false;
+    }
+
+    budget_refill(spool);
+    return !spool->budget_bytes || spool->budget_tokens >= need;
+}
+
+int spool_append(spool_t *spool, const spool_entry_t *entry) {
+    uint32_t need = record_size(entry->len);
+    int ret;
+
+    if (!spool->open) {
+        return -EBADF;
+    }
+
+    if (need > spool->segment_size - SEGMENT_DATA_OFFSET) {
+        console_warn(&csl, "Batch of %u bytes exceeds the spool segment size", entry->len);
+        return -E2BIG;
+    }
+
+    budget_refill(spool);
+    if (spool->budget_bytes && spool->budget_tokens < need) {
+        spool->stats.budget_rejects++;
+        return -EDQUOT;
+    }
+
+    if (spool->write_off + need > spool->write.size && (ret = rotate_segment(spool)) < 0) {
+        return ret;
+    }
+
+    spool_record_t *record = (spool_record_t *)(spool->write.map + spool->write_off);
+    memcpy(record + 1, entry->body, entry->len);
+    record->len = entry->len;
+    record->crc = (uint32_t)crc32(0L, (const Bytef *)entry->body, entry->len);
+    record->encoding = (uint16_t)entry->encoding;
+    record->flags = 0;
+    record->count = entry->count;
+    record->format = (uint32_t)entry->format;
+    record->instance = entry->instance;
+    record->seq = entry->seq;
+
+    // Publish the record only once its body is in place
+    __atomic_store_n(&record->magic, SPOOL_RECORD_MAGIC, __ATOMIC_RELEASE);
+
+    // Schedule writeback of the touched pages without blocking the event loop
+    long page_size = sysconf(_SC_PAGESIZE);
+    uint32_t sync_start = spool->write_off & ~(uint32_t)(page_size - 1);
+    msync(spool->write.map + sync_start, spool->write_off + need - sync_start, MS_ASYNC);
+
+    spool->write_off += need;
+    spool->budget_tokens -= need;
+    spool->stats.pending_batches++;
+    spool->stats.pending_records += entry->count;
+    spool->stats.written_batches++;
+    spool->stats.written_bytes += need;
+    return 0;
+}
+
+int spool_peek(spool_t *spool, spool_entry_t *entry) {
+    if (!spool->open) {
+        return -ENOENT;
+    }
+
+    for (;;) {
+        spool_segment_t *seg = read_segment(spool);
+        if (!seg) {
+            console_warn(&csl, "Skipping unreadable spool segment %08x", spool->first_id);
+            advance_first_segment(spool, false);
+            continue;
+        }
+
+        uint32_t end = seg == &spool->write ? spool->write_off : seg->size;
+        const spool_record_t *record = record_at(seg, segment_header(seg)->read_off, end);
+        if (record) {
+            entry->body = (const uint8_t *)(record + 1);
+            entry->len = record->len;
+            entry->encoding = (compression_t)record->encoding;
+            entry->format = (payload_format_t)record->format;
+            entry->count = record->count;
+            entry->instance = record->instance;
+            entry->seq = record->seq;
+            return 0;
+        }
+
+        if (seg == &spool->write) {
+            // Everything written so far was delivered
+            spool->stats.pending_batches = 0;
+            spool->stats.pending_records = 0;
+            return -ENOENT;
+        }
+
+        // Sealed segment fully replayed
+        advance_first_segment(spool, false);
+    }
+}
+
+int spool_consume(spool_t *spool, uint64_t instance, uint64_t seq) {
+    spool_segment_t *seg = read_segment(spool);
+    if (!seg) {
+        return -ENOENT;
+    }
+
+    spool_segment_header_t *header = segment_header(seg);
+    uint32_t end = seg == &spool->write ? spool->write_off : seg->size;
+    const spool_record_t *record = record_at(seg, header->read_off, end);
+    if (!record) {
+        return -ENOENT;
+    }
+    if (record->instance != instance || record->seq != seq) {
+        return -ESTALE;
+    }
+
+    pending_sub(spool, 1, record->count);
+    spool->stats.replayed_batches++;
+    header->read_off += record_size(record->len);
+    return 0;
+}
+
+bool spool_has_pending(const spool_t *spool) { return spool->open && spool->stats.pending_batches > 0; }
+
+void spool_get_stats(const spool_t *spool, spool_stats_t *stats) {
+    *stats = spool->stats;
+    stats->segments = spool->open ? spool->write.id - spool->first_id + 1 : 0;
+}
@@ -0,0 +1,172 @@
+#ifndef SPOOL_H
+#define SPOOL_H
+
+#include "compress.h"
+#include "payload.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
+
+#define SPOOL_SEGMENT_MAGIC 0x46525350 // "FRSP"
+#define SPOOL_RECORD_MAGIC 0x46524252  // "FRBR"
+#define SPOOL_VERSION 2
+#define SPOOL_ALIGN 8
+#define SPOOL_MIN_SEGMENTS 2
+
+/**
+ * Segment file header
+ * Segments are fixed-size files named by a monotonically increasing id.
+ */
+typedef struct spool_segment_header {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t size;     // Segment file size in bytes
+    uint32_t read_off; // Replay cursor, records before it were delivered
+} spool_segment_header_t;
+
+/**
+ * Spooled batch record, followed by the encoded request body
+ * The magic is stored last, so a record interrupted by a crash is never replayed.
+ */
+typedef struct spool_record {
+    uint32_t magic;
+    uint32_t len;      // Body bytes
+    uint32_t crc;      // crc32 of the body
+    uint16_t encoding; // compression_t the body was encoded with
+    uint16_t flags;
+    uint32_t count;  // Log records in the batch
+    uint32_t format; // payload_format_t of the body, 0 (JSON) in records written before formats existed
+    uint64_t instance; // Collector instance that created the batch
+    uint64_t seq;      // Batch sequence number within that instance
+} spool_record_t;
+
+/**
+ * Mapped segment file
+ */
+typedef struct spool_segment {
+    uint32_t id;
+    int fd;
+    uint8_t *map;
+    uint32_t size;
+} spool_segment_t;
+
+/**
+ * A spooled batch as passed to spool_append() and returned by spool_peek()
+ * A peeked body points into the segment mapping and stays valid until the next spool call.
+ */
+typedef struct spool_entry {
+    const uint8_t *body;
+    uint32_t len;
+    compression_t encoding;
+    payload_format_t format;
+    uint32_t count;
+    uint64_t instance;
+    uint64_t seq;
+} spool_entry_t;
+
+/**
+ * Spool statistics
+ */
+typedef struct spool_stats {
+    uint32_t pending_batches;  // Batches waiting for replay
+    uint32_t pending_records;  // Log records in those batches
+    uint32_t segments;         // Segment files on disk
+    uint64_t written_batches;  // Batches appended since start
+    uint64_t written_bytes;    // Bytes appended since start (records and headers)
+    uint64_t replayed_batches; // Batches delivered from the spool
+    uint64_t dropped_batches;  // Batches lost to the size bound
+    uint64_t budget_rejects;   // Batches refused by the write budget
+} spool_stats_t;
+
+/**
+ * Append-only spool of encoded batches
+ * Failed uploads are appended to mmap'd segment files and replayed in order.
+ * The total size is bounded by dropping the oldest segment, and a byte budget
+ * per hour limits writes so a long outage cannot wear out flash storage.
+ */
+typedef struct spool {
+    char dir[128];
+    uint32_t segment_size;
+    uint32_t max_segments;
+
+    spool_segment_t write; // Segment appended to
+    uint32_t write_off;
+    spool_segment_t read; // Oldest segment, replayed from (fd < 0 when it is the write segment)
+    uint32_t first_id;    // Oldest segment id on disk
+
+    uint64_t budget_bytes;    // Write budget per hour, 0 for unlimited
+    double budget_tokens;     // Bytes that may still be written
+    struct timespec refilled; // Last budget refill
+
+    spool_stats_t stats;
+    bool open;
+} spool_t;
+
+/**
+ * Open (or create) the spool directory and recover existing segments
+ * @param spool Spool to initialize
+ * @param dir Directory holding the segment files
+ * @param size_kb Upper bound of all segments together
+ * @param segment_kb Size of one segment file
+ * @param budget_kb_per_hour Write budget, 0 for unlimited
+ * @return 0 on success, negative error code on failure
+ */
+int spool_open(spool_t *spool, const char *dir, uint32_t size_kb, uint32_t segment_kb, uint32_t budget_kb_per_hour);
+
+/**
+ * Unmap and close all segment files (spooled data stays on disk)
+ * @param spool Spool to close
+ */
+void spool_close(spool_t *spool);
+
+/**
+ * Check whether a failed batch of the given size would be accepted
+ * @param spool Spool
+ * @param len Body bytes (0 to only check that the spool is usable)
+ * @return true if spool_append() is expected to succeed
+ */
+bool spool_can_accept(spool_t *spool, uint32_t len);
+
+/**
+ * Append an encoded batch
+ * The oldest segment is dropped if the size bound would be exceeded.
+ * @param spool Spool
+ * @param entry Batch body and metadata
+ * @return 0 on success, -EDQUOT if the write budget is exhausted, other negative error code on failure
+ */
+int spool_append(spool_t *spool, const spool_entry_t *entry);
+
+/**
+ * Get the oldest spooled batch without removing it
+ * @param spool Spool
+ * @param entry Filled with the batch
+ * @return 0 on success, -ENOENT if the spool is empty
+ */
+int spool_peek(spool_t *spool, spool_entry_t *entry);
+
+/**
+ * Remove the oldest spooled batch if it is the one a replay was started for
+ * The batch may have been dropped with its segment while the replay was in
+ * flight, the batch now at the front is then left alone.
+ * @param spool Spool
+ * @param instance Instance of the batch returned by spool_peek()
+ * @param seq Sequence number of that batch
+ * @return 0 on success, -ESTALE if the oldest batch is a different one, -ENOENT if the spool is empty
+ */
+int spool_consume(spool_t *spool, uint64_t instance, uint64_t seq);
+
+/**
+ * Check if batches are waiting for replay
+ * @param spool Spool
+ * @return true if spool_peek() has something to return
+ */
+bool spool_has_pending(const spool_t *spool);
+
+/**
+ * Get spool statistics
+ * @param spool Spool
+ * @param stats Filled with the current statistics
+ */
+void spool_get_stats(const spool_t *spool, spool_stats_t *stats);
+
+#endif // SPOOL_H
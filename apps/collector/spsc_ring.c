@@ -0,0 +1,125 @@
+#include "spsc_ring.h"
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define RING_MSG_WRAP 0x0001 // Padding up to the end of the buffer, the next message starts at offset 0
+
+/**
+ * Message header, keeps the payload SPSC_RING_ALIGN aligned
+ */
+typedef struct ring_msg {
+    uint32_t size;  // Total size including the header, padded to SPSC_RING_ALIGN
+    uint32_t flags; // RING_MSG_* flags
+} ring_msg_t;
+
+static inline uint32_t align_size(uint32_t len) {
+    return (len + sizeof(ring_msg_t) + SPSC_RING_ALIGN - 1) & ~(uint32_t)(SPSC_RING_ALIGN - 1);
+}
+
+int spsc_ring_init(spsc_ring_t *ring, uint32_t size) {
+    uint32_t rounded = SPSC_RING_CACHE_LINE;
+
+    memset(ring, 0, sizeof(*ring));
+
+    while (rounded < size && rounded < (1U << 31)) {
+        rounded <<= 1;
+    }
+
+    ring->buf = malloc(rounded);
+    if (!ring->buf) {
+        return -ENOMEM;
+    }
+
+    ring->size = rounded;
+    ring->mask = rounded - 1;
+    return 0;
+}
+
+void spsc_ring_free(spsc_ring_t *ring) {
+    free(ring->buf);
+    memset(ring, 0, sizeof(*ring));
+}
+
+void *spsc_ring_reserve(spsc_ring_t *ring, uint32_t len) {
+    uint32_t head = __atomic_load_n(&ring->head, __ATOMIC_RELAXED);
+    uint32_t need = align_size(len);
+    uint32_t pos = head & ring->mask;
+    uint32_t to_end = ring->size - pos;
+    uint32_t wrap = need > to_end ? to_end : 0;
+
+    // Half the buffer at most, so a message always fits once the ring drained
+    if (need > ring->size / 2) {
+        return NULL;
+    }
+
+    // Only look at the consumer's counter when the cached one says the ring is full
+    if (ring->size - (head - ring->tail_cache) < need + wrap) {
+        ring->tail_cache = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+        if (ring->size - (head - ring->tail_cache) < need + wrap) {
+            return NULL;
+        }
+    }
+
+    if (wrap) {
+        ring_msg_t *marker = (ring_msg_t *)(ring->buf + pos);
+        marker->size = wrap;
+        marker->flags = RING_MSG_WRAP;
+        pos = 0;
+    }
+
+    ring_msg_t *msg = (ring_msg_t *)(ring->buf + pos);
+    msg->size = need;
+    msg->flags = 0;
+    ring->pending = wrap + need;
+    return msg + 1;
+}
+
+void spsc_ring_commit(spsc_ring_t *ring) {
+    uint32_t head = __atomic_load_n(&ring->head, __ATOMIC_RELAXED) + ring->pending;
+
+    // Publishes the message contents along with the counter
+    __atomic_store_n(&ring->head, head, __ATOMIC_RELEASE);
+    ring->pending = 0;
+
+    if (head - ring->tail_cache > ring->high_water) {
+        __atomic_store_n(&ring->high_water, head - ring->tail_cache, __ATOMIC_RELAXED);
+    }
+}
+
+const void *spsc_ring_peek(spsc_ring_t *ring, uint32_t *len) {
+    uint32_t tail = __atomic_load_n(&ring->tail, __ATOMIC_RELAXED);
+
+    while (true) {
+        if (tail == ring->head_cache) {
+            ring->head_cache = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+            if (tail == ring->head_cache) {
+                return NULL;
+            }
+        }
+
+        const ring_msg_t *msg = (const ring_msg_t *)(ring->buf + (tail & ring->mask));
+        if (!(msg->flags & RING_MSG_WRAP)) {
+            *len = msg->size - (uint32_t)sizeof(*msg);
+            return msg + 1;
+        }
+
+        // The wrap marker is committed together with the message after it
+        tail += msg->size;
+        __atomic_store_n(&ring->tail, tail, __ATOMIC_RELEASE);
+    }
+}
+
+void spsc_ring_release(spsc_ring_t *ring) {
+    uint32_t tail = __atomic_load_n(&ring->tail, __ATOMIC_RELAXED);
+    const ring_msg_t *msg = (const ring_msg_t *)(ring->buf + (tail & ring->mask));
+
+    // The producer may reuse the bytes as soon as it sees the new tail
+    __atomic_store_n(&ring->tail, tail + msg->size, __ATOMIC_RELEASE);
+}
+
+uint32_t spsc_ring_used(const spsc_ring_t *ring) {
+    return __atomic_load_n(&ring->head, __ATOMIC_RELAXED) - __atomic_load_n(&ring->tail, __ATOMIC_RELAXED);
+}
+
+uint32_t spsc_ring_high_water(const spsc_ring_t *ring) { return __atomic_load_n(&ring->high_water, __ATOMIC_RELAXED); }
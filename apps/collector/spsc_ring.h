@@ -0,0 +1,85 @@
+#ifndef SPSC_RING_H
+#define SPSC_RING_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define SPSC_RING_ALIGN 8
+#define SPSC_RING_CACHE_LINE 64
+
+/**
+ * Lock-free ring of variable-length messages between exactly one producer
+ * and one consumer thread
+ * head and tail are free-running byte counters, each written by one side
+ * only and published with release/acquire ordering. Every message is
+ * prefixed with its padded size; a message that does not fit before the end
+ * of the buffer leaves a wrap marker and starts over at offset 0, so the
+ * consumer always sees a message in one piece.
+ */
+typedef struct spsc_ring {
+    uint8_t *buf;
+    uint32_t size; // Buffer size, a power of two
+    uint32_t mask;
+
+    // Producer side
+    uint32_t head __attribute__((aligned(SPSC_RING_CACHE_LINE))); // Next write position
+    uint32_t tail_cache;                                          // Last tail seen by the producer
+    uint32_t pending;                                             // Bytes reserved, not yet committed
+    uint32_t high_water;                                          // Peak bytes in use seen by the producer
+
+    // Consumer side
+    uint32_t tail __attribute__((aligned(SPSC_RING_CACHE_LINE))); // Next read position
+    uint32_t head_cache;                                          // Last head seen by the consumer
+} spsc_ring_t;
+
+/**
+ * Allocate the ring buffer
+ * @param ring Ring to initialize
+ * @param size Buffer size in bytes (rounded up to a power of two)
+ * @return 0 on success, negative error code on failure
+ */
+int spsc_ring_init(spsc_ring_t *ring, uint32_t size);
+
+/**
+ * Release the ring buffer
+ */
+void spsc_ring_free(spsc_ring_t *ring);
+
+/**
+ * Reserve space for a message (producer)
+ * @param ring Ring
+ * @param len Message length
+ * @return message buffer to fill, NULL if the ring is full
+ */
+void *spsc_ring_reserve(spsc_ring_t *ring, uint32_t len);
+
+/**
+ * Publish the message reserved last (producer)
+ */
+void spsc_ring_commit(spsc_ring_t *ring);
+
+/**
+ * Oldest published message (consumer)
+ * @param ring Ring
+ * @param len Set to the message length (padded to SPSC_RING_ALIGN)
+ * @return message, NULL if the ring is empty
+ */
+const void *spsc_ring_peek(spsc_ring_t *ring, uint32_t *len);
+
+/**
+ * Free the message returned by spsc_ring_peek() (consumer)
+ */
+void spsc_ring_release(spsc_ring_t *ring);
+
+/**
+ * Bytes in use, approximate while the other side is running
+ */
+uint32_t spsc_ring_used(const spsc_ring_t *ring);
+
+/**
+ * Peak bytes in use as seen by the producer
+ */
+uint32_t spsc_ring_high_water(const spsc_ring_t *ring);
+
+#endif // SPSC_RING_H
@@ -0,0 +1,669 @@
+#define _GNU_SOURCE // recvmmsg(), accept4()
+#include "syslog_input.h"
+#include "collect.h"
+#include "config.h"
+#include "core/console.h"
+#include <arpa/inet.h>
+#include <errno.h>
+#include <libubox/uloop.h>
+#include <netinet/in.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+static Console csl = {
+    .topic = "syslog",
+};
+
+#define TCP_BUF_SIZE (SYSLOG_TCP_FRAME_MAX + 8) // A full frame plus its octet count
+
+/**
+ * TCP connection from a syslog sender
+ */
+typedef struct syslog_client {
+    struct uloop_fd fd;
+    struct sockaddr_storage addr;
+    size_t len; // Bytes in buf not consumed yet
+    char buf[TCP_BUF_SIZE];
+} syslog_client_t;
+
+static struct uloop_fd udp_fd = {.fd = -1};
+static struct uloop_fd tcp_fd = {.fd = -1};
+static syslog_client_t *clients[SYSLOG_TCP_MAX_CLIENTS];
+
+// Listener settings the sockets were opened with
+static char bound_addr[64];
+static uint32_t bound_udp_port = 0;
+static uint32_t bound_tcp_port = 0;
+
+// Filter compiled from the same rules as the logd stream, which may own its copy on the reader thread
+static log_filter_t filter;
+static syslog_input_stats_t stats;
+
+// Receive buffers, reused by every recvmmsg() call
+static struct {
+    struct mmsghdr msgs[SYSLOG_UDP_BATCH];
+    struct iovec iov[SYSLOG_UDP_BATCH];
+    struct sockaddr_storage addr[SYSLOG_UDP_BATCH];
+    char buf[SYSLOG_UDP_BATCH][SYSLOG_UDP_MSG_SIZE];
+} udp_rx;
+
+// Message rewritten as "<host> <tag>: <text>", the arena copies it on enqueue
+static char line[MAX_LOG_MSG_SIZE];
+
+/**
+ * Bounded writer into line
+ */
+typedef struct line_writer {
+    size_t len;
+} line_writer_t;
+
+static void line_append(line_writer_t *w, const char *data, size_t len) {
+    if (len > sizeof(line) - w->len) {
+        len = sizeof(line) - w->len;
+    }
+    memcpy(line + w->len, data, len);
+    w->len += len;
+}
+
+/**
+ * Receive time in milliseconds since the epoch, like logd timestamps
+ * Sender clocks are often unset on LAN devices, so their timestamps are not used.
+ */
+static uint64_t realtime_ms(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    return (uint64_t)now.tv_sec * 1000 + (uint64_t)now.tv_nsec / 1000000;
+}
+
+/**
+ * Hash of the sender address (FNV-1a), keys the per-sender rate limit and sampling
+ * IPv4 senders hash the same on the IPv4 and the dual-stack socket.
+ * @return hash, never 0 (which marks local logs)
+ */
+static uint32_t peer_origin(const struct sockaddr_storage *addr) {
+    const uint8_t *bytes = NULL;
+    size_t len = 0;
+
+    if (addr->ss_family == AF_INET) {
+        bytes = (const uint8_t *)&((const struct sockaddr_in *)addr)->sin_addr;
+        len = 4;
+    } else if (addr->ss_family == AF_INET6) {
+        const struct in6_addr *in6 = &((const struct sockaddr_in6 *)addr)->sin6_addr;
+        bytes = IN6_IS_ADDR_V4MAPPED(in6) ? &in6->s6_addr[12] : in6->s6_addr;
+        len = IN6_IS_ADDR_V4MAPPED(in6) ? 4 : 16;
+    }
+
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < len; i++) {
+        hash = (hash ^ bytes[i]) * 16777619u;
+    }
+    return hash ? hash : 1;
+}
+
+/**
+ * Append the address of the sender, used when the message names no host
+ */
+static void append_peer(line_writer_t *w, const struct sockaddr_storage *addr) {
+    char host[INET6_ADDRSTRLEN] = "-";
+
+    if (addr->ss_family == AF_INET) {
+        inet_ntop(AF_INET, &((const struct sockaddr_in *)addr)->sin_addr, host, sizeof(host));
+    } else if (addr->ss_family == AF_INET6) {
+        const struct in6_addr *in6 = &((const struct sockaddr_in6 *)addr)->sin6_addr;
+
+        // IPv4 senders on the dual-stack socket
+        if (IN6_IS_ADDR_V4MAPPED(in6)) {
+            inet_ntop(AF_INET, &in6->s6_addr[12], host, sizeof(host));
+        } else {
+            inet_ntop(AF_INET6, in6, host, sizeof(host));
+        }
+    }
+
+    line_append(w, host, strlen(host));
+}
+
+/**
+ * Split the next space separated field off a message
+ * @return field length, *p points past the separator
+ */
+static size_t next_field(const char **p, const char *end, const char **field) {
+    const char *sp = memchr(*p, ' ', (size_t)(end - *p));
+    const char *stop = sp ? sp : end;
+    size_t len = (size_t)(stop - *p);
+
+    *field = *p;
+    *p = sp ? sp + 1 : end;
+    return len;
+}
+
+static bool is_nil(const char *field, size_t len) { return len == 1 && field[0] == '-'; }
+
+/**
+ * Skip RFC 5424 structured data: "-" or one or more [id param="value"] elements
+ * Values may contain escaped quotes and brackets.
+ * @return true if the structured data was well formed
+ */
+static bool skip_structured_data(const char **p, const char *end) {
+    const char *cur = *p;
+
+    if (cur < end && *cur == '-') {
+        *p = cur + 1;
+        return true;
+    }
+
+    while (cur < end && *cur == '[') {
+        bool quoted = false;
+
+        for (cur++; cur < end; cur++) {
+            if (quoted && *cur == '\\' && cur + 1 < end) {
+                cur++;
+            } else if (*cur == '"') {
+                quoted = !quoted;
+            } else if (!quoted && *cur == ']') {
+                break;
+            }
+        }
+        if (cur == end) {
+            return false;
+        }
+        cur++;
+    }
+
+    *p = cur;
+    return true;
+}
+
+/**
+ * Rewrite an RFC 5424 message (after "<PRI>1 ")
+ * VERSION TIMESTAMP HOSTNAME APP-NAME PROCID MSGID STRUCTURED-DATA [MSG]
+ */
+static bool rewrite_rfc5424(line_writer_t *w, const char *p, const char *end, const struct sockaddr_storage *addr) {
+    const char *timestamp, *host, *app, *procid, *msgid;
+    size_t host_len, app_len, procid_len;
+
+    next_field(&p, end, &timestamp);
+    host_len = next_field(&p, end, &host);
+    app_len = next_field(&p, end, &app);
+    procid_len = next_field(&p, end, &procid);
+    next_field(&p, end, &msgid);
+
+    const char *sd = p;
+    if (!skip_structured_data(&p, end)) {
+        return false;
+    }
+    size_t sd_len = (size_t)(p - sd);
+
+    if (is_nil(host, host_len) || host_len == 0) {
+        append_peer(w, addr);
+    } else {
+        line_append(w, host, host_len);
+    }
+
+    if (app_len && !is_nil(app, app_len)) {
+        line_append(w, " ", 1);
+        line_append(w, app, app_len);
+        if (procid_len && !is_nil(procid, procid_len)) {
+            line_append(w, "[", 1);
+            line_append(w, procid, procid_len);
+            line_append(w, "]", 1);
+        }
+        line_append(w, ":", 1);
+    }
+
+    // Structured data is kept in front of the text, the backend sees what the device sent
+    if (sd_len && !is_nil(sd, sd_len)) {
+        line_append(w, " ", 1);
+        line_append(w, sd, sd_len);
+    }
+
+    if (p < end && *p == ' ') {
+        p++;
+    }
+    if (end - p >= 3 && memcmp(p, "\xEF\xBB\xBF", 3) == 0) {
+        p += 3;
+    }
+    if (p < end) {
+        line_append(w, " ", 1);
+        line_append(w, p, (size_t)(end - p));
+    }
+    return true;
+}
+
+/**
+ * Check for an RFC 3164 timestamp ("Mmm dd hh:mm:ss ")
+ */
+static bool has_bsd_timestamp(const char *p, const char *end) {
+    return end - p >= 16 && p[3] == ' ' && p[6] == ' ' && p[9] == ':' && p[12] == ':' && p[15] == ' ' &&
+           p[0] >= 'A' && p[0] <= 'Z';
+}
+
+/**
+ * Rewrite an RFC 3164 message (after "<PRI>")
+ * TIMESTAMP HOSTNAME TAG: MSG, where senders often leave out the timestamp or the host.
+ */
+static void rewrite_rfc3164(line_writer_t *w, const char *p, const char *end, const struct sockaddr_storage *addr) {
+    if (has_bsd_timestamp(p, end)) {
+        const char *rest = p + 16;
+        const char *host;
+        size_t host_len = next_field(&rest, end, &host);
+
+        // A tag ("dropbear[42]:") in place of the host means the sender left it out
+        if (host_len && rest < end && host[host_len - 1] != ':' && !memchr(host, '[', host_len)) {
+            line_append(w, host, host_len);
+            p = rest;
+        } else {
+            append_peer(w, addr);
+            p += 16;
+        }
+    } else {
+        append_peer(w, addr);
+    }
+
+    if (p < end) {
+        line_append(w, " ", 1);
+        line_append(w, p, (size_t)(end - p));
+    }
+}
+
+/**
+ * Parse a syslog message, filter it and hand it to the collector
+ */
+static void handle_message(const char *data, size_t len, const struct sockaddr_storage *addr) {
+    const char *p = data;
+    const char *end = data + len;
+    uint32_t priority = SYSLOG_PRIORITY_DEFAULT;
+    line_writer_t w = {0};
+
+    // Trailing line ends and NULs some senders append
+    while (end > p && (end[-1] == '\n' || end[-1] == '\r' || end[-1] == '\0')) {
+        end--;
+    }
+    if (p == end) {
+        return;
+    }
+
+    // PRI: "<" 1-3 digits ">", at most 191 (facility 23, severity 7)
+    if (*p == '<') {
+        const char *q = p + 1;
+        uint32_t value = 0;
+
+        while (q < end && q - p <= 3 && *q >= '0' && *q <= '9') {
+            value = value * 10 + (uint32_t)(*q++ - '0');
+        }
+        if (q < end && *q == '>' && q > p + 1 && value <= 191) {
+            priority = value;
+            p = q + 1;
+        }
+    }
+
+    if (end - p >= 2 && p[0] == '1' && p[1] == ' ') {
+        if (!rewrite_rfc5424(&w, p + 2, end, addr)) {
+            // Broken structured data, keep the message as it came
+            w.len = 0;
+            rewrite_rfc3164(&w, p, end, addr);
+        }
+    } else {
+        rewrite_rfc3164(&w, p, end, addr);
+    }
+
+    stats.received++;
+    if (!filter_accept(&filter, line, w.len, priority, FILTER_SOURCE_REMOTE)) {
+        return;
+    }
+
+    log_data_t log_data = {
+        .time = realtime_ms(),
+        .priority = priority,
+        .source = FILTER_SOURCE_REMOTE,
+        .origin = peer_origin(addr),
+        .msg = line,
+        .msg_len = w.len,
+    };
+
+    // Acceptance, dedup, rate limits and queue limits are applied and counted by the collector
+    collect_enqueue_log(&log_data);
+}
+
+/**
+ * Drain the UDP socket in batches of SYSLOG_UDP_BATCH datagrams
+ */
+static void udp_read_cb(struct uloop_fd *fd, unsigned int events) {
+    for (int round = 0; round < SYSLOG_UDP_ROUNDS; round++) {
+        for (int i = 0; i < SYSLOG_UDP_BATCH; i++) {
+            udp_rx.msgs[i].msg_hdr.msg_namelen = sizeof(udp_rx.addr[i]);
+        }
+
+        int n = recvmmsg(fd->fd, udp_rx.msgs, SYSLOG_UDP_BATCH, MSG_DONTWAIT, NULL);
+        if (n <= 0) {
+            if (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+                console_warn(&csl, "UDP receive failed: %s", strerror(errno));
+            }
+            return;
+        }
+
+        for (int i = 0; i < n; i++) {
+            size_t len = udp_rx.msgs[i].msg_len;
+
+            if (udp_rx.msgs[i].msg_hdr.msg_flags & MSG_TRUNC) {
+                stats.truncated++;
+                len = SYSLOG_UDP_MSG_SIZE;
+            }
+            handle_message(udp_rx.buf[i], len, &udp_rx.addr[i]);
+        }
+
+        // A short batch emptied the socket
+        if (n < SYSLOG_UDP_BATCH) {
+            return;
+        }
+    }
+    // More is pending, the level-triggered fd brings us back after other events
+}
+
+static void close_client(syslog_client_t *client) {
+    for (int i = 0; i < SYSLOG_TCP_MAX_CLIENTS; i++) {
+        if (clients[i] == client) {
+            clients[i] = NULL;
+        }
+    }
+
+    uloop_fd_delete(&client->fd);
+    close(client->fd.fd);
+    free(client);
+    stats.tcp_clients--;
+}
+
+/**
+ * Handle the complete frames in a client buffer
+ * RFC 6587 octet counting ("<len> <msg>") when a frame starts with a digit,
+ * newline-terminated messages otherwise.
+ * @return bytes consumed, negative on a framing error
+ */
+static ssize_t process_frames(syslog_client_t *client) {
+    size_t off = 0;
+
+    while (off < client->len) {
+        const char *p = client->buf + off;
+        size_t avail = client->len - off;
+
+        if (*p >= '0' && *p <= '9') {
+            size_t count = 0, i = 0;
+
+            while (i < avail && i < 6 && p[i] >= '0' && p[i] <= '9') {
+                count = count * 10 + (size_t)(p[i++] - '0');
+            }
+            if (i == avail) {
+                break;
+            }
+            if (p[i] != ' ' || count == 0 || count > SYSLOG_TCP_FRAME_MAX) {
+                return -1;
+            }
+            if (avail - i - 1 < count) {
+                break;
+            }
+
+            handle_message(p + i + 1, count, &client->addr);
+            off += i + 1 + count;
+        } else {
+            const char *lf = memchr(p, '\n', avail);
+            if (!lf) {
+                break;
+            }
+
+            handle_message(p, (size_t)(lf - p), &client->addr);
+            off += (size_t)(lf - p) + 1;
+        }
+    }
+
+    return (ssize_t)off;
+}
+
+static void client_read_cb(struct uloop_fd *fd, unsigned int events) {
+    syslog_client_t *client = container_of(fd, syslog_client_t, fd);
+
+    while (true) {
+        ssize_t n = read(fd->fd, client->buf + client->len, sizeof(client->buf) - client->len);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            return;
+        }
+        if (n <= 0) {
+            close_client(client);
+            return;
+        }
+
+        client->len += (size_t)n;
+        ssize_t consumed = process_frames(client);
+        if (consumed < 0) {
+            stats.framing_errors++;
+            console_warn(&csl, "Closing syslog connection with an invalid octet count");
+            close_client(client);
+            return;
+        }
+
+        // An unterminated line filling the buffer is taken as one message
+        if (consumed == 0 && client->len == sizeof(client->buf)) {
+            handle_message(client->buf, client->len, &client->addr);
+            consumed = (ssize_t)client->len;
+        }
+
+        client->len -= (size_t)consumed;
+        memmove(client->buf, client->buf + consumed, client->len);
+    }
+}
+
+static void tcp_accept_cb(struct uloop_fd *fd, unsigned int events) {
+    while (true) {
+        struct sockaddr_storage addr;
+        socklen_t addr_len = sizeof(addr);
+        int conn = accept4(fd->fd, (struct sockaddr *)&addr, &addr_len, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (conn < 0) {
+            if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+                console_warn(&csl, "Failed to accept syslog connection: %s", strerror(errno));
+            }
+            return;
+        }
+
+        int slot = -1;
+        for (int i = 0; i < SYSLOG_TCP_MAX_CLIENTS && slot < 0; i++) {
+            if (!clients[i]) {
+                slot = i;
+            }
+        }
+
+        syslog_client_t *client = slot >= 0 ? malloc(sizeof(*client)) : NULL;
+        if (!client) {
+            stats.tcp_rejected++;
+            close(conn);
+            continue;
+        }
+
+        memset(client, 0, offsetof(syslog_client_t, buf));
+        client->addr = addr;
+        client->fd.fd = conn;
+        client->fd.cb = client_read_cb;
+        uloop_fd_add(&client->fd, ULOOP_READ);
+        clients[slot] = client;
+        stats.tcp_clients++;
+    }
+}
+
+/**
+ * Open a listening socket
+ * An empty address listens on all IPv6 and IPv4 addresses, falling back to IPv4 only.
+ * @return descriptor, negative error code on failure
+ */
+static int open_socket(int type, const char *addr, uint16_t port) {
+    struct sockaddr_storage ss = {0};
+    struct sockaddr_in *in = (struct sockaddr_in *)&ss;
+    struct sockaddr_in6 *in6 = (struct sockaddr_in6 *)&ss;
+    socklen_t len;
+    int one = 1, zero = 0;
+
+    if (!addr[0]) {
+        in6->sin6_family = AF_INET6;
+        in6->sin6_addr = in6addr_any;
+        in6->sin6_port = htons(port);
+        len = sizeof(*in6);
+    } else if (inet_pton(AF_INET, addr, &in->sin_addr) == 1) {
+        in->sin_family = AF_INET;
+        in->sin_port = htons(port);
+        len = sizeof(*in);
+    } else if (inet_pton(AF_INET6, addr, &in6->sin6_addr) == 1) {
+        in6->sin6_family = AF_INET6;
+        in6->sin6_port = htons(port);
+        len = sizeof(*in6);
+    } else {
+        return -EINVAL;
+    }
+
+    int fd = socket(ss.ss_family, type | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0 && !addr[0] && errno == EAFNOSUPPORT) {
+        // Kernel without IPv6
+        memset(&ss, 0, sizeof(ss));
+        in->sin_family = AF_INET;
+        in->sin_addr.s_addr = htonl(INADDR_ANY);
+        in->sin_port = htons(port);
+        len = sizeof(*in);
+        fd = socket(AF_INET, type | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    }
+    if (fd < 0) {
+        return -errno;
+    }
+
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    if (ss.ss_family == AF_INET6 && !addr[0]) {
+        setsockopt(fd, IPPROTO_IPV6, IPV6_V6ONLY, &zero, sizeof(zero));
+    }
+    if (type == SOCK_DGRAM) {
+        int rcvbuf = SYSLOG_UDP_RCVBUF;
+        setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+    }
+
+    if (bind(fd, (struct sockaddr *)&ss, len) < 0 || (type == SOCK_STREAM && listen(fd, SOMAXCONN) < 0)) {
+        int ret = -errno;
+        close(fd);
+        return ret;
+    }
+
+    return fd;
+}
+
+static void close_listeners(void) {
+    for (int i = 0; i < SYSLOG_TCP_MAX_CLIENTS; i++) {
+        if (clients[i]) {
+            close_client(clients[i]);
+        }
+    }
+
+    if (udp_fd.fd >= 0) {
+        uloop_fd_delete(&udp_fd);
+        close(udp_fd.fd);
+        udp_fd.fd = -1;
+    }
+    if (tcp_fd.fd >= 0) {
+        uloop_fd_delete(&tcp_fd);
+        close(tcp_fd.fd);
+        tcp_fd.fd = -1;
+    }
+
+    stats.udp = false;
+    stats.tcp = false;
+}
+
+/**
+ * Open the listeners of the current configuration
+ */
+static void open_listeners(const collector_config_t *config) {
+    const char *where = config->syslog_bind[0] ? config->syslog_bind : "*";
+
+    snprintf(bound_addr, sizeof(bound_addr), "%s", config->syslog_bind);
+    bound_udp_port = config->syslog_udp_port;
+    bound_tcp_port = config->syslog_tcp_port;
+
+    if (bound_udp_port) {
+        int fd = open_socket(SOCK_DGRAM, bound_addr, (uint16_t)bound_udp_port);
+        if (fd < 0) {
+            console_error(&csl, "Failed to listen on UDP %s:%u: %s", where, bound_udp_port, strerror(-fd));
+        } else {
+            udp_fd.fd = fd;
+            udp_fd.cb = udp_read_cb;
+            uloop_fd_add(&udp_fd, ULOOP_READ);
+            stats.udp = true;
+            console_info(&csl, "Listening for syslog on UDP %s:%u", where, bound_udp_port);
+        }
+    }
+
+    if (bound_tcp_port) {
+        int fd = open_socket(SOCK_STREAM, bound_addr, (uint16_t)bound_tcp_port);
+        if (fd < 0) {
+            console_error(&csl, "Failed to listen on TCP %s:%u: %s", where, bound_tcp_port, strerror(-fd));
+        } else {
+            tcp_fd.fd = fd;
+            tcp_fd.cb = tcp_accept_cb;
+            uloop_fd_add(&tcp_fd, ULOOP_READ);
+            stats.tcp = true;
+            console_info(&csl, "Listening for syslog on TCP %s:%u", where, bound_tcp_port);
+        }
+    }
+}
+
+int syslog_input_init(void) {
+    const collector_config_t *config = config_get_current();
+
+    memset(&stats, 0, sizeof(stats));
+    for (int i = 0; i < SYSLOG_UDP_BATCH; i++) {
+        udp_rx.iov[i].iov_base = udp_rx.buf[i];
+        udp_rx.iov[i].iov_len = sizeof(udp_rx.buf[i]);
+        udp_rx.msgs[i].msg_hdr.msg_iov = &udp_rx.iov[i];
+        udp_rx.msgs[i].msg_hdr.msg_iovlen = 1;
+        udp_rx.msgs[i].msg_hdr.msg_name = &udp_rx.addr[i];
+    }
+
+    if (!config->syslog_udp_port && !config->syslog_tcp_port) {
+        return 0;
+    }
+
+    if (filter_compile(&filter, &config->filters) < 0) {
+        console_warn(&csl, "Syslog filter patterns disabled, applying severity thresholds only");
+    }
+
+    open_listeners(config);
+    return stats.udp || stats.tcp ? 0 : -EADDRNOTAVAIL;
+}
+
+void syslog_input_apply_config(void) {
+    const collector_config_t *config = config_get_current();
+    log_filter_t staged;
+
+    if (filter_compile(&staged, &config->filters) < 0) {
+        filter_free(&staged);
+        console_warn(&csl, "Keeping the previous syslog filter");
+    } else {
+        staged.stats = filter.stats;
+        filter_free(&filter);
+        filter = staged;
+    }
+
+    if (strcmp(config->syslog_bind, bound_addr) != 0 || config->syslog_udp_port != bound_udp_port ||
+        config->syslog_tcp_port != bound_tcp_port) {
+        close_listeners();
+        open_listeners(config);
+    }
+}
+
+void syslog_input_cleanup(void) {
+    close_listeners();
+    filter_free(&filter);
+}
+
+void syslog_input_get_stats(syslog_input_stats_t *out) {
+    *out = stats;
+    out->filter = filter.stats;
+}
@@ -0,0 +1,54 @@
+#ifndef SYSLOG_INPUT_H
+#define SYSLOG_INPUT_H
+
+#include "filter.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+#define SYSLOG_UDP_BATCH 32          // Datagrams per recvmmsg() call
+#define SYSLOG_UDP_MSG_SIZE 2048     // RFC 5426 receivers must take 2048 bytes, longer datagrams are truncated
+#define SYSLOG_UDP_ROUNDS 8          // recvmmsg() calls per wakeup before other events get a turn
+#define SYSLOG_UDP_RCVBUF (256 * 1024) // Socket buffer for bursts while the loop is busy
+#define SYSLOG_TCP_MAX_CLIENTS 16    // Connections beyond this are refused
+#define SYSLOG_TCP_FRAME_MAX 8192    // Largest octet-counted frame or line
+#define SYSLOG_PRIORITY_DEFAULT 13   // user.notice, RFC 3164 for messages without PRI
+
+/**
+ * Syslog listener statistics
+ */
+typedef struct syslog_input_stats {
+    bool udp;                 // Listening on UDP
+    bool tcp;                 // Listening on TCP
+    uint64_t received;        // Datagrams and frames that carried a message
+    uint64_t truncated;       // Datagrams longer than SYSLOG_UDP_MSG_SIZE
+    uint32_t tcp_clients;     // Open connections
+    uint64_t tcp_rejected;    // Connections refused at SYSLOG_TCP_MAX_CLIENTS
+    uint64_t framing_errors;  // Connections closed for an invalid octet count
+    filter_stats_t filter;    // Filter outcomes of received messages
+} syslog_input_stats_t;
+
+/**
+ * Open the syslog listeners configured by syslog_udp_port and syslog_tcp_port
+ * Messages (RFC 5424 or RFC 3164) are filtered and enqueued like logd records,
+ * with source FILTER_SOURCE_REMOTE and the sending host in front of the message.
+ * @return 0 on success (also with both listeners disabled), negative error code on failure
+ */
+int syslog_input_init(void);
+
+/**
+ * Apply a reloaded configuration
+ * The filter is recompiled, listeners are reopened if their address or port changed.
+ */
+void syslog_input_apply_config(void);
+
+/**
+ * Close the listeners and all connections
+ */
+void syslog_input_cleanup(void);
+
+/**
+ * Get listener statistics
+ */
+void syslog_input_get_stats(syslog_input_stats_t *stats);
+
+#endif // SYSLOG_INPUT_H
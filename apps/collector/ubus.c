@@ -2,16 +2,32 @@
 #include "collect.h"
 #include "config.h"
 #include "core/console.h"
+#include "cursor.h"
+#include "filter.h"
+#include "ingest_thread.h"
+#include "syslog_input.h"
 #include <libubox/blobmsg.h>
-#include <libubox/blobmsg_json.h>
 #include <libubox/ustream.h>
+#include <errno.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <syslog.h>
 #include <time.h>
+#include <unistd.h>
 
 #define UBUS_RECONNECT_DELAY_MS 1000
 #define UBUS_RECONNECT_MAX_TRIES 10
+#define COLLECTOR_OBJECT_NAME "fry-collector"
+#define TOKEN_EVENT "fry-agent.token"    // Sent by fry-agent after it rotated the access token
+#define TOKEN_REQUEST_TIMEOUT_MS 5000    // get_access_token reply deadline
+#define TOKEN_REFRESH_MARGIN_S 60        // Refresh this long before the token expires
+#define TOKEN_REFRESH_MAX_S 3600         // Re-check at least hourly
+#define TOKEN_RETRY_MISSING_MS 10000     // Retry interval without a valid token
+#define TOKEN_RETRY_VALID_MS 60000       // Retry interval while the current token is still valid
+#define CURSOR_SAVE_INTERVAL_MS 5000     // Cursor writes while logs flow
+#define CURSOR_CHECKPOINTS 64            // Read positions waiting for their records to leave memory
+#define CATCHUP_WINDOW_MS 1000           // catchup_rate is counted per window
 
 static Console csl = {
     .topic = "ubus",
@@ -26,10 +42,52 @@ static int reconnect_tries = UBUS_RECONNECT_MAX_TRIES;
 static struct ustream_fd log_stream;
 static struct ubus_request log_request;
 static bool log_streaming = false;
+static bool use_ingest_thread = false; // Read the stream on a reader thread instead of the ustream
 
 // Timers
 static struct uloop_timeout reconnect_timer;
 static struct uloop_timeout token_refresh_timer;
+static struct uloop_timeout cursor_save_timer;
+static struct uloop_timeout catchup_timer; // Ends a pause of the paced ustream
+
+// Last processed logd record, the stream resumes after it
+static log_cursor_t log_cursor;
+static bool cursor_save_failed = false;
+
+/**
+ * Read positions the cursor has not reached yet
+ * A record only counts as processed once everything enqueued up to it was
+ * delivered, spooled or dropped by policy. Each checkpoint keeps the lane
+ * commit marks at the time it was read and is released to the cursor once
+ * every lane settled past them.
+ */
+typedef struct cursor_checkpoint {
+    uint32_t id;
+    uint64_t time;
+    uint64_t marks[LOG_LANE_COUNT];
+} cursor_checkpoint_t;
+
+static struct {
+    cursor_checkpoint_t entries[CURSOR_CHECKPOINTS];
+    uint32_t head;  // Oldest checkpoint
+    uint32_t count;
+    bool held;      // A record was read but not stored, the cursor stays in front of it
+} checkpoints;
+
+/**
+ * Catch-up on the backlog logd replays when the stream (re)starts
+ * Set up before the stream is attached; the pacing window belongs to
+ * whoever reads the stream (the reader thread or the event loop) after that.
+ */
+static struct {
+    bool resume;            // Skip records up to resume_id/resume_time
+    uint32_t resume_id;
+    uint64_t resume_time;
+    uint64_t backlog_until; // Records older than this (ms since the epoch) are backlog
+    uint32_t rate;          // Backlog records per CATCHUP_WINDOW_MS, 0 for unlimited
+    uint64_t window_start;  // Monotonic ms
+    uint32_t window_count;
+} catchup;
 
 // Log policy
 enum { LOG_MSG, LOG_ID, LOG_PRIO, LOG_SOURCE, LOG_TIME, __LOG_MAX };
@@ -46,68 +104,363 @@ static const struct blobmsg_policy log_policy[] = {
 static char access_token[256] = {0};
 static time_t token_expiry = 0;
 static bool token_initialized = false;
+static struct ubus_request token_request;
+static bool token_request_pending = false;
+static struct ubus_event_handler token_event_handler;
+static uint64_t token_refreshes = 0;
+static uint64_t token_failures = 0;
 
 // Log acceptance control
 static bool accept_logs = false;
 static int consecutive_network_failures = 0;
 static const int MAX_NETWORK_FAILURES = 3;
 
+// Compiled log filter (from the "config filter" sections)
+static log_filter_t log_filter;
+
+// Logs from logd ignored while log acceptance was disabled
+static uint64_t not_accepted_count = 0;
+// Logd records that needed the generic parser
+static uint64_t generic_parsed_count = 0;
+// Filtered records the reader thread dropped because the ring was full
+static uint64_t ring_dropped_count = 0;
+// Replayed records at or below the cursor
+static uint64_t catchup_skipped_count = 0;
+static time_t start_time = 0;
+
+static int method_stats(struct ubus_context *ctx, struct ubus_object *obj, struct ubus_request_data *req,
+                        const char *method, struct blob_attr *msg);
+static int method_reload(struct ubus_context *ctx, struct ubus_object *obj, struct ubus_request_data *req,
+                         const char *method, struct blob_attr *msg);
+
+// Collector object: ubus call fry-collector stats|reload
+static const struct ubus_method collector_methods[] = {
+    UBUS_METHOD_NOARG("stats", method_stats),
+    UBUS_METHOD_NOARG("reload", method_reload),
+};
+
+static struct ubus_object_type collector_object_type = UBUS_OBJECT_TYPE(COLLECTOR_OBJECT_NAME, collector_methods);
+
+static struct ubus_object collector_object = {
+    .name = COLLECTOR_OBJECT_NAME,
+    .type = &collector_object_type,
+    .methods = collector_methods,
+    .n_methods = ARRAY_SIZE(collector_methods),
+};
+
 // Forward declarations
 static void start_log_streaming(void);
 static void stop_log_streaming(void);
+static void abort_token_request(void);
+static void token_refresh_timer_cb(struct uloop_timeout *timeout);
+static void token_event_cb(struct ubus_context *ctx, struct ubus_event_handler *ev, const char *type,
+                           struct blob_attr *msg);
 
 /**
- * Check if log entry should be processed based on filters
+ * Enqueue a log entry that passed the filter
  */
-static bool should_process_log(const char *msg, int priority, int source) {
-    // Example: filter out debug messages
-    if ((priority & 0x7) == LOG_DEBUG) {
-        return false;
+static void enqueue_log_entry(const log_data_t *log_data) {
+    // Short circuit: Don't accept logs if token is not available or network issues
+    if (!accept_logs) {
+        not_accepted_count++;
+        return;
     }
 
-    // Example: filter out kernel messages if needed
-    // if (source == 0) { // SOURCE_KLOG
-    //     return false;
-    // }
+    // Enqueue the log, the message is copied straight from the stream (or ring) buffer into the arena
+    int ret = collect_enqueue_log(log_data);
+    if (ret == -EINVAL || ret == -EPERM) {
+        // Collection stopped under the stream, logd replays the record after a restart
+        if (!checkpoints.held) {
+            console_warn(&csl, "Failed to enqueue log: %d, holding the cursor", ret);
+        }
+        checkpoints.held = true;
+    } else if (ret < 0 && ret != -EAGAIN) { // -EAGAIN: rate limited, reported by the limiter
+        console_warn(&csl, "Failed to enqueue log: %d", ret);
+    }
+}
 
-    // Add more filtering logic as needed
-    return true;
+/**
+ * Move the cursor to the newest checkpoint whose records all left memory
+ */
+static void settle_cursor(void) {
+    uint64_t settled[LOG_LANE_COUNT];
+
+    if (checkpoints.count == 0) {
+        return;
+    }
+
+    collect_get_settled_marks(settled);
+    while (checkpoints.count > 0) {
+        const cursor_checkpoint_t *cp = &checkpoints.entries[checkpoints.head];
+
+        for (int lane = 0; lane < LOG_LANE_COUNT; lane++) {
+            if (cp->marks[lane] > settled[lane]) {
+                return;
+            }
+        }
+
+        cursor_advance(&log_cursor, cp->id, cp->time);
+        checkpoints.head = (checkpoints.head + 1) % CURSOR_CHECKPOINTS;
+        checkpoints.count--;
+    }
 }
 
 /**
- * Process a single log entry
+ * Write the cursor, called periodically while logs flow and when the stream stops
  */
-static void process_log_entry(struct blob_attr *tb[__LOG_MAX]) {
-    const char *msg;
-    uint32_t priority, source;
-    uint64_t timestamp;
+static void save_cursor(void) {
+    settle_cursor();
 
-    // Short circuit: Don't accept logs if token is not available or network issues
-    if (!accept_logs) {
+    int ret = cursor_save(&log_cursor);
+
+    if (ret < 0 && !cursor_save_failed) {
+        console_warn(&csl, "Failed to write cursor %s: %s", log_cursor.path, strerror(-ret));
+    }
+    cursor_save_failed = ret < 0;
+}
+
+static void cursor_save_timer_cb(struct uloop_timeout *timeout) {
+    save_cursor();
+
+    // Keep going until the records behind the pending checkpoints left memory
+    if (checkpoints.count > 0) {
+        uloop_timeout_set(&cursor_save_timer, CURSOR_SAVE_INTERVAL_MS);
+    }
+}
+
+/**
+ * Queue a checkpoint past a record that was enqueued or filtered out
+ */
+static void advance_cursor(uint32_t id, uint64_t time) {
+    cursor_checkpoint_t *cp;
+    uint64_t marks[LOG_LANE_COUNT];
+
+    // Records read while acceptance was off are lost and may come back with the backlog
+    if (!log_cursor.path[0] || !accept_logs || checkpoints.held) {
         return;
     }
 
-    msg = blobmsg_get_string(tb[LOG_MSG]);
-    priority = blobmsg_get_u32(tb[LOG_PRIO]);
-    source = blobmsg_get_u32(tb[LOG_SOURCE]);
-    timestamp = blobmsg_get_u64(tb[LOG_TIME]);
+    // A checkpoint that waits for the same records is moved forward, so is the newest one when all are taken
+    collect_get_commit_marks(marks);
+    cp = checkpoints.count > 0
+             ? &checkpoints.entries[(checkpoints.head + checkpoints.count - 1) % CURSOR_CHECKPOINTS]
+             : NULL;
+    if (!cp || (memcmp(cp->marks, marks, sizeof(marks)) != 0 && checkpoints.count < CURSOR_CHECKPOINTS)) {
+        cp = &checkpoints.entries[(checkpoints.head + checkpoints.count) % CURSOR_CHECKPOINTS];
+        checkpoints.count++;
+    }
+    cp->id = id;
+    cp->time = time;
+    memcpy(cp->marks, marks, sizeof(marks));
+
+    if (!cursor_save_timer.pending) {
+        uloop_timeout_set(&cursor_save_timer, CURSOR_SAVE_INTERVAL_MS);
+    }
+}
 
+/**
+ * Process a single log entry
+ */
+static void process_log_entry(const log_data_t *log_data) {
     // Apply filters
-    if (!should_process_log(msg, priority, source)) {
-        return;
+    if (filter_accept(&log_filter, log_data->msg, log_data->msg_len, log_data->priority, log_data->source)) {
+        enqueue_log_entry(log_data);
     }
 
-    // Create log structure for collection with raw fields
-    log_data_t log_data = {.time = timestamp,
-                           .priority = priority,
-                           .source = source,
-                           .msg = msg};
+    advance_cursor(log_data->id, log_data->time);
+}
 
-    // Enqueue the log
-    int ret = collect_enqueue_log(&log_data);
-    if (ret < 0) {
-        console_warn(&csl, "Failed to enqueue log: %d", ret);
+/**
+ * Set up the catch-up for a new stream
+ * @return number of buffered records to request from logd
+ */
+static uint32_t prepare_catchup(void) {
+    const collector_config_t *config = config_get_current();
+    struct timespec now;
+
+    memset(&catchup, 0, sizeof(catchup));
+    if (!log_cursor.path[0] || config->catchup_lines == 0) {
+        return 0;
+    }
+
+    // Records behind pending checkpoints are still held in memory, the stream resumes after the newest
+    clock_gettime(CLOCK_REALTIME, &now);
+    if (checkpoints.count > 0) {
+        const cursor_checkpoint_t *cp =
+            &checkpoints.entries[(checkpoints.head + checkpoints.count - 1) % CURSOR_CHECKPOINTS];
+        catchup.resume = true;
+        catchup.resume_id = cp->id;
+        catchup.resume_time = cp->time;
+    } else {
+        catchup.resume = log_cursor.valid;
+        catchup.resume_id = log_cursor.id;
+        catchup.resume_time = log_cursor.time;
+    }
+    catchup.backlog_until = (uint64_t)now.tv_sec * 1000 + (uint64_t)now.tv_nsec / 1000000;
+    catchup.rate = config->catchup_rate;
+    return config->catchup_lines;
+}
+
+/**
+ * Check if a replayed record was processed before, also called on the reader thread
+ */
+static bool catchup_seen(const log_data_t *log_data) {
+    return catchup.resume && cursor_covers(catchup.resume_id, catchup.resume_time, log_data->id, log_data->time);
+}
+
+/**
+ * Pace backlog records to catchup_rate, also called on the reader thread
+ * Live records are never held back.
+ * @return milliseconds until the record may be processed, 0 right away
+ */
+static uint32_t catchup_pace(const log_data_t *log_data) {
+    struct timespec ts;
+
+    if (!catchup.rate || log_data->time >= catchup.backlog_until) {
+        return 0;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    uint64_t now = (uint64_t)ts.tv_sec * 1000 + (uint64_t)ts.tv_nsec / 1000000;
+    if (now - catchup.window_start >= CATCHUP_WINDOW_MS) {
+        catchup.window_start = now;
+        catchup.window_count = 0;
+    }
+
+    if (catchup.window_count >= catchup.rate) {
+        return (uint32_t)(catchup.window_start + CATCHUP_WINDOW_MS - now);
+    }
+
+    catchup.window_count++;
+    return 0;
+}
+
+/**
+ * Parse a log record in the exact layout logd writes
+ * logd emits msg, id, priority, source and time in log_policy order for every
+ * record, so each attribute is checked against the next policy entry instead of
+ * being looked up by name. Types, lengths and the message NUL are validated like
+ * blobmsg_parse() does.
+ * @return true if the record had the expected layout and log_data was filled
+ */
+static bool parse_log_record_fast(struct blob_attr *record, log_data_t *log_data) {
+    struct blob_attr *fields[__LOG_MAX];
+    size_t msg_len = 0;
+    const char *end = (const char *)blob_data(record) + blob_len(record);
+    struct blob_attr *cur = blob_data(record);
+
+    for (int i = 0; i < __LOG_MAX; i++) {
+        const char *name = log_policy[i].name;
+        size_t name_len = strlen(name); // Folded at compile time
+        size_t hdr_len = sizeof(*cur) + blobmsg_hdrlen(name_len);
+
+        if ((const char *)cur + sizeof(*cur) > end) {
+            return false;
+        }
+
+        size_t raw_len = blob_raw_len(cur);
+        if (raw_len < hdr_len || (const char *)cur + raw_len > end || !blob_is_extended(cur) ||
+            blob_id(cur) != log_policy[i].type) {
+            return false;
+        }
+
+        const struct blobmsg_hdr *hdr = blob_data(cur);
+        if (blobmsg_namelen(hdr) != name_len || memcmp(hdr->name, name, name_len + 1) != 0) {
+            return false;
+        }
+
+        size_t data_len = raw_len - hdr_len;
+        const char *data = (const char *)cur + hdr_len;
+        switch (log_policy[i].type) {
+        case BLOBMSG_TYPE_STRING:
+            if (data_len == 0 || data[data_len - 1] != '\0') {
+                return false;
+            }
+            msg_len = data_len - 1;
+            break;
+        case BLOBMSG_TYPE_INT32:
+            if (data_len != sizeof(uint32_t)) {
+                return false;
+            }
+            break;
+        case BLOBMSG_TYPE_INT64:
+            if (data_len != sizeof(uint64_t)) {
+                return false;
+            }
+            break;
+        default:
+            return false;
+        }
+
+        fields[i] = cur;
+        cur = blob_next(cur);
+    }
+
+    // Trailing attributes mean a layout this parser does not know
+    if ((const char *)cur < end) {
+        return false;
+    }
+
+    log_data->msg = blobmsg_get_string(fields[LOG_MSG]);
+    log_data->msg_len = msg_len;
+    log_data->priority = blobmsg_get_u32(fields[LOG_PRIO]);
+    log_data->source = blobmsg_get_u32(fields[LOG_SOURCE]);
+    log_data->id = blobmsg_get_u32(fields[LOG_ID]);
+    log_data->origin = 0;
+    log_data->time = blobmsg_get_u64(fields[LOG_TIME]);
+    return true;
+}
+
+/**
+ * Parse a log record with the generic blobmsg parser
+ * Used for records the fast path does not recognize, e.g. reordered or extra fields.
+ * @return true if all required fields were present and log_data was filled
+ */
+static bool parse_log_record_generic(struct blob_attr *record, log_data_t *log_data) {
+    struct blob_attr *tb[__LOG_MAX];
+
+    if (blobmsg_parse(log_policy, ARRAY_SIZE(log_policy), tb, blob_data(record), blob_len(record)) != 0) {
+        return false;
+    }
+
+    // Verify all required fields are present
+    if (!tb[LOG_ID] || !tb[LOG_PRIO] || !tb[LOG_SOURCE] || !tb[LOG_TIME] || !tb[LOG_MSG]) {
+        return false;
+    }
+
+    log_data->msg = blobmsg_get_string(tb[LOG_MSG]);
+    log_data->msg_len = blobmsg_len(tb[LOG_MSG]) - 1; // blobmsg_parse() checked the terminating NUL
+    log_data->priority = blobmsg_get_u32(tb[LOG_PRIO]);
+    log_data->source = blobmsg_get_u32(tb[LOG_SOURCE]);
+    log_data->id = blobmsg_get_u32(tb[LOG_ID]);
+    log_data->origin = 0;
+    log_data->time = blobmsg_get_u64(tb[LOG_TIME]);
+    return true;
+}
+
+/**
+ * Parse a log record, falling back to the generic parser
+ * Also called on the reader thread, so it must not touch any state.
+ * @param generic Set if the fast path did not recognize the layout
+ * @return true if log_data was filled
+ */
+static bool parse_log_record(struct blob_attr *record, log_data_t *log_data, bool *generic) {
+    if (parse_log_record_fast(record, log_data)) {
+        return true;
+    }
+
+    *generic = true;
+    return parse_log_record_generic(record, log_data);
+}
+
+/**
+ * Count records that needed the generic parser
+ */
+static void count_generic_parsed(uint64_t count) {
+    if (count > 0 && generic_parsed_count == 0) {
+        console_info(&csl, "Unexpected logd record layout, using the generic parser");
     }
+    generic_parsed_count += count;
 }
 
 /**
@@ -116,7 +469,8 @@ static void process_log_entry(struct blob_attr *tb[__LOG_MAX]) {
 static void log_stream_data_cb(struct ustream *s, int bytes) {
     while (true) {
         struct blob_attr *a;
-        struct blob_attr *tb[__LOG_MAX];
+        log_data_t log_data;
+        bool generic = false;
         int len, cur_len;
 
         // Get available data
@@ -127,11 +481,21 @@ static void log_stream_data_cb(struct ustream *s, int bytes) {
         cur_len = blob_len(a) + sizeof(*a);
         if (len < cur_len) break;
 
-        // Parse the log entry
-        if (blobmsg_parse(log_policy, ARRAY_SIZE(log_policy), tb, blob_data(a), blob_len(a)) == 0) {
-            // Verify all required fields are present
-            if (tb[LOG_ID] && tb[LOG_PRIO] && tb[LOG_SOURCE] && tb[LOG_TIME] && tb[LOG_MSG]) {
-                process_log_entry(tb);
+        // Parse the log entry, the fields keep pointing into the stream buffer
+        if (parse_log_record(a, &log_data, &generic)) {
+            if (catchup_seen(&log_data)) {
+                catchup_skipped_count++;
+            } else {
+                uint32_t delay_ms = catchup_pace(&log_data);
+                if (delay_ms > 0) {
+                    // Leave the record buffered and stop reading until the pause is over
+                    ustream_set_read_blocked(s, true);
+                    uloop_timeout_set(&catchup_timer, delay_ms);
+                    break;
+                }
+
+                count_generic_parsed(generic);
+                process_log_entry(&log_data);
             }
         }
 
@@ -140,6 +504,30 @@ static void log_stream_data_cb(struct ustream *s, int bytes) {
     }
 }
 
+/**
+ * Resume the paced ustream
+ */
+static void catchup_timer_cb(struct uloop_timeout *timeout) {
+    if (!log_streaming || ingest_thread_running()) {
+        return;
+    }
+
+    ustream_set_read_blocked(&log_stream.stream, false);
+    log_stream_data_cb(&log_stream.stream, 0);
+}
+
+/**
+ * Stream ended, clean up and try to reconnect
+ */
+static void log_stream_ended(void) {
+    stop_log_streaming();
+
+    // Schedule reconnection
+    if (reconnect_tries > 0) {
+        uloop_timeout_set(&reconnect_timer, UBUS_RECONNECT_DELAY_MS);
+    }
+}
+
 /**
  * Handle stream state changes
  */
@@ -147,23 +535,64 @@ static void log_stream_state_cb(struct ustream *s) {
     console_info(&csl, "Log stream state changed, EOF=%d", s->eof);
 
     if (s->eof) {
-        // Stream ended, clean up and try to reconnect
-        stop_log_streaming();
+        log_stream_ended();
+    }
+}
 
-        // Schedule reconnection
-        if (reconnect_tries > 0) {
-            uloop_timeout_set(&reconnect_timer, UBUS_RECONNECT_DELAY_MS);
-        }
+/**
+ * Add up the counters of the reader thread
+ */
+static void ingest_counts_cb(const ingest_thread_counts_t *counts) {
+    log_filter.stats.accepted += counts->filter.accepted;
+    log_filter.stats.dropped_level += counts->filter.dropped_level;
+    log_filter.stats.dropped_pattern += counts->filter.dropped_pattern;
+    count_generic_parsed(counts->generic_parsed);
+    ring_dropped_count += counts->ring_dropped;
+    catchup_skipped_count += counts->skipped;
+    if (counts->advanced) {
+        advance_cursor(counts->last_id, counts->last_time);
     }
 }
 
 /**
- * File descriptor callback for log reading
+ * Reader thread gave up the stream
  */
-static void log_read_fd_cb(struct ubus_request *req, int fd) {
-    console_info(&csl, "Got log stream file descriptor: %d", fd);
+static void ingest_ended_cb(int error) {
+    if (error < 0) {
+        console_warn(&csl, "Log stream read failed: %s", strerror(-error));
+    } else {
+        console_info(&csl, "Log stream reached EOF");
+    }
+
+    log_stream_ended();
+}
+
+static const ingest_thread_ops_t ingest_ops = {
+    .parse = parse_log_record,
+    .seen = catchup_seen,
+    .pace = catchup_pace,
+    .log = enqueue_log_entry,
+    .counts = ingest_counts_cb,
+    .ended = ingest_ended_cb,
+};
+
+/**
+ * Read log records from a logd stream descriptor
+ * With the reader thread, parsing and filtering run on a second core and only
+ * the records that passed reach the event loop.
+ */
+static void attach_log_stream(int fd) {
+    if (use_ingest_thread) {
+        int ret = ingest_thread_start(fd, &log_filter, config_get_current()->ingest_ring_kb * 1024, &ingest_ops);
+        if (ret == 0) {
+            log_streaming = true;
+            return;
+        }
+
+        console_warn(&csl, "Failed to start the reader thread: %s, reading logs on the event loop", strerror(-ret));
+        use_ingest_thread = false;
+    }
 
-    // Initialize ustream for the file descriptor
     memset(&log_stream, 0, sizeof(log_stream));
     log_stream.stream.notify_read = log_stream_data_cb;
     log_stream.stream.notify_state = log_stream_state_cb;
@@ -172,12 +601,31 @@ static void log_read_fd_cb(struct ubus_request *req, int fd) {
     log_streaming = true;
 }
 
+/**
+ * Decide once where the log stream is read
+ */
+static void select_ingest_mode(void) {
+    use_ingest_thread = ingest_thread_wanted(config_get_current()->ingest_thread);
+    if (use_ingest_thread) {
+        console_info(&csl, "Reading logs on a separate thread (%ld CPUs online)", sysconf(_SC_NPROCESSORS_ONLN));
+    }
+}
+
+/**
+ * File descriptor callback for log reading
+ */
+static void log_read_fd_cb(struct ubus_request *req, int fd) {
+    console_info(&csl, "Got log stream file descriptor: %d", fd);
+    attach_log_stream(fd);
+}
+
 /**
  * Connection lost callback
  */
 static void ubus_connection_lost_cb(struct ubus_context *ctx) {
     console_warn(&csl, "UBUS connection lost");
     ubus_connected = false;
+    abort_token_request();
 
     // Stop log streaming
     stop_log_streaming();
@@ -193,8 +641,14 @@ static void ubus_connection_lost_cb(struct ubus_context *ctx) {
 static void stop_log_streaming(void) {
     if (log_streaming) {
         console_info(&csl, "Stopping log stream");
-        ustream_free(&log_stream.stream);
         log_streaming = false;
+        uloop_timeout_cancel(&catchup_timer);
+        if (ingest_thread_running()) {
+            ingest_thread_stop(&log_filter);
+        } else {
+            ustream_free(&log_stream.stream);
+        }
+        save_cursor();
     }
 }
 
@@ -202,7 +656,7 @@ static void stop_log_streaming(void) {
  * Start log streaming
  */
 static void start_log_streaming(void) {
-    uint32_t id;
+    uint32_t id, lines;
     int ret;
     static struct blob_buf b;
 
@@ -227,7 +681,9 @@ static void start_log_streaming(void) {
     blob_buf_init(&b, 0);
     blobmsg_add_u8(&b, "stream", 1);  // Enable streaming
     blobmsg_add_u8(&b, "oneshot", 0); // Continuous streaming (like -f)
-    blobmsg_add_u32(&b, "lines", 0);  // Start from current position
+    lines = prepare_catchup();
+    checkpoints.held = false;
+    blobmsg_add_u32(&b, "lines", lines); // Backlog to catch up on, 0 starts from the current position
 
     // Make async request
     memset(&log_request, 0, sizeof(log_request));
@@ -244,10 +700,230 @@ static void start_log_streaming(void) {
     // Complete the async request
     ubus_complete_request_async(ctx, &log_request);
 
-    console_info(&csl, "Started log streaming");
+    console_info(&csl, "Started log streaming (backlog of up to %u records)", lines);
     blob_buf_free(&b);
 }
 
+// Names of the priority lanes in the stats reply
+static const char *const lane_names[LOG_LANE_COUNT] = {"high", "medium", "low"};
+
+/**
+ * Add the blobmsg table of a histogram-backed percentile set
+ */
+static void add_percentiles(struct blob_buf *b, const char *name, double p50, double p95, double p99, double max) {
+    void *table = blobmsg_open_table(b, name);
+    blobmsg_add_double(b, "p50", p50);
+    blobmsg_add_double(b, "p95", p95);
+    blobmsg_add_double(b, "p99", p99);
+    blobmsg_add_double(b, "max", max);
+    blobmsg_close_table(b, table);
+}
+
+/**
+ * Method: stats
+ * Counters are cumulative since start, rates and percentiles are computed on request.
+ */
+static int method_stats(struct ubus_context *ctx, struct ubus_object *obj, struct ubus_request_data *req,
+                        const char *method, struct blob_attr *msg) {
+    collect_ingest_stats_t ingest;
+    collect_buffer_stats_t buffer;
+    collect_payload_stats_t payload;
+    collect_batching_stats_t batching;
+    collect_http_stats_t http;
+    ingest_thread_stats_t ring;
+    spool_stats_t spool;
+    membudget_t memory;
+    syslog_input_stats_t syslog;
+    const sink_t *sinks[SINK_MAX + 1];
+    uint32_t queue_size, dropped_count;
+    void *table;
+
+    console_debug(&csl, "UBUS method called: %s", method);
+
+    collect_get_ingest_stats(&ingest);
+    ingest_thread_get_stats(&ring);
+    collect_get_buffer_stats(&buffer);
+    collect_get_payload_stats(&payload);
+    collect_get_batching_stats(&batching);
+    collect_get_http_stats(&http);
+    collect_get_spool_stats(&spool);
+    collect_get_memory_stats(&memory);
+    syslog_input_get_stats(&syslog);
+    int sink_count = collect_get_sinks(sinks, SINK_MAX + 1);
+    collect_get_stats(&queue_size, &dropped_count);
+
+    struct blob_buf response = {0};
+    blob_buf_init(&response, 0);
+
+    blobmsg_add_u64(&response, "uptime", (uint64_t)(time(NULL) - start_time));
+    blobmsg_add_u8(&response, "accepting_logs", accept_logs ? 1 : 0);
+
+    table = blobmsg_open_table(&response, "ingest");
+    blobmsg_add_u64(&response, "received", ingest.received + not_accepted_count);
+    blobmsg_add_u64(&response, "enqueued", ingest.enqueued);
+    blobmsg_add_u64(&response, "collapsed", ingest.collapsed);
+    blobmsg_add_u64(&response, "catchup_skipped", catchup_skipped_count);
+    blobmsg_add_double(&response, "rate_per_s", ingest.rate_per_s);
+    blobmsg_add_u32(&response, "sample_rate", ingest.sample_rate);
+    blobmsg_add_u8(&response, "thread", ring.running);
+    if (ring.running) {
+        blobmsg_add_u32(&response, "ring_bytes", ring.ring_bytes);
+        blobmsg_add_u32(&response, "ring_used_bytes", ring.used_bytes);
+        blobmsg_add_u32(&response, "ring_high_water", ring.high_water);
+    }
+    blobmsg_close_table(&response, table);
+
+    table = blobmsg_open_table(&response, "syslog");
+    blobmsg_add_u8(&response, "udp", syslog.udp);
+    blobmsg_add_u8(&response, "tcp", syslog.tcp);
+    blobmsg_add_u64(&response, "received", syslog.received);
+    blobmsg_add_u64(&response, "filtered", syslog.filter.dropped_level + syslog.filter.dropped_pattern);
+    blobmsg_add_u64(&response, "truncated", syslog.truncated);
+    blobmsg_add_u32(&response, "tcp_clients", syslog.tcp_clients);
+    blobmsg_add_u64(&response, "tcp_rejected", syslog.tcp_rejected);
+    blobmsg_add_u64(&response, "framing_errors", syslog.framing_errors);
+    blobmsg_close_table(&response, table);
+
+    table = blobmsg_open_table(&response, "drops");
+    blobmsg_add_u64(&response, "buffer_exhausted", ingest.buffer_exhausted);
+    blobmsg_add_u64(&response, "queue_full", ingest.queue_full);
+    blobmsg_add_u64(&response, "evicted", ingest.evicted);
+    blobmsg_add_u64(&response, "acceptance_disabled", ingest.rejected + not_accepted_count);
+    blobmsg_add_u64(&response, "filtered", log_filter.stats.dropped_level + log_filter.stats.dropped_pattern);
+    blobmsg_add_u64(&response, "rate_limited", ingest.rate_limited);
+    blobmsg_add_u64(&response, "sampled", ingest.sampled);
+    blobmsg_add_u64(&response, "ring_full", ring_dropped_count);
+    blobmsg_close_table(&response, table);
+
+    table = blobmsg_open_table(&response, "queue");
+    blobmsg_add_u32(&response, "records", queue_size);
+    blobmsg_add_u32(&response, "held_records", buffer.held_records);
+    blobmsg_add_u32(&response, "used_bytes", buffer.used_bytes);
+    blobmsg_add_u32(&response, "capacity_bytes", buffer.capacity_bytes);
+    blobmsg_add_u32(&response, "fill_percent", buffer.fill_percent);
+    void *lanes = blobmsg_open_table(&response, "lanes");
+    for (int lane = 0; lane < LOG_LANE_COUNT; lane++) {
+        void *entry = blobmsg_open_table(&response, lane_names[lane]);
+        blobmsg_add_u32(&response, "records", buffer.lanes[lane].queued_records);
+        blobmsg_add_u32(&response, "held_records", buffer.lanes[lane].held_records);
+        blobmsg_add_u32(&response, "used_bytes", buffer.lanes[lane].used_bytes);
+        blobmsg_add_u32(&response, "capacity_bytes", buffer.lanes[lane].capacity_bytes);
+        blobmsg_add_u64(&response, "evicted", buffer.lanes[lane].evicted);
+        blobmsg_close_table(&response, entry);
+    }
+    blobmsg_close_table(&response, lanes);
+    blobmsg_close_table(&response, table);
+
+    table = blobmsg_open_table(&response, "memory");
+    blobmsg_add_u8(&response, "budget_mode", memory.enabled);
+    if (memory.enabled) {
+        blobmsg_add_u32(&response, "budget_kb", memory.budget_kb);
+        blobmsg_add_u32(&response, "target_kb", memory.target_kb);
+        blobmsg_add_u64(&response, "available_kb", memory.available_kb);
+        if (memory.psi_avg10 >= 0) {
+            blobmsg_add_double(&response, "psi_some_avg10", memory.psi_avg10);
+        }
+        blobmsg_add_u8(&response, "pressure", memory.pressure);
+        blobmsg_add_u64(&response, "pressure_events", memory.pressure_events);
+        blobmsg_add_u32(&response, "shrunk", memory.shrunk);
+        blobmsg_add_u32(&response, "grown", memory.grown);
+    }
+    blobmsg_close_table(&response, table);
+
+    table = blobmsg_open_table(&response, "batches");
+    blobmsg_add_u64(&response, "serialized", payload.batches);
+    blobmsg_add_u64(&response, "logs", payload.logs);
+    blobmsg_add_u32(&response, "batch_size", batching.batch_size);
+    blobmsg_add_u32(&response, "batch_timeout_ms", batching.batch_timeout_ms);
+    add_percentiles(&response, "size", http.batch_size_p50, http.batch_size_p95, http.batch_size_p99,
+                    http.batch_size_max);
+    blobmsg_close_table(&response, table);
+
+    table = blobmsg_open_table(&response, "payload");
+    blobmsg_add_u64(&response, "serialized_bytes", payload.payload_bytes);
+    blobmsg_add_u64(&response, "wire_bytes", payload.wire_bytes);
+    blobmsg_close_table(&response, table);
+
+    table = blobmsg_open_table(&response, "http");
+    blobmsg_add_u64(&response, "requests", http.requests);
+    blobmsg_add_u32(&response, "consecutive_failures", http.consecutive_failures);
+    blobmsg_add_u64(&response, "rejected_batches", http.rejected_batches);
+    blobmsg_add_u32(&response, "backoff_ms", http.backoff_ms);
+    blobmsg_add_u32(&response, "backoff_level", http.backoff_level);
+    add_percentiles(&response, "latency_ms", http.latency_p50_ms, http.latency_p95_ms, http.latency_p99_ms,
+                    http.latency_max_ms);
+    blobmsg_close_table(&response, table);
+
+    table = blobmsg_open_table(&response, "token");
+    blobmsg_add_u8(&response, "valid", ubus_is_access_token_valid());
+    blobmsg_add_u64(&response, "expires_in", ubus_is_access_token_valid() ? (uint64_t)(token_expiry - time(NULL)) : 0);
+    blobmsg_add_u64(&response, "refreshes", token_refreshes);
+    blobmsg_add_u64(&response, "failures", token_failures);
+    blobmsg_close_table(&response, table);
+
+    table = blobmsg_open_table(&response, "spool");
+    blobmsg_add_u32(&response, "pending_batches", spool.pending_batches);
+    blobmsg_add_u32(&response, "pending_records", spool.pending_records);
+    blobmsg_add_u32(&response, "segments", spool.segments);
+    blobmsg_add_u64(&response, "replayed_batches", spool.replayed_batches);
+    blobmsg_add_u64(&response, "dropped_batches", spool.dropped_batches);
+    blobmsg_close_table(&response, table);
+
+    table = blobmsg_open_table(&response, "sinks");
+    for (int i = 0; i < sink_count; i++) {
+        void *entry = blobmsg_open_table(&response, sinks[i]->name);
+        blobmsg_add_string(&response, "type", sinks[i]->ops->type);
+        blobmsg_add_u8(&response, "connected", sinks[i]->stats.connected);
+        blobmsg_add_u64(&response, "batches", sinks[i]->stats.batches);
+        blobmsg_add_u64(&response, "bytes", sinks[i]->stats.bytes);
+        blobmsg_add_u64(&response, "errors", sinks[i]->stats.errors);
+        blobmsg_add_u64(&response, "dropped", sinks[i]->stats.dropped);
+        blobmsg_add_u32(&response, "queued_bytes", sinks[i]->stats.queued_bytes);
+        blobmsg_close_table(&response, entry);
+    }
+    blobmsg_close_table(&response, table);
+
+    int ret = ubus_send_reply(ctx, req, response.head);
+    blob_buf_free(&response);
+    return ret;
+}
+
+/**
+ * Method: reload
+ * Re-reads the configuration file and applies it without dropping queued logs.
+ */
+static int method_reload(struct ubus_context *ctx, struct ubus_object *obj, struct ubus_request_data *req,
+                         const char *method, struct blob_attr *msg) {
+    int ret = collect_reload_config();
+    if (ret == -ENOENT) {
+        return UBUS_STATUS_NOT_FOUND;
+    }
+    return ret < 0 ? UBUS_STATUS_INVALID_ARGUMENT : UBUS_STATUS_OK;
+}
+
+/**
+ * Publish the collector object on the current connection
+ */
+static void add_collector_object(void) {
+    int ret = ubus_add_object(ctx, &collector_object);
+    if (ret) {
+        console_warn(&csl, "Failed to add %s object: %s", COLLECTOR_OBJECT_NAME, ubus_strerror(ret));
+    }
+}
+
+/**
+ * Listen for token rotations announced by fry-agent on the current connection
+ */
+static void subscribe_token_events(void) {
+    memset(&token_event_handler, 0, sizeof(token_event_handler));
+    token_event_handler.cb = token_event_cb;
+
+    int ret = ubus_register_event_handler(ctx, &token_event_handler, TOKEN_EVENT);
+    if (ret) {
+        console_warn(&csl, "Failed to listen for %s events: %s", TOKEN_EVENT, ubus_strerror(ret));
+    }
+}
+
 /**
  * Reconnect timer callback
  */
@@ -262,6 +938,7 @@ static void reconnect_timer_cb(struct uloop_timeout *timeout) {
 
     // Clean up old context
     if (ctx) {
+        abort_token_request();
         ubus_free(ctx);
         ctx = NULL;
     }
@@ -282,8 +959,16 @@ static void reconnect_timer_cb(struct uloop_timeout *timeout) {
     ubus_add_uloop(ctx);
     ubus_connected = true;
 
+    add_collector_object();
+    subscribe_token_events();
+
     console_info(&csl, "Reconnected to UBUS");
 
+    // A rotation may have been missed while disconnected
+    if (!token_request_pending) {
+        ubus_refresh_access_token();
+    }
+
     // Start log streaming
     start_log_streaming();
 }
@@ -296,6 +981,17 @@ int ubus_init(void) {
 
     console_info(&csl, "Initializing UBUS connection");
 
+    // Compile the log filter before any log can arrive
+    if (filter_compile(&log_filter, &config_get_current()->filters) < 0) {
+        console_warn(&csl, "Log filter patterns disabled, applying severity thresholds only");
+    }
+    select_ingest_mode();
+
+    int ret = cursor_load(&log_cursor, config_get_current()->cursor_file);
+    if (ret < 0) {
+        console_warn(&csl, "Failed to read cursor %s: %s", config_get_current()->cursor_file, strerror(-ret));
+    }
+
     // Connect to UBUS
     ctx = ubus_connect(ubus_socket);
     if (!ctx) {
@@ -310,17 +1006,58 @@ int ubus_init(void) {
     ubus_add_uloop(ctx);
     ubus_connected = true;
 
+    start_time = time(NULL);
+    add_collector_object();
+    subscribe_token_events();
+
     // Initialize timers
     reconnect_timer.cb = reconnect_timer_cb;
+    token_refresh_timer.cb = token_refresh_timer_cb;
+    cursor_save_timer.cb = cursor_save_timer_cb;
+    catchup_timer.cb = catchup_timer_cb;
 
     console_info(&csl, "UBUS initialized successfully");
 
-    // Don't start log streaming yet - wait for token initialization
+    // Don't start log streaming yet - the token reply enables log acceptance
     console_info(&csl, "Waiting for access token before starting log streaming");
+    ubus_refresh_access_token();
 
     return 0;
 }
 
+/**
+ * Read logs from an open stream without a UBUS connection
+ */
+int ubus_init_offline(int log_fd, const char *token) {
+    console_info(&csl, "Reading logs from descriptor %d without UBUS", log_fd);
+
+    if (filter_compile(&log_filter, &config_get_current()->filters) < 0) {
+        console_warn(&csl, "Log filter patterns disabled, applying severity thresholds only");
+    }
+    select_ingest_mode();
+
+    start_time = time(NULL);
+
+    // The stream is not logd's, the cursor stays in memory and nothing is skipped
+    cursor_load(&log_cursor, NULL);
+
+    // Fixed token that does not expire, there is no agent to refresh it
+    snprintf(access_token, sizeof(access_token), "%s", token);
+    token_expiry = start_time + 365 * 24 * 3600;
+    token_initialized = true;
+    accept_logs = true;
+
+    // The stream ends at EOF, nothing to reconnect to
+    reconnect_tries = 0;
+    attach_log_stream(log_fd);
+    return 0;
+}
+
+/**
+ * Check if the log stream is open
+ */
+bool ubus_is_log_streaming(void) { return log_streaming; }
+
 /**
  * Start the UBUS loop (not needed with uloop integration)
  */
@@ -338,12 +1075,16 @@ void ubus_cleanup(void) {
     // Cancel timers
     uloop_timeout_cancel(&reconnect_timer);
     uloop_timeout_cancel(&token_refresh_timer);
+    uloop_timeout_cancel(&cursor_save_timer);
 
     // Stop log streaming
     stop_log_streaming();
+    save_cursor();
+    filter_free(&log_filter);
 
     // Free UBUS context
     if (ctx) {
+        abort_token_request();
         ubus_free(ctx);
         ctx = NULL;
     }
@@ -408,83 +1149,18 @@ void ubus_report_network_failure(int consecutive_failures) {
 }
 
 /**
- * Structure to hold response data
+ * Token reply from fry-agent, filled while the request completes
  */
-struct token_response_data {
-    struct blob_buf buf;
+static struct {
+    char token[sizeof(access_token)];
+    time_t expiry;
     bool received;
-};
-
-/**
- * Sync response callback for access token
- */
-static void ubus_sync_response_cb(struct ubus_request *req, int type, struct blob_attr *msg) {
-    struct token_response_data *data = (struct token_response_data *)req->priv;
-
-    console_debug(&csl, "Sync response callback: type=%d, msg=%p, data=%p", type, msg, data);
-
-    if (type == UBUS_MSG_DATA && msg && data) {
-        blob_buf_init(&data->buf, 0);
-        blob_put_raw(&data->buf, blob_data(msg), blob_len(msg));
-        data->received = true;
-        console_debug(&csl, "Response message copied to buffer");
-    }
-}
+} token_reply;
 
 /**
- * Get access token from fry-agent
+ * Parse the get_access_token reply
  */
-int ubus_get_access_token(char *token_buf, size_t token_size, time_t *expiry) {
-    uint32_t id;
-    struct blob_buf b = {};
-    struct token_response_data response_data = {.received = false};
-    int ret;
-
-    if (!ctx || !ubus_connected) {
-        console_error(&csl, "UBUS not connected");
-        return -1;
-    }
-
-    if (!token_buf || token_size < 2 || !expiry) {
-        console_error(&csl, "Invalid parameters");
-        return -1;
-    }
-
-    // Look up fry-agent object
-    ret = ubus_lookup_id(ctx, "fry-agent", &id);
-    if (ret != 0) {
-        console_error(&csl, "Failed to find fry-agent object: %s", ubus_strerror(ret));
-        return -1;
-    }
-
-    console_debug(&csl, "Found fry-agent object with id: %u", id);
-
-    // Prepare request
-    blob_buf_init(&b, 0);
-
-    // Invoke get_access_token method
-    ret = ubus_invoke(ctx, id, "get_access_token", b.head, ubus_sync_response_cb, &response_data, 5000);
-
-    blob_buf_free(&b);
-
-    if (ret != 0) {
-        console_error(&csl, "Failed to get access token: %s", ubus_strerror(ret));
-        return -1;
-    }
-
-    if (!response_data.received || !response_data.buf.head) {
-        console_error(&csl, "No response received from fry-agent");
-        return -1;
-    }
-
-    // Log the raw response for debugging
-    char *json_str = blobmsg_format_json(response_data.buf.head, true);
-    if (json_str) {
-        console_debug(&csl, "Raw token response: %s", json_str);
-        free(json_str);
-    }
-
-    // Parse the response
+static void token_data_cb(struct ubus_request *req, int type, struct blob_attr *msg) {
     enum { TOKEN_FIELD, ISSUED_AT_FIELD, EXPIRES_AT_FIELD, VALID_FIELD, __TOKEN_MAX };
 
     static const struct blobmsg_policy token_policy[__TOKEN_MAX] = {
@@ -496,65 +1172,156 @@ int ubus_get_access_token(char *token_buf, size_t token_size, time_t *expiry) {
 
     struct blob_attr *tb[__TOKEN_MAX];
 
-    if (blobmsg_parse(token_policy, __TOKEN_MAX, tb, blobmsg_data(response_data.buf.head),
-                      blobmsg_len(response_data.buf.head)) != 0) {
-        console_error(&csl, "Failed to parse token response");
-        blob_buf_free(&response_data.buf);
-        return -1;
+    if (type != UBUS_MSG_DATA || !msg) {
+        return;
     }
 
-    // Log which fields were found
-    console_debug(&csl, "Token field present: %s", tb[TOKEN_FIELD] ? "yes" : "no");
-    console_debug(&csl, "Issued_at field present: %s", tb[ISSUED_AT_FIELD] ? "yes" : "no");
-    console_debug(&csl, "Expires_at field present: %s", tb[EXPIRES_AT_FIELD] ? "yes" : "no");
-    console_debug(&csl, "Valid field present: %s", tb[VALID_FIELD] ? "yes" : "no");
+    if (blobmsg_parse(token_policy, __TOKEN_MAX, tb, blob_data(msg), blob_len(msg)) != 0) {
+        console_error(&csl, "Failed to parse token response");
+        return;
+    }
 
     // Check if all required fields are present
     if (!tb[TOKEN_FIELD] || !tb[EXPIRES_AT_FIELD] || !tb[VALID_FIELD]) {
         console_error(&csl, "Missing required fields in token response");
-        blob_buf_free(&response_data.buf);
-        return -1;
+        return;
     }
 
-    // Check if token is valid
-    uint8_t valid = blobmsg_get_u8(tb[VALID_FIELD]);
-    console_debug(&csl, "Token valid field: %s", valid ? "true" : "false");
-    if (!valid) {
+    if (!blobmsg_get_u8(tb[VALID_FIELD])) {
         console_error(&csl, "Token marked as invalid by fry-agent");
-        blob_buf_free(&response_data.buf);
-        return -1;
+        return;
     }
 
-    // Extract token
     const char *token = blobmsg_get_string(tb[TOKEN_FIELD]);
-    if (!token || strlen(token) == 0) {
+    size_t token_len = strlen(token);
+    if (token_len == 0) {
         console_error(&csl, "Empty token received");
-        blob_buf_free(&response_data.buf);
-        return -1;
+        return;
+    }
+    if (token_len >= sizeof(token_reply.token)) {
+        console_error(&csl, "Token too large for buffer (token: %zu, buffer: %zu)", token_len,
+                      sizeof(token_reply.token));
+        return;
     }
 
-    console_debug(&csl, "Token length: %zu", strlen(token));
+    memcpy(token_reply.token, token, token_len + 1);
+    token_reply.expiry = (time_t)blobmsg_get_u64(tb[EXPIRES_AT_FIELD]);
+    token_reply.received = true;
+}
 
-    // Copy token to buffer
-    size_t token_len = strlen(token);
-    if (token_len >= token_size) {
-        console_error(&csl, "Token too large for buffer (token: %zu, buffer: %zu)", token_len, token_size);
-        blob_buf_free(&response_data.buf);
-        return -1;
+/**
+ * Delay until the next token refresh
+ * The token is fetched TOKEN_REFRESH_MARGIN_S before it expires, or halfway
+ * for short-lived tokens. The delay is capped so a wall clock step (time
+ * sync after boot) cannot postpone the refresh past the real expiry.
+ */
+static uint32_t token_refresh_delay_ms(void) {
+    time_t remaining = token_expiry - time(NULL);
+    time_t margin = remaining / 2 < TOKEN_REFRESH_MARGIN_S ? remaining / 2 : TOKEN_REFRESH_MARGIN_S;
+    time_t delay = remaining - margin;
+
+    if (delay < 1) {
+        delay = 1;
+    } else if (delay > TOKEN_REFRESH_MAX_S) {
+        delay = TOKEN_REFRESH_MAX_S;
+    }
+
+    return (uint32_t)delay * 1000;
+}
+
+/**
+ * Install a freshly retrieved token and schedule the next refresh
+ */
+static void apply_access_token(void) {
+    memcpy(access_token, token_reply.token, sizeof(access_token));
+    token_expiry = token_reply.expiry;
+    token_initialized = true;
+    token_refreshes++;
+
+    console_info(&csl, "Access token refreshed, expires at %ld", (long)token_expiry);
+
+    // Reset network failure counter on successful token refresh
+    consecutive_network_failures = 0;
+    if (!accept_logs) {
+        console_info(&csl, "Enabling log acceptance - token available and network healthy");
+        ubus_set_log_acceptance(true);
     }
 
-    strncpy(token_buf, token, token_size - 1);
-    token_buf[token_size - 1] = '\0';
+    uloop_timeout_set(&token_refresh_timer, token_refresh_delay_ms());
+}
+
+/**
+ * Token request failed or timed out, retry sooner while the token is missing
+ */
+static void access_token_failed(void) {
+    bool valid = ubus_is_access_token_valid();
+    uint32_t retry_ms = valid ? TOKEN_RETRY_VALID_MS : TOKEN_RETRY_MISSING_MS;
 
-    // Extract expiry time
-    *expiry = (time_t)blobmsg_get_u64(tb[EXPIRES_AT_FIELD]);
+    token_failures++;
 
-    console_info(&csl, "Successfully retrieved access token, expires at %ld", *expiry);
+    // Logs cannot be uploaded without a token
+    if (!valid && accept_logs) {
+        console_warn(&csl, "Disabling log acceptance due to token refresh failure");
+        ubus_set_log_acceptance(false);
+    }
 
-    // Clean up
-    blob_buf_free(&response_data.buf);
+    console_info(&csl, "Scheduling token refresh retry in %u ms", retry_ms);
+    uloop_timeout_set(&token_refresh_timer, retry_ms);
+}
 
-    return 0;
+/**
+ * get_access_token completed
+ */
+static void token_complete_cb(struct ubus_request *req, int ret) {
+    if (!token_request_pending) {
+        return;
+    }
+    token_request_pending = false;
+
+    if (ret != 0 || !token_reply.received) {
+        console_error(&csl, "Failed to get access token: %s", ret ? ubus_strerror(ret) : "no valid reply");
+        access_token_failed();
+        return;
+    }
+
+    apply_access_token();
+}
+
+/**
+ * Drop a token request in flight, its connection is about to go away
+ */
+static void abort_token_request(void) {
+    if (token_request_pending) {
+        token_request_pending = false;
+        ubus_abort_request(ctx, &token_request);
+    }
+}
+
+/**
+ * Refresh timer: send the next request, or give up on the one in flight
+ * While a request is pending the timer is its deadline.
+ */
+static void token_refresh_timer_cb(struct uloop_timeout *timeout) {
+    if (token_request_pending) {
+        console_warn(&csl, "Access token request timed out");
+        abort_token_request();
+        access_token_failed();
+        return;
+    }
+
+    if (ubus_refresh_access_token() == -ENOTCONN) {
+        // Retried once the connection is back
+        uloop_timeout_set(&token_refresh_timer, TOKEN_RETRY_MISSING_MS);
+    }
+}
+
+/**
+ * fry-agent announced a token rotation
+ */
+static void token_event_cb(struct ubus_context *ctx, struct ubus_event_handler *ev, const char *type,
+                           struct blob_attr *msg) {
+    console_info(&csl, "Received %s event, fetching the new access token", type);
+    ubus_refresh_access_token();
 }
 
 /**
@@ -569,37 +1336,76 @@ bool ubus_is_access_token_valid(void) {
 }
 
 /**
- * Refresh access token
+ * Start an asynchronous access token refresh
  */
 int ubus_refresh_access_token(void) {
-    time_t new_expiry;
-    char new_token[256];
+    static struct blob_buf b;
+    uint32_t id;
+    int ret;
 
-    int ret = ubus_get_access_token(new_token, sizeof(new_token), &new_expiry);
-    if (ret < 0) {
-        console_error(&csl, "Failed to refresh access token");
-        return ret;
+    if (!ctx || !ubus_connected) {
+        return -ENOTCONN;
     }
 
-    // Update global token
-    strncpy(access_token, new_token, sizeof(access_token));
-    token_expiry = new_expiry;
-    token_initialized = true;
+    // Already on its way
+    if (token_request_pending) {
+        return 0;
+    }
 
-    // Reset network failure counter on successful token refresh
-    consecutive_network_failures = 0;
+    ret = ubus_lookup_id(ctx, "fry-agent", &id);
+    if (ret != 0) {
+        console_error(&csl, "Failed to find fry-agent object: %s", ubus_strerror(ret));
+        access_token_failed();
+        return -ENOENT;
+    }
 
-    // Enable log acceptance if token is valid and no network issues
-    bool should_accept = (consecutive_network_failures < MAX_NETWORK_FAILURES);
-    if (should_accept) {
-        if (!accept_logs) {
-            console_info(&csl, "Enabling log acceptance - token available and network healthy");
-            ubus_set_log_acceptance(true);
-        }
-    } else {
-        console_warn(&csl, "Token available but network issues detected, keeping log acceptance disabled");
+    blob_buf_init(&b, 0);
+    memset(&token_request, 0, sizeof(token_request));
+    ret = ubus_invoke_async(ctx, id, "get_access_token", b.head, &token_request);
+    if (ret != 0) {
+        console_error(&csl, "Failed to request access token: %s", ubus_strerror(ret));
+        access_token_failed();
+        return -EIO;
     }
 
-    console_info(&csl, "Access token refreshed successfully");
+    memset(&token_reply, 0, sizeof(token_reply));
+    token_request.data_cb = token_data_cb;
+    token_request.complete_cb = token_complete_cb;
+    ubus_complete_request_async(ctx, &token_request);
+    token_request_pending = true;
+
+    // Deadline of the request, the completion re-arms the timer for the next refresh
+    uloop_timeout_set(&token_refresh_timer, TOKEN_REQUEST_TIMEOUT_MS);
+    console_debug(&csl, "Requested access token from fry-agent");
     return 0;
 }
+
+/**
+ * Apply a reloaded configuration
+ * The filter is compiled aside and swapped in, the old one stays on failure.
+ */
+void ubus_apply_config(void) {
+    static log_filter_t staged;
+
+    if (filter_compile(&staged, &config_get_current()->filters) < 0) {
+        filter_free(&staged);
+        console_warn(&csl, "Keeping the previous log filter");
+        return;
+    }
+
+    // The reader thread switches over before its next read
+    if (ingest_thread_running()) {
+        ingest_thread_set_filter(&staged);
+        return;
+    }
+
+    staged.stats = log_filter.stats;
+    filter_free(&log_filter);
+    log_filter = staged;
+    memset(&staged, 0, sizeof(staged));
+}
+
+/**
+ * Get log filter statistics
+ */
+void ubus_get_filter_stats(filter_stats_t *stats) { *stats = log_filter.stats; }
@@ -1,6 +1,7 @@
 #ifndef UBUS_H
 #define UBUS_H
 
+#include "filter.h"
 #include <libubus.h>
 #include <stdbool.h>
 #include <time.h>
@@ -11,6 +12,22 @@
  */
 int ubus_init(void);
 
+/**
+ * Read logs from an already open logd stream instead of a UBUS subscription
+ * No UBUS connection is made and uploads use the given token. Used by the
+ * benchmark to replay log streams without ubusd, logd or fry-agent.
+ * @param log_fd Descriptor delivering blobmsg log records as logd sends them
+ * @param token Access token for uploads
+ * @return 0 on success, negative error code on failure
+ */
+int ubus_init_offline(int log_fd, const char *token);
+
+/**
+ * Check if the log stream is open
+ * @return true until the stream reached EOF or was stopped
+ */
+bool ubus_is_log_streaming(void);
+
 /**
  * Start the UBUS event loop in a separate thread
  * This function will block and handle UBUS events
@@ -29,15 +46,6 @@ void ubus_cleanup(void);
  */
 bool ubus_is_connected(void);
 
-/**
- * Retrieve access token from fry-agent via UBUS
- * @param token_buf Buffer to store the token (should be at least 256 bytes)
- * @param token_size Size of the token buffer
- * @param expiry Pointer to store token expiry time
- * @return 0 on success, negative error code on failure
- */
-int ubus_get_access_token(char *token_buf, size_t token_size, time_t *expiry);
-
 /**
  * Check if the cached access token is still valid
  * @return true if valid, false if expired or not available
@@ -45,8 +53,10 @@ int ubus_get_access_token(char *token_buf, size_t token_size, time_t *expiry);
 bool ubus_is_access_token_valid(void);
 
 /**
- * Force refresh of the cached access token from fry-agent
- * @return 0 on success, negative error code on failure
+ * Fetch a new access token from fry-agent without blocking
+ * The reply replaces the cached token, enables log acceptance and schedules
+ * the next refresh ahead of its expiry. Failures are retried on a timer.
+ * @return 0 if a request is in flight, negative error code on failure
  */
 int ubus_refresh_access_token(void);
 
@@ -74,4 +84,15 @@ const char *ubus_get_current_token(void);
  */
 void ubus_report_network_failure(int consecutive_failures);
 
+/**
+ * Apply a reloaded configuration to the log filter
+ */
+void ubus_apply_config(void);
+
+/**
+ * Get log filter statistics
+ * @param stats Filled with the current statistics
+ */
+void ubus_get_filter_stats(filter_stats_t *stats);
+
 #endif // UBUS_H
\ No newline at end of file
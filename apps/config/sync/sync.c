@@ -432,9 +432,9 @@ static int restart_services_production(const ServiceRestartNeeds *needs, ConfigA
         sleep(2);
     }
 
-    // 3. Restart fry-collector
+    // 3. Reload fry-collector (SIGHUP, keeps its queue), restart if that fails
     if (needs->fry_collector) {
-        console_info(&csl, "Restarting fry-collector...");
+        console_info(&csl, "Reloading fry-collector...");
 
         if (execute_service_command("/etc/init.d/fry-collector reload", "fry-collector", service_error, sizeof(service_error)) == 0) {
             console_info(&csl, "fry-collector reloaded successfully");